@@ -0,0 +1,54 @@
+#!/bin/sh
+# ԂŃq[vmۂȂƂm߂(make check)
+#
+# ĝẴlbg[NOԂvethAstamd-check -rňʒu2ĐB
+# stamd-check2ڂɃq[vmۂ1ŏIB
+# OԂȂƂ(rootłȂȂ)77ŏIAmake͎sȂƕ񍐂B
+#
+# ĐʒufixturenȂawkōB1b10A2bƂɉֈڂ
+# DAD蒼̂ŁA40bȂ1400𔻒f̒iɓnA20DADB
+#
+# usage: alloc.sh [stamd-check] [fixture]
+
+STAMD=${1:-./stamd-check}
+FIXTURE=$2
+PASS_SECONDS=${REPLAY_SECONDS:-40}
+NS=stamd-check.$$
+SKIP=77
+
+if [ "$(id -u)" != 0 ]; then
+    echo "check: not run (needs root for a network namespace)"
+    exit $SKIP
+fi
+if ! ip netns add "$NS" 2>/dev/null; then
+    echo "check: not run (ip netns is not available)"
+    exit $SKIP
+fi
+GENERATED=
+trap 'ip netns del "$NS"; if [ -n "$GENERATED" ]; then rm -f "$GENERATED"; fi' EXIT
+if [ -z "$FIXTURE" ]; then
+    GENERATED=$(mktemp) || exit 1
+    FIXTURE=$GENERATED
+    # time lat lon altB2ڂ̍ŏ1ڂ̍Ōォ牓̂ŁAŏDAD
+    awk -v n="$PASS_SECONDS" 'BEGIN {
+        for (i = 0; i < n * 10; i++) {
+            leg = int(i / 20);
+            printf "%d %.6f %.6f 10\n", int(i / 10), 35 + (leg % 10) * 0.3 + (i % 20) * 0.00001, 139 + (leg % 7) * 0.3;
+        }
+    }' > "$FIXTURE"
+fi
+
+ip netns exec "$NS" sysctl -q -w net.ipv6.conf.all.accept_dad=0 net.ipv6.conf.default.accept_dad=0
+ip -n "$NS" link set lo up
+ip -n "$NS" link add chk0 type veth peer name chk1
+ip -n "$NS" link set chk0 up
+ip -n "$NS" link set chk1 up
+
+ip netns exec "$NS" "$STAMD" -n -i chk0 -c '' -t 1 -r "$FIXTURE"
+status=$?
+if [ $status -eq 0 ]; then
+    echo "check: passed"
+else
+    echo "check: FAILED, stamd allocated heap memory in the steady state (exit $status)"
+fi
+exit $status
@@ -0,0 +1,74 @@
+/**
+ * @file sta_alloc.c
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief q[v̊mۂ̉
+ *
+ * ʒu̎󂯎肩DADA蓖Ă܂łƁAAREQ/AREP̏́ANɑ傫߂
+ * \X^bÑobt@gAԂł̓q[vmۂȂB
+ * ꂪĂȂƂm߂悤ɁASTA_ALLOC_COUNTtăRpC
+ * st@CmallocȂǂuāAglibc̖{(__libc_malloc)ĂԑOɉ񐔂𐔂B
+ * ûmake checkōstamd-checkŁAzzstamdglibcmalloĉ܂܎gB
+ * stamd -r͂̉񐔂ōĐ2ڂɊmۂȂ𒲂ׂB
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sta_alloc.h"
+
+#ifdef STA_ALLOC_COUNT
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+
+static uint64_t alloc_calls = 0;
+
+void *malloc(size_t size) {
+    __sync_fetch_and_add(&alloc_calls, 1);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+    __sync_fetch_and_add(&alloc_calls, 1);
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    __sync_fetch_and_add(&alloc_calls, 1);
+    return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size) {
+    __sync_fetch_and_add(&alloc_calls, 1);
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size) {
+    void *p = memalign(alignment, size);
+
+    if (p == NULL) {
+        return ENOMEM;
+    }
+    *memptr = p;
+    return 0;
+}
+#endif
+
+/**
+ * @brief q[vmۂ񐔂Ԃ
+ *
+ * NĂmallocAcallocAreallocAmemalignȂǂ̌Ăяo̐Bfree͐ȂB
+ * @return 񐔁BSTA_ALLOC_COUNTȂ̃rhłALLOC_NOT_COUNTED
+ */
+uint64_t alloc_count(void) {
+#ifdef STA_ALLOC_COUNT
+    return __sync_fetch_and_add(&alloc_calls, 0);
+#else
+    return ALLOC_NOT_COUNTED;
+#endif
+}
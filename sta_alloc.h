@@ -0,0 +1,18 @@
+/**
+ * @file sta_alloc.h
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief q[v̊mۂ̉
+ * ԂŃq[vgĂȂƂm߂邽߂ɁAmallocȂǂ̌Ăяo𐔂B
+ * ̂STA_ALLOC_COUNTtăRpCƂ(make checkstamd-check)B
+ */
+
+#ifndef _STA_ALLOC_H
+#define _STA_ALLOC_H
+
+#include <stdint.h>
+
+#define ALLOC_NOT_COUNTED UINT64_MAX ///< alloc_count̒lBȂrh
+
+uint64_t alloc_count(void);
+
+#endif
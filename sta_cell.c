@@ -0,0 +1,331 @@
+/**
+ * @file sta_cell.c
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief ZƂ̃}`LXgO[v
+ *
+ * STÄܓxEox̏ʃrbgZԍƂAZƂff02::/16̃O[v蓖ĂB
+ * AREQ͌AhX̃Z̃O[vɑ̂ŁÃm[hNIC̃tB^ŗƂB
+ * em[h͎STADAĎ̂܂3x3Z̃O[vɎQB
+ * STA̎(Xbg)ƂɒS̃ZoĂAO[v͎QƐŊǗB
+ * Xbg̓VOm[hȂ0݂STAA1DAĎA
+ * }`eig[hȂeigԍ*2+ʁB
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <sys/socket.h>
+#include "sta_cell.h"
+#include "sta_layout.h"
+
+/**
+ * @brief QĂO[v
+ */
+typedef struct _cell_group_entry {
+    cell_id cell;
+    int refs; ///< ̃O[vKvƂĂXbg̐
+    int next; ///< nbV\̘AA܂͋󂫃Xg
+} cell_group_entry;
+
+/**
+ * @brief XbgƂ̒S̃Z
+ */
+typedef struct _cell_slot {
+    int valid;
+    cell_id cell;
+} cell_slot;
+
+static int cell_sock = -1;
+static unsigned int cell_ifindex = 0;
+static int cell_shift = 0; ///< 0ȂgȂ
+static const sta_layout *cell_layout = NULL;
+static cell_slot *slots = NULL;
+static int nslots = 0;
+static cell_group_entry *groups = NULL;
+static int *group_head = NULL;
+static unsigned int group_mask = 0;
+static int group_free = -1;
+static int joined = 0; ///< QĂO[v̐
+static pthread_mutex_t cell_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief STAZԍo
+ *
+ * @param sta STA
+ * @param[out] cell Zԍ
+ * @retval 0 
+ * @retval -1 STAł͂Ȃ
+ */
+static int cell_of(const struct in6_addr *sta, cell_id *cell) {
+    uint64_t lat, lon;
+
+    if (sta_field_raw(cell_layout, sta, STA_LAT, &lat) != 0 || sta_field_raw(cell_layout, sta, STA_LON, &lon) != 0) {
+        return -1;
+    }
+    cell->lat = (uint32_t)(lat >> cell_shift);
+    cell->lon = (uint32_t)(lon >> cell_shift);
+    return 0;
+}
+
+/**
+ * @brief ZԍO[ṽAhX
+ *
+ * ff02::xx:5354:LLLL:LLOO:OOOO ̌`Bxx̓VtgʁAL͈ܓxAO͌ox̃Zԍ24bitB
+ * 5354"ST"B32bitMACAhX̃tB^ɎĝŁÃׂZm͋ʂB
+ * @param cell Zԍ
+ * @param[out] group O[ṽAhX
+ */
+static void cell_addr(const cell_id *cell, struct in6_addr *group) {
+    memset(group, 0, sizeof(*group));
+    group->s6_addr[0] = 0xff;
+    group->s6_addr[1] = 0x02;
+    group->s6_addr[7] = (uint8_t)cell_shift;
+    group->s6_addr[8] = 0x53;
+    group->s6_addr[9] = 0x54;
+    group->s6_addr[10] = (cell->lat >> 16) & 0xff;
+    group->s6_addr[11] = (cell->lat >> 8) & 0xff;
+    group->s6_addr[12] = cell->lat & 0xff;
+    group->s6_addr[13] = (cell->lon >> 16) & 0xff;
+    group->s6_addr[14] = (cell->lon >> 8) & 0xff;
+    group->s6_addr[15] = cell->lon & 0xff;
+}
+
+static unsigned int cell_hash(const cell_id *cell) {
+    return ((cell->lat * 73856093u) ^ (cell->lon * 19349663u)) & group_mask;
+}
+
+/**
+ * @brief O[vɎQA܂͗E
+ *
+ * @param cell Zԍ
+ * @param join 1ȂQA0Ȃ痣E
+ */
+static void cell_membership(const cell_id *cell, int join) {
+    struct ipv6_mreq mreq;
+
+    memset(&mreq, 0, sizeof(mreq));
+    mreq.ipv6mr_interface = cell_ifindex;
+    cell_addr(cell, &(mreq.ipv6mr_multiaddr));
+    if (setsockopt(cell_sock, IPPROTO_IPV6, join ? IPV6_ADD_MEMBERSHIP : IPV6_DROP_MEMBERSHIP, &mreq, sizeof(mreq)) < 0
+        && !(join && errno == EADDRINUSE)) { // 蒼O̎QcĂ
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[cell_membership] %s (%u, %u) error: %m", join ? "join" : "leave", cell->lat, cell->lon);
+        return;
+    }
+    joined += join ? 1 : -1;
+}
+
+/**
+ * @brief O[v̎QƐ𑝌
+ *
+ * 01ɂȂQA10ɂȂ痣EB
+ * cell_mutexԂŌĂԂƁB
+ * @param cell Zԍ
+ * @param delta +1-1
+ */
+static void cell_ref(const cell_id *cell, int delta) {
+    unsigned int h = cell_hash(cell);
+    int *pp;
+    int idx;
+
+    for (pp = &group_head[h]; *pp != -1; pp = &(groups[*pp].next)) {
+        if (groups[*pp].cell.lat == cell->lat && groups[*pp].cell.lon == cell->lon) {
+            break;
+        }
+    }
+    idx = *pp;
+
+    if (delta > 0) {
+        if (idx == -1) {
+            if (group_free == -1) {
+                return; // (Xbg+1)*CELL_NEAR̂őȂȂ邱Ƃ͂Ȃ
+            }
+            idx = group_free;
+            group_free = groups[idx].next;
+            groups[idx].cell = *cell;
+            groups[idx].refs = 0;
+            groups[idx].next = group_head[h];
+            group_head[h] = idx;
+            cell_membership(cell, 1);
+        }
+        groups[idx].refs++;
+    } else if (idx != -1) {
+        if (--groups[idx].refs == 0) {
+            cell_membership(cell, 0);
+            *pp = groups[idx].next;
+            groups[idx].next = group_free;
+            group_free = idx;
+        }
+    }
+}
+
+/**
+ * @brief Ẑ܂3x3̃O[v̎QƐ𑝌
+ *
+ * @param cell S̃Z
+ * @param delta +1-1
+ */
+static void cell_ref_near(const cell_id *cell, int delta) {
+    cell_id c;
+    int dlat, dlon;
+
+    for (dlat = -1; dlat <= 1; dlat++) {
+        for (dlon = -1; dlon <= 1; dlon++) {
+            if ((dlat < 0 && cell->lat == 0) || (dlon < 0 && cell->lon == 0)) {
+                continue; // ɂƌox-180x̊O
+            }
+            c.lat = cell->lat + dlat;
+            c.lon = cell->lon + dlon;
+            cell_ref(&c, delta);
+        }
+    }
+}
+
+/**
+ * @brief ZƂ̃O[vg
+ *
+ * @param sock AREQ󂯂\Pbg
+ * @param ifindex C^[tF[Xԍ
+ * @param layout STÃrbgzu
+ * @param shift ZԍɂƂɗƂʃrbgB0ȂgȂ
+ * @param count Xbg̐
+ * @retval 0 
+ * @retval -1 s
+ */
+int cell_init(int sock, unsigned int ifindex, const sta_layout *layout, int shift, int count) {
+    unsigned int nbuckets = 1;
+    int shift_min;
+    int i;
+
+    if (shift == 0) {
+        return 0;
+    }
+    // O[ṽAhXɂ͈ܓxƌox24bitȂ
+    shift_min = sta_layout_field(layout, STA_LAT)->bits;
+    if (sta_layout_field(layout, STA_LON)->bits > shift_min) {
+        shift_min = sta_layout_field(layout, STA_LON)->bits;
+    }
+    shift_min -= 24;
+    if (shift_min < 1) {
+        shift_min = 1;
+    }
+    if (shift < shift_min || shift > CELL_SHIFT_MAX || count <= 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[cell_init] invalid shift %d", shift);
+        return -1;
+    }
+
+    while (nbuckets < (unsigned int)(count + 1) * CELL_NEAR) {
+        nbuckets <<= 1;
+    }
+    slots = (cell_slot *)calloc(count, sizeof(cell_slot));
+    groups = (cell_group_entry *)calloc((size_t)(count + 1) * CELL_NEAR, sizeof(cell_group_entry));
+    group_head = (int *)malloc(nbuckets * sizeof(int));
+    if (slots == NULL || groups == NULL || group_head == NULL) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[cell_init] malloc error");
+        free(slots);
+        free(groups);
+        free(group_head);
+        return -1;
+    }
+    for (i = 0; i < (int)nbuckets; i++) {
+        group_head[i] = -1;
+    }
+    for (i = 0; i < (count + 1) * CELL_NEAR; i++) {
+        groups[i].next = (i + 1 < (count + 1) * CELL_NEAR) ? i + 1 : -1;
+    }
+    group_free = 0;
+    group_mask = nbuckets - 1;
+    nslots = count;
+    cell_sock = sock;
+    cell_ifindex = ifindex;
+    cell_shift = shift;
+    cell_layout = layout;
+    return 0;
+}
+
+/**
+ * @brief STÃZ̃O[ṽAhX߂
+ *
+ * @param sta STA
+ * @param[out] group O[ṽAhX
+ * @retval 0 
+ * @retval -1 ZƂ̃O[vgĂȂA܂STAł͂Ȃ
+ */
+int cell_group(const struct in6_addr *sta, struct in6_addr *group) {
+    cell_id cell;
+
+    if (cell_shift == 0 || cell_of(sta, &cell) == -1) {
+        return -1;
+    }
+    cell_addr(&cell, group);
+    return 0;
+}
+
+/**
+ * @brief XbgSTAς̂ŃO[vtւ
+ *
+ * VẐ܂ɐɎQĂÂẐ܂𗣒ÊŁA
+ * nhIt̓rAREQ肱ڂȂBZςȂΉȂB
+ * @param slot Xbg
+ * @param sta VSTABNULLȂXbgɂ
+ */
+void cell_follow(int slot, const struct in6_addr *sta) {
+    cell_slot next;
+
+    if (cell_shift == 0 || slot < 0 || slot >= nslots) {
+        return;
+    }
+    memset(&next, 0, sizeof(next));
+    if (sta != NULL && cell_of(sta, &(next.cell)) == 0) {
+        next.valid = 1;
+    }
+
+    pthread_mutex_lock(&cell_mutex);
+    if (next.valid == slots[slot].valid
+        && (!next.valid || (next.cell.lat == slots[slot].cell.lat && next.cell.lon == slots[slot].cell.lon))) {
+        pthread_mutex_unlock(&cell_mutex);
+        return;
+    }
+    if (next.valid) {
+        cell_ref_near(&(next.cell), +1);
+    }
+    if (slots[slot].valid) {
+        cell_ref_near(&(slots[slot].cell), -1);
+    }
+    slots[slot] = next;
+    pthread_mutex_unlock(&cell_mutex);
+}
+
+/**
+ * @brief C^[tF[X蒼ꂽ̂ŃO[vɎQ
+ *
+ * C^[tF[XƃJ[l͎QÔŁAQƐ̎cĂO[vɐVԍŎQB
+ * @param ifindex VC^[tF[Xԍ
+ */
+void cell_rejoin(unsigned int ifindex) {
+    unsigned int h;
+    int idx;
+
+    if (cell_shift == 0) {
+        return;
+    }
+    pthread_mutex_lock(&cell_mutex);
+    cell_ifindex = ifindex;
+    joined = 0;
+    for (h = 0; h <= group_mask; h++) {
+        for (idx = group_head[h]; idx != -1; idx = groups[idx].next) {
+            cell_membership(&(groups[idx].cell), 1);
+        }
+    }
+    pthread_mutex_unlock(&cell_mutex);
+}
+
+/**
+ * @brief QĂO[v̐
+ *
+ * @return O[v̐
+ */
+int cell_joined(void) {
+    return joined;
+}
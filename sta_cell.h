@@ -0,0 +1,35 @@
+/**
+ * @file sta_cell.h
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief ZƂ̃}`LXgO[v
+ * STȀʃrbgŌ܂ZƂɃN[J̃}`LXgO[v蓖Ă
+ */
+
+#ifndef _STA_CELL_H
+#define _STA_CELL_H
+
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include "sta_layout.h"
+
+#define CELL_SHIFT_MIN 2 ///< geo80ŃZԍ24bitɎ߂邽߂̍ŏlBzuƂ̍ŏlcell_init߂
+#define CELL_SHIFT_MAX 20
+#define CELL_SHIFT_DEFAULT 8 ///< ܓx110mAox230m(ԓ)
+#define CELL_NEAR 9 ///< 1̃ZɂĎQO[v̐(܂3x3)
+
+/**
+ * @brief Zԍ
+ */
+typedef struct _cell_id {
+    uint32_t lat; ///< STÄܓx̃tB[h̏
+    uint32_t lon; ///< STǍox̃tB[h̏
+} cell_id;
+
+int cell_init(int sock, unsigned int ifindex, const sta_layout *layout, int shift, int nslots);
+int cell_group(const struct in6_addr *sta, struct in6_addr *group);
+void cell_follow(int slot, const struct in6_addr *sta);
+void cell_rejoin(unsigned int ifindex);
+int cell_joined(void);
+
+#endif
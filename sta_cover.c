@@ -0,0 +1,350 @@
+/**
+ * @file sta_cover.c
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief nIȔ͈͂𕢂STÃvtBbNX
+ *
+ * STÅetB[h̃rbg͏ʂ珇ɕԂ̂ŁAvtBbNX߂
+ * tB[hƂɏʃrbg܂A肤l͋ԂɂȂB
+ * /481rbg΂ȂAS̃tB[h̋Ԃ͈͂Ɏ܂vtBbNXoA
+ * ͈͂ƏdȂȂ͎̂̂āAꕔdȂ̂̃rbg2ɕB
+ * Dɉ΂̂ŁAô͔͈͂Ɏ܂ő̃vtBbNXŁA菭Ȃmȕ͂ȂB
+ *
+ * mɕƐ𒴂Ƃ́Aŕ̂߂āAꕔdȂvtBbNX̂܂܏oB
+ * ͈͂LƂɂȂ̂ŁAǂꂾLexcessŕԂB
+ * oxƈܓx𑱂ĕׂzuł́Aox1̒lɌ܂܂ňܓx͍iȂ̂ŁA
+ * ƌox̑тŕƂɂȂBZI[_[̔zu("z:geo80"Ȃ)Ȃ痼𓯂ōiB
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sta_cover.h"
+
+#define COVER_RANGES 2 ///< 1̃tB[h͈̔͂̐B180x0܂2ɂȂ
+
+/**
+ * @brief tB[h͈̐̔
+ *
+ * [܂ށB̃tB[h2^(bits-1)𑫂āA召̏ƃrbg𑵂̏ĂB
+ */
+typedef struct _cover_range {
+    uint64_t lo;
+    uint64_t hi;
+} cover_range;
+
+/**
+ * @brief tB[hƂ͈̔
+ */
+typedef struct _cover_query {
+    int nranges[STA_LAYOUT_MAX_FIELDS]; ///< 0Ȃ͈͂w肵Ȃ
+    cover_range ranges[STA_LAYOUT_MAX_FIELDS][COVER_RANGES];
+} cover_query;
+
+/**
+ * @brief ΂Ăr̃vtBbNX
+ */
+typedef struct _cover_cell {
+    struct in6_addr addr;
+    int depth; ///< STA_PREFIX_LEN牄΂rbg
+    uint64_t value[STA_LAYOUT_MAX_FIELDS]; ///< tB[ȟ܂ʃrbg
+    int fixed[STA_LAYOUT_MAX_FIELDS]; ///< tB[ȟ܂rbg
+} cover_cell;
+
+/**
+ * @brief vtBbNXƔ͈͂̊֌W
+ */
+typedef enum _cover_state {
+    COVER_NONE, ///< dȂȂ
+    COVER_PARTIAL, ///< ꕔdȂ
+    COVER_FULL ///< ͈͂Ɏ܂
+} cover_state;
+
+static inline uint64_t cover_mask(int bits) {
+    return (bits >= 64) ? ~(uint64_t)0 : (((uint64_t)1 << bits) - 1);
+}
+
+/**
+ * @brief ltB[h̐ɂāA召̏ɕג
+ *
+ * rbgɎ܂Ȃl͒[Ɋ񂹂B
+ * @param fd tB[h
+ * @param v l
+ * @return Ȃ2^(bits-1)𑫂
+ */
+static uint64_t cover_raw(const sta_field *fd, double v) {
+    int64_t raw;
+
+    if (sta_field_quantize(fd, v, &raw) != 0) {
+        if (v < fd->offset) {
+            return 0;
+        }
+        return cover_mask(fd->bits);
+    }
+    if (fd->is_signed) {
+        return (uint64_t)(raw + ((int64_t)1 << (fd->bits - 1)));
+    }
+    return (uint64_t)raw;
+}
+
+/**
+ * @brief tB[h͈̔͂
+ *
+ * @param layout zu
+ * @param q ͈
+ * @param kind ށBzuɂȂΉȂ
+ * @param min ŏ
+ * @param max ő
+ * @param domain_min ނ̎肤ŏB͈͂܂œ͂ȂAtB[h̐̍ŏ܂ōL
+ * @param domain_max ނ̎肤ő
+ * @param wrap ŏő傫ƂɈĂ悢Ȃ1
+ * @retval 0 
+ * @retval -1 ͈͂Ȃ
+ */
+static int cover_query_add(const sta_layout *layout, cover_query *q, sta_kind kind, double min, double max,
+                           double domain_min, double domain_max, int wrap) {
+    const sta_field *fd = sta_layout_field(layout, kind);
+    uint64_t lo, hi;
+    int i;
+
+    if (isnan(min) || isnan(max)) {
+        return -1;
+    }
+    if (fd == NULL) {
+        return 0;
+    }
+    i = (int)(fd - layout->fields);
+    if (min > max && !wrap) {
+        return -1;
+    }
+    // ܓx90xȂǂ̃rbg͎gȂ̂ŁAvtBbNX傫Ȃ悤Ɋ܂߂Ă
+    lo = (min <= domain_min) ? 0 : cover_raw(fd, min);
+    hi = (max >= domain_max) ? cover_mask(fd->bits) : cover_raw(fd, max);
+    if (min <= max) {
+        q->nranges[i] = 1;
+        q->ranges[i][0].lo = lo;
+        q->ranges[i][0].hi = hi;
+    } else if (lo > hi) {
+        q->nranges[i] = 2;
+        q->ranges[i][0].lo = 0;
+        q->ranges[i][0].hi = hi;
+        q->ranges[i][1].lo = lo;
+        q->ranges[i][1].hi = cover_mask(fd->bits);
+    } // ēlɖ߂Ȃ͈͂w肵Ȃ̂Ɠ
+    return 0;
+}
+
+/**
+ * @brief vtBbNXŌ܂tB[h̋
+ *
+ * @param fd tB[h
+ * @param value ܂ʃrbg
+ * @param fixed ܂rbg
+ * @param[out] lo ŏ
+ * @param[out] hi ő
+ */
+static void cover_interval(const sta_field *fd, uint64_t value, int fixed, uint64_t *lo, uint64_t *hi) {
+    if (fixed == 0) {
+        *lo = 0;
+        *hi = cover_mask(fd->bits);
+        return;
+    }
+    if (fd->is_signed) {
+        value ^= (uint64_t)1 << (fixed - 1); // rbg𔽓]Ƒ召̏ɂȂ
+    }
+    *lo = value << (fd->bits - fixed);
+    *hi = *lo | cover_mask(fd->bits - fixed);
+}
+
+/**
+ * @brief vtBbNX͈͂ƂǂdȂ邩ׂ
+ *
+ * @param layout zu
+ * @param q ͈
+ * @param cell vtBbNX
+ * @param[out] inside vtBbNX͈̂͂ɓ鐔BNULLȂ狁߂Ȃ
+ * @return cover_state
+ */
+static cover_state cover_classify(const sta_layout *layout, const cover_query *q, const cover_cell *cell, double *inside) {
+    cover_state state = COVER_FULL;
+    uint64_t lo, hi, a, b;
+    double n;
+    int full, hit;
+    int i, r;
+
+    if (inside != NULL) {
+        *inside = 1.0;
+    }
+    for (i = 0; i < layout->nfields; i++) {
+        cover_interval(&(layout->fields[i]), cell->value[i], cell->fixed[i], &lo, &hi);
+        if (q->nranges[i] == 0) {
+            if (inside != NULL) {
+                *inside *= (double)(hi - lo) + 1.0;
+            }
+            continue;
+        }
+        full = 0;
+        hit = 0;
+        n = 0.0;
+        for (r = 0; r < q->nranges[i]; r++) {
+            if (lo >= q->ranges[i][r].lo && hi <= q->ranges[i][r].hi) {
+                full = 1;
+            }
+            if (hi >= q->ranges[i][r].lo && lo <= q->ranges[i][r].hi) {
+                hit = 1;
+                a = (lo > q->ranges[i][r].lo) ? lo : q->ranges[i][r].lo;
+                b = (hi < q->ranges[i][r].hi) ? hi : q->ranges[i][r].hi;
+                n += (double)(b - a) + 1.0;
+            }
+        }
+        if (inside != NULL) {
+            *inside *= n;
+        }
+        if (!hit) {
+            return COVER_NONE;
+        }
+        if (!full) {
+            state = COVER_PARTIAL;
+        }
+    }
+    return state;
+}
+
+/**
+ * @brief vtBbNXo
+ *
+ * @param layout zu
+ * @param q ͈
+ * @param cell vtBbNX
+ * @param[out] out o
+ * @param[in,out] total ovtBbNX̑傫̍v
+ * @param[in,out] inside ovtBbNX͈̂͂ɓ鐔̍v
+ */
+static void cover_emit(const sta_layout *layout, const cover_query *q, const cover_cell *cell,
+                       sta_prefix *out, double *total, double *inside) {
+    double n;
+    int i;
+
+    out->addr = cell->addr;
+    out->len = STA_PREFIX_LEN + cell->depth;
+    cover_classify(layout, q, cell, &n);
+    *inside += n;
+    n = 1.0;
+    for (i = 0; i < layout->nfields; i++) {
+        n *= ldexp(1.0, layout->fields[i].bits - cell->fixed[i]);
+    }
+    *total += n;
+}
+
+/**
+ * @brief ͈͂𕢂vtBbNX߂
+ *
+ * mɕȂ炻̂΂񏭂ȂvtBbNXԂB
+ * max𒴂ȂAmaxȓŔ͈͂LvtBbNXԂB
+ * @param layout zu
+ * @param box ͈
+ * @param[out] out vtBbNXBmax̑傫邱
+ * @param max vtBbNX̐̏
+ * @param[out] excess STA͈̐͂ɓSTA̐̉{BmȂ1BNULLȂԂȂ
+ * @return vtBbNX̐B͈͂Ȃ-1
+ */
+int sta_cover(const sta_layout *layout, const sta_box *box, sta_prefix *out, int max, double *excess) {
+    cover_query q;
+    cover_cell *done, *cur, *next, *tmp;
+    cover_cell child;
+    cover_state state;
+    double total = 0.0;
+    double inside = 0.0;
+    int ndone, ncur, nnext, level;
+    int depth, bit, f, j, c, i;
+    int overflow = 0;
+
+    if (max < 1) {
+        return -1;
+    }
+    memset(&q, 0, sizeof(q));
+    if (cover_query_add(layout, &q, STA_LAT, box->lat_min, box->lat_max, -90.0, 90.0, 0) != 0
+        || cover_query_add(layout, &q, STA_LON, box->lon_min, box->lon_max, -180.0, 180.0, 1) != 0
+        || (box->has_alt && cover_query_add(layout, &q, STA_ALT, box->alt_min, box->alt_max, -HUGE_VAL, HUGE_VAL, 0) != 0)
+        || (box->has_time && cover_query_add(layout, &q, STA_TIME, (double)box->tod_start, (double)box->tod_end,
+                                             0.0, 86399.0, 1) != 0)) {
+        return -1;
+    }
+    done = (cover_cell *)malloc((size_t)max * sizeof(cover_cell));
+    cur = (cover_cell *)malloc((size_t)max * sizeof(cover_cell));
+    next = (cover_cell *)malloc((size_t)max * sizeof(cover_cell));
+    if (done == NULL || cur == NULL || next == NULL) {
+        free(done);
+        free(cur);
+        free(next);
+        return -1;
+    }
+
+    memset(&(cur[0]), 0, sizeof(cur[0]));
+    sta_layout_prefix(&(cur[0].addr));
+    ndone = 0;
+    ncur = 0;
+    state = cover_classify(layout, &q, &(cur[0]), NULL);
+    if (state == COVER_FULL) {
+        done[ndone++] = cur[0];
+    } else if (state == COVER_PARTIAL) {
+        ncur = 1;
+    }
+
+    // ꕔdȂvtBbNX1rbg΂Bndone + ncur <= maxۂ
+    for (depth = 0; ncur > 0 && depth < STA_BITS; depth++) {
+        f = sta_layout_bit(layout, depth, &j);
+        bit = STA_PREFIX_LEN + depth;
+        nnext = 0;
+        level = ndone;
+        for (i = 0; i < ncur && !overflow; i++) {
+            for (c = 0; c < 2 && !overflow; c++) {
+                if (f < 0 && c == 1) {
+                    break; // ǂ̃tB[hgĂȂrbg0
+                }
+                child = cur[i];
+                child.depth = depth + 1;
+                if (c) {
+                    child.addr.s6_addr[bit / 8] |= (uint8_t)(0x80 >> (bit % 8));
+                }
+                if (f >= 0) {
+                    child.value[f] = (child.value[f] << 1) | (uint64_t)c;
+                    child.fixed[f]++;
+                }
+                state = cover_classify(layout, &q, &child, NULL);
+                if (state == COVER_NONE) {
+                    continue;
+                }
+                if (level + nnext == max) {
+                    overflow = 1;
+                } else if (state == COVER_FULL) {
+                    done[level++] = child;
+                } else {
+                    next[nnext++] = child;
+                }
+            }
+        }
+        if (overflow) {
+            break; // ̐[͒߂āAꕔdȂvtBbNX̂܂ܕ
+        }
+        ndone = level;
+        tmp = cur;
+        cur = next;
+        next = tmp;
+        ncur = nnext;
+    }
+
+    for (i = 0; i < ndone; i++) {
+        cover_emit(layout, &q, &(done[i]), &(out[i]), &total, &inside);
+    }
+    for (i = 0; i < ncur; i++) {
+        cover_emit(layout, &q, &(cur[i]), &(out[ndone + i]), &total, &inside);
+    }
+    if (excess != NULL) {
+        *excess = (inside > 0.0) ? total / inside : 1.0;
+    }
+    free(done);
+    free(cur);
+    free(next);
+    return ndone + ncur;
+}
@@ -0,0 +1,46 @@
+/**
+ * @file sta_cover.h
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief nIȔ͈͂𕢂STÃvtBbNX
+ * ܓxox͈̔(ƍxA͈̔)ɓSTAAł邾ȂvtBbNXŕ\B
+ * WILXǧoHAt@CAEH[̃[ALv`̃tB^Ɏg
+ */
+
+#ifndef _STA_COVER_H
+#define _STA_COVER_H
+
+#include <netinet/in.h>
+#include "sta_layout.h"
+
+#define STA_COVER_DEFAULT_MAX 64 ///< vtBbNX̐̊̏
+
+/**
+ * @brief ͈
+ *
+ * [܂ށBoxƎ͍ŏő傫΁A180x0܂͈͂ɂȂB
+ * zuɂȂނ͈̔͂͌ȂB
+ */
+typedef struct _sta_box {
+    double lat_min;
+    double lat_max;
+    double lon_min;
+    double lon_max;
+    int has_alt; ///< x͈̔͂w肷Ȃ1
+    double alt_min;
+    double alt_max;
+    int has_time; ///< ͈̔͂w肷Ȃ1
+    long tod_start; ///< ̓0̕b(n)
+    long tod_end;
+} sta_box;
+
+/**
+ * @brief vtBbNX
+ */
+typedef struct _sta_prefix {
+    struct in6_addr addr;
+    int len; ///< vtBbNXBSTA_PREFIX_LENȏ
+} sta_prefix;
+
+int sta_cover(const sta_layout *layout, const sta_box *box, sta_prefix *out, int max, double *excess);
+
+#endif
@@ -0,0 +1,180 @@
+/**
+ * @file sta_ctl.c
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief \Pbg
+ * stamd̓ԂstaconfigȂǂ̃[J̃c[ɌUnixhC\PbgB
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "sta_ctl.h"
+
+sta_metrics metrics; ///< stamd̃JE^
+
+static int ctl_listen_fd = -1;
+static sta_ctl_handler ctl_handler = NULL;
+
+static void *ctl_server(void *arg);
+
+/**
+ * @brief 1̐ڑ̗v
+ *
+ * SOCK_SEQPACKETȂ̂1recv1̗v낤B
+ * 肪邩G[ɂȂ܂ŗvƕԓJԂB
+ * @param fd ڑς݂̃\Pbg
+ * @param req v󂯂STA_CTL_MAX_MSG̃obt@
+ * @param rep ԓgݗĂSTA_CTL_MAX_MSG̃obt@
+ */
+static void ctl_serve_connection(int fd, char *req, char *rep) {
+    sta_ctl_hdr *req_hdr;
+    sta_ctl_hdr *rep_hdr;
+    ssize_t len;
+
+    req_hdr = (sta_ctl_hdr *)req;
+    rep_hdr = (sta_ctl_hdr *)rep;
+
+    while ((len = recv(fd, req, STA_CTL_MAX_MSG, 0)) > 0) {
+        METRIC_INC(ctl_requests);
+        memset(rep_hdr, 0, sizeof(*rep_hdr));
+        rep_hdr->version = STA_CTL_VERSION;
+
+        if ((size_t)len < sizeof(sta_ctl_hdr) || req_hdr->version != STA_CTL_VERSION
+            || req_hdr->len != (size_t)len - sizeof(sta_ctl_hdr)) {
+            rep_hdr->status = STA_CTL_EINVAL;
+        } else {
+            rep_hdr->op = req_hdr->op;
+            rep_hdr->tenant = req_hdr->tenant;
+            (*ctl_handler)(req_hdr, req + sizeof(sta_ctl_hdr), rep_hdr,
+                           rep + sizeof(sta_ctl_hdr), STA_CTL_MAX_MSG - sizeof(sta_ctl_hdr));
+        }
+
+        if (send(fd, rep, sizeof(sta_ctl_hdr) + rep_hdr->len, MSG_NOSIGNAL) < 0) {
+            syslog(LOG_LOCAL0|LOG_DEBUG, "[ctl_serve_connection] send error: %m");
+            break;
+        }
+    }
+}
+
+/**
+ * @brief \Pbg̎tXbh
+ *
+ * v͏ÎŁAڑ1ԂɏB
+ * NCAgŋl܂Ȃ悤ɎMɂ̓^CAEgB
+ * vƕԓ̃obt@͍ŏ1񂾂mۂAڑƂɂ͊mۂȂB
+ * @param arg gĂȂ
+ * @return NULLԂ
+ */
+static void *ctl_server(void *arg) {
+    int fd;
+    struct timeval tv;
+    char *req;
+    char *rep;
+
+    (void)arg;
+    pthread_detach(pthread_self());
+
+    req = (char *)malloc(STA_CTL_MAX_MSG);
+    rep = (char *)malloc(STA_CTL_MAX_MSG);
+    if (req == NULL || rep == NULL) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[ctl_server] malloc error");
+        free(req);
+        free(rep);
+        return NULL;
+    }
+
+    for (;;) {
+        fd = accept(ctl_listen_fd, NULL, NULL);
+        if (fd < 0) {
+            syslog(LOG_LOCAL0|LOG_DEBUG, "[ctl_server] accept error: %m");
+            continue;
+        }
+        tv.tv_sec = 1;
+        tv.tv_usec = 0;
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+        ctl_serve_connection(fd, req, rep);
+        close(fd);
+    }
+    free(req);
+    free(rep);
+    return NULL;
+}
+
+/**
+ * @brief \PbgJĎtXbhN
+ *
+ * Â\Pbgt@CcĂΏĂbindB
+ * ̃pXȂSTA_CTL_DIR0700ōB
+ * bindĂchmodƂ̊Ԃɂւ̂ŁAumaskŏ߂0600ōB
+ * @param path \Pbg̃pX
+ * @param handler v֐
+ * @retval 0 
+ * @retval -1 s
+ */
+int sta_ctl_start(const char *path, sta_ctl_handler handler) {
+    struct sockaddr_un sun;
+    struct stat st;
+    pthread_t tid;
+    mode_t mask;
+    int ret;
+
+    if (strlen(path) >= sizeof(sun.sun_path)) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[sta_ctl_start] path too long: %s", path);
+        return -1;
+    }
+    if (strcmp(path, STA_CTL_PATH) == 0) {
+        if (mkdir(STA_CTL_DIR, S_IRWXU) == -1 && errno != EEXIST) {
+            syslog(LOG_LOCAL0|LOG_DEBUG, "[sta_ctl_start] mkdir %s error: %m", STA_CTL_DIR);
+            return -1;
+        }
+        // ق̃[U[ɍfBNgȂgȂ
+        if (lstat(STA_CTL_DIR, &st) == -1 || !S_ISDIR(st.st_mode) || st.st_uid != geteuid()
+            || (st.st_mode & (S_IWGRP | S_IWOTH)) != 0) {
+            syslog(LOG_LOCAL0|LOG_DEBUG, "[sta_ctl_start] %s is not a private directory", STA_CTL_DIR);
+            return -1;
+        }
+    }
+
+    ctl_listen_fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (ctl_listen_fd < 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[sta_ctl_start] socket error: %m");
+        return -1;
+    }
+
+    memset(&sun, 0, sizeof(sun));
+    sun.sun_family = AF_UNIX;
+    strcpy(sun.sun_path, path);
+    unlink(path);
+
+    mask = umask(S_IXUSR | S_IRWXG | S_IRWXO);
+    ret = bind(ctl_listen_fd, (struct sockaddr *)&sun, sizeof(sun));
+    umask(mask);
+    if (ret == -1) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[sta_ctl_start] bind error: %m");
+        close(ctl_listen_fd);
+        return -1;
+    }
+
+    if (listen(ctl_listen_fd, 8) == -1) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[sta_ctl_start] listen error: %m");
+        close(ctl_listen_fd);
+        return -1;
+    }
+
+    ctl_handler = handler;
+    if (pthread_create(&tid, NULL, ctl_server, NULL) != 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[sta_ctl_start] pthread_create error: %m");
+        close(ctl_listen_fd);
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,168 @@
+/**
+ * @file sta_ctl.h
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief \Pbg
+ * stamd̓ԂstaconfigȂǂ̃[J̃c[ɌUnixhC\PbgB
+ * staconfigincludêŁAstamd̑̃wb_ɈˑȂƁB
+ */
+
+#ifndef _STA_CTL_H
+#define _STA_CTL_H
+
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <stdint.h>
+
+#define STA_CTL_DIR "/run/stamd" ///< STA_CTL_PATHuArootfBNg
+#define STA_CTL_PATH STA_CTL_DIR "/stamd.ctl"
+#define STA_CTL_VERSION 1
+#define STA_CTL_MAX_MSG 65536 ///< 1bZ[W̍ő咷(wb_)
+#define STA_CTL_ALL_TENANTS 0xffffffff ///< tenantɓƃVOm[h܂͑Seig
+
+/**
+ * @brief v̎
+ */
+typedef enum _sta_ctl_op {
+    STA_CTL_GET_STA = 1, ///< ݂STABԓsta_ctl_sta
+    STA_CTL_GET_PENDING = 2, ///< DAĎAhXBԓsta_ctl_dad
+    STA_CTL_GET_DAD = 3, ///< SDADZbVBԓsta_ctl_dad̔z
+    STA_CTL_GET_NEIGH = 4, ///< ߗ׃m[hBԓsta_ctl_neigh̔z
+    STA_CTL_GET_METRICS = 5, ///< JE^Bԓsta_metrics
+    STA_CTL_ADD = 6, ///< ʒuSTADADBvsta_ctl_positionAԓsta_ctl_dad
+    STA_CTL_DEL = 7 ///< ݂STA폜Bvsta_ctl_ifname
+} sta_ctl_op;
+
+/**
+ * @brief ԓ̏
+ */
+typedef enum _sta_ctl_status {
+    STA_CTL_OK = 0,
+    STA_CTL_ENOENT = 1, ///< YȂ
+    STA_CTL_EINVAL = 2, ///< v
+    STA_CTL_EBUSY = 3, ///< DAD
+    STA_CTL_ENOTSUP = 4 ///< Ή̗v
+} sta_ctl_status;
+
+#define STA_CTL_F_TRUNCATED 0x01 ///< ԓērŐ؂
+
+/**
+ * @brief vƕԓɋʂ̃wb_
+ *
+ * [JʐMȂ̂ŃzXgoCgI[_[B̌lenoCg̃yC[hB
+ */
+typedef struct _sta_ctl_hdr {
+    uint8_t version; ///< STA_CTL_VERSION
+    uint8_t op; ///< sta_ctl_op
+    uint8_t status; ///< sta_ctl_statusBvł0
+    uint8_t flags; ///< STA_CTL_F_*
+    uint32_t tenant; ///< eigԍA܂STA_CTL_ALL_TENANTS
+    uint32_t len; ///< yC[h̒
+} sta_ctl_hdr;
+
+/**
+ * @brief C^[tF[X
+ */
+typedef struct _sta_ctl_ifname {
+    char ifname[16]; ///< IF_NAMESIZE
+} sta_ctl_ifname;
+
+/**
+ * @brief STA_CTL_GET_STA̕ԓ
+ */
+typedef struct _sta_ctl_sta {
+    char ifname[16]; ///< stamdǗĂC^[tF[X
+    struct in6_addr addr; ///< ݂STA
+} sta_ctl_sta;
+
+/**
+ * @brief DADZbV
+ */
+typedef struct _sta_ctl_dad {
+    uint32_t tenant; ///< eigԍBVOm[hȂSTA_CTL_ALL_TENANTS
+    int32_t state; ///< address_status̒l
+    struct in6_addr addr; ///< AhX
+    int64_t generated_time; ///< DADn߂
+    int64_t deadline; ///< DADł؂鎞
+} sta_ctl_dad;
+
+/**
+ * @brief ߗ׃m[h
+ */
+typedef struct _sta_ctl_neigh {
+    struct in6_addr addr; ///< ߗ׃m[hSTA
+    struct in6_addr from; ///< pPbg̑M
+    double lat;
+    double lon;
+    double alt;
+    int64_t last_seen; ///< Ōɕ
+} sta_ctl_neigh;
+
+/**
+ * @brief STA_CTL_ADD̗v
+ */
+typedef struct _sta_ctl_position {
+    char ifname[16];
+    int32_t nodeid[16]; ///< }`eig[hł̃m[hID
+    int64_t time;
+    double lat;
+    double lon;
+    double alt;
+} sta_ctl_position;
+
+/**
+ * @brief stamd̃JE^
+ *
+ * stamd̒ł̍\̂̂܂ܐāASTA_CTL_GET_METRICSł̂܂ܕԂB
+ */
+typedef struct _sta_metrics {
+    uint64_t samples; ///< FIFO󂯎ʒu̐
+    uint64_t areq_sent;
+    uint64_t areq_recv;
+    uint64_t arep_sent;
+    uint64_t arep_recv;
+    uint64_t dad_started;
+    uint64_t dad_completed; ///< dȂŊm肵
+    uint64_t dad_duplicate; ///< d
+    uint64_t addr_added;
+    uint64_t addr_deleted;
+    uint64_t ctl_requests;
+    uint64_t areq_unicast; ///< ߗ׃m[hɃjLXgAREQ̐
+    uint64_t areq_skipped; ///< gĂȂBߗ׃m[h̕\łAREQ̓}`LXg
+    uint64_t cell_groups; ///< QĂZƂ̃}`LXgO[v̐(JE^ł͂Ȃ)
+    uint64_t areq_addresses; ///< AREQŖ₢킹AhX̐
+    uint64_t dad_fallback; ///< {dĂ̂ŗ\̌Ŋm肵
+    uint64_t wire_malformed; ///< ͂łɎ̂ĂpPbg̐
+    uint64_t arep_suppressed; ///< dȂȂ̂ŕԂȂAREP̐
+    uint64_t link_events; ///< wlan_interface̍蒼グ̐
+    uint64_t startup_us; ///< NĂAREQɐ܂ł̎[}CNb](JE^ł͂Ȃ)
+    uint64_t exit_margin; ///< L͈͂̊O]T̒̕Ȃ̂DADȂʒu̐
+    uint64_t exit_dwell; ///< ]T̕oĂ܂Ȃ̂DADȂʒu̐
+    uint64_t exit_return; ///< _֖̕߂ĂĂ̂DADȂʒu̐
+    uint64_t addr_deprecated; ///< ؂ւŔ񐄏ɂĎcÂSTA̐
+    uint64_t exit_unsure; ///< Mȉ~L͈͂̋EɂĂ̂DADȂʒu̐
+    uint64_t allocations; ///< NĂq[vmۂ񐔁BȂrhłALLOC_NOT_COUNTED
+    uint64_t queue_decision; ///< f̒ĩL[ɗ܂Ăʒu̐(JE^ł͂Ȃ)
+    uint64_t queue_dad; ///< DAD̒ĩL[ɗ܂Ăʒu̐(JE^ł͂Ȃ)
+    uint64_t queue_program; ///< AhX̐ݒ̒ĩL[ɗ܂ĂSTA̐(JE^ł͂Ȃ)
+    uint64_t queue_dropped; ///< ĩL[tŎ̂Ăʒu̐
+} sta_metrics;
+
+#define METRIC_INC(name) __sync_fetch_and_add(&(metrics.name), 1)
+#define METRIC_ADD(name, n) __sync_fetch_and_add(&(metrics.name), (n))
+
+/**
+ * @brief v֐̌^
+ *
+ * @param req ṽwb_
+ * @param payload ṽyC[h
+ * @param[out] rep ԓ̃wb_BstatusAflagsAlen𖄂߂
+ * @param[out] out ԓ̃yC[h̏ݐ
+ * @param outmax out̑傫
+ */
+typedef void (*sta_ctl_handler)(const sta_ctl_hdr *req, const void *payload, sta_ctl_hdr *rep, void *out, size_t outmax);
+
+extern sta_metrics metrics;
+
+int sta_ctl_start(const char *path, sta_ctl_handler handler);
+
+#endif
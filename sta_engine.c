@@ -0,0 +1,640 @@
+/**
+ * @file sta_engine.c
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief FIFOUDP\Pbg̓͂̃GW
+ *
+ * ]PositionOut1read邽сApPbg1recvfrom邽тɃVXeR[
+ * 1ĂсAꂼ̃XbhubNĂBłFIFOUDP\Pbg1̃[vœǂށB
+ *
+ * epoll͏̂ł\PbgENGINE_BATCH܂őēǂށB
+ * io_uringUDP\PbgƂprovided buffer̃OgM(multishot recvmsg)
+ * 1oĂAFIFOreadƍ킹āAƂ̍ēƎ̊̑҂
+ * 1io_uring_enterōsBM̂т̃VXeR[͂ȂȂB
+ * io_uringgȂ(ÂJ[lAseccompȂ)ƂepollœB
+ *
+ * AREP͎󂯎obt@̒őgݗĂ̂ŁA[vreply_hold
+ * 󂯎pPbgIƂreply_flushł܂Ƃ߂đB
+ * io_uringłprovided bufferJ[lɕԂ(engine_ring_publish)OɑB
+ * ^C}[͏]̂܂܁BĂяo̊֐͏]̎MXbhƓƂĂ悢A
+ * ̊Ԃ̃[v̑̓͂͑҂B
+ */
+
+#define _GNU_SOURCE // recvmmsg
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+#include "sta_engine.h"
+#include "sta_reply.h"
+
+#if defined(__NR_io_uring_setup) && defined(IORING_RECV_MULTISHOT)
+#define ENGINE_HAVE_URING 1
+#endif
+
+/**
+ * @brief FIFO̓ǂ݂̃R[h
+ */
+typedef struct _engine_fifo {
+    int fd;
+    size_t record_size;
+    char *buf; ///< ENGINE_FIFO_RECORDS
+    size_t used; ///< bufɂ܂ĂoCg
+    engine_record_fn on_record;
+} engine_fifo;
+
+/**
+ * @brief GW̖Oނ
+ *
+ * @param s "threads"A"epoll"A"uring"
+ * @param[out] kind 
+ * @retval 0 
+ * @retval -1 mȂO
+ */
+int engine_from_string(const char *s, engine_kind *kind) {
+    if (strcmp(s, "threads") == 0) {
+        *kind = ENGINE_THREADS;
+    } else if (strcmp(s, "epoll") == 0) {
+        *kind = ENGINE_EPOLL;
+    } else if (strcmp(s, "uring") == 0) {
+        *kind = ENGINE_URING;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief GW̖O
+ *
+ * @param kind 
+ * @return O
+ */
+const char *engine_name(engine_kind kind) {
+    switch (kind) {
+    case ENGINE_EPOLL:
+        return "epoll";
+    case ENGINE_URING:
+        return "uring";
+    default:
+        return "threads";
+    }
+}
+
+/**
+ * @brief ǂ񂾃oCgR[hɐ؂ēn
+ *
+ * FIFOւ݂̏1R[hƂ͌Ȃ̂ŁA[͎ɉ񂷁B
+ * @param fifo FIFO
+ * @param n Vǂ񂾃oCg
+ */
+static void engine_fifo_consume(engine_fifo *fifo, size_t n) {
+    size_t off = 0;
+
+    fifo->used += n;
+    while (fifo->used - off >= fifo->record_size) {
+        fifo->on_record(fifo->buf + off);
+        off += fifo->record_size;
+    }
+    if (off > 0) {
+        memmove(fifo->buf, fifo->buf + off, fifo->used - off);
+        fifo->used -= off;
+    }
+}
+
+/**
+ * @brief recvmmsg̎Mobt@pӂ
+ *
+ * @param bufs obt@
+ * @param from M
+ * @param iov bufswiovec
+ * @param[out] msgs recvmmsgɓn
+ */
+static void engine_mmsg_init(char (*bufs)[ENGINE_PACKET_SIZE], struct sockaddr_in6 *from, struct iovec *iov, struct mmsghdr *msgs) {
+    int i;
+
+    for (i = 0; i < ENGINE_BATCH; i++) {
+        iov[i].iov_base = bufs[i];
+        iov[i].iov_len = ENGINE_PACKET_SIZE;
+        memset(&(msgs[i]), 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_name = &from[i];
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+}
+
+/**
+ * @brief \Pbgǂ߂邾ǂ
+ *
+ * recvmmsgENGINE_BATCH܂ł܂Ƃ߂ēǂ݁A1̃\Pbgɕ΂Ȃ悤ɂŎ~߂B
+ * ̊ԂAREP͓ǂ񂾃obt@̒őgݗĂĂ̂ŁAŌɂ܂Ƃ߂đB
+ * @param fd \Pbg
+ * @param on_packet pPbgn֐
+ */
+static void engine_drain_udp(int fd, engine_packet_fn on_packet) {
+    char bufs[ENGINE_BATCH][ENGINE_PACKET_SIZE];
+    struct sockaddr_in6 from[ENGINE_BATCH];
+    struct iovec iov[ENGINE_BATCH];
+    struct mmsghdr msgs[ENGINE_BATCH];
+    int n, i;
+
+    engine_mmsg_init(bufs, from, iov, msgs);
+    for (i = 0; i < ENGINE_BATCH; i++) {
+        msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+    }
+    n = recvmmsg(fd, msgs, ENGINE_BATCH, MSG_DONTWAIT, NULL);
+    if (n < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            syslog(LOG_LOCAL0|LOG_DEBUG, "[engine_drain_udp] recvmmsg error: %m");
+        }
+        return;
+    }
+    for (i = 0; i < n; i++) {
+        on_packet(fd, &from[i], bufs[i], (int)msgs[i].msg_len);
+    }
+    reply_flush();
+}
+
+/**
+ * @brief epoll̃[v
+ *
+ * @retval 0 FIFOꂽ
+ * @retval -1 s
+ */
+static int engine_run_epoll(const int *udp_fds, int nudp, engine_fifo *fifo, engine_packet_fn on_packet) {
+    struct epoll_event ev, events[ENGINE_BATCH];
+    ssize_t len;
+    int ep;
+    int n, i;
+
+    ep = epoll_create1(EPOLL_CLOEXEC);
+    if (ep < 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[engine_run_epoll] epoll_create1 error: %m");
+        return -1;
+    }
+    for (i = 0; i < nudp; i++) {
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = udp_fds[i];
+        if (epoll_ctl(ep, EPOLL_CTL_ADD, udp_fds[i], &ev) != 0) {
+            syslog(LOG_LOCAL0|LOG_DEBUG, "[engine_run_epoll] epoll_ctl error: %m");
+            close(ep);
+            return -1;
+        }
+    }
+    if (fifo->fd >= 0) {
+        // 肪̂҂ĂJĂ̂ŁA̓mubLOœǂ
+        fcntl(fifo->fd, F_SETFL, fcntl(fifo->fd, F_GETFL) | O_NONBLOCK);
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = fifo->fd;
+        if (epoll_ctl(ep, EPOLL_CTL_ADD, fifo->fd, &ev) != 0) {
+            syslog(LOG_LOCAL0|LOG_DEBUG, "[engine_run_epoll] epoll_ctl error: %m");
+            close(ep);
+            return -1;
+        }
+    }
+
+    for (;;) {
+        n = epoll_wait(ep, events, ENGINE_BATCH, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            syslog(LOG_LOCAL0|LOG_DEBUG, "[engine_run_epoll] epoll_wait error: %m");
+            close(ep);
+            return -1;
+        }
+        for (i = 0; i < n; i++) {
+            if (events[i].data.fd != fifo->fd) {
+                engine_drain_udp(events[i].data.fd, on_packet);
+                continue;
+            }
+            len = read(fifo->fd, fifo->buf + fifo->used, fifo->record_size * ENGINE_FIFO_RECORDS - fifo->used);
+            if (len == 0) {
+                close(ep);
+                return 0;
+            } else if (len < 0) {
+                if (errno != EAGAIN && errno != EINTR) {
+                    syslog(LOG_LOCAL0|LOG_DEBUG, "[engine_run_epoll] read error: %m");
+                }
+                continue;
+            }
+            engine_fifo_consume(fifo, (size_t)len);
+        }
+    }
+}
+
+#ifdef ENGINE_HAVE_URING
+
+#define ENGINE_TAG_UDP 1ULL ///< user_datȁ32rbgBʂudp_fds̓Y
+#define ENGINE_TAG_FIFO 2ULL
+#define ENGINE_BGID 0 ///< provided buffer̃O[v
+
+/**
+ * @brief io_uring̃O
+ */
+typedef struct _engine_ring {
+    int fd;
+    void *ring_ptr; ///< SQCQ(IORING_FEAT_SINGLE_MMAP)
+    size_t ring_len;
+    struct io_uring_sqe *sqes;
+    size_t sqes_len;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned sq_entries;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    struct io_uring_buf_ring *br; ///< provided buffer̃O
+    size_t br_len;
+    char *bufs; ///< ENGINE_URING_BUFSENGINE_URING_BUF_SIZE̎Mobt@
+    unsigned short br_tail;
+    unsigned to_submit;
+    struct msghdr msg; ///< M̊ԃJ[lQƂBMAhX̑傫g
+} engine_ring;
+
+/**
+ * @brief O
+ *
+ * @param r O
+ */
+static void engine_ring_close(engine_ring *r) {
+    if (r->sqes != NULL && r->sqes != MAP_FAILED) {
+        munmap(r->sqes, r->sqes_len);
+    }
+    if (r->ring_ptr != NULL && r->ring_ptr != MAP_FAILED) {
+        munmap(r->ring_ptr, r->ring_len);
+    }
+    if (r->br != NULL && r->br != MAP_FAILED) {
+        munmap(r->br, r->br_len);
+    }
+    free(r->bufs);
+    if (r->fd >= 0) {
+        close(r->fd);
+    }
+}
+
+/**
+ * @brief provided bufferOɖ߂
+ *
+ * engine_ring_publishŌ悤ɂȂB
+ * @param r O
+ * @param bid obt@ԍ
+ */
+static void engine_ring_recycle(engine_ring *r, unsigned bid) {
+    struct io_uring_buf *b = &(r->br->bufs[r->br_tail & (ENGINE_URING_BUFS - 1)]);
+
+    b->addr = (uint64_t)(uintptr_t)(r->bufs + (size_t)bid * ENGINE_URING_BUF_SIZE);
+    b->len = ENGINE_URING_BUF_SIZE;
+    b->bid = (uint16_t)bid;
+    r->br_tail++;
+}
+
+/**
+ * @brief ߂provided bufferJ[lɌ
+ *
+ * @param r O
+ */
+static void engine_ring_publish(engine_ring *r) {
+    __sync_synchronize();
+    r->br->tail = r->br_tail;
+}
+
+/**
+ * @brief O
+ *
+ * @param r O
+ * @retval 0 
+ * @retval -1 io_uringAKvȋ@\gȂ
+ */
+static int engine_ring_open(engine_ring *r) {
+    struct io_uring_params p;
+    struct io_uring_buf_reg reg;
+    unsigned i;
+
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+    memset(&p, 0, sizeof(p));
+    r->fd = (int)syscall(__NR_io_uring_setup, ENGINE_URING_ENTRIES, &p);
+    if (r->fd < 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[engine_ring_open] io_uring_setup error: %m");
+        return -1;
+    }
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[engine_ring_open] kernel too old for this engine");
+        engine_ring_close(r);
+        return -1;
+    }
+
+    r->ring_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    if (p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe) > r->ring_len) {
+        r->ring_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    }
+    r->ring_ptr = mmap(NULL, r->ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    r->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->ring_ptr == MAP_FAILED || r->sqes == MAP_FAILED) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[engine_ring_open] mmap error: %m");
+        engine_ring_close(r);
+        return -1;
+    }
+    r->sq_head = (unsigned *)((char *)r->ring_ptr + p.sq_off.head);
+    r->sq_tail = (unsigned *)((char *)r->ring_ptr + p.sq_off.tail);
+    r->sq_mask = (unsigned *)((char *)r->ring_ptr + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)((char *)r->ring_ptr + p.sq_off.array);
+    r->sq_entries = p.sq_entries;
+    r->cq_head = (unsigned *)((char *)r->ring_ptr + p.cq_off.head);
+    r->cq_tail = (unsigned *)((char *)r->ring_ptr + p.cq_off.tail);
+    r->cq_mask = (unsigned *)((char *)r->ring_ptr + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)((char *)r->ring_ptr + p.cq_off.cqes);
+
+    // Mobt@̃Oo^
+    r->br_len = ENGINE_URING_BUFS * sizeof(struct io_uring_buf);
+    r->br = mmap(NULL, r->br_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    r->bufs = malloc((size_t)ENGINE_URING_BUFS * ENGINE_URING_BUF_SIZE);
+    if (r->br == MAP_FAILED || r->bufs == NULL) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[engine_ring_open] cannot allocate buffers");
+        engine_ring_close(r);
+        return -1;
+    }
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)r->br;
+    reg.ring_entries = ENGINE_URING_BUFS;
+    reg.bgid = ENGINE_BGID;
+    if (syscall(__NR_io_uring_register, r->fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[engine_ring_open] provided buffer ring is not available: %m");
+        engine_ring_close(r);
+        return -1;
+    }
+    for (i = 0; i < ENGINE_URING_BUFS; i++) {
+        engine_ring_recycle(r, i);
+    }
+    engine_ring_publish(r);
+
+    r->msg.msg_namelen = sizeof(struct sockaddr_in6);
+    return 0;
+}
+
+/**
+ * @brief SQE1
+ *
+ * oĂv̓\Pbg̐+1Ȃ̂ŁASQӂ邱Ƃ͂ȂB
+ * @param r O
+ * @return 0Ŗ߂SQE
+ */
+static struct io_uring_sqe *engine_ring_sqe(engine_ring *r) {
+    unsigned tail = *(r->sq_tail);
+    unsigned idx = tail & *(r->sq_mask);
+    struct io_uring_sqe *sqe = &(r->sqes[idx]);
+
+    memset(sqe, 0, sizeof(*sqe));
+    r->sq_array[idx] = idx;
+    __sync_synchronize();
+    *(r->sq_tail) = tail + 1;
+    r->to_submit++;
+    return sqe;
+}
+
+/**
+ * @brief \Pbg̕Mo
+ *
+ * @param r O
+ * @param fd \Pbg
+ * @param i udp_fds̓Y
+ */
+static void engine_ring_arm_udp(engine_ring *r, int fd, int i) {
+    struct io_uring_sqe *sqe = engine_ring_sqe(r);
+
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)&(r->msg);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_TRUNC;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = ENGINE_BGID;
+    sqe->user_data = (ENGINE_TAG_UDP << 32) | (uint32_t)i;
+}
+
+/**
+ * @brief FIFOreado
+ *
+ * @param r O
+ * @param fifo FIFO
+ */
+static void engine_ring_arm_fifo(engine_ring *r, engine_fifo *fifo) {
+    struct io_uring_sqe *sqe = engine_ring_sqe(r);
+
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fifo->fd;
+    sqe->addr = (uint64_t)(uintptr_t)(fifo->buf + fifo->used);
+    sqe->len = (uint32_t)(fifo->record_size * ENGINE_FIFO_RECORDS - fifo->used);
+    sqe->off = (uint64_t)-1; // pCv݈͌ʒu
+    sqe->user_data = ENGINE_TAG_FIFO << 32;
+}
+
+/**
+ * @brief M̊1
+ *
+ * @param r O
+ * @param cqe 
+ * @param fd \Pbg
+ * @param on_packet pPbgn֐
+ */
+static void engine_ring_udp_done(engine_ring *r, const struct io_uring_cqe *cqe, int fd, engine_packet_fn on_packet) {
+    struct io_uring_recvmsg_out *out;
+    unsigned bid;
+    char *buf;
+    size_t hdr;
+    int len;
+
+    if (!(cqe->flags & IORING_CQE_F_BUFFER)) {
+        if (cqe->res < 0 && cqe->res != -ENOBUFS) {
+            errno = -cqe->res;
+            syslog(LOG_LOCAL0|LOG_DEBUG, "[engine_ring_udp_done] recvmsg error: %m");
+        }
+        return;
+    }
+    bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+    buf = r->bufs + (size_t)bid * ENGINE_URING_BUF_SIZE;
+    out = (struct io_uring_recvmsg_out *)buf;
+    hdr = sizeof(*out) + r->msg.msg_namelen + r->msg.msg_controllen;
+    if (cqe->res >= (int)hdr) {
+        len = cqe->res - (int)hdr;
+        if ((unsigned)len > out->payloadlen) {
+            len = (int)out->payloadlen;
+        }
+        on_packet(fd, (const struct sockaddr_in6 *)(buf + sizeof(*out)), buf + hdr, len);
+    }
+    engine_ring_recycle(r, bid);
+}
+
+/**
+ * @brief io_uring̃[v
+ *
+ * @retval 0 FIFOꂽ
+ * @retval -1 s
+ */
+static int engine_run_uring(engine_ring *r, const int *udp_fds, int nudp, engine_fifo *fifo, engine_packet_fn on_packet) {
+    struct io_uring_cqe *cqe;
+    unsigned head, tail;
+    uint32_t idx;
+    int ret;
+    int i;
+
+    for (i = 0; i < nudp; i++) {
+        engine_ring_arm_udp(r, udp_fds[i], i);
+    }
+    if (fifo->fd >= 0) {
+        engine_ring_arm_fifo(r, fifo);
+    }
+
+    for (;;) {
+        // ēƎ̊̑҂1
+        ret = (int)syscall(__NR_io_uring_enter, r->fd, r->to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            syslog(LOG_LOCAL0|LOG_DEBUG, "[engine_run_uring] io_uring_enter error: %m");
+            return -1;
+        }
+        r->to_submit -= (unsigned)ret;
+
+        head = *(r->cq_head);
+        tail = *(volatile unsigned *)(r->cq_tail);
+        __sync_synchronize();
+        for (; head != tail; head++) {
+            cqe = &(r->cqes[head & *(r->cq_mask)]);
+            idx = (uint32_t)cqe->user_data;
+            if ((cqe->user_data >> 32) == ENGINE_TAG_UDP) {
+                engine_ring_udp_done(r, cqe, udp_fds[idx], on_packet);
+                if (!(cqe->flags & IORING_CQE_F_MORE)) {
+                    engine_ring_arm_udp(r, udp_fds[idx], (int)idx); // obt@sȂǂŎ~܂
+                }
+            } else {
+                if (cqe->res == 0) {
+                    __sync_synchronize();
+                    *(r->cq_head) = head + 1;
+                    return 0;
+                } else if (cqe->res > 0) {
+                    engine_fifo_consume(fifo, (size_t)cqe->res);
+                } else if (cqe->res != -EINTR && cqe->res != -EAGAIN) {
+                    errno = -cqe->res;
+                    syslog(LOG_LOCAL0|LOG_DEBUG, "[engine_run_uring] read error: %m");
+                }
+                engine_ring_arm_fifo(r, fifo);
+            }
+        }
+        __sync_synchronize();
+        *(r->cq_head) = head;
+        reply_flush(); // AREP̓obt@ԂOɑ
+        engine_ring_publish(r);
+    }
+}
+
+#endif
+
+/**
+ * @brief ENGINE_THREADSUDP\Pbg̎M[v
+ *
+ * ĂяoXbhŃubLOrecvmmsg񂵁A͂Ă镪܂Ƃ߂ēǂł̃XbhŏB
+ * pPbgƂɃXbhobt@͍ȂBAREP͓ǂ񂾕IƂł܂Ƃ߂đB
+ * @param fd UDP\Pbg
+ * @param on_packet pPbgn֐
+ */
+void engine_recv_udp(int fd, engine_packet_fn on_packet) {
+    char bufs[ENGINE_BATCH][ENGINE_PACKET_SIZE];
+    struct sockaddr_in6 from[ENGINE_BATCH];
+    struct iovec iov[ENGINE_BATCH];
+    struct mmsghdr msgs[ENGINE_BATCH];
+    int n, i;
+
+    reply_hold();
+    engine_mmsg_init(bufs, from, iov, msgs);
+    for (;;) {
+        for (i = 0; i < ENGINE_BATCH; i++) {
+            msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+        }
+        n = recvmmsg(fd, msgs, ENGINE_BATCH, MSG_WAITFORONE, NULL);
+        if (n < 0) {
+            if (errno != EINTR) {
+                syslog(LOG_LOCAL0|LOG_DEBUG, "[engine_recv_udp] recvmmsg error: %m");
+            }
+            continue;
+        }
+        for (i = 0; i < n; i++) {
+            on_packet(fd, &from[i], bufs[i], (int)msgs[i].msg_len);
+        }
+        reply_flush();
+    }
+}
+
+/**
+ * @brief GW̃[v
+ *
+ * ĂяoXbhŁAFIFO܂Ŗ߂ȂBFIFOnȂΖ߂ȂB
+ * ENGINE_URINGgȂENGINE_EPOLLŉ񂷁BENGINE_THREADS͌ĂяoňƁB
+ * @param kind GW̎
+ * @param udp_fds UDP\Pbg
+ * @param nudp UDP\Pbg̐
+ * @param fifo_fd 肪JƂFIFOBgȂ-1
+ * @param record_size FIFÕR[h̑傫
+ * @param on_packet pPbgn֐
+ * @param on_record R[hn֐
+ * @retval 0 FIFOꂽ
+ * @retval -1 s
+ */
+int engine_run(engine_kind kind, const int *udp_fds, int nudp, int fifo_fd, size_t record_size,
+               engine_packet_fn on_packet, engine_record_fn on_record) {
+    engine_fifo fifo;
+    int ret;
+#ifdef ENGINE_HAVE_URING
+    engine_ring ring;
+#endif
+
+    reply_hold();
+    memset(&fifo, 0, sizeof(fifo));
+    fifo.fd = fifo_fd;
+    fifo.record_size = record_size;
+    fifo.on_record = on_record;
+    if (fifo_fd >= 0) {
+        fifo.buf = malloc(record_size * ENGINE_FIFO_RECORDS);
+        if (fifo.buf == NULL) {
+            return -1;
+        }
+    }
+
+#ifdef ENGINE_HAVE_URING
+    if (kind == ENGINE_URING) {
+        if (engine_ring_open(&ring) == 0) {
+            syslog(LOG_LOCAL0|LOG_DEBUG, "[engine_run] io_uring engine, %d sockets%s", nudp, (fifo_fd >= 0) ? " and the FIFO" : "");
+            ret = engine_run_uring(&ring, udp_fds, nudp, &fifo, on_packet);
+            engine_ring_close(&ring);
+            free(fifo.buf);
+            return ret;
+        }
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[engine_run] io_uring is not available, falling back to epoll");
+    }
+#else
+    if (kind == ENGINE_URING) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[engine_run] built without io_uring, falling back to epoll");
+    }
+#endif
+    syslog(LOG_LOCAL0|LOG_DEBUG, "[engine_run] epoll engine, %d sockets%s", nudp, (fifo_fd >= 0) ? " and the FIFO" : "");
+    ret = engine_run_epoll(udp_fds, nudp, &fifo, on_packet);
+    free(fifo.buf);
+    return ret;
+}
@@ -0,0 +1,55 @@
+/**
+ * @file sta_engine.h
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief FIFOUDP\Pbg̓͂̃GW
+ * ]̃XbhƂ̃ubLOread/recvfrom̂ɁAepollio_uring1̃[vœǂ
+ */
+
+#ifndef _STA_ENGINE_H
+#define _STA_ENGINE_H
+
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <stddef.h>
+
+#define ENGINE_BATCH 64 ///< 1ɏCxg̐B1̃\Pbg瑱ēǂސ܂
+#define ENGINE_PACKET_SIZE 512 ///< stamdUDP_RECV_BUF_SIZE
+#define ENGINE_FIFO_RECORDS 16 ///< FIFO1ɓǂރR[h̐
+#define ENGINE_URING_ENTRIES 256 ///< io_uringSQ̑傫
+#define ENGINE_URING_BUFS 256 ///< MɎgprovided buffer̐B2ׂ̂
+#define ENGINE_URING_BUF_SIZE 1024 ///< provided buffeȓ傫Bio_uring_recvmsg_outƑMAhX̕邱
+
+/**
+ * @brief GW̎
+ */
+typedef enum _engine_kind {
+    ENGINE_THREADS, ///< ]ǂAFIFOUDPꂼ̃XbhŃubLOɓǂ
+    ENGINE_EPOLL, ///< epoll1̃[v
+    ENGINE_URING ///< io_uring1̃OBgȂepoll
+} engine_kind;
+
+/**
+ * @brief UDP̃pPbg󂯎ƂɌĂԊ֐̌^
+ *
+ * AREPbufčĂ悢BbufENGINE_PACKET_SIZE܂ŏāAreply_flush܂ŗLB
+ * @param fd 󂯎\Pbg
+ * @param from M
+ * @param buf pPbg
+ * @param len pPbg̒
+ */
+typedef void (*engine_packet_fn)(int fd, const struct sockaddr_in6 *from, char *buf, int len);
+
+/**
+ * @brief FIFO烌R[h1ǂ񂾂ƂɌĂԊ֐̌^
+ *
+ * @param record R[hBĂяo̊ԂL
+ */
+typedef void (*engine_record_fn)(const void *record);
+
+int engine_from_string(const char *s, engine_kind *kind);
+const char *engine_name(engine_kind kind);
+int engine_run(engine_kind kind, const int *udp_fds, int nudp, int fifo_fd, size_t record_size,
+               engine_packet_fn on_packet, engine_record_fn on_record);
+void engine_recv_udp(int fd, engine_packet_fn on_packet);
+
+#endif
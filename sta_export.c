@@ -0,0 +1,193 @@
+/**
+ * @file sta_export.c
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief ߗ׃m[h̕\̋Lւ̏o
+ *
+ * STA͈ʒu𕄍Ă̂ŁAAREQ/AREP󂯎邽тɋߗ׃m[ḧʒu킩B
+ * |[ggGPSR̃f[r[RœƂ𒲂גȂčςނ悤ɁA
+ * sta_neigh̕\MAP_SHAREDmmapt@CɏoB/dev/shmɒu΃ōςށB
+ *
+ * ͂̃W[̃XbhŁA\ŜV[PXbN̒ŏB
+ * ǂݎ̓bN炸Aɓǂ񂾂ǂݒ̂ŁAstamd҂邱Ƃ͂ȂB
+ * \͂܂̃obt@ɏW߂̂ŁAV[PXbN̊ԂmemcpyɂȂB
+ */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include "sta_export.h"
+
+static export_hdr *export_base = NULL;
+static size_t export_map_size = 0;
+static int export_capacity = 0;
+static pthread_mutex_t export_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t export_cond = PTHREAD_COND_INITIALIZER;
+static int export_kicked = 0;
+static size_t (*export_collect)(export_neigh *out, size_t max, int tick) = NULL;
+static int export_interval_ms = EXPORT_INTERVAL_MS;
+
+/**
+ * @brief ot@CJ
+ *
+ * Ȃ΍BO̒g͎gȂ̂ŁAwb_ċ̕\ɂB
+ * @param path t@C̃pX
+ * @param capacity oߗ׃m[h̍ő吔
+ * @retval 0 
+ * @retval -1 s
+ */
+int export_open(const char *path, int capacity) {
+    int fd;
+
+    export_capacity = capacity;
+    export_map_size = sizeof(export_hdr) + (size_t)capacity * sizeof(export_neigh);
+
+    fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[export_open] open %s error: %m", path);
+        return -1;
+    }
+    if (ftruncate(fd, export_map_size) != 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[export_open] ftruncate %s error: %m", path);
+        close(fd);
+        return -1;
+    }
+    export_base = (export_hdr *)mmap(NULL, export_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // mmapƂ͗vȂ
+    if (export_base == MAP_FAILED) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[export_open] mmap %s error: %m", path);
+        export_base = NULL;
+        return -1;
+    }
+
+    // ǂݎ肪Âstamd̕\ǂł邩Ȃ̂ŁAɂĂ蒼
+    if (export_base->seq.seq & 1) {
+        export_base->seq.seq++; // Ostamd̓rŗ
+    }
+    seqlock_write_begin(&(export_base->seq));
+    export_base->magic = EXPORT_MAGIC;
+    export_base->version = EXPORT_VERSION;
+    export_base->capacity = (uint32_t)capacity;
+    export_base->entry_size = sizeof(export_neigh);
+    export_base->count = 0;
+    export_base->updated = (int64_t)time(NULL);
+    export_base->pid = (uint32_t)getpid();
+    export_base->interval_ms = (uint32_t)export_interval_ms;
+    seqlock_write_end(&(export_base->seq));
+    return 0;
+}
+
+/**
+ * @brief W߂\o
+ *
+ * @param entries ߗ׃m[h
+ * @param n ߗ׃m[h̐
+ */
+static void export_write(const export_neigh *entries, size_t n) {
+    seqlock_write_begin(&(export_base->seq));
+    memcpy(export_base + 1, entries, n * sizeof(export_neigh));
+    export_base->count = (uint32_t)n;
+    export_base->updated = (int64_t)time(NULL);
+    seqlock_write_end(&(export_base->seq));
+}
+
+/**
+ * @brief oԊu̎̋؂߂
+ *
+ * @param[out] ts ؂̎
+ */
+static void export_next_tick(struct timespec *ts) {
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    ts->tv_sec = tv.tv_sec + export_interval_ms / 1000;
+    ts->tv_nsec = tv.tv_usec * 1000 + (long)(export_interval_ms % 1000) * 1000000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+/**
+ * @brief oXbh
+ *
+ * export_kickŋN邩Aexport_interval_msтɕ\W߂ďoB
+ * NꂽƂ͊Ԋű؂𓮂Ȃ̂ŁANi͊ԊuƂɂXVB
+ * @param arg gĂȂ
+ * @return NULLԂ
+ */
+static void *export_thread(void *arg) {
+    struct timeval tv;
+    struct timespec tick;
+    export_neigh *buf;
+    size_t n;
+    int ticked;
+
+    (void)arg;
+    pthread_detach(pthread_self());
+
+    buf = (export_neigh *)malloc((size_t)export_capacity * sizeof(export_neigh));
+    if (buf == NULL) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[export_thread] malloc error");
+        return NULL;
+    }
+    export_next_tick(&tick);
+    for (;;) {
+        pthread_mutex_lock(&export_mutex);
+        if (!export_kicked) {
+            pthread_cond_timedwait(&export_cond, &export_mutex, &tick);
+        }
+        export_kicked = 0;
+        pthread_mutex_unlock(&export_mutex);
+
+        gettimeofday(&tv, NULL);
+        ticked = (tv.tv_sec > tick.tv_sec || (tv.tv_sec == tick.tv_sec && tv.tv_usec * 1000 >= tick.tv_nsec));
+        if (ticked) {
+            export_next_tick(&tick);
+        }
+        n = export_collect(buf, (size_t)export_capacity, ticked);
+        export_write(buf, n);
+    }
+    free(buf);
+    return NULL;
+}
+
+/**
+ * @brief oXbhn߂
+ *
+ * @param collect ߗ׃m[h̕\W߂֐BoԊű؂łtick1
+ * @param interval_ms oԊu[~b]
+ * @retval 0 
+ * @retval -1 s
+ */
+int export_start(size_t (*collect)(export_neigh *out, size_t max, int tick), int interval_ms) {
+    pthread_t tid;
+
+    if (export_base == NULL) {
+        return -1;
+    }
+    export_collect = collect;
+    export_interval_ms = interval_ms;
+    export_base->interval_ms = (uint32_t)interval_ms;
+    if (pthread_create(&tid, NULL, export_thread, NULL) != 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[export_start] pthread_create error: %m");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Vߗ׃m[hɏo悤m点
+ */
+void export_kick(void) {
+    pthread_mutex_lock(&export_mutex);
+    export_kicked = 1;
+    pthread_cond_signal(&export_cond);
+    pthread_mutex_unlock(&export_mutex);
+}
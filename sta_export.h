@@ -0,0 +1,90 @@
+/**
+ * @file sta_export.h
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief ߗ׃m[h̕\̋Lւ̏o
+ * GPSRȂǓzXg̃vZXAIPCȂŋߗ׃m[ḧʒuǂ߂悤ɂ
+ *
+ * ǂݎ̓t@CPROT_READmmapAexport_readŎʂB
+ * g̓V[PXbNŎĂ̂ŁÂ܂ܓǂނƏ̓r邱ƂB
+ */
+
+#ifndef _STA_EXPORT_H
+#define _STA_EXPORT_H
+
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "sta_seqlock.h"
+
+#define EXPORT_MAGIC 0x5354414e ///< "STAN"
+#define EXPORT_VERSION 1
+#define EXPORT_INTERVAL_MS 1000 ///< oԊu[~b]BNi͂̊ԊuƂɍXV
+
+/**
+ * @brief t@C̐擪
+ */
+typedef struct _export_hdr {
+    uint32_t magic; ///< EXPORT_MAGIC
+    uint32_t version; ///< EXPORT_VERSION
+    uint32_t capacity; ///< entries̗vf
+    uint32_t entry_size; ///< sizeof(export_neigh)
+    seqlock seq; ///< ͊
+    uint32_t count; ///< gĂGg̐
+    int64_t updated; ///< Ōɏ
+    uint32_t pid; ///< Ăstamd
+    uint32_t interval_ms; ///< oԊu[~b]
+} export_hdr;
+
+/**
+ * @brief ߗ׃m[h1
+ *
+ * wb_̒capacityԁB
+ */
+typedef struct _export_neigh {
+    struct in6_addr addr; ///< ߗ׃m[hSTA
+    struct in6_addr from; ///< pPbg̑MBGPSR̃lNXgzbv
+    uint32_t scope_id; ///< from̃XR[vID
+    uint32_t heard; ///< pPbg̐
+    double lat; ///< STAtZܓx
+    double lon; ///< STAtZox
+    double alt; ///< STAtZx
+    double quality; ///< NiBoԊûԊů̎wړ(0-1)
+    int64_t last_seen; ///< Ōɕ
+} export_neigh;
+
+int export_open(const char *path, int capacity);
+int export_start(size_t (*collect)(export_neigh *out, size_t max, int tick), int interval_ms);
+void export_kick(void);
+
+/**
+ * @brief ǂݎ肪\ʂ
+ *
+ * ̓rɓǂ񂾂ǂݒ̂ŁAт\ʂBstamd҂邱Ƃ͂ȂB
+ * @param hdr PROT_READmmapt@C̐擪
+ * @param[out] out ߗ׃m[hʂobt@
+ * @param max out̗vf
+ * @return ʂߗ׃m[h̐BmagicAversionAentry_sizeႦ-1
+ */
+static inline int export_read(const export_hdr *hdr, export_neigh *out, size_t max) {
+    unsigned int seq;
+    size_t n;
+
+    if (hdr->magic != EXPORT_MAGIC || hdr->version != EXPORT_VERSION || hdr->entry_size != sizeof(export_neigh)) {
+        return -1;
+    }
+    do {
+        seq = seqlock_read_begin(&(hdr->seq));
+        n = hdr->count;
+        if (n > hdr->capacity) {
+            n = hdr->capacity;
+        }
+        if (n > max) {
+            n = max;
+        }
+        memcpy(out, hdr + 1, n * sizeof(export_neigh));
+    } while (seqlock_read_retry(&(hdr->seq), seq));
+    return (int)n;
+}
+
+#endif
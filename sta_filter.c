@@ -0,0 +1,241 @@
+/**
+ * @file sta_filter.c
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief UDP\PbgBPFtB^
+ *
+ * UDP_PORT_NUMBERɓ͂f[^ÓAǂ߂1M[vŏB
+ * ă[vobNĂ}`LXgAREQA`̍ȂpPbgA
+ * DADĂȂƂAREP͓ǂł̂Ă邾Ȃ̂ŁASO_ATTACH_FILTER
+ * tclassic BPF̃vOŃJ[l̂Ɏ̂ĂB
+ *
+ * vOUDPwb_̐擪猩B擪2oCgŌ`typeA
+ * wire_parseAmulti_parse󂯕tŒZ̒Ẑ̂ĂB
+ * AREPʂǂDAD̏Ԃŕς̂ŁADAD̃Xbg
+ * 01ȏ̊ԂŕςƂɍ蒼đS̃\PbgɕtB
+ * ẽpPbg̓tB^ȂĂ̒Ŏ̂Ă̂ŁAtȂĂ͕ςȂB
+ */
+
+#include <linux/filter.h>
+#include <linux/if_packet.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <syslog.h>
+#include "sta_filter.h"
+#include "sta_multi.h"
+#include "sta_wire.h"
+
+#define FILTER_PAYLOAD ((uint32_t)sizeof(struct udphdr)) ///< UDPwb_̐擪̃yC[ḧʒu
+
+/**
+ * @brief vO̖߂̈ʒu
+ */
+enum {
+    I_PKTTYPE, I_LOOPBACK, ///< [vobNẴ}`LXĝ͎Ă
+    I_LEN, I_TAX, ///< Xɒ
+    I_TYPE, I_MAGIC, I_AREQ, I_AREP, I_AREQ_MULTI, I_AREP_MULTI, ///< 擪2oCgŐU蕪
+    I_COMPACT, I_COMPACT_AREQ, I_COMPACT_AREP, ///< RpNgȌ`type
+    I_GATE_LEGACY, I_GATE_MULTI, I_GATE_COMPACT, ///< AREPBDADłȂΎ̂Ă
+    I_NEED_LEGACY, I_CHECK_LEGACY, I_NEED_MULTI, I_CHECK_MULTI, I_NEED_COMPACT, I_CHECK_COMPACT, ///< ŒZ̒
+    I_ACCEPT, I_DROP,
+    FILTER_LEN
+};
+
+static int filter_fds[FILTER_FDS_MAX]; ///< tB^t\Pbg
+static int filter_nfds = 0;
+static unsigned char *filter_slots = NULL; ///< XbgƂDADȂ1
+static int filter_nslots = 0;
+static int filter_npending = 0; ///< DAD̃Xbg̐
+static pthread_mutex_t filter_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief zXg̃oCgtypeABPFldhœǂ񂾂Ƃ̒lɂ
+ *
+ * @param type packet_type
+ * @return ldh̒l
+ */
+static uint32_t filter_type_word(int type) {
+    uint16_t t = (uint16_t)type;
+    uint8_t b[2];
+
+    memcpy(b, &t, sizeof(b));
+    return ((uint32_t)b[0] << 8) | b[1];
+}
+
+/**
+ * @brief ̖߂
+ *
+ * @param i ߂̈ʒu
+ * @param k ׂl
+ * @param jt ^̂ƂɔԖ߂̈ʒu
+ * @param jf ÛƂɔԖ߂̈ʒu
+ * @return 
+ */
+static struct sock_filter filter_jeq(int i, uint32_t k, int jt, int jf) {
+    struct sock_filter insn = BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, k, 0, 0);
+
+    insn.jt = (uint8_t)(jt - i - 1);
+    insn.jf = (uint8_t)(jf - i - 1);
+    return insn;
+}
+
+/**
+ * @brief ׂ閽߂
+ *
+ * @param i ߂̈ʒu
+ * @param min yC[h̍ŒZ̒
+ * @return 
+ */
+static struct sock_filter filter_jge(int i, uint32_t min) {
+    struct sock_filter insn = BPF_JUMP(BPF_JMP|BPF_JGE|BPF_K, FILTER_PAYLOAD + min, 0, 0);
+
+    insn.jt = (uint8_t)(I_ACCEPT - i - 1);
+    insn.jf = (uint8_t)(I_DROP - i - 1);
+    return insn;
+}
+
+/**
+ * @brief vOgݗĂ
+ *
+ * @param[out] prog FILTER_LEN̖
+ * @param accept_arep AREPʂȂ1
+ */
+static void filter_build(struct sock_filter *prog, int accept_arep) {
+    struct sock_filter ret_drop = BPF_STMT(BPF_RET|BPF_K, 0);
+    struct sock_filter ret_accept = BPF_STMT(BPF_RET|BPF_K, 0xffffffffu);
+    struct sock_filter ld_pkttype = BPF_STMT(BPF_LD|BPF_W|BPF_ABS, (uint32_t)(SKF_AD_OFF + SKF_AD_PKTTYPE));
+    struct sock_filter ld_len = BPF_STMT(BPF_LD|BPF_W|BPF_LEN, 0);
+    struct sock_filter tax = BPF_STMT(BPF_MISC|BPF_TAX, 0);
+    struct sock_filter txa = BPF_STMT(BPF_MISC|BPF_TXA, 0);
+    struct sock_filter ld_type = BPF_STMT(BPF_LD|BPF_H|BPF_ABS, FILTER_PAYLOAD);
+    struct sock_filter ld_compact_type = BPF_STMT(BPF_LD|BPF_B|BPF_ABS, FILTER_PAYLOAD + 3);
+    struct sock_filter ja = BPF_JUMP(BPF_JMP|BPF_JA, 0, 0, 0);
+
+    prog[I_PKTTYPE] = ld_pkttype;
+    prog[I_LOOPBACK] = filter_jeq(I_LOOPBACK, PACKET_LOOPBACK, I_DROP, I_LEN);
+    prog[I_LEN] = ld_len;
+    prog[I_TAX] = tax;
+    prog[I_TYPE] = ld_type; // Zēǂ߂Ȃ΂Ŏ̂Ă
+    prog[I_MAGIC] = filter_jeq(I_MAGIC, WIRE_MAGIC, I_COMPACT, I_AREQ);
+    prog[I_AREQ] = filter_jeq(I_AREQ, filter_type_word(FILTER_AREQ), I_NEED_LEGACY, I_AREP);
+    prog[I_AREP] = filter_jeq(I_AREP, filter_type_word(FILTER_AREP), I_GATE_LEGACY, I_AREQ_MULTI);
+    prog[I_AREQ_MULTI] = filter_jeq(I_AREQ_MULTI, filter_type_word(FILTER_AREQ_MULTI), I_NEED_MULTI, I_AREP_MULTI);
+    prog[I_AREP_MULTI] = filter_jeq(I_AREP_MULTI, filter_type_word(FILTER_AREP_MULTI), I_GATE_MULTI, I_DROP);
+    prog[I_COMPACT] = ld_compact_type;
+    prog[I_COMPACT_AREQ] = filter_jeq(I_COMPACT_AREQ, FILTER_AREQ, I_NEED_COMPACT, I_COMPACT_AREP);
+    prog[I_COMPACT_AREP] = filter_jeq(I_COMPACT_AREP, FILTER_AREP, I_GATE_COMPACT, I_DROP);
+    if (accept_arep) {
+        prog[I_GATE_LEGACY] = ja;
+        prog[I_GATE_LEGACY].k = I_NEED_LEGACY - I_GATE_LEGACY - 1;
+        prog[I_GATE_MULTI] = ja;
+        prog[I_GATE_MULTI].k = I_NEED_MULTI - I_GATE_MULTI - 1;
+        prog[I_GATE_COMPACT] = ja;
+        prog[I_GATE_COMPACT].k = I_NEED_COMPACT - I_GATE_COMPACT - 1;
+    } else {
+        prog[I_GATE_LEGACY] = ret_drop;
+        prog[I_GATE_MULTI] = ret_drop;
+        prog[I_GATE_COMPACT] = ret_drop;
+    }
+    prog[I_NEED_LEGACY] = txa;
+    prog[I_CHECK_LEGACY] = filter_jge(I_CHECK_LEGACY, WIRE_LEGACY_ADDR_OFFSET + sizeof(struct sockaddr_in6));
+    prog[I_NEED_MULTI] = txa;
+    prog[I_CHECK_MULTI] = filter_jge(I_CHECK_MULTI, sizeof(multi_hdr));
+    prog[I_NEED_COMPACT] = txa;
+    prog[I_CHECK_COMPACT] = filter_jge(I_CHECK_COMPACT, WIRE_COMPACT_SIZE);
+    prog[I_ACCEPT] = ret_accept;
+    prog[I_DROP] = ret_drop;
+}
+
+/**
+ * @brief ̏Ԃ̃vO\Pbgɕt
+ *
+ * filter_mutexԂŌĂԂƁB
+ * @param fd \Pbg
+ * @retval 0 
+ * @retval -1 s
+ */
+static int filter_set(int fd) {
+    struct sock_filter prog[FILTER_LEN];
+    struct sock_fprog fprog;
+
+    filter_build(prog, filter_npending > 0);
+    fprog.len = FILTER_LEN;
+    fprog.filter = prog;
+    if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog)) != 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[filter_set] setsockopt SO_ATTACH_FILTER error: %m");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief DADǂo\pӂ
+ *
+ * @param nslots Xbg̐Bcell_follow̃XbgƓԍg
+ * @retval 0 
+ * @retval -1 s
+ */
+int filter_start(int nslots) {
+    filter_slots = calloc((size_t)nslots, 1);
+    if (filter_slots == NULL) {
+        return -1;
+    }
+    filter_nslots = nslots;
+    return 0;
+}
+
+/**
+ * @brief \PbgɃtB^t
+ *
+ * ȌADAD̏Ԃς邽тɕtB
+ * @param fd UDP\Pbg
+ * @retval 0 
+ * @retval -1 s
+ */
+int filter_attach(int fd) {
+    int ret;
+
+    pthread_mutex_lock(&filter_mutex);
+    if (filter_nfds == FILTER_FDS_MAX) {
+        pthread_mutex_unlock(&filter_mutex);
+        return -1;
+    }
+    ret = filter_set(fd);
+    if (ret == 0) {
+        filter_fds[filter_nfds++] = fd;
+    }
+    pthread_mutex_unlock(&filter_mutex);
+    return ret;
+}
+
+/**
+ * @brief XbgDADn܂AIƂm点
+ *
+ * DAD̃XbgȂȂAŏ1łƂɃvO蒼B
+ * AREP肱ڂȂ悤ɁADADn߂ƂAREQ𑗂OɌĂԂƁB
+ * @param slot Xbg
+ * @param pending DADn߂Ȃ1AIȂ0
+ */
+void filter_pending(int slot, int pending) {
+    int i;
+
+    if (slot < 0 || slot >= filter_nslots) {
+        return;
+    }
+    pending = pending ? 1 : 0;
+    pthread_mutex_lock(&filter_mutex);
+    if (filter_slots[slot] != pending) {
+        filter_slots[slot] = (unsigned char)pending;
+        filter_npending += pending ? 1 : -1;
+        if (filter_npending == pending) { // 01A10ɂȂ
+            for (i = 0; i < filter_nfds; i++) {
+                filter_set(filter_fds[i]);
+            }
+        }
+    }
+    pthread_mutex_unlock(&filter_mutex);
+}
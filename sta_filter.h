@@ -0,0 +1,21 @@
+/**
+ * @file sta_filter.h
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief UDP\PbgBPFtB^
+ * ֌ŴȂpPbgJ[lŎ̂ĂBAREPDADʂ
+ */
+
+#ifndef _STA_FILTER_H
+#define _STA_FILTER_H
+
+#define FILTER_FDS_MAX 64 ///< tB^t\Pbg̍ő吔BSHARD_MAXƓ
+#define FILTER_AREQ 0 ///< stamdpacket_typeAREQ
+#define FILTER_AREP 1 ///< stamdpacket_typeAREP
+#define FILTER_AREQ_MULTI 2 ///< stamdpacket_typeAREQ_MULTI
+#define FILTER_AREP_MULTI 3 ///< stamdpacket_typeAREP_MULTI
+
+int filter_start(int nslots);
+int filter_attach(int fd);
+void filter_pending(int slot, int pending);
+
+#endif
@@ -0,0 +1,181 @@
+/**
+ * @file sta_fix.c
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief ʂ̕sm
+ *
+ * PositionOut.error͓Ak̕ʂł2x2̕UUs[m^2]ŁA
+ * {, k, k, kk}̏ɕł̂ƂB
+ * Mxp̐Mȉ~̓}nmrXsqrt(-2 ln(1-p))̓ŁA
+ * PʃxNgǔɂk*sqrt(u'u)܂ōLB
+ * L͈͂̔ł́Aԉp̌ւ̍L肾ΑB
+ */
+
+#include <math.h>
+#include <string.h>
+#include "sta_fix.h"
+
+/**
+ * @brief MxMȉ~̔{߂
+ *
+ * @param confidence MxB0傫1菬
+ * @return W΍Ɋ|{(0.95Ȃ2.45)
+ */
+double fix_confidence_scale(double confidence) {
+    return sqrt(-2.0 * log(1.0 - confidence));
+}
+
+/**
+ * @brief Mȉ~̍L߂
+ *
+ * @param cov UUs
+ * @param ux ̓
+ * @param uy ̖kBuxAuy͒PʃxNg
+ * @param scale fix_confidence_scale̔{
+ * @return ǔ̍L[m]
+ */
+double fix_spread(const double cov[4], double ux, double uy, double scale) {
+    double v = ux * ux * cov[0] + ux * uy * (cov[1] + cov[2]) + uy * uy * cov[3];
+
+    return (v > 0.0) ? scale * sqrt(v) : 0.0;
+}
+
+/**
+ * @brief UUsƂĎg邩ׂ
+ *
+ * @param cov UUs
+ * @retval 1 g(ׂ0܂)
+ * @retval 0 LłȂAlłȂ
+ */
+int fix_cov_valid(const double cov[4]) {
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        if (!isfinite(cov[i])) {
+            return 0;
+        }
+    }
+    return cov[0] >= 0.0 && cov[3] >= 0.0 && cov[0] * cov[3] - cov[1] * cov[2] >= -1e-9;
+}
+
+/**
+ * @brief J}tB^1ϑԂi߂
+ *
+ * fŗ\AʒuϑƂčXVBx͔FGƂ݂ȂB
+ * ϑ̕UUs0ȂAFIX_DEFAULT_VARgB
+ * @param f tB^̏
+ * @param q x̎G̋[m^2/s^3]
+ * @param t ϑ̎[b]
+ * @param[in,out] lat ϑܓxBܓxԂ
+ * @param[in,out] lon ϑoxBoxԂ
+ * @param[in,out] cov ϑ̕UUsBʒu̕UUsԂ
+ */
+void fix_filter_step(fix_filter *f, double q, double t, double *lat, double *lon, double cov[4]) {
+    double F[4][4], FP[4][4], K[4][2], KHP[4][4];
+    double R[4], S[4], Si[4];
+    double mx, my, zx, zy, yx, yy, det, dt, dt2, dt3, c;
+    int i, j, k;
+
+    if (fix_cov_valid(cov) && (cov[0] > 0.0 || cov[3] > 0.0)) {
+        memcpy(R, cov, sizeof(R));
+    } else {
+        R[0] = R[3] = FIX_DEFAULT_VAR;
+        R[1] = R[2] = 0.0;
+    }
+
+    dt = t - f->t;
+    if (!f->initialized || dt < 0.0 || dt > FIX_RESET_SEC) {
+        memset(f, 0, sizeof(*f));
+        f->initialized = 1;
+        f->lat0 = *lat;
+        f->lon0 = *lon;
+        f->t = t;
+        f->P[0][0] = R[0];
+        f->P[0][2] = R[1];
+        f->P[2][0] = R[2];
+        f->P[2][2] = R[3];
+        f->P[1][1] = f->P[3][3] = 100.0; // x͂킩Ȃ(10m/sx)
+        memcpy(cov, R, sizeof(R));
+        return;
+    }
+
+    mx = 111319.0 * cos(f->lat0 * M_PI / 180.0);
+    my = 110952.0;
+    zx = (*lon - f->lon0) * mx;
+    zy = (*lat - f->lat0) * my;
+
+    // \ x = F xAP = F P F' + Q
+    memset(F, 0, sizeof(F));
+    for (i = 0; i < 4; i++) {
+        F[i][i] = 1.0;
+    }
+    F[0][1] = F[2][3] = dt;
+    f->x[0] += dt * f->x[1];
+    f->x[2] += dt * f->x[3];
+    for (i = 0; i < 4; i++) {
+        for (j = 0; j < 4; j++) {
+            FP[i][j] = 0.0;
+            for (k = 0; k < 4; k++) {
+                FP[i][j] += F[i][k] * f->P[k][j];
+            }
+        }
+    }
+    for (i = 0; i < 4; i++) {
+        for (j = 0; j < 4; j++) {
+            c = 0.0;
+            for (k = 0; k < 4; k++) {
+                c += FP[i][k] * F[j][k];
+            }
+            f->P[i][j] = c;
+        }
+    }
+    dt2 = dt * dt;
+    dt3 = dt2 * dt;
+    for (i = 0; i < 4; i += 2) {
+        f->P[i][i] += q * dt3 / 3.0;
+        f->P[i][i + 1] += q * dt2 / 2.0;
+        f->P[i + 1][i] += q * dt2 / 2.0;
+        f->P[i + 1][i + 1] += q * dt;
+    }
+
+    // XVBϑ͈ʒu(x[0]x[2])
+    S[0] = f->P[0][0] + R[0];
+    S[1] = f->P[0][2] + R[1];
+    S[2] = f->P[2][0] + R[2];
+    S[3] = f->P[2][2] + R[3];
+    det = S[0] * S[3] - S[1] * S[2];
+    if (!(fabs(det) > 1e-12)) {
+        f->initialized = 0; // lIɂȂ蒼
+        return;
+    }
+    Si[0] = S[3] / det;
+    Si[1] = -S[1] / det;
+    Si[2] = -S[2] / det;
+    Si[3] = S[0] / det;
+    for (i = 0; i < 4; i++) {
+        K[i][0] = f->P[i][0] * Si[0] + f->P[i][2] * Si[2];
+        K[i][1] = f->P[i][0] * Si[1] + f->P[i][2] * Si[3];
+    }
+    yx = zx - f->x[0];
+    yy = zy - f->x[2];
+    for (i = 0; i < 4; i++) {
+        f->x[i] += K[i][0] * yx + K[i][1] * yy;
+    }
+    for (i = 0; i < 4; i++) {
+        for (j = 0; j < 4; j++) {
+            KHP[i][j] = K[i][0] * f->P[0][j] + K[i][1] * f->P[2][j];
+        }
+    }
+    for (i = 0; i < 4; i++) {
+        for (j = 0; j < 4; j++) {
+            f->P[i][j] -= KHP[i][j];
+        }
+    }
+    f->t = t;
+
+    *lon = f->lon0 + f->x[0] / mx;
+    *lat = f->lat0 + f->x[2] / my;
+    cov[0] = f->P[0][0];
+    cov[1] = f->P[0][2];
+    cov[2] = f->P[2][0];
+    cov[3] = f->P[2][2];
+}
@@ -0,0 +1,34 @@
+/**
+ * @file sta_fix.h
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief ʂ̕sm
+ * UUs񂩂Mȉ~̑傫߁AKvȂ瓙f̃J}tB^ŕ
+ */
+
+#ifndef _STA_FIX_H
+#define _STA_FIX_H
+
+#define FIX_CONFIDENCE_DEFAULT 0.95 ///< Mȉ~̊̐Mx
+#define FIX_DEFAULT_VAR 25.0 ///< UUs񂪂ȂƂ̊ϑ̕U[m^2]
+#define FIX_RESET_SEC 30.0 ///< ԂtB^蒼[b]
+
+/**
+ * @brief f̃J}tB^̏
+ *
+ * ŏ̊ϑ_ƂAk̕[m]ŎB0Ŗ߂̂ԁB
+ */
+typedef struct _fix_filter {
+    int initialized;
+    double lat0; ///< _̈ܓx
+    double lon0; ///< _̌ox
+    double x[4]; ///< ȂxAkAk̑x
+    double P[4][4]; ///< x̕UUs
+    double t; ///< Ō̊ϑ̎[b]
+} fix_filter;
+
+double fix_confidence_scale(double confidence);
+double fix_spread(const double cov[4], double ux, double uy, double scale);
+int fix_cov_valid(const double cov[4]);
+void fix_filter_step(fix_filter *f, double q, double t, double *lat, double *lon, double cov[4]);
+
+#endif
@@ -0,0 +1,312 @@
+/**
+ * @file sta_handoff.c
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief STA̐؂ւmake-before-break
+ *
+ * SIOCSIFADDRł̓AhX̎ݒłȂ̂ŁAÂSTArtnetlink
+ * RTM_NEWADDR(NLM_F_REPLACE)IFA_CACHEINFOĔ񐄏ɂB
+ * preferred_lft0̃AhX͐Vڑ̑Mɂ͑I΂ȂA
+ * ̃AhXɌ̐ڑ̃pPbg͂̂܂܎󂯎B
+ * P\߂炱̃W[̃XbhĂяo̊֐ŏB
+ * J[lvalid_lftP\+HANDOFF_SLACKɂĂ̂ŁAstamdĂcȂB
+ *
+ * 񐄏ɂSTA͂܂̃m[ĥ̂Ȃ̂ŁAAREQɂ͏dƓ悤
+ * handoff_holdsň悤ɂĂB
+ */
+
+#include <errno.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include "sta_handoff.h"
+
+#define HANDOFF_FOREVER 0xffffffffu ///< INFINITY_LIFE_TIME
+
+/**
+ * @brief 񐄏ɂSTA
+ */
+typedef struct _handoff_entry {
+    struct in6_addr addr;
+    time_t expires; ///< 
+} handoff_entry;
+
+static handoff_entry entries[HANDOFF_MAX];
+static volatile int nentries = 0; ///< handoff_holds̓bNOɂ
+static int handoff_grace = 0;
+static void (*handoff_remove)(const struct in6_addr *addr) = NULL;
+static pthread_mutex_t handoff_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t handoff_cond = PTHREAD_COND_INITIALIZER;
+
+/**
+ * @brief AhX̎ς
+ *
+ * @param ifindex C^[tF[Xԍ
+ * @param addr AhX
+ * @param preferred preferred_lft[b]
+ * @param valid valid_lft[b]
+ * @retval 0 
+ * @retval -1 s
+ */
+static int handoff_set_lifetime(unsigned int ifindex, const struct in6_addr *addr, uint32_t preferred, uint32_t valid) {
+    struct {
+        struct nlmsghdr nlh;
+        struct ifaddrmsg ifa;
+        char attrs[RTA_SPACE(sizeof(struct in6_addr)) + RTA_SPACE(sizeof(struct ifa_cacheinfo))];
+    } req;
+    struct {
+        struct nlmsghdr nlh;
+        struct nlmsgerr err;
+    } ack;
+    struct sockaddr_nl snl;
+    struct ifa_cacheinfo ci;
+    struct rtattr *rta;
+    int fd;
+    int len;
+
+    memset(&req, 0, sizeof(req));
+    req.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifaddrmsg));
+    req.nlh.nlmsg_type = RTM_NEWADDR;
+    req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_REPLACE | NLM_F_ACK;
+    req.nlh.nlmsg_seq = 1;
+    req.ifa.ifa_family = AF_INET6;
+    req.ifa.ifa_prefixlen = 0; // add_staƓ
+    req.ifa.ifa_index = ifindex;
+
+    rta = (struct rtattr *)((char *)&req + NLMSG_ALIGN(req.nlh.nlmsg_len));
+    rta->rta_type = IFA_LOCAL;
+    rta->rta_len = RTA_LENGTH(sizeof(struct in6_addr));
+    memcpy(RTA_DATA(rta), addr, sizeof(struct in6_addr));
+    req.nlh.nlmsg_len = NLMSG_ALIGN(req.nlh.nlmsg_len) + RTA_SPACE(sizeof(struct in6_addr));
+
+    memset(&ci, 0, sizeof(ci));
+    ci.ifa_prefered = preferred;
+    ci.ifa_valid = valid;
+    rta = (struct rtattr *)((char *)&req + NLMSG_ALIGN(req.nlh.nlmsg_len));
+    rta->rta_type = IFA_CACHEINFO;
+    rta->rta_len = RTA_LENGTH(sizeof(ci));
+    memcpy(RTA_DATA(rta), &ci, sizeof(ci));
+    req.nlh.nlmsg_len = NLMSG_ALIGN(req.nlh.nlmsg_len) + RTA_SPACE(sizeof(ci));
+
+    fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+    if (fd < 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[handoff_set_lifetime] socket error: %m");
+        return -1;
+    }
+    memset(&snl, 0, sizeof(snl));
+    snl.nl_family = AF_NETLINK;
+    if (sendto(fd, &req, req.nlh.nlmsg_len, 0, (struct sockaddr *)&snl, sizeof(snl)) < 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[handoff_set_lifetime] sendto error: %m");
+        close(fd);
+        return -1;
+    }
+    len = recv(fd, &ack, sizeof(ack), 0);
+    close(fd);
+    if (len < (int)sizeof(ack) || ack.nlh.nlmsg_type != NLMSG_ERROR) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[handoff_set_lifetime] no ack");
+        return -1;
+    }
+    if (ack.err.error != 0) {
+        errno = -ack.err.error;
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[handoff_set_lifetime] RTM_NEWADDR error: %m");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 񐄏ɂSTAT
+ *
+ * handoff_mutexԂŌĂԂƁB
+ * @param addr AhX
+ * @return entries̓YBȂ-1
+ */
+static int handoff_find(const struct in6_addr *addr) {
+    int i;
+
+    for (i = 0; i < nentries; i++) {
+        if (memcmp(&(entries[i].addr), addr, sizeof(struct in6_addr)) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief 񐄏ɂSTA\O
+ *
+ * handoff_mutexԂŌĂԂƁB
+ * @param i entries̓Y
+ */
+static void handoff_drop(int i) {
+    entries[i] = entries[nentries - 1];
+    nentries--;
+}
+
+/**
+ * @brief P\߂STAXbh
+ *
+ * @param arg gĂȂ
+ * @return NULLԂ
+ */
+static void *handoff_thread(void *arg) {
+    struct in6_addr expired[HANDOFF_MAX];
+    struct timespec ts;
+    time_t now, next;
+    int nexpired;
+    int i;
+
+    (void)arg;
+    pthread_detach(pthread_self());
+
+    pthread_mutex_lock(&handoff_mutex);
+    for (;;) {
+        now = time(NULL);
+        next = 0;
+        nexpired = 0;
+        for (i = 0; i < nentries; ) {
+            if (entries[i].expires <= now) {
+                expired[nexpired++] = entries[i].addr;
+                handoff_drop(i);
+            } else {
+                if (next == 0 || entries[i].expires < next) {
+                    next = entries[i].expires;
+                }
+                i++;
+            }
+        }
+        if (nexpired > 0) {
+            // ̂ioctlȂ̂ŁÅAREQ̏҂Ȃ
+            pthread_mutex_unlock(&handoff_mutex);
+            for (i = 0; i < nexpired; i++) {
+                handoff_remove(&expired[i]);
+            }
+            pthread_mutex_lock(&handoff_mutex);
+            continue;
+        }
+        if (next == 0) {
+            pthread_cond_wait(&handoff_cond, &handoff_mutex);
+        } else {
+            ts.tv_sec = next;
+            ts.tv_nsec = 0;
+            pthread_cond_timedwait(&handoff_cond, &handoff_mutex, &ts);
+        }
+    }
+    pthread_mutex_unlock(&handoff_mutex);
+    return NULL;
+}
+
+/**
+ * @brief make-before-break̐؂ւg
+ *
+ * @param grace ÂSTA񐄏̂܂܎cb
+ * @param remove P\߂STA֐B̃W[̃XbhĂ΂
+ * @retval 0 
+ * @retval -1 s
+ */
+int handoff_start(int grace, void (*remove)(const struct in6_addr *addr)) {
+    pthread_t tid;
+
+    handoff_grace = grace;
+    handoff_remove = remove;
+    if (pthread_create(&tid, NULL, handoff_thread, NULL) != 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[handoff_start] pthread_create error: %m");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief ÂSTA񐄏ɂ
+ *
+ * VSTAĂĂԂƁB\ɓĂJ[lɒm点̂ŁA
+ * ̒m点ŋNAhX̃Cxg͂łɔ񐄏STAƂČB
+ * @param ifindex C^[tF[Xԍ
+ * @param addr ÂSTA
+ * @retval 0 
+ * @retval -1 sBĂяoł
+ */
+int handoff_deprecate(unsigned int ifindex, const struct in6_addr *addr) {
+    int i;
+
+    pthread_mutex_lock(&handoff_mutex);
+    i = handoff_find(addr);
+    if (i == -1) {
+        if (nentries >= HANDOFF_MAX) {
+            pthread_mutex_unlock(&handoff_mutex);
+            syslog(LOG_LOCAL0|LOG_DEBUG, "[handoff_deprecate] too many deprecated STAs");
+            return -1;
+        }
+        i = nentries;
+        entries[i].addr = *addr;
+        nentries++;
+    }
+    entries[i].expires = time(NULL) + handoff_grace;
+    pthread_mutex_unlock(&handoff_mutex);
+
+    if (handoff_set_lifetime(ifindex, addr, 0, (uint32_t)(handoff_grace + HANDOFF_SLACK)) != 0) {
+        pthread_mutex_lock(&handoff_mutex);
+        i = handoff_find(addr);
+        if (i != -1) {
+            handoff_drop(i);
+        }
+        pthread_mutex_unlock(&handoff_mutex);
+        return -1;
+    }
+    pthread_mutex_lock(&handoff_mutex);
+    pthread_cond_signal(&handoff_cond);
+    pthread_mutex_unlock(&handoff_mutex);
+    return 0;
+}
+
+/**
+ * @brief 񐄏ɂSTA܂g
+ *
+ * P\̂ɌSTA֖߂ĂƂɁAɎ𖳊ɖ߂B
+ * @param ifindex C^[tF[Xԍ
+ * @param addr STA
+ * @retval 0 ߂
+ * @retval -1 񐄏ɂSTAł͂ȂA߂ȂBadd_sta邱
+ */
+int handoff_reclaim(unsigned int ifindex, const struct in6_addr *addr) {
+    int i;
+
+    if (nentries == 0) {
+        return -1;
+    }
+    pthread_mutex_lock(&handoff_mutex);
+    i = handoff_find(addr);
+    if (i != -1) {
+        handoff_drop(i);
+    }
+    pthread_mutex_unlock(&handoff_mutex);
+    if (i == -1) {
+        return -1;
+    }
+    return handoff_set_lifetime(ifindex, addr, HANDOFF_FOREVER, HANDOFF_FOREVER);
+}
+
+/**
+ * @brief 񐄏ɂSTAׂ
+ *
+ * AREQ̏ĂԂ̂ŁA񐄏ɂĂȂ΃bNȂB
+ * @param addr AhX
+ * @retval 1 񐄏ɂSTA
+ * @retval 0 ł͂Ȃ
+ */
+int handoff_holds(const struct in6_addr *addr) {
+    int found;
+
+    if (nentries == 0) {
+        return 0;
+    }
+    pthread_mutex_lock(&handoff_mutex);
+    found = (handoff_find(addr) != -1);
+    pthread_mutex_unlock(&handoff_mutex);
+    return found;
+}
@@ -0,0 +1,22 @@
+/**
+ * @file sta_handoff.h
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief STA̐؂ւmake-before-break
+ * VSTAĂÂSTA񐄏(preferred_lft 0)ɂAP\߂Ă
+ */
+
+#ifndef _STA_HANDOFF_H
+#define _STA_HANDOFF_H
+
+#include <sys/types.h>
+#include <netinet/in.h>
+
+#define HANDOFF_MAX 16 ///< ɔ񐄏ɂĂSTA̐Bӂꂽ炷
+#define HANDOFF_SLACK 5 ///< J[lvalid_lftP\蒷bBstamdĂ悤
+
+int handoff_start(int grace, void (*remove)(const struct in6_addr *addr));
+int handoff_deprecate(unsigned int ifindex, const struct in6_addr *addr);
+int handoff_reclaim(unsigned int ifindex, const struct in6_addr *addr);
+int handoff_holds(const struct in6_addr *addr);
+
+#endif
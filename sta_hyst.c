@@ -0,0 +1,160 @@
+/**
+ * @file sta_hyst.c
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief L͈͂̏õqXeVX
+ *
+ * L͈͂oƔf͎̂3ƂB
+ * 1. _̋L͈͂̔a+margin_m𒴂ĂB
+ * 2. 1𖞂dwell_msB
+ * 3. ŋ߂̓_̕ĂȂBmin_speedxΌ͌ȂB
+ * 3ň~߂̂͊OɏoĂdwell_msHYST_MAX_HOLD{܂ŁB
+ * 񂷂悤ɊO葱m[h܂łÂSTÂ܂܂ɂȂ߁B
+ * L͈͂̒ɖ߂2̎v͎~܂B
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sta_hyst.h"
+
+/**
+ * @brief _猩ʒu𕽖ʂ̍Wɂ
+ *
+ * L͈͂͐\mȂ̂ŁA_̈ܓxł̐~}@ŏ\B
+ * @param lat ܓx
+ * @param lon ox
+ * @param anchor_lat _̈ܓx
+ * @param anchor_lon _̌ox
+ * @param[out] x [m]
+ * @param[out] y k[m]
+ */
+static void hyst_xy(double lat, double lon, double anchor_lat, double anchor_lon, double *x, double *y) {
+    *x = (lon - anchor_lon) * 111319.0 * cos(anchor_lat * M_PI / 180.0);
+    *y = (lat - anchor_lat) * 110952.0;
+}
+
+/**
+ * @brief p[^ǂ
+ *
+ * "margin_m[,dwell_ms[,min_speed]]"Bȗ̂0B
+ * @param spec 
+ * @param[out] p p[^
+ * @retval 0 
+ * @retval -1 
+ */
+int hyst_parse(const char *spec, hyst_params *p) {
+    char *end;
+
+    memset(p, 0, sizeof(*p));
+    p->margin_m = strtod(spec, &end);
+    if (end == spec || p->margin_m < 0.0) {
+        return -1;
+    }
+    if (*end == ',') {
+        spec = end + 1;
+        p->dwell_ms = (int)strtol(spec, &end, 10);
+        if (end == spec || p->dwell_ms < 0) {
+            return -1;
+        }
+    }
+    if (*end == ',') {
+        spec = end + 1;
+        p->min_speed = strtod(spec, &end);
+        if (end == spec || p->min_speed < 0.0) {
+            return -1;
+        }
+    }
+    return (*end == '\0') ? 0 : -1;
+}
+
+/**
+ * @brief qXeVXg
+ *
+ * @param p p[^
+ * @retval 1 g
+ * @retval 0 gȂ
+ */
+int hyst_enabled(const hyst_params *p) {
+    return p->margin_m > 0.0 || p->dwell_ms > 0;
+}
+
+/**
+ * @brief ʒu󂯎AL͈͂of
+ *
+ * L͈͂̒ǂ̔͌ĂяoōsAinsideœnB
+ * HYST_MOVEԂĂяoDADn߁Ahyst_reset邱ƁB
+ * hɑ΂ēɌĂ΂ȂƁB
+ * @param h 
+ * @param p p[^
+ * @param inside L͈͂̒Ȃ1
+ * @param lat ̈ܓx
+ * @param lon ̌ox
+ * @param anchor_lat L͈͂̊_̈ܓx
+ * @param anchor_lon L͈͂̊_̌ox
+ * @param range_m L͈͂̔a[m]
+ * @param now_ms ̎[~b]BP
+ * @return f̌
+ */
+hyst_verdict hyst_check(hyst_state *h, const hyst_params *p, int inside, double lat, double lon,
+                        double anchor_lat, double anchor_lon, double range_m, int64_t now_ms) {
+    double x, y, x0, y0, vx, vy;
+    double dist, dt;
+    int oldest;
+
+    h->lat[h->head] = lat;
+    h->lon[h->head] = lon;
+    h->t_ms[h->head] = now_ms;
+    oldest = (h->n < HYST_SAMPLES) ? 0 : (h->head + 1) % HYST_SAMPLES;
+    h->head = (h->head + 1) % HYST_SAMPLES;
+    if (h->n < HYST_SAMPLES) {
+        h->n++;
+    }
+
+    if (inside) {
+        h->exit_ms = 0;
+        return HYST_INSIDE;
+    }
+    if (!hyst_enabled(p)) {
+        return HYST_MOVE;
+    }
+
+    // 1. ]T̕
+    hyst_xy(lat, lon, anchor_lat, anchor_lon, &x, &y);
+    dist = sqrt(x * x + y * y);
+    if (dist <= range_m + p->margin_m) {
+        h->exit_ms = 0;
+        return HYST_HELD_MARGIN;
+    }
+
+    // 2. ؍ݎ
+    if (h->exit_ms == 0) {
+        h->exit_ms = now_ms;
+    }
+    if (now_ms - h->exit_ms < p->dwell_ms) {
+        return HYST_HELD_DWELL;
+    }
+
+    // 3. BoĂԌÂʒu̕ς̑x́A_痣̐
+    if (h->n > 1 && now_ms - h->exit_ms < (int64_t)p->dwell_ms * HYST_MAX_HOLD) {
+        dt = (now_ms - h->t_ms[oldest]) / 1000.0;
+        if (dt > 0.0) {
+            hyst_xy(h->lat[oldest], h->lon[oldest], anchor_lat, anchor_lon, &x0, &y0);
+            vx = (x - x0) / dt;
+            vy = (y - y0) / dt;
+            if (sqrt(vx * vx + vy * vy) >= p->min_speed && vx * x + vy * y < 0.0) {
+                return HYST_HELD_DIRECTION;
+            }
+        }
+    }
+    return HYST_MOVE;
+}
+
+/**
+ * @brief DADn߂̂ŁAoY
+ *
+ * ʒu̗͐V_łĝŎcB
+ * @param h 
+ */
+void hyst_reset(hyst_state *h) {
+    h->exit_ms = 0;
+}
@@ -0,0 +1,59 @@
+/**
+ * @file sta_hyst.h
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief L͈͂̏õqXeVX
+ * Et߂̂ӂGPŜԂŗL͈͂o肷邽тDADȂ悤A
+ * ]T̕A؍ݎԁǍŖ{ɏo𔻒f
+ */
+
+#ifndef _STA_HYST_H
+#define _STA_HYST_H
+
+#include <stdint.h>
+
+#define HYST_SAMPLES 8 ///< ̌߂̂ɊoĂʒu̐
+#define HYST_MAX_HOLD 4 ///< ň~߂̂dwell_mŝ̔{܂
+
+/**
+ * @brief qXeVX̃p[^
+ *
+ * margin_mdwell_msǂ0ȂgȂ(͈͂o炷DAD)B
+ */
+typedef struct _hyst_params {
+    double margin_m; ///< L͈͂̊O̗]T̕[m]B܂ł͏oƂ݂ȂȂ
+    int dwell_ms; ///< ]T̕oĂ炱̎ԊOɂoƂ݂Ȃ[~b]
+    double min_speed; ///< xΌȂ[m/s]BԂƋʂ邽
+} hyst_params;
+
+/**
+ * @brief f̌
+ */
+typedef enum _hyst_verdict {
+    HYST_INSIDE = 0, ///< L͈͓
+    HYST_MOVE = 1, ///< ôDAD
+    HYST_HELD_MARGIN = 2, ///< ͈͂̊O]T̒̕
+    HYST_HELD_DWELL = 3, ///< ]T̕oĂ܂dwell_msĂȂ
+    HYST_HELD_DIRECTION = 4 ///< _֖̕߂ĂĂ
+} hyst_verdict;
+
+/**
+ * @brief m[h(eig)Ƃ̏
+ *
+ * 0Ŗ߂̂ԁB
+ */
+typedef struct _hyst_state {
+    double lat[HYST_SAMPLES]; ///< ŋ߂̈ʒũOobt@
+    double lon[HYST_SAMPLES];
+    int64_t t_ms[HYST_SAMPLES]; ///< 󂯎[~b]
+    int head; ///< ɏʒu
+    int n; ///< Ă鐔
+    int64_t exit_ms; ///< ]T̕oBɂ0
+} hyst_state;
+
+int hyst_parse(const char *spec, hyst_params *p);
+int hyst_enabled(const hyst_params *p);
+hyst_verdict hyst_check(hyst_state *h, const hyst_params *p, int inside, double lat, double lon,
+                        double anchor_lat, double anchor_lon, double range_m, int64_t now_ms);
+void hyst_reset(hyst_state *h);
+
+#endif
@@ -0,0 +1,725 @@
+/**
+ * @file sta_layout.c
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief STÃrbgzu
+ *
+ * 80rbg͏64rbgƉ16rbg2̐őgݗĂĂAlbg[NoCgŏB
+ * gݍ݂̔zuSTA_LAYOUT_*̃}NtB[hƂ1WJ֐ɂȂA
+ * ʒurbgׂ͂Ē萔Ȃ̂Ń[vtB[h̕\ȂB
+ * -Lŕ񂩂zúAi\Ȃ񂷔ėp̊֐ňB
+ * ZI[_[̔zuėp̊֐ňAtB[hׂĂ擪2݂ɕבւB
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sta_layout.h"
+
+/**
+ * @brief gݗĒ80rbg
+ */
+typedef struct _sta_bits {
+    uint64_t hi; ///< 擪64rbg
+    uint32_t lo; ///< c16rbg(16rbgg)
+} sta_bits;
+
+static const uint8_t sta_prefix[6] = { 0x20, 0x01, 0x02, 0x00, 0x00, 0x00 }; ///< 2001:200:0::/48
+static const char *const kind_names[STA_KINDS] = { "lon", "lat", "alt", "time" };
+
+static inline uint64_t sta_mask(int bits) {
+    return (bits >= 64) ? ~(uint64_t)0 : (((uint64_t)1 << bits) - 1);
+}
+
+/**
+ * @brief 10ׂ̂
+ *
+ * ]encode_to_staƓ10.0JԂ|B1e22܂ł͌덷Ȃ\B
+ */
+static inline double sta_pow10(int decimals) {
+    double p = 1.0;
+
+    while (decimals-- > 0) {
+        p *= 10.0;
+    }
+    return p;
+}
+
+/**
+ * @brief ltB[h̐ɂ
+ *
+ * ]encode_to_staƓԂŕ_̌vẐŁAgeo80ł͓STAɂȂB
+ * @param v l
+ * @param bits rbg
+ * @param decimals _ȉ̌
+ * @param step 
+ * @param offset 
+ * @param is_signed Ȃ1
+ * @param[out] raw tB[h̐
+ * @retval 0 
+ * @retval -1 rbgɎ܂Ȃ
+ */
+static inline int sta_quantize(double v, int bits, int decimals, int step, double offset, int is_signed, int64_t *raw) {
+    double x = v - offset;
+    int64_t n, q;
+    int i;
+
+    for (i = 0; i < decimals; i++) {
+        x *= 10.0;
+    }
+    x = floor(x);
+    if (!(x > -4.0e18 && x < 4.0e18)) { // NaNŗƂ
+        return -1;
+    }
+    n = (int64_t)x;
+    q = n / step;
+    if (n % step != 0 && n < 0) {
+        q--; // ؂̂
+    }
+    if (is_signed) {
+        if (q < -((int64_t)1 << (bits - 1)) || q >= ((int64_t)1 << (bits - 1))) {
+            return -1;
+        }
+    } else if (q < 0 || (uint64_t)q > sta_mask(bits)) {
+        return -1;
+    }
+    *raw = q;
+    return 0;
+}
+
+/**
+ * @brief tB[h
+ *
+ * @param w gݗĒ80rbg
+ * @param pos 擪̈ʒu
+ * @param bits rbg
+ * @param raw tB[h̐BȂ牺bitsrbgg
+ */
+static inline void sta_put(sta_bits *w, int pos, int bits, int64_t raw) {
+    uint64_t u = (uint64_t)raw & sta_mask(bits);
+    int end = pos + bits;
+
+    if (end <= 64) {
+        w->hi = (w->hi & ~(sta_mask(bits) << (64 - end))) | (u << (64 - end));
+    } else if (pos >= 64) {
+        w->lo = (w->lo & ~(uint32_t)(sta_mask(bits) << (STA_BITS - end))) | (uint32_t)(u << (STA_BITS - end));
+    } else { // 64rbgڂ܂
+        w->hi = (w->hi & ~sta_mask(64 - pos)) | (u >> (end - 64));
+        w->lo = (w->lo & ~(uint32_t)(sta_mask(end - 64) << (STA_BITS - end)))
+            | (uint32_t)((u & sta_mask(end - 64)) << (STA_BITS - end));
+    }
+}
+
+/**
+ * @brief tB[hǂ
+ *
+ * @param w 80rbg
+ * @param pos 擪̈ʒu
+ * @param bits rbg
+ * @param is_signed Ȃ1Bg
+ * @return tB[h̐
+ */
+static inline int64_t sta_get(const sta_bits *w, int pos, int bits, int is_signed) {
+    uint64_t u;
+    int end = pos + bits;
+
+    if (end <= 64) {
+        u = w->hi >> (64 - end);
+    } else if (pos >= 64) {
+        u = (uint64_t)(w->lo >> (STA_BITS - end));
+    } else {
+        u = (w->hi << (end - 64)) | (uint64_t)(w->lo >> (STA_BITS - end));
+    }
+    u &= sta_mask(bits);
+    if (is_signed && (u >> (bits - 1)) & 1) {
+        return (int64_t)u - ((int64_t)1 << bits);
+    }
+    return (int64_t)u;
+}
+
+static inline void sta_store(const sta_bits *w, struct in6_addr *addr) {
+    int i;
+
+    memcpy(addr->s6_addr, sta_prefix, sizeof(sta_prefix));
+    for (i = 0; i < 8; i++) {
+        addr->s6_addr[6 + i] = (uint8_t)(w->hi >> (56 - 8 * i));
+    }
+    addr->s6_addr[14] = (uint8_t)(w->lo >> 8);
+    addr->s6_addr[15] = (uint8_t)w->lo;
+}
+
+static inline int sta_load(const struct in6_addr *addr, sta_bits *w) {
+    int i;
+
+    if (memcmp(addr->s6_addr, sta_prefix, sizeof(sta_prefix)) != 0) {
+        return -1;
+    }
+    w->hi = 0;
+    for (i = 0; i < 8; i++) {
+        w->hi = (w->hi << 8) | addr->s6_addr[6 + i];
+    }
+    w->lo = ((uint32_t)addr->s6_addr[14] << 8) | addr->s6_addr[15];
+    return 0;
+}
+
+/**
+ * @brief ZI[_[Ō݂ɕׂƂ̃rbg̈ʒu
+ *
+ * @param layout zu
+ * @param f tB[h̔ԍ(01)
+ * @param j tB[h̏ʂ琔rbg
+ * @return 80rbg̐擪琔ʒu
+ */
+static inline int sta_zpos(const sta_layout *layout, int f, int j) {
+    int m = layout->fields[0].bits;
+
+    if (layout->fields[1].bits < m) {
+        m = layout->fields[1].bits;
+    }
+    if (j < m) {
+        return 2 * j + f;
+    }
+    return m + j; // Zقg؂
+}
+
+/**
+ * @brief 擪2̃tB[h݂ɕבւ
+ *
+ * @param layout zu
+ * @param w 80rbg
+ * @param inverse ݂ɕ񂾂̂ɖ߂Ȃ1
+ */
+static void sta_interleave(const sta_layout *layout, sta_bits *w, int inverse) {
+    sta_bits src = *w;
+    int from, to;
+    int f, j;
+
+    for (f = 0; f < 2; f++) {
+        for (j = 0; j < layout->fields[f].bits; j++) {
+            from = layout->fields[f].pos + j;
+            to = sta_zpos(layout, f, j);
+            if (inverse) {
+                sta_put(w, from, 1, sta_get(&src, to, 1, 0));
+            } else {
+                sta_put(w, to, 1, sta_get(&src, from, 1, 0));
+            }
+        }
+    }
+}
+
+static inline void sta_layout_store(const sta_layout *layout, sta_bits *w, struct in6_addr *addr) {
+    if (layout->interleave) {
+        sta_interleave(layout, w, 0);
+    }
+    sta_store(w, addr);
+}
+
+static inline int sta_layout_load(const sta_layout *layout, const struct in6_addr *addr, sta_bits *w) {
+    if (sta_load(addr, w) != 0) {
+        return -1;
+    }
+    if (layout->interleave) {
+        sta_interleave(layout, w, 1);
+    }
+    return 0;
+}
+
+/**
+ * @brief fR[hl
+ *
+ * ʂ10^-decimalsPʂŊ؂悤ɑIł邱(sta_layout_findŊm߂)B
+ */
+static inline void sta_fixed_set(sta_fixed *f, sta_kind kind, int64_t raw, int decimals, int step, double offset) {
+    f->v[kind] = raw * step + (int64_t)floor(offset * sta_pow10(decimals) + 0.5);
+    f->decimals[kind] = decimals;
+    f->present[kind] = 1;
+}
+
+static inline double sta_value(const sta_coord *c, sta_kind kind) {
+    switch (kind) {
+    case STA_LON:
+        return c->lon;
+    case STA_LAT:
+        return c->lat;
+    case STA_ALT:
+        return c->alt;
+    default:
+        return (double)c->tod;
+    }
+}
+
+// gݍ݂̔zu̓WJBF̈STA_LAYOUT_GEO80ȂǂƓ
+#define STA_VALUE_LON(c) ((c)->lon)
+#define STA_VALUE_LAT(c) ((c)->lat)
+#define STA_VALUE_ALT(c) ((c)->alt)
+#define STA_VALUE_TIME(c) ((double)(c)->tod)
+#define STA_FIELD_INIT(kind, name, bits, dec, step, off, sgn) { STA_##kind, name, bits, dec, step, off, sgn, 0 },
+#define STA_SUM_BITS(kind, name, bits, dec, step, off, sgn) + (bits)
+#define STA_POS_ENUM(kind, name, bits, dec, step, off, sgn) POS_##kind, END_##kind = POS_##kind + (bits) - 1,
+#define STA_ENCODE_FIELD(kind, name, bits, dec, step, off, sgn) \
+    if (sta_quantize(STA_VALUE_##kind(c), (bits), (dec), (step), (off), (sgn), &raw) != 0) { \
+        return -1; \
+    } \
+    sta_put(&w, POS_##kind, (bits), raw);
+#define STA_DECODE_FIELD(kind, name, bits, dec, step, off, sgn) \
+    sta_fixed_set(f, STA_##kind, sta_get(&w, POS_##kind, (bits), (sgn)), (dec), (step), (off));
+
+/**
+ * @brief gݍ݂̔zu̐pGR[_ƃfR[_`
+ *
+ * ʒu͊֐̗̒񋓌^őÕtB[h̏I̎ƂĐB
+ * 80rbgɎ܂Ȃzu͔z̑傫ɂȂăRpCłȂB
+ */
+#define STA_DEFINE_CODEC(lname, LIST) \
+    typedef char lname##_fits[(0 LIST(STA_SUM_BITS) <= STA_BITS) ? 1 : -1]; \
+    static int lname##_encode(const sta_layout *layout, const sta_coord *c, struct in6_addr *addr) { \
+        enum { LIST(STA_POS_ENUM) FIELDS_END }; \
+        sta_bits w = { 0, 0 }; \
+        int64_t raw; \
+        (void)layout; \
+        LIST(STA_ENCODE_FIELD) \
+        sta_store(&w, addr); \
+        return 0; \
+    } \
+    static int lname##_decode(const sta_layout *layout, const struct in6_addr *addr, sta_fixed *f) { \
+        enum { LIST(STA_POS_ENUM) FIELDS_END }; \
+        sta_bits w; \
+        (void)layout; \
+        if (sta_load(addr, &w) != 0) { \
+            return -1; \
+        } \
+        memset(f, 0, sizeof(*f)); \
+        LIST(STA_DECODE_FIELD) \
+        return 0; \
+    }
+
+STA_DEFINE_CODEC(geo80, STA_LAYOUT_GEO80)
+STA_DEFINE_CODEC(ground80, STA_LAYOUT_GROUND80)
+
+/**
+ * @brief \ȂGR[h
+ */
+static int generic_encode(const sta_layout *layout, const sta_coord *c, struct in6_addr *addr) {
+    const sta_field *fd;
+    sta_bits w = { 0, 0 };
+    int64_t raw;
+    int i;
+
+    for (i = 0; i < layout->nfields; i++) {
+        fd = &(layout->fields[i]);
+        if (sta_quantize(sta_value(c, fd->kind), fd->bits, fd->decimals, fd->step, fd->offset, fd->is_signed, &raw) != 0) {
+            return -1;
+        }
+        sta_put(&w, fd->pos, fd->bits, raw);
+    }
+    sta_layout_store(layout, &w, addr);
+    return 0;
+}
+
+/**
+ * @brief \ȂfR[h
+ */
+static int generic_decode(const sta_layout *layout, const struct in6_addr *addr, sta_fixed *f) {
+    const sta_field *fd;
+    sta_bits w;
+    int i;
+
+    if (sta_layout_load(layout, addr, &w) != 0) {
+        return -1;
+    }
+    memset(f, 0, sizeof(*f));
+    for (i = 0; i < layout->nfields; i++) {
+        fd = &(layout->fields[i]);
+        sta_fixed_set(f, fd->kind, sta_get(&w, fd->pos, fd->bits, fd->is_signed), fd->decimals, fd->step, fd->offset);
+    }
+    return 0;
+}
+
+static sta_layout builtin_layouts[] = {
+    { "geo80", 0, { STA_LAYOUT_GEO80(STA_FIELD_INIT) }, geo80_encode, geo80_decode, 0 },
+    { "ground80", 0, { STA_LAYOUT_GROUND80(STA_FIELD_INIT) }, ground80_encode, ground80_decode, 0 }
+};
+
+/**
+ * @brief tB[h̐ƈʒu𖄂߂āAzuƂĐm߂
+ *
+ * @param layout zu
+ * @retval 0 
+ * @retval -1 Ȃ
+ */
+static int sta_layout_prepare(sta_layout *layout) {
+    sta_field *fd;
+    int seen[STA_KINDS];
+    double scaled;
+    int pos = 0;
+    int i;
+
+    memset(seen, 0, sizeof(seen));
+    for (i = 0; i < STA_LAYOUT_MAX_FIELDS && layout->fields[i].bits != 0; i++) {
+        fd = &(layout->fields[i]);
+        if ((int)fd->kind < 0 || fd->kind >= STA_KINDS || seen[fd->kind]
+            || fd->bits < 1 || fd->bits > STA_FIELD_MAX_BITS || fd->decimals < 0 || fd->decimals > 9 || fd->step < 1) {
+            return -1;
+        }
+        scaled = fd->offset * sta_pow10(fd->decimals);
+        if (fabs(scaled - floor(scaled + 0.5)) > 1e-6) {
+            return -1; // fR[hl𐮐ŎĂȂ
+        }
+        seen[fd->kind] = 1;
+        fd->pos = pos;
+        pos += fd->bits;
+    }
+    layout->nfields = i;
+    if (pos > STA_BITS || !seen[STA_LON] || !seen[STA_LAT]) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 񂩂zu
+ *
+ * ":rbg:::[:s]"J}ŋ؂ďʃrbgׂB
+ * Ⴆ"lon:28:6:2:-180,lat:27:6:2:-90,time:14:0:10:0"Bs͕B
+ * @param spec 
+ * @return zuBȂNULL
+ */
+static sta_layout *sta_layout_parse(const char *spec) {
+    sta_layout *layout;
+    sta_field *fd;
+    const char *p = spec;
+    char *end;
+    size_t n;
+    int i, k;
+
+    layout = (sta_layout *)calloc(1, sizeof(sta_layout));
+    if (layout == NULL) {
+        return NULL;
+    }
+    layout->name = "custom";
+    layout->encode = generic_encode;
+    layout->decode = generic_decode;
+    for (i = 0; *p != '\0'; i++) {
+        if (i >= STA_LAYOUT_MAX_FIELDS) {
+            goto fail;
+        }
+        fd = &(layout->fields[i]);
+        n = strcspn(p, ":");
+        for (k = 0; k < STA_KINDS; k++) {
+            if (strlen(kind_names[k]) == n && strncmp(p, kind_names[k], n) == 0) {
+                break;
+            }
+        }
+        if (k == STA_KINDS || p[n] != ':') {
+            goto fail;
+        }
+        fd->kind = (sta_kind)k;
+        fd->name = kind_names[k];
+        p += n + 1;
+        fd->bits = (int)strtol(p, &end, 10);
+        if (*end != ':') {
+            goto fail;
+        }
+        fd->decimals = (int)strtol(end + 1, &end, 10);
+        if (*end != ':') {
+            goto fail;
+        }
+        fd->step = (int)strtol(end + 1, &end, 10);
+        if (*end != ':') {
+            goto fail;
+        }
+        fd->offset = strtod(end + 1, &end);
+        if (*end == ':' && end[1] == 's') {
+            fd->is_signed = 1;
+            end += 2;
+        }
+        if (*end == ',') {
+            end++;
+        } else if (*end != '\0') {
+            goto fail;
+        }
+        p = end;
+    }
+    if (sta_layout_prepare(layout) != 0) {
+        goto fail;
+    }
+    return layout;
+
+fail:
+    free(layout);
+    return NULL;
+}
+
+/**
+ * @brief ZI[_[̔zu
+ *
+ * @param base ̔zuBsta_layout_parseō̂Ȃ
+ * @param name zu̖O
+ * @return zuB擪2̃tB[hȂNULL
+ */
+static sta_layout *sta_layout_interleaved(const sta_layout *base, const char *name) {
+    sta_layout *layout;
+
+    if (base == NULL) {
+        return NULL;
+    }
+    layout = NULL;
+    if (name != NULL && base->nfields >= 2 && !base->interleave) {
+        layout = (sta_layout *)malloc(sizeof(sta_layout));
+    }
+    if (layout != NULL) {
+        *layout = *base;
+        layout->name = name;
+        layout->encode = generic_encode;
+        layout->decode = generic_decode;
+        layout->interleave = 1;
+    }
+    if (base->encode == generic_encode) {
+        free((void *)base);
+    }
+    return layout;
+}
+
+/**
+ * @brief zu𓾂
+ *
+ * gݍ݂̖O("geo80"A"ground80")Ȃp̊֐zuA
+ * łȂsta_layout_parsȅƂĔėp̔zuBN1ĂԂƁB
+ * OSTA_LAYOUT_INTERLEAVEtĂZI[_[ɂB
+ * @param spec OBNULLȂSTA_LAYOUT_DEFAULT
+ * @return zuBȂNULL
+ */
+const sta_layout *sta_layout_find(const char *spec) {
+    size_t n = strlen(STA_LAYOUT_INTERLEAVE);
+    size_t i;
+
+    if (spec == NULL) {
+        spec = STA_LAYOUT_DEFAULT;
+    }
+    if (strncmp(spec, STA_LAYOUT_INTERLEAVE, n) == 0) {
+        return sta_layout_interleaved(sta_layout_find(spec + n), strdup(spec));
+    }
+    for (i = 0; i < sizeof(builtin_layouts) / sizeof(builtin_layouts[0]); i++) {
+        if (strcmp(spec, builtin_layouts[i].name) == 0) {
+            if (builtin_layouts[i].nfields == 0 && sta_layout_prepare(&builtin_layouts[i]) != 0) {
+                return NULL;
+            }
+            return &builtin_layouts[i];
+        }
+    }
+    return sta_layout_parse(spec);
+}
+
+/**
+ * @brief ނtB[h
+ *
+ * @param layout zu
+ * @param kind 
+ * @return tB[hBzuɂȂNULL
+ */
+const sta_field *sta_layout_field(const sta_layout *layout, sta_kind kind) {
+    int i;
+
+    for (i = 0; i < layout->nfields; i++) {
+        if (layout->fields[i].kind == kind) {
+            return &(layout->fields[i]);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief 80rbĝ̃rbgǂ̃tB[ĥׂ̂
+ *
+ * tB[h̃rbgZI[_[łʂ珇ɕԂ̂ŁAvtBbNX1rbg΂
+ * ǂꂩ1̃tB[h̏ʃrbg1܂B
+ * @param layout zu
+ * @param bit 80rbg̐擪琔ʒu
+ * @param[out] j tB[h̏ʂ琔rbg
+ * @return tB[h̔ԍBǂ̃tB[hgĂȂrbgȂ-1
+ */
+int sta_layout_bit(const sta_layout *layout, int bit, int *j) {
+    const sta_field *fd;
+    int m;
+    int i;
+
+    if (layout->interleave && bit < layout->fields[0].bits + layout->fields[1].bits) {
+        m = layout->fields[0].bits;
+        if (layout->fields[1].bits < m) {
+            m = layout->fields[1].bits;
+        }
+        if (bit < 2 * m) {
+            *j = bit / 2;
+            return bit % 2;
+        }
+        *j = bit - m;
+        return (layout->fields[0].bits > m) ? 0 : 1;
+    }
+    for (i = 0; i < layout->nfields; i++) {
+        fd = &(layout->fields[i]);
+        if (bit >= fd->pos && bit < fd->pos + fd->bits) {
+            *j = bit - fd->pos;
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief STÃvtBbNX
+ *
+ * @param[out] addr 2001:200:0::Bc80rbg0
+ */
+void sta_layout_prefix(struct in6_addr *addr) {
+    memset(addr, 0, sizeof(*addr));
+    memcpy(addr->s6_addr, sta_prefix, sizeof(sta_prefix));
+}
+
+/**
+ * @brief tB[h1̑傫߂
+ *
+ * @param fd tB[h
+ * @return 1̑傫(xAmAb)
+ */
+double sta_field_quantum(const sta_field *fd) {
+    return fd->step / sta_pow10(fd->decimals);
+}
+
+/**
+ * @brief ltB[h̐ɂ
+ *
+ * sta_encodeƓvZB
+ * @param fd tB[h
+ * @param v l
+ * @param[out] raw tB[h̐
+ * @retval 0 
+ * @retval -1 rbgɎ܂Ȃ
+ */
+int sta_field_quantize(const sta_field *fd, double v, int64_t *raw) {
+    return sta_quantize(v, fd->bits, fd->decimals, fd->step, fd->offset, fd->is_signed, raw);
+}
+
+/**
+ * @brief STAɃGR[h
+ *
+ * ܓxoxnɂ邩͌ĂяoŊm߂邱ƁBł̓rbgɎ܂邩B
+ * @param layout zu
+ * @param c l
+ * @param[out] addr STA
+ * @retval 0 
+ * @retval -1 ܂ȂtB[h
+ */
+int sta_encode(const sta_layout *layout, const sta_coord *c, struct in6_addr *addr) {
+    return layout->encode(layout, c, addr);
+}
+
+/**
+ * @brief STA𐮐̂܂܃fR[h
+ *
+ * @param layout zu
+ * @param addr STA
+ * @param[out] f l
+ * @retval 0 
+ * @retval -1 STAł͂Ȃ
+ */
+int sta_decode_fixed(const sta_layout *layout, const struct in6_addr *addr, sta_fixed *f) {
+    return layout->decode(layout, addr, f);
+}
+
+/**
+ * @brief STAfR[h
+ *
+ * zuɂȂl0ɂȂB
+ * @param layout zu
+ * @param addr STA
+ * @param[out] c l
+ * @retval 0 
+ * @retval -1 STAł͂Ȃ
+ */
+int sta_decode(const sta_layout *layout, const struct in6_addr *addr, sta_coord *c) {
+    sta_fixed f;
+
+    if (layout->decode(layout, addr, &f) != 0) {
+        return -1;
+    }
+    c->lon = f.v[STA_LON] / sta_pow10(f.decimals[STA_LON]);
+    c->lat = f.v[STA_LAT] / sta_pow10(f.decimals[STA_LAT]);
+    c->alt = f.v[STA_ALT] / sta_pow10(f.decimals[STA_ALT]);
+    c->tod = (long)(f.v[STA_TIME] / (int64_t)sta_pow10(f.decimals[STA_TIME]));
+    return 0;
+}
+
+/**
+ * @brief tB[h̐̂܂܎o
+ *
+ * ̃tB[hȂƂĕԂBZԍȂǂɎgB
+ * @param layout zu
+ * @param addr STA
+ * @param kind 
+ * @param[out] raw tB[h̐
+ * @retval 0 
+ * @retval -1 STAł͂ȂAzuɂȂ
+ */
+int sta_field_raw(const sta_layout *layout, const struct in6_addr *addr, sta_kind kind, uint64_t *raw) {
+    const sta_field *fd = sta_layout_field(layout, kind);
+    sta_bits w;
+
+    if (fd == NULL || sta_layout_load(layout, addr, &w) != 0) {
+        return -1;
+    }
+    *raw = (uint64_t)sta_get(&w, fd->pos, fd->bits, 0);
+    return 0;
+}
+
+/**
+ * @brief ̃tB[h炵STA
+ *
+ * ʒũrbg͂̂܂܂ŁAsteps炷B1ňB
+ * @param layout zu
+ * @param sta STA
+ * @param steps 炷
+ * @param[out] out STA
+ * @retval 0 
+ * @retval -1 STAł͂ȂAzuɎȂ
+ */
+int sta_shift_time(const sta_layout *layout, const struct in6_addr *sta, int steps, struct in6_addr *out) {
+    const sta_field *fd = sta_layout_field(layout, STA_TIME);
+    sta_bits w;
+    int64_t period;
+    int64_t t;
+
+    if (fd == NULL || sta_layout_load(layout, sta, &w) != 0) {
+        return -1;
+    }
+    period = (int64_t)(86400 * sta_pow10(fd->decimals)) / fd->step;
+    if (period < 1 || (uint64_t)period > sta_mask(fd->bits) + 1) {
+        period = (int64_t)sta_mask(fd->bits) + 1;
+    }
+    t = (sta_get(&w, fd->pos, fd->bits, 0) + steps) % period;
+    sta_put(&w, fd->pos, fd->bits, t);
+    sta_layout_store(layout, &w, out);
+    return 0;
+}
+
+/**
+ * @brief zu𕶎ɂ
+ *
+ * sta_layout_findɓn鏑ŁAO擪ɕtBZI[_[Ȃ珑STA_LAYOUT_INTERLEAVEtB
+ * @param layout zu
+ * @param[out] buf o
+ * @param len buf̑傫
+ * @return 
+ */
+size_t sta_layout_describe(const sta_layout *layout, char *buf, size_t len) {
+    const sta_field *fd;
+    size_t n;
+    int i;
+
+    n = (size_t)snprintf(buf, len, "%s %s", layout->name, layout->interleave ? STA_LAYOUT_INTERLEAVE : "");
+    for (i = 0; i < layout->nfields && n < len; i++) {
+        fd = &(layout->fields[i]);
+        n += (size_t)snprintf(buf + n, len - n, "%s%s:%d:%d:%d:%g%s", (i > 0) ? "," : "",
+                              fd->name, fd->bits, fd->decimals, fd->step, fd->offset, fd->is_signed ? ":s" : "");
+    }
+    return (n < len) ? n : len - 1;
+}
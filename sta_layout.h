@@ -0,0 +1,130 @@
+/**
+ * @file sta_layout.h
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief STÃrbgzu
+ * vtBbNX2001:200:0::/48̌80rbgɕׂtB[h\Ō߂
+ */
+
+#ifndef _STA_LAYOUT_H
+#define _STA_LAYOUT_H
+
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define STA_PREFIX_LEN 48 ///< STÃvtBbNX2001:200:0::/48̒
+#define STA_BITS 80 ///< tB[hׂrbg
+#define STA_LAYOUT_MAX_FIELDS 8
+#define STA_FIELD_MAX_BITS 48 ///< 1̃tB[h̍őrbg
+#define STA_LAYOUT_DEFAULT "geo80"
+
+/**
+ * @brief tB[h̎
+ */
+typedef enum _sta_kind {
+    STA_LON = 0, ///< ox[x]
+    STA_LAT = 1, ///< ܓx[x]
+    STA_ALT = 2, ///< x[m]
+    STA_TIME = 3, ///< ̓0̕b(n)
+    STA_KINDS = 4
+} sta_kind;
+
+/**
+ * @brief gݍ݂̃rbgzu
+ *
+ * F(, O, rbg, _ȉ̌, , , )ʃrbgׂB
+ * l牺ʂA10^{Đ؂̂āA݂ŊĐ؂̂Ă̂rbgɋl߂B
+ * Ȃ2̕␔ŋl߂Bl߂Ȃ΃GR[h͎sB
+ * gݍ݂̔zu̓RpCɓWJp̃GR[_ƃfR[_gB
+ *
+ * geo80͏]̔zuBox26bitAܓx26bitAx14bit(2mA)A14bit(10b)B
+ * xɉʂ͂Ə]STAƕςĂ܂̂ŁA̍x2̕␔ŕ\B
+ */
+#define STA_LAYOUT_GEO80(F) \
+    F(LON, "lon", 26, 6, 8, -180.0, 0) \
+    F(LAT, "lat", 26, 6, 4, -90.0, 0) \
+    F(ALT, "alt", 14, 0, 2, 0.0, 1) \
+    F(TIME, "time", 14, 0, 10, 0.0, 0)
+
+/**
+ * @brief xȂnp̃rbgzu
+ *
+ * ox32bitAܓx31bit(ǂ_ȉ7A1cm)A14bit(10b)Bc3bit0B
+ */
+#define STA_LAYOUT_GROUND80(F) \
+    F(LON, "lon", 32, 7, 1, -180.0, 0) \
+    F(LAT, "lat", 31, 7, 1, -90.0, 0) \
+    F(TIME, "time", 14, 0, 10, 0.0, 0)
+
+/**
+ * @brief ZI[_[̔zu
+ *
+ * zu̖ȎO"z:"tƁA擪2̃tB[hʂ1rbg݂ɕׂB
+ * Zقg؂Aق̎ĉ܂ܕׂBႦ"z:geo80"͌oxƈܓx52rbg݂ɂB
+ * vtBbNXoxƈܓx𓯂ōîŁA͈͂vtBbNXŕƂɏȂčς(sta_cover)B
+ * ʒuς邾Ȃ̂ŁAsta_fieldpos݂͌ɂÖʒû܂܂ɂĂB
+ */
+#define STA_LAYOUT_INTERLEAVE "z:"
+
+/**
+ * @brief tB[h
+ */
+typedef struct _sta_field {
+    sta_kind kind;
+    const char *name; ///< "lon"A"lat"A"alt"A"time"
+    int bits; ///< rbg
+    int decimals; ///< ɂO10ił炷
+    int step; ///< 1̑傫(10^-decimalsP)
+    double offset; ///< l
+    int is_signed; ///< 1Ȃ2̕␔
+    int pos; ///< 80rbg̐擪琔ʒu
+} sta_field;
+
+/**
+ * @brief GR[hl
+ */
+typedef struct _sta_coord {
+    double lon;
+    double lat;
+    double alt;
+    long tod; ///< ̓0̕b(n)
+} sta_coord;
+
+/**
+ * @brief fR[hl
+ *
+ * 10^-decimalsPʂ̐Ŏ̂ŁAۂ߂ɂ̂܂܏oBzuɂȂނpresent0B
+ */
+typedef struct _sta_fixed {
+    int64_t v[STA_KINDS];
+    int decimals[STA_KINDS];
+    int present[STA_KINDS];
+} sta_fixed;
+
+/**
+ * @brief rbgzu
+ */
+typedef struct _sta_layout {
+    const char *name;
+    int nfields;
+    sta_field fields[STA_LAYOUT_MAX_FIELDS];
+    int (*encode)(const struct _sta_layout *layout, const sta_coord *c, struct in6_addr *addr);
+    int (*decode)(const struct _sta_layout *layout, const struct in6_addr *addr, sta_fixed *f);
+    int interleave; ///< 擪2̃tB[h݂ɕׂȂ1(STA_LAYOUT_INTERLEAVE)
+} sta_layout;
+
+const sta_layout *sta_layout_find(const char *spec);
+const sta_field *sta_layout_field(const sta_layout *layout, sta_kind kind);
+int sta_layout_bit(const sta_layout *layout, int bit, int *j);
+void sta_layout_prefix(struct in6_addr *addr);
+double sta_field_quantum(const sta_field *fd);
+int sta_field_quantize(const sta_field *fd, double v, int64_t *raw);
+int sta_encode(const sta_layout *layout, const sta_coord *c, struct in6_addr *addr);
+int sta_decode(const sta_layout *layout, const struct in6_addr *addr, sta_coord *c);
+int sta_decode_fixed(const sta_layout *layout, const struct in6_addr *addr, sta_fixed *f);
+int sta_field_raw(const sta_layout *layout, const struct in6_addr *addr, sta_kind kind, uint64_t *raw);
+int sta_shift_time(const sta_layout *layout, const struct in6_addr *sta, int steps, struct in6_addr *out);
+size_t sta_layout_describe(const sta_layout *layout, char *buf, size_t len);
+
+#endif
@@ -0,0 +1,262 @@
+/**
+ * @file sta_link.c
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief C^[tF[X̊Ď
+ *
+ * }`LXgO[vւ̎Q̓\PbgĂ̂ŁA
+ * C^[tF[X邩蒼ȂO邱Ƃ͂ȂB
+ * /proc/net/igmp6𑗐M̂тɓǂޑɁARTMGRP_LINK̃Cxg҂A
+ * wlan_interfaceオ蒼ꂽ(ԍς)ƂĂяoɒm点B
+ * ߂RTMGRP_IPV6_IFADDR҂Awlan_interfaceIPv6AhXƂm点B
+ *
+ * getifaddrs͌ʂq[vɍ̂ŁADAD̂тɌĂԂƂ̂тɊmۂ邱ƂɂȂB
+ * ̃AhXlink_addrsRTM_GETADDR̃_vX^bÑobt@ɓǂŒׂB
+ */
+
+#include <errno.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <syslog.h>
+#include <unistd.h>
+#include "sta_link.h"
+
+static int link_fd = -1;
+static char link_ifname[IF_NAMESIZE];
+static unsigned int link_ifindex = 0; ///< ŌɌԍB0ȂĂ
+static int link_up = 0;
+static void (*link_on_change)(unsigned int ifindex, int up) = NULL;
+static void (*link_on_addr)(void) = NULL;
+
+/**
+ * @brief ÑbZ[W1
+ *
+ * @param nlh bZ[W
+ */
+static void link_handle(struct nlmsghdr *nlh) {
+    struct ifinfomsg *ifi = (struct ifinfomsg *)NLMSG_DATA(nlh);
+    struct rtattr *rta;
+    int rtalen;
+    const char *name = NULL;
+    unsigned int ifindex;
+    int up;
+
+    rtalen = IFLA_PAYLOAD(nlh);
+    for (rta = IFLA_RTA(ifi); RTA_OK(rta, rtalen); rta = RTA_NEXT(rta, rtalen)) {
+        if (rta->rta_type == IFLA_IFNAME) {
+            name = (const char *)RTA_DATA(rta);
+            break;
+        }
+    }
+    if (name == NULL || strncmp(name, link_ifname, IF_NAMESIZE) != 0) {
+        return;
+    }
+
+    if (nlh->nlmsg_type == RTM_DELLINK) {
+        ifindex = 0;
+        up = 0;
+    } else {
+        ifindex = (unsigned int)ifi->ifi_index;
+        up = (ifi->ifi_flags & IFF_UP) != 0;
+    }
+    if (ifindex == link_ifindex && up == link_up) {
+        return; // AhXJE^̕ω
+    }
+    syslog(LOG_LOCAL0|LOG_DEBUG, "[link_handle] %s index %u -> %u, %s", link_ifname, link_ifindex, ifindex, up ? "up" : "down");
+    link_ifindex = ifindex;
+    link_up = up;
+    link_on_change(ifindex, up);
+}
+
+/**
+ * @brief AhX̃bZ[W1
+ *
+ * @param nlh bZ[W
+ */
+static void link_handle_addr(struct nlmsghdr *nlh) {
+    struct ifaddrmsg *ifa = (struct ifaddrmsg *)NLMSG_DATA(nlh);
+
+    if (ifa->ifa_family != AF_INET6 || link_ifindex == 0 || ifa->ifa_index != link_ifindex) {
+        return;
+    }
+    link_on_addr();
+}
+
+/**
+ * @brief IPv6AhXSׂ
+ *
+ * RTM_GETADDR̃_vǂ݁AAhXƂfnĂԁBq[v͎gȂB
+ * @param fn AhXƂɌĂԊ֐B0ȊOԂ炻ł߂
+ * @param arg fnɓn
+ * @retval 0 
+ * @retval -1 s
+ */
+int link_addrs(int (*fn)(unsigned int ifindex, const struct in6_addr *addr, void *arg), void *arg) {
+    struct {
+        struct nlmsghdr nlh;
+        struct ifaddrmsg ifa;
+    } req;
+    char buf[LINK_RECV_BUF_SIZE];
+    struct nlmsghdr *nlh;
+    struct ifaddrmsg *ifa;
+    struct rtattr *rta;
+    const struct in6_addr *addr;
+    int rtalen;
+    int done = 0;
+    int ret = 0;
+    int len;
+    int s;
+
+    s = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (s < 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[link_addrs] socket error: %m");
+        return -1;
+    }
+    memset(&req, 0, sizeof(req));
+    req.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifaddrmsg));
+    req.nlh.nlmsg_type = RTM_GETADDR;
+    req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nlh.nlmsg_seq = 1;
+    req.ifa.ifa_family = AF_INET6;
+    if (send(s, &req, req.nlh.nlmsg_len, 0) < 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[link_addrs] send error: %m");
+        close(s);
+        return -1;
+    }
+    while (!done) {
+        len = recv(s, buf, sizeof(buf), 0);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            syslog(LOG_LOCAL0|LOG_DEBUG, "[link_addrs] recv error: %m");
+            ret = -1;
+            break;
+        }
+        for (nlh = (struct nlmsghdr *)buf; NLMSG_OK(nlh, (unsigned int)len); nlh = NLMSG_NEXT(nlh, len)) {
+            if (nlh->nlmsg_type == NLMSG_DONE) {
+                done = 1;
+                break;
+            }
+            if (nlh->nlmsg_type == NLMSG_ERROR) {
+                ret = -1;
+                done = 1;
+                break;
+            }
+            if (nlh->nlmsg_type != RTM_NEWADDR) {
+                continue;
+            }
+            ifa = (struct ifaddrmsg *)NLMSG_DATA(nlh);
+            addr = NULL;
+            rtalen = IFA_PAYLOAD(nlh);
+            for (rta = IFA_RTA(ifa); RTA_OK(rta, rtalen); rta = RTA_NEXT(rta, rtalen)) {
+                if (rta->rta_type == IFA_ADDRESS) {
+                    addr = (const struct in6_addr *)RTA_DATA(rta);
+                }
+            }
+            if (ifa->ifa_family == AF_INET6 && addr != NULL && fn(ifa->ifa_index, addr, arg) != 0) {
+                done = 1; // c̃_v͓ǂ܂ɕ
+                break;
+            }
+        }
+    }
+    close(s);
+    return ret;
+}
+
+/**
+ * @brief ÑCxg҂Xbh
+ *
+ * @param arg gĂȂ
+ * @return NULLԂ
+ */
+static void *link_monitor_thread(void *arg) {
+    char *buf;
+    struct nlmsghdr *nlh;
+    int len;
+
+    (void)arg;
+    pthread_detach(pthread_self());
+
+    buf = (char *)malloc(LINK_RECV_BUF_SIZE);
+    if (buf == NULL) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[link_monitor_thread] malloc error");
+        return NULL;
+    }
+    for (;;) {
+        len = recv(link_fd, buf, LINK_RECV_BUF_SIZE, 0);
+        if (len < 0) {
+            syslog(LOG_LOCAL0|LOG_DEBUG, "[link_monitor_thread] recv error: %m");
+            continue; // ENOBUFSȂCxg肱ڂÃCxgŏԂג
+        }
+        for (nlh = (struct nlmsghdr *)buf; NLMSG_OK(nlh, (unsigned int)len); nlh = NLMSG_NEXT(nlh, len)) {
+            if (nlh->nlmsg_type == RTM_NEWLINK || nlh->nlmsg_type == RTM_DELLINK) {
+                link_handle(nlh);
+            } else if (nlh->nlmsg_type == RTM_NEWADDR || nlh->nlmsg_type == RTM_DELADDR) {
+                link_handle_addr(nlh);
+            }
+        }
+    }
+    free(buf);
+    return NULL;
+}
+
+/**
+ * @brief C^[tF[X̊Ďn߂
+ *
+ * N̏Ԃ͌ĂяoŐݒς݂ƂAꂩ̕ωm点B
+ * @param ifname ĎC^[tF[X
+ * @param on_change オ蒼ꂽƂɊĎXbhĂ΂B
+ *        up0Ȃ牺(ifindex0)
+ * @param on_addr IPv6AhXƂɊĎXbhĂ΂BNULLȂAhX͌Ȃ
+ * @retval 0 
+ * @retval -1 s
+ */
+int link_monitor_start(const char *ifname, void (*on_change)(unsigned int ifindex, int up), void (*on_addr)(void)) {
+    struct sockaddr_nl snl;
+    struct ifreq ifr;
+    pthread_t tid;
+    int s;
+
+    memset(link_ifname, 0, sizeof(link_ifname));
+    strncpy(link_ifname, ifname, sizeof(link_ifname) - 1);
+    link_ifindex = if_nametoindex(link_ifname);
+    link_up = 0;
+    link_on_change = on_change;
+    link_on_addr = on_addr;
+    if ((s = socket(AF_INET6, SOCK_DGRAM, 0)) >= 0) {
+        memset(&ifr, 0, sizeof(ifr));
+        strncpy(ifr.ifr_name, link_ifname, sizeof(ifr.ifr_name) - 1);
+        if (ioctl(s, SIOCGIFFLAGS, &ifr) == 0) {
+            link_up = (ifr.ifr_flags & IFF_UP) != 0;
+        }
+        close(s);
+    }
+
+    link_fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+    if (link_fd < 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[link_monitor_start] socket error: %m");
+        return -1;
+    }
+    memset(&snl, 0, sizeof(snl));
+    snl.nl_family = AF_NETLINK;
+    snl.nl_groups = RTMGRP_LINK | (on_addr != NULL ? RTMGRP_IPV6_IFADDR : 0);
+    if (bind(link_fd, (struct sockaddr *)&snl, sizeof(snl)) < 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[link_monitor_start] bind error: %m");
+        close(link_fd);
+        link_fd = -1;
+        return -1;
+    }
+    if (pthread_create(&tid, NULL, link_monitor_thread, NULL) != 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[link_monitor_start] pthread_create error: %m");
+        close(link_fd);
+        link_fd = -1;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,19 @@
+/**
+ * @file sta_link.h
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief C^[tF[X̊Ď
+ * rtnetlink̃ÑCxgwlan_interface̍蒼グAAhX̃CxgIPv6AhX̑mB
+ * getifaddrs̑Ƀq[vg킸IPv6AhX𒲂ׂ
+ */
+
+#ifndef _STA_LINK_H
+#define _STA_LINK_H
+
+#include <netinet/in.h>
+
+#define LINK_RECV_BUF_SIZE 8192
+
+int link_addrs(int (*fn)(unsigned int ifindex, const struct in6_addr *addr, void *arg), void *arg);
+int link_monitor_start(const char *ifname, void (*on_change)(unsigned int ifindex, int up), void (*on_addr)(void));
+
+#endif
@@ -0,0 +1,229 @@
+/**
+ * @file sta_multi.c
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief AREQ/AREP
+ *
+ * AhXƂAREQ𑗂ƁA̐MAREP̎MNB
+ * AREQ1pPbgōőMULTI_MAX̌₢킹A
+ * 󂯎m[h͑Š1Œׂărbg}bvŕԂB
+ * }`eig[hł́AZԂɎn܂eigDAD1AREQɂ܂Ƃ߂B
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/time.h>
+#include <syslog.h>
+#include <time.h>
+#include "sta_multi.h"
+
+static struct in6_addr batch[MULTI_MAX]; ///< ܂ĂȂ
+static int batch_count = 0;
+static int batch_max = 0; ///< 0Ȃ܂Ƃ߂Ȃ
+static void (*batch_flush)(const struct in6_addr *candidates, int count) = NULL;
+static pthread_mutex_t batch_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t batch_cond = PTHREAD_COND_INITIALIZER;
+
+/**
+ * @brief AREQ/AREPgݗĂ
+ *
+ * @param[out] buf gݗĂ
+ * @param buflen buf̑傫
+ * @param type AREQ_MULTIAREP_MULTI
+ * @param txid ԍ
+ * @param duplicate dẴrbg
+ * @param candidates 
+ * @param count ̐
+ * @param holder AREPȂԓm[hSTABAREQSTAȂNULL
+ * @return pPbg̒B肫Ȃ0
+ */
+size_t multi_build(char *buf, size_t buflen, int type, uint32_t txid, uint32_t duplicate,
+                   const struct in6_addr *candidates, int count, const struct in6_addr *holder) {
+    multi_hdr hdr;
+    size_t len;
+
+    if (count <= 0 || count > MULTI_MAX) {
+        return 0;
+    }
+    len = sizeof(hdr) + (size_t)count * sizeof(struct in6_addr);
+    if (holder != NULL) {
+        len += sizeof(struct in6_addr);
+    }
+    if (len > buflen) {
+        return 0;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.type = (uint16_t)type;
+    hdr.version = MULTI_VERSION;
+    hdr.count = (uint8_t)count;
+    hdr.txid = htonl(txid);
+    hdr.duplicate = htonl(duplicate);
+    memcpy(buf, &hdr, sizeof(hdr));
+    memcpy(buf + sizeof(hdr), candidates, (size_t)count * sizeof(struct in6_addr));
+    if (holder != NULL) {
+        memcpy(buf + sizeof(hdr) + (size_t)count * sizeof(struct in6_addr), holder, sizeof(struct in6_addr));
+    }
+    return len;
+}
+
+/**
+ * @brief 󂯎AREQ̏AREPɏ
+ *
+ * AREQ̂̂̂܂܎ĉŁAwb_ĕԓm[hSTAɂB
+ * @param buf multi_parseAREQBAREPɂȂ
+ * @param buflen buf̑傫
+ * @param type AREP_MULTI
+ * @param duplicate dẴrbg
+ * @param holder ԓm[hSTABȂNULL
+ * @return AREP̒B肫Ȃ0
+ */
+size_t multi_reply(char *buf, size_t buflen, int type, uint32_t duplicate, const struct in6_addr *holder) {
+    multi_hdr *hdr = (multi_hdr *)buf;
+    size_t len;
+
+    len = sizeof(*hdr) + (size_t)hdr->count * sizeof(struct in6_addr);
+    if (holder != NULL) {
+        len += sizeof(struct in6_addr);
+    }
+    if (len > buflen) {
+        return 0;
+    }
+    hdr->type = (uint16_t)type;
+    hdr->duplicate = htonl(duplicate);
+    if (holder != NULL) {
+        memcpy(buf + len - sizeof(struct in6_addr), holder, sizeof(struct in6_addr));
+    }
+    return len;
+}
+
+/**
+ * @brief AREQ/AREP͂
+ *
+ * ̐pPbg-1ԂŁAabort͂ȂB
+ * @param buf 󂯎pPbg
+ * @param len pPbg̒
+ * @param[out] packet ͌
+ * @retval 0 
+ * @retval -1 ĂA܂͒mȂo[W
+ */
+int multi_parse(const char *buf, size_t len, multi_packet *packet) {
+    multi_hdr hdr;
+    size_t body;
+
+    if (len < sizeof(hdr)) {
+        return -1;
+    }
+    memcpy(&hdr, buf, sizeof(hdr));
+    if (hdr.version != MULTI_VERSION || hdr.count == 0 || hdr.count > MULTI_MAX) {
+        return -1;
+    }
+    body = (size_t)hdr.count * sizeof(struct in6_addr);
+    if (len < sizeof(hdr) + body) {
+        return -1;
+    }
+
+    packet->type = hdr.type;
+    packet->txid = ntohl(hdr.txid);
+    packet->duplicate = ntohl(hdr.duplicate);
+    packet->count = hdr.count;
+    memcpy(packet->candidates, buf + sizeof(hdr), body);
+    packet->has_holder = (len >= sizeof(hdr) + body + sizeof(struct in6_addr));
+    if (packet->has_holder) {
+        memcpy(&(packet->holder), buf + sizeof(hdr) + body, sizeof(struct in6_addr));
+    } else {
+        memset(&(packet->holder), 0, sizeof(packet->holder));
+    }
+    return 0;
+}
+
+/**
+ * @brief ܂Ƃ߂đXbh
+ *
+ * ŏ̌₪ĂMULTI_LINGER_MS҂Abatch_max܂瑗B
+ * @param arg gĂȂ
+ * @return NULLԂ
+ */
+static void *multi_batch_thread(void *arg) {
+    struct in6_addr candidates[MULTI_MAX];
+    struct timeval now;
+    struct timespec deadline;
+    int count;
+
+    (void)arg;
+    pthread_detach(pthread_self());
+
+    for (;;) {
+        pthread_mutex_lock(&batch_mutex);
+        while (batch_count == 0) {
+            pthread_cond_wait(&batch_cond, &batch_mutex);
+        }
+        gettimeofday(&now, NULL);
+        deadline.tv_sec = now.tv_sec;
+        deadline.tv_nsec = now.tv_usec * 1000L + MULTI_LINGER_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        while (batch_count < batch_max) {
+            if (pthread_cond_timedwait(&batch_cond, &batch_mutex, &deadline) == ETIMEDOUT) {
+                break;
+            }
+        }
+        count = batch_count;
+        memcpy(candidates, batch, (size_t)count * sizeof(struct in6_addr));
+        batch_count = 0;
+        pthread_cond_broadcast(&batch_cond); // tő҂Ămulti_batch_addN
+        pthread_mutex_unlock(&batch_mutex);
+
+        batch_flush(candidates, count);
+    }
+    return NULL;
+}
+
+/**
+ * @brief ܂Ƃ߂đXbh𗧂Ă
+ *
+ * @param max 1AREQɓ̍ő吔
+ * @param flush ܂Ƃ܂𑗂֐B̃W[̃XbhĂ΂
+ * @retval 0 
+ * @retval -1 s
+ */
+int multi_batch_start(int max, void (*flush)(const struct in6_addr *candidates, int count)) {
+    pthread_t tid;
+
+    if (max < 2 || max > MULTI_MAX || flush == NULL) {
+        return -1;
+    }
+    batch_max = max;
+    batch_flush = flush;
+    if (pthread_create(&tid, NULL, multi_batch_thread, NULL) != 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[multi_batch_start] pthread_create error: %m");
+        batch_max = 0;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief AREQɓ
+ *
+ * ܂Ƃ߂ꂸɈtȂAo܂ő҂B
+ * @param candidate AhX
+ * @retval 0 
+ * @retval -1 ܂Ƃ߂đXbhĂȂ
+ */
+int multi_batch_add(const struct in6_addr *candidate) {
+    if (batch_max == 0) {
+        return -1;
+    }
+    pthread_mutex_lock(&batch_mutex);
+    while (batch_count >= batch_max) {
+        pthread_cond_wait(&batch_cond, &batch_mutex);
+    }
+    batch[batch_count++] = *candidate;
+    pthread_cond_broadcast(&batch_cond);
+    pthread_mutex_unlock(&batch_mutex);
+    return 0;
+}
@@ -0,0 +1,56 @@
+/**
+ * @file sta_multi.h
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief AREQ/AREP
+ * 1AREQŕ̌AhX₢킹AAREP͌₲Ƃ̏drbg}bvŕԂ
+ */
+
+#ifndef _STA_MULTI_H
+#define _STA_MULTI_H
+
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define MULTI_VERSION 1
+#define MULTI_MAX 16 ///< 1pPbgɓ̍ő吔Brbg}bvɎ܂邱
+#define MULTI_LINGER_MS 20 ///< eiǧ܂Ƃ߂邽߂ɑ҂[~b]
+#define MULTI_NEGATIVE_ONLY 0x80000000u ///< AREQduplicateɗĂBd̂ƂԓĂق
+
+/**
+ * @brief AREQ/AREP̃wb_
+ *
+ * type͏]AREQ/AREPƓzXg̃oCgȂ̂ŁA]stamd͒mȂtypeƂĎ̂ĂB
+ * ȊO̓lbg[NoCgBwb_̌Ɍ₪countсA
+ * AREPȂ炳ɕԓm[hgSTA(ȂΑS0)B
+ */
+typedef struct _multi_hdr {
+    uint16_t type; ///< AREQ_MULTIAREP_MULTI
+    uint8_t version; ///< MULTI_VERSION
+    uint8_t count; ///< ̐
+    uint32_t txid; ///< AREQ𑗂m[h߂ԍBAREP͂̂܂ܕԂ
+    uint32_t duplicate; ///< AREPŏdẴrbgBAREQłMULTI_NEGATIVE_ONLYg
+} __attribute__((packed)) multi_hdr;
+
+/**
+ * @brief ͂AREQ/AREP
+ */
+typedef struct _multi_packet {
+    int type;
+    uint32_t txid;
+    uint32_t duplicate;
+    int count;
+    struct in6_addr candidates[MULTI_MAX];
+    struct in6_addr holder; ///< AREPԂm[hSTA
+    int has_holder;
+} multi_packet;
+
+size_t multi_build(char *buf, size_t buflen, int type, uint32_t txid, uint32_t duplicate,
+                   const struct in6_addr *candidates, int count, const struct in6_addr *holder);
+size_t multi_reply(char *buf, size_t buflen, int type, uint32_t duplicate, const struct in6_addr *holder);
+int multi_parse(const char *buf, size_t len, multi_packet *packet);
+int multi_batch_start(int max, void (*flush)(const struct in6_addr *candidates, int count));
+int multi_batch_add(const struct in6_addr *candidate);
+
+#endif
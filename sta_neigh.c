@@ -0,0 +1,432 @@
+/**
+ * @file sta_neigh.c
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief ߗ׃m[h̋ԃCfbNX
+ *
+ * ߗ׃m[hSTAtZʒuŃObhɓĂA
+ * AhX̂܂3x3Zɂm[hɂAREQjLXgł悤ɂB
+ * STAd͓̂ʒu𕄍m[hȂ̂ŁAm[hɕKv͂ȂB
+ * A܂ĂȂm[h邩Ȃ̂ŁA
+ * refreshbƂ1̓}`LXgĕ\蒼B
+ *
+ * \sta_exportŋLɂoB̂Ƃ̓jLXgɎgȂĂoĂA
+ * oԊuƂɕǂ烊Ni߂B
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include "sta_neigh.h"
+
+static neigh_entry entries[NEIGH_MAX];
+static int id_head[NEIGH_BUCKETS]; ///< MSTAňnbV\̃oPbg
+static int cell_head[NEIGH_BUCKETS]; ///< ZňnbV\̃oPbg
+static int neigh_count = 0;
+static int neigh_refresh = 0; ///< }`LXgԊu[b]B0ȂɃ}`LXg
+static int neigh_enabled = 0; ///< ߗ׃m[hoȂ1
+static time_t last_sweep = 0; ///< ŌɃ}`LXg
+static pthread_mutex_t neigh_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief ʒuObh̃Z߂
+ *
+ * s͈ܓxNEIGH_CELL_MƂɐ؂B͍̕s̒S̈ܓxŌox1x̒ς̂ōsƂɕςB
+ * @param lat ܓx
+ * @param lon ox
+ * @param[out] row s
+ * @param[out] col 
+ */
+static void neigh_cell(double lat, double lon, int *row, int *col) {
+    const double latcell = NEIGH_CELL_M / 110952.0;
+    double rowlat;
+    double c;
+
+    *row = (int)floor((lat + 90.0) / latcell);
+    rowlat = (*row + 0.5) * latcell - 90.0;
+    c = cos(rowlat * M_PI / 180.0);
+    if (c < 0.01) {
+        c = 0.01; // ɂ̋߂
+    }
+    *col = (int)floor((lon + 180.0) / (NEIGH_CELL_M / (111319.0 * c)));
+}
+
+static unsigned int neigh_cell_hash(int row, int col) {
+    return (((uint32_t)row * 73856093u) ^ ((uint32_t)col * 19349663u)) & (NEIGH_BUCKETS - 1);
+}
+
+static unsigned int neigh_id_hash(const struct in6_addr *from, const struct in6_addr *sta) {
+    const unsigned char *p;
+    uint32_t h = 2166136261u;
+    int i;
+
+    p = (const unsigned char *)from;
+    for (i = 0; i < 16; i++) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    p = (const unsigned char *)sta;
+    for (i = 0; i < 16; i++) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return h & (NEIGH_BUCKETS - 1);
+}
+
+/**
+ * @brief Gg𗼕̃nbV\Oċ󂫂ɂ
+ *
+ * neigh_mutexԂŌĂԂƁB
+ * @param idx Ggԍ
+ */
+static void neigh_unlink(int idx) {
+    neigh_entry *e = &entries[idx];
+    int *pp;
+
+    for (pp = &id_head[neigh_id_hash(&(e->from.sin6_addr), &(e->sta))]; *pp != -1; pp = &(entries[*pp].id_next)) {
+        if (*pp == idx) {
+            *pp = e->id_next;
+            break;
+        }
+    }
+    for (pp = &cell_head[neigh_cell_hash(e->row, e->col)]; *pp != -1; pp = &(entries[*pp].cell_next)) {
+        if (*pp == idx) {
+            *pp = e->cell_next;
+            break;
+        }
+    }
+    e->used = 0;
+    neigh_count--;
+}
+
+/**
+ * @brief ߗ׃m[h̕\
+ *
+ * @param refresh }`LXgԊu[b]B0ȂAREQ̃jLXgɋߗ׃m[hgȂ
+ * @param keep 1Ȃrefresh0łߗ׃m[ho(oƂ)
+ * @retval 0 
+ */
+int neigh_init(int refresh, int keep) {
+    int i;
+
+    pthread_mutex_lock(&neigh_mutex);
+    memset(entries, 0, sizeof(entries));
+    for (i = 0; i < NEIGH_BUCKETS; i++) {
+        id_head[i] = -1;
+        cell_head[i] = -1;
+    }
+    neigh_count = 0;
+    neigh_refresh = refresh;
+    neigh_enabled = (refresh > 0 || keep);
+    last_sweep = 0;
+    pthread_mutex_unlock(&neigh_mutex);
+    return 0;
+}
+
+/**
+ * @brief ߗ׃m[h\ɓ
+ *
+ * neigh_mutexԂŌĂԂƁB
+ * @param from pPbg̑M
+ * @param sta ߗ׃m[hSTA
+ * @param lat STAtZܓx
+ * @param lon STAtZox
+ * @param alt STAtZx
+ * @param now 
+ * @return Ggԍ
+ */
+static int neigh_insert(const struct sockaddr_in6 *from, const struct in6_addr *sta, double lat, double lon, double alt, time_t now) {
+    unsigned int h;
+    unsigned int c;
+    int idx;
+    int oldest;
+    neigh_entry *e;
+
+    h = neigh_id_hash(&(from->sin6_addr), sta);
+    for (idx = id_head[h]; idx != -1; idx = entries[idx].id_next) {
+        e = &entries[idx];
+        if (memcmp(&(e->from.sin6_addr), &(from->sin6_addr), sizeof(struct in6_addr)) == 0
+            && memcmp(&(e->sta), sta, sizeof(struct in6_addr)) == 0) {
+            e->last_seen = now;
+            e->from.sin6_scope_id = from->sin6_scope_id;
+            return idx;
+        }
+    }
+
+    if (neigh_count >= NEIGH_MAX) {
+        oldest = 0;
+        for (idx = 1; idx < NEIGH_MAX; idx++) {
+            if (entries[idx].last_seen < entries[oldest].last_seen) {
+                oldest = idx;
+            }
+        }
+        neigh_unlink(oldest);
+    }
+    for (idx = 0; idx < NEIGH_MAX && entries[idx].used; idx++) {
+        ;
+    }
+
+    e = &entries[idx];
+    e->from = *from;
+    e->sta = *sta;
+    e->lat = lat;
+    e->lon = lon;
+    e->alt = alt;
+    e->last_seen = now;
+    e->heard = 0;
+    e->heard_tick = 0;
+    e->quality = 0.0;
+    e->used = 1;
+    neigh_cell(lat, lon, &(e->row), &(e->col));
+    e->id_next = id_head[h];
+    id_head[h] = idx;
+    c = neigh_cell_hash(e->row, e->col);
+    e->cell_next = cell_head[c];
+    cell_head[c] = idx;
+    neigh_count++;
+    return idx;
+}
+
+/**
+ * @brief ߗ׃m[ho
+ *
+ * MSTȂgłɂΎƕXVB
+ * \tȂԌÂ̂̂ĂB
+ * @param from pPbg̑M
+ * @param sta ߗ׃m[hSTA
+ * @param lat STAtZܓx
+ * @param lon STAtZox
+ * @param alt STAtZx
+ * @retval 1 ߂ĕ
+ * @retval 0 mĂA܂͊oȂ
+ */
+int neigh_learn(const struct sockaddr_in6 *from, const struct in6_addr *sta, double lat, double lon, double alt) {
+    time_t now;
+    neigh_entry *e;
+    int first;
+
+    if (!neigh_enabled) {
+        return 0;
+    }
+    now = time(NULL);
+    pthread_mutex_lock(&neigh_mutex);
+    e = &entries[neigh_insert(from, sta, lat, lon, alt, now)];
+    first = (e->heard == 0);
+    e->heard++;
+    e->heard_tick = 1;
+    pthread_mutex_unlock(&neigh_mutex);
+    return first;
+}
+
+/**
+ * @brief oĂߗ׃m[h\ɖ߂
+ *
+ * ċNƂɎgBŌɕƍŌɃ}`LXĝ܂ܖ߂̂ŁA
+ * Â͎̂neigh_sweptneigh_exportŖYB
+ * @param in neigh_dumpŏo
+ * @param n in̗vf
+ * @param scope_id M̃XR[vID(wlan_interface̔ԍ)
+ * @param swept ŌɃ}`LXg
+ */
+void neigh_restore(const sta_ctl_neigh *in, size_t n, unsigned int scope_id, time_t swept) {
+    struct sockaddr_in6 from;
+    size_t i;
+
+    if (!neigh_enabled) {
+        return;
+    }
+    memset(&from, 0, sizeof(from));
+    from.sin6_family = AF_INET6;
+    from.sin6_scope_id = scope_id;
+    pthread_mutex_lock(&neigh_mutex);
+    for (i = 0; i < n; i++) {
+        from.sin6_addr = in[i].from;
+        neigh_insert(&from, &(in[i].addr), in[i].lat, in[i].lon, in[i].alt, (time_t)in[i].last_seen);
+    }
+    last_sweep = swept;
+    pthread_mutex_unlock(&neigh_mutex);
+}
+
+/**
+ * @brief ŌɃ}`LXg𓾂
+ *
+ * @return Ōneigh_sweptĂ񂾎
+ */
+time_t neigh_swept_at(void) {
+    time_t t;
+
+    pthread_mutex_lock(&neigh_mutex);
+    t = last_sweep;
+    pthread_mutex_unlock(&neigh_mutex);
+    return t;
+}
+
+/**
+ * @brief AhXAREQ𑗂ׂߗ׃m[h
+ *
+ * ̈ʒû܂3x3Zɂm[h̑MdȂŕԂB
+ * \Â(Ō̃}`LXgrefreshbȏソ)ƂA
+ * 悪max葽Ƃ1ȂƂ-1Ԃ̂ŁA}`LXg邱ƁB
+ * \AREQ̑MƎAREP炵oȂ̂ŁAłNȂƂ͌ȂB
+ * @param lat AhXtZܓx
+ * @param lon AhXtZox
+ * @param[out] targets 
+ * @param max targets̑傫
+ * @return ̐B}`LXgׂȂ-1
+ */
+int neigh_targets(double lat, double lon, struct sockaddr_in6 *targets, int max) {
+    const double latcell = NEIGH_CELL_M / 110952.0;
+    time_t now = time(NULL);
+    time_t expire;
+    int row, col;
+    int dr, cc;
+    int idx;
+    int i;
+    int n = 0;
+    neigh_entry *e;
+
+    if (neigh_refresh <= 0) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&neigh_mutex);
+    if (now - last_sweep >= neigh_refresh) {
+        pthread_mutex_unlock(&neigh_mutex);
+        return -1;
+    }
+    expire = now - (time_t)neigh_refresh * NEIGH_EXPIRE_SWEEPS;
+
+    for (dr = -1; dr <= 1; dr++) {
+        // ͍̕sƂɈႤ̂ŁAsƂɌ̗ߒ
+        neigh_cell(lat + dr * latcell, lon, &row, &col);
+        for (cc = col - 1; cc <= col + 1; cc++) {
+            for (idx = cell_head[neigh_cell_hash(row, cc)]; idx != -1; idx = entries[idx].cell_next) {
+                e = &entries[idx];
+                if (e->row != row || e->col != cc || e->last_seen < expire) {
+                    continue;
+                }
+                for (i = 0; i < n; i++) {
+                    if (memcmp(&(targets[i].sin6_addr), &(e->from.sin6_addr), sizeof(struct in6_addr)) == 0) {
+                        break;
+                    }
+                }
+                if (i < n) {
+                    continue;
+                }
+                if (n >= max) {
+                    pthread_mutex_unlock(&neigh_mutex);
+                    return -1;
+                }
+                targets[n++] = e->from;
+            }
+        }
+    }
+    pthread_mutex_unlock(&neigh_mutex);
+    return (n > 0) ? n : -1;
+}
+
+/**
+ * @brief }`LXgƂL^
+ *
+ * łɒԕĂȂm[hYB
+ */
+void neigh_swept(void) {
+    time_t now = time(NULL);
+    time_t expire;
+    int idx;
+
+    if (neigh_refresh <= 0) {
+        return;
+    }
+    pthread_mutex_lock(&neigh_mutex);
+    last_sweep = now;
+    expire = now - (time_t)neigh_refresh * NEIGH_EXPIRE_SWEEPS;
+    for (idx = 0; idx < NEIGH_MAX; idx++) {
+        if (entries[idx].used && entries[idx].last_seen < expire) {
+            neigh_unlink(idx);
+        }
+    }
+    pthread_mutex_unlock(&neigh_mutex);
+}
+
+/**
+ * @brief ߗ׃m[h𐧌\Pbg̕ԓ̌`ŏo
+ *
+ * @param[out] out o
+ * @param max out̗vf
+ * @param[out] truncated 肫Ȃ1
+ * @return o
+ */
+size_t neigh_dump(sta_ctl_neigh *out, size_t max, int *truncated) {
+    size_t n = 0;
+    int idx;
+
+    *truncated = 0;
+    pthread_mutex_lock(&neigh_mutex);
+    for (idx = 0; idx < NEIGH_MAX; idx++) {
+        if (!entries[idx].used) {
+            continue;
+        }
+        if (n >= max) {
+            *truncated = 1;
+            break;
+        }
+        memset(&out[n], 0, sizeof(out[n]));
+        out[n].addr = entries[idx].sta;
+        out[n].from = entries[idx].from.sin6_addr;
+        out[n].lat = entries[idx].lat;
+        out[n].lon = entries[idx].lon;
+        out[n].alt = entries[idx].alt;
+        out[n].last_seen = entries[idx].last_seen;
+        n++;
+    }
+    pthread_mutex_unlock(&neigh_mutex);
+    return n;
+}
+
+/**
+ * @brief ߗ׃m[hLɏo`ŏo
+ *
+ * tick1ȂAoԊu1؂ƂăNiXVB
+ * }`LXgȂƂ́ANEIGH_IDLE_EXPIREbĂȂm[hYB
+ * @param[out] out o
+ * @param max out̗vf
+ * @param tick oԊű؂Ȃ1
+ * @return o
+ */
+size_t neigh_export(export_neigh *out, size_t max, int tick) {
+    time_t expire = time(NULL) - NEIGH_IDLE_EXPIRE;
+    neigh_entry *e;
+    size_t n = 0;
+    int idx;
+
+    pthread_mutex_lock(&neigh_mutex);
+    for (idx = 0; idx < NEIGH_MAX; idx++) {
+        e = &entries[idx];
+        if (!e->used) {
+            continue;
+        }
+        if (tick) {
+            if (neigh_refresh <= 0 && e->last_seen < expire) {
+                neigh_unlink(idx);
+                continue;
+            }
+            e->quality += NEIGH_QUALITY_ALPHA * ((e->heard_tick ? 1.0 : 0.0) - e->quality);
+            e->heard_tick = 0;
+        }
+        if (n >= max) {
+            continue; // i̍XV͑Sɍs
+        }
+        memset(&out[n], 0, sizeof(out[n]));
+        out[n].addr = e->sta;
+        out[n].from = e->from.sin6_addr;
+        out[n].scope_id = e->from.sin6_scope_id;
+        out[n].heard = e->heard;
+        out[n].lat = e->lat;
+        out[n].lon = e->lon;
+        out[n].alt = e->alt;
+        out[n].quality = e->quality;
+        out[n].last_seen = (int64_t)e->last_seen;
+        n++;
+    }
+    pthread_mutex_unlock(&neigh_mutex);
+    return n;
+}
@@ -0,0 +1,58 @@
+/**
+ * @file sta_neigh.h
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief ߗ׃m[h̋ԃCfbNX
+ * AREQ/AREPߗ׃m[hSTAƈʒuoāAAhXƏdȂ肤m[h
+ */
+
+#ifndef _STA_NEIGH_H
+#define _STA_NEIGH_H
+
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <stddef.h>
+#include <time.h>
+#include "sta_ctl.h"
+#include "sta_export.h"
+
+#define NEIGH_MAX 4096 ///< oĂߗ׃m[h̍ő吔
+#define NEIGH_BUCKETS 1024 ///< nbV\̃oPbgB2ׂ̂
+#define NEIGH_CELL_M 100.0 ///< Obh̃Z̈[m]BL͈͂̒a傫
+#define NEIGH_UNICAST_MAX 8 ///< 葽Ȃ}`LXg̕
+#define NEIGH_EXPIRE_SWEEPS 3 ///< ̉񐔂̃}`LXg̊ԕȂΖY
+#define NEIGH_IDLE_EXPIRE 60 ///< }`LXgȂƂA̎[b]ȂΖY
+#define NEIGH_QUALITY_ALPHA 0.125 ///< Ni̎wړς̏d
+
+/**
+ * @brief ߗ׃m[h
+ *
+ * MAhXSTȂg1GgB
+ * }`eigstamd1̑M畡STAƂB
+ */
+typedef struct _neigh_entry {
+    struct sockaddr_in6 from; ///< pPbg̑M(XR[vID)
+    struct in6_addr sta; ///< ߗ׃m[hSTA
+    double lat; ///< STAtZܓx
+    double lon; ///< STAtZox
+    double alt; ///< STAtZx
+    time_t last_seen; ///< Ōɕ
+    unsigned int heard; ///< pPbg̐
+    int heard_tick; ///< ̏oԊůԂɕ1
+    double quality; ///< oԊûԊů̎wړ
+    int row; ///< Obh̍s
+    int col; ///< Obh̗
+    int id_next; ///< MSTAňnbV\̘A
+    int cell_next; ///< ZňnbV\̘A
+    int used; ///< gpȂ1
+} neigh_entry;
+
+int neigh_init(int refresh, int keep);
+int neigh_learn(const struct sockaddr_in6 *from, const struct in6_addr *sta, double lat, double lon, double alt);
+int neigh_targets(double lat, double lon, struct sockaddr_in6 *targets, int max);
+void neigh_swept(void);
+size_t neigh_dump(sta_ctl_neigh *out, size_t max, int *truncated);
+size_t neigh_export(export_neigh *out, size_t max, int tick);
+void neigh_restore(const sta_ctl_neigh *in, size_t n, unsigned int scope_id, time_t swept);
+time_t neigh_swept_at(void);
+
+#endif
@@ -0,0 +1,239 @@
+/**
+ * @file sta_reply.c
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief AREP̑M
+ *
+ * AREP͎󂯎AREQ̃obt@̏ŏč̂ŁA܂łɃq[v͎gȂB
+ * M[vreply_holdĂ󂯎pPbgAreply_flush
+ * ̊ԂAREP1sendmmsgőBAREP̌ɂȂobt@reply_flush܂ŏȂƁB
+ * reply_holdĂȂXbhreply_send͂̏sendtoB
+ *
+ * dAREP̃obNIt́AM[v~߂Ȃ悤ɌŒ̕\Ɏʂ
+ * Mp̃Xbh玞瑗B\tȂ炻̏őB
+ */
+
+#define _GNU_SOURCE // sendmmsg
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <syslog.h>
+#include <time.h>
+#include "sta_reply.h"
+
+/**
+ * @brief ߂ĂAREP
+ */
+typedef struct _reply_batch {
+    int holding; ///< reply_holdĂȂ1
+    int fd; ///< ߂ĂAREP𑗂\Pbg
+    int count;
+    struct mmsghdr msgs[REPLY_BATCH];
+    struct iovec iov[REPLY_BATCH];
+    struct sockaddr_in6 to[REPLY_BATCH];
+} reply_batch;
+
+/**
+ * @brief x点đAREP
+ */
+typedef struct _reply_pending {
+    struct timespec due; ///< 鎞(CLOCK_REALTIME)
+    int fd;
+    struct sockaddr_in6 to;
+    size_t len; ///< 0Ȃ
+    char buf[REPLY_LATER_SIZE];
+} reply_pending;
+
+static __thread reply_batch batch; ///< XbhƂɗ߂ĂAREP
+
+static reply_pending pending[REPLY_LATER_MAX];
+static int pending_count = 0;
+static pthread_mutex_t pending_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pending_cond = PTHREAD_COND_INITIALIZER;
+static pthread_once_t pending_once = PTHREAD_ONCE_INIT;
+static int pending_started = 0; ///< Mp̃Xbhꂽ1
+
+/**
+ * @brief ̃XbhAREPreply_flush܂ŗ߂
+ */
+void reply_hold(void) {
+    batch.holding = 1;
+}
+
+/**
+ * @brief ߂ĂAREP𑗂
+ *
+ * ȂAREP1΂Ďc𑗂蒼B߂̂͂߂ȂB
+ */
+void reply_flush(void) {
+    int sent = 0;
+    int ret;
+
+    while (sent < batch.count) {
+        ret = sendmmsg(batch.fd, batch.msgs + sent, (unsigned int)(batch.count - sent), 0);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            syslog(LOG_LOCAL0|LOG_DEBUG, "[reply_flush] sendmmsg error: %m");
+            ret = 1;
+        }
+        sent += ret;
+    }
+    batch.count = 0;
+}
+
+/**
+ * @brief AREP𑗂
+ *
+ * reply_holdĂΗ߂邾ŁAbufreply_flush܂ŏȂƁB
+ * Ⴄ\PbgAREPAREPLY_BATCH܂炻܂ł𑗂B
+ * @param fd \Pbg
+ * @param to 
+ * @param buf AREP
+ * @param len AREP̒
+ * @retval 0 A܂͗߂
+ * @retval -1 s
+ */
+int reply_send(int fd, const struct sockaddr_in6 *to, const char *buf, size_t len) {
+    int i;
+
+    if (!batch.holding) {
+        if (sendto(fd, buf, len, 0, (const struct sockaddr *)to, sizeof(*to)) < 0) {
+            return -1;
+        }
+        return 0;
+    }
+    if (batch.count > 0 && batch.fd != fd) {
+        reply_flush();
+    }
+    i = batch.count++;
+    batch.fd = fd;
+    batch.to[i] = *to;
+    batch.iov[i].iov_base = (void *)buf;
+    batch.iov[i].iov_len = len;
+    memset(&(batch.msgs[i]), 0, sizeof(batch.msgs[i]));
+    batch.msgs[i].msg_hdr.msg_name = &(batch.to[i]);
+    batch.msgs[i].msg_hdr.msg_namelen = sizeof(batch.to[i]);
+    batch.msgs[i].msg_hdr.msg_iov = &(batch.iov[i]);
+    batch.msgs[i].msg_hdr.msg_iovlen = 1;
+    if (batch.count == REPLY_BATCH) {
+        reply_flush();
+    }
+    return 0;
+}
+
+/**
+ * @brief x点đAREP̃Xbh
+ *
+ * ΂񑁂AREP̎܂ő҂āÂ̗𑗂B
+ * @param arg gĂȂ
+ * @return NULLԂ
+ */
+static void *reply_later_thread(void *arg) {
+    struct timespec now;
+    reply_pending out;
+    int first;
+    int i;
+
+    (void)arg;
+    pthread_detach(pthread_self());
+
+    pthread_mutex_lock(&pending_mutex);
+    for (;;) {
+        while (pending_count == 0) {
+            pthread_cond_wait(&pending_cond, &pending_mutex);
+        }
+        first = -1;
+        for (i = 0; i < REPLY_LATER_MAX; i++) {
+            if (pending[i].len > 0 && (first < 0 || pending[i].due.tv_sec < pending[first].due.tv_sec
+                || (pending[i].due.tv_sec == pending[first].due.tv_sec && pending[i].due.tv_nsec < pending[first].due.tv_nsec))) {
+                first = i;
+            }
+        }
+        clock_gettime(CLOCK_REALTIME, &now);
+        if (now.tv_sec < pending[first].due.tv_sec
+            || (now.tv_sec == pending[first].due.tv_sec && now.tv_nsec < pending[first].due.tv_nsec)) {
+            pthread_cond_timedwait(&pending_cond, &pending_mutex, &(pending[first].due));
+            continue; // VAREPȂ̂őIђ
+        }
+        out.fd = pending[first].fd;
+        out.to = pending[first].to;
+        out.len = pending[first].len;
+        memcpy(out.buf, pending[first].buf, pending[first].len);
+        pending[first].len = 0;
+        pending_count--;
+        pthread_mutex_unlock(&pending_mutex);
+
+        if (sendto(out.fd, out.buf, out.len, 0, (const struct sockaddr *)&(out.to), sizeof(out.to)) < 0) {
+            syslog(LOG_LOCAL0|LOG_DEBUG, "[reply_later_thread] sendto error: %m");
+        }
+        pthread_mutex_lock(&pending_mutex);
+    }
+    return NULL;
+}
+
+/**
+ * @brief x点đAREP̃Xbh
+ */
+static void reply_later_start(void) {
+    pthread_t tid;
+
+    if (pthread_create(&tid, NULL, reply_later_thread, NULL) != 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[reply_later_start] pthread_create error: %m");
+        return;
+    }
+    pending_started = 1;
+}
+
+/**
+ * @brief AREPx点đ
+ *
+ * M[v~߂Ȃ悤ɁAbufŒ̕\ɎʂđMp̃Xbh瑗B
+ * \tAMp̃XbhȂreply_sendőB
+ * @param fd \Pbg
+ * @param to 
+ * @param buf AREPBĂяo̊ԂLł悢
+ * @param len AREP̒
+ * @param delay_us x点鎞[}CNb]B0ȉȂreply_sendƓ
+ * @retval 0 A܂͑\ɂ
+ * @retval -1 s
+ */
+int reply_send_later(int fd, const struct sockaddr_in6 *to, const char *buf, size_t len, long delay_us) {
+    struct timespec due;
+    int i;
+
+    if (delay_us <= 0 || len == 0 || len > REPLY_LATER_SIZE) {
+        return reply_send(fd, to, buf, len);
+    }
+    pthread_once(&pending_once, reply_later_start);
+    if (!pending_started) {
+        return reply_send(fd, to, buf, len);
+    }
+    clock_gettime(CLOCK_REALTIME, &due);
+    due.tv_sec += delay_us / 1000000L;
+    due.tv_nsec += (delay_us % 1000000L) * 1000L;
+    if (due.tv_nsec >= 1000000000L) {
+        due.tv_sec++;
+        due.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&pending_mutex);
+    for (i = 0; i < REPLY_LATER_MAX && pending[i].len > 0; i++) {
+    }
+    if (i == REPLY_LATER_MAX) {
+        pthread_mutex_unlock(&pending_mutex);
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[reply_send_later] %d replies pending, sending now", REPLY_LATER_MAX);
+        return reply_send(fd, to, buf, len);
+    }
+    pending[i].due = due;
+    pending[i].fd = fd;
+    pending[i].to = *to;
+    pending[i].len = len;
+    memcpy(pending[i].buf, buf, len);
+    pending_count++;
+    pthread_cond_signal(&pending_cond);
+    pthread_mutex_unlock(&pending_mutex);
+    return 0;
+}
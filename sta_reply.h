@@ -0,0 +1,24 @@
+/**
+ * @file sta_reply.h
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief AREP̑M
+ * M[v1񕪂AREP𗭂߂sendmmsgł܂Ƃ߂đBobNItAREP͌Œ̕\x点đ
+ */
+
+#ifndef _STA_REPLY_H
+#define _STA_REPLY_H
+
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <stddef.h>
+
+#define REPLY_BATCH 64 ///< 1sendmmsgőAREP̐BENGINE_BATCHƓ
+#define REPLY_LATER_MAX 64 ///< x点đAREPĂ鐔
+#define REPLY_LATER_SIZE 512 ///< x点đAREP̍ő̑傫BstamdUDP_RECV_BUF_SIZE
+
+void reply_hold(void);
+void reply_flush(void);
+int reply_send(int fd, const struct sockaddr_in6 *to, const char *buf, size_t len);
+int reply_send_later(int fd, const struct sockaddr_in6 *to, const char *buf, size_t len, long delay_us);
+
+#endif
@@ -0,0 +1,78 @@
+/**
+ * @file sta_seqlock.h
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief V[PXbN
+ * ͊̂ɏAǂݎ͔ԍςĂǂݒB
+ * ǂݎ̓bNȂ̂ŁA肪J[lĂłĂ҂ȂB
+ * 蓯m̔r͌ĂяoōsƁB
+ */
+
+#ifndef _STA_SEQLOCK_H
+#define _STA_SEQLOCK_H
+
+#include <sched.h>
+
+typedef struct _seqlock {
+    volatile unsigned int seq; ///< Ȃ珑
+} seqlock;
+
+/**
+ * @brief 
+ *
+ * @param sl V[PXbN
+ */
+static inline void seqlock_init(seqlock *sl) {
+    sl->seq = 0;
+}
+
+/**
+ * @brief ǂݎn߂
+ *
+ * ȂI܂ŏB͍\̂̃Rs[Ȃ̂łIB
+ * @param sl V[PXbN
+ * @return seqlock_read_retryɓnԍ
+ */
+static inline unsigned int seqlock_read_begin(const seqlock *sl) {
+    unsigned int seq;
+
+    while ((seq = sl->seq) & 1) {
+        sched_yield();
+    }
+    __sync_synchronize();
+    return seq;
+}
+
+/**
+ * @brief ǂłԂɏꂽׂ
+ *
+ * @param sl V[PXbN
+ * @param seq seqlock_read_begin̕Ԃԍ
+ * @retval 1 ꂽ̂œǂݒ
+ * @retval 0 ǂ񂾒l͈тĂ
+ */
+static inline int seqlock_read_retry(const seqlock *sl, unsigned int seq) {
+    __sync_synchronize();
+    return sl->seq != seq;
+}
+
+/**
+ * @brief n߂
+ *
+ * @param sl V[PXbN
+ */
+static inline void seqlock_write_begin(seqlock *sl) {
+    sl->seq++;
+    __sync_synchronize();
+}
+
+/**
+ * @brief I
+ *
+ * @param sl V[PXbN
+ */
+static inline void seqlock_write_end(seqlock *sl) {
+    __sync_synchronize();
+    sl->seq++;
+}
+
+#endif
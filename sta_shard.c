@@ -0,0 +1,198 @@
+/**
+ * @file sta_shard.c
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief UDP|[gSO_REUSEPORTɂ镪
+ *
+ * 1{̃\Pbg1̃XbhœǂނƁAAREQWƂɂœłɂȂB
+ * SO_REUSEPORTœ|[gɃ[J[̐\PbgJAe[J[͎
+ * \PbgCPUɌŒ肵XbhœǂށB
+ * jLXgSO_ATTACH_REUSEPORT_CBPF̐U蕪vOŁApPbg󂯂CPU
+ * Œ肵[J[̃\PbgɓnBvOtȂ΃J[l4^ṽnbVB
+ *
+ * }`LXgSO_REUSEPORT̃O[vłS\Pbgɕ̂ŁA
+ * 2Ԗڈȍ~̃\PbgIPV6_MULTICAST_ALL؂AQȂB
+ * }`LXgAREQ͎QĂ0(sockfd)󂯂B
+ * IPV6_MULTICAST_ALL̂ȂÂJ[lł͓AREQɉxĂ܂̂ŕȂB
+ */
+
+#define _GNU_SOURCE // CPU_SETApthread_setaffinity_np
+
+#include <errno.h>
+#include <linux/filter.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <syslog.h>
+#include <unistd.h>
+#include "sta_shard.h"
+
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF 51
+#endif
+#ifndef IPV6_MULTICAST_ALL
+#define IPV6_MULTICAST_ALL 29
+#endif
+
+static int shard_cpus[SHARD_MAX]; ///< [J[ԍƂCPU
+static int shard_ncpus = 0; ///< gCPU̐
+
+/**
+ * @brief [J[Ɋ蓖ĂCPU߂
+ *
+ * ̃vZXgCPUԍ̏Ɋ蓖āAȂ΍ŏJԂB
+ * @param nworkers [J[̐
+ */
+static void shard_assign_cpus(int nworkers) {
+    cpu_set_t set;
+    int cpu, i;
+
+    shard_ncpus = 0;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (cpu = 0; cpu < CPU_SETSIZE && shard_ncpus < SHARD_MAX; cpu++) {
+            if (CPU_ISSET(cpu, &set)) {
+                shard_cpus[shard_ncpus++] = cpu;
+            }
+        }
+    }
+    for (i = shard_ncpus; i < nworkers; i++) {
+        shard_cpus[i] = (shard_ncpus > 0) ? shard_cpus[i % shard_ncpus] : -1;
+    }
+}
+
+/**
+ * @brief ̃vZXgCPU̐
+ *
+ * U蕪vO͎󂯂CPŨ[J[IԂ̂ŁACPU葽[J[ɂ̓jLXgȂB
+ * @return CPU̐B킩Ȃ0
+ */
+int shard_cpu_count(void) {
+    cpu_set_t set;
+
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+        return 0;
+    }
+    return CPU_COUNT(&set);
+}
+
+/**
+ * @brief 󂯂CPŨ[J[IԐU蕪vOt
+ *
+ * CPUǂ̃[J[ɂ蓖ĂĂȂCPUԍ%[J[B
+ * vO̕ԂlSO_REUSEPORT̃O[v̒̃\Pbg̏ԂɂȂB
+ * @param fd O[v̂ǂꂩ̃\Pbg
+ * @param nworkers [J[̐
+ * @retval 0 
+ * @retval -1 s
+ */
+static int shard_attach_steering(int fd, int nworkers) {
+    struct sock_filter code[SHARD_MAX * 2 + 3];
+    struct sock_fprog prog;
+    int n = 0;
+    int i;
+
+    code[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, (uint32_t)(SKF_AD_OFF + SKF_AD_CPU));
+    for (i = 0; i < nworkers && i < shard_ncpus; i++) {
+        code[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (uint32_t)shard_cpus[i], 0, 1);
+        code[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, (uint32_t)i);
+    }
+    code[n++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, (uint32_t)nworkers);
+    code[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_A, 0);
+
+    prog.len = (unsigned short)n;
+    prog.filter = code;
+    if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) != 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[shard_attach_steering] setsockopt error: %m");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief |[gɃ[J[̐\PbgJ
+ *
+ * workers[0]̃\Pbg}`LXg󂯂B
+ * [J[̔ԍ̏bind̂ŁȀԂSO_REUSEPORT̃O[v̒̏ԂɂȂB
+ * @param port |[gԍ
+ * @param nworkers [J[̐
+ * @param[out] workers [J[Bnworkers
+ * @retval 0 
+ * @retval -1 sBJ\Pbg͕
+ */
+int shard_open(int port, int nworkers, shard_worker *workers) {
+    struct sockaddr_in6 addr;
+    int one = 1;
+    int zero = 0;
+    int i;
+
+    if (nworkers < 1 || nworkers > SHARD_MAX) {
+        return -1;
+    }
+    shard_assign_cpus(nworkers);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin6_family = AF_INET6;
+    addr.sin6_addr = in6addr_any;
+    addr.sin6_port = htons(port);
+
+    for (i = 0; i < nworkers; i++) {
+        workers[i].index = i;
+        workers[i].cpu = shard_cpus[i];
+        workers[i].fd = socket(AF_INET6, SOCK_DGRAM, 0);
+        if (workers[i].fd < 0) {
+            syslog(LOG_LOCAL0|LOG_DEBUG, "[shard_open] socket error: %m");
+            goto fail;
+        }
+        if (setsockopt(workers[i].fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0
+            || setsockopt(workers[i].fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) != 0) {
+            syslog(LOG_LOCAL0|LOG_DEBUG, "[shard_open] setsockopt error: %m");
+            close(workers[i].fd);
+            goto fail;
+        }
+        if (i > 0 && setsockopt(workers[i].fd, IPPROTO_IPV6, IPV6_MULTICAST_ALL, &zero, sizeof(zero)) != 0) {
+            syslog(LOG_LOCAL0|LOG_DEBUG, "[shard_open] IPV6_MULTICAST_ALL is not available: %m");
+            close(workers[i].fd);
+            goto fail;
+        }
+        if (bind(workers[i].fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+            syslog(LOG_LOCAL0|LOG_DEBUG, "[shard_open] bind error: %m");
+            close(workers[i].fd);
+            goto fail;
+        }
+    }
+    if (nworkers > 1 && shard_attach_steering(workers[0].fd, nworkers) != 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[shard_open] falling back to the kernel's flow hash");
+    }
+    return 0;
+
+fail:
+    while (--i >= 0) {
+        close(workers[i].fd);
+    }
+    return -1;
+}
+
+/**
+ * @brief ĂяoXbh[J[CPUɌŒ肷
+ *
+ * @param worker [J[
+ * @retval 0 
+ * @retval -1 sBŒ肹ɂ̂܂ܓ
+ */
+int shard_pin(shard_worker *worker) {
+    cpu_set_t set;
+    int err;
+
+    if (worker->cpu < 0) {
+        return -1;
+    }
+    CPU_ZERO(&set);
+    CPU_SET(worker->cpu, &set);
+    err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0) {
+        errno = err;
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[shard_pin] pthread_setaffinity_np error: %m");
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,26 @@
+/**
+ * @file sta_shard.h
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief UDP|[gSO_REUSEPORTɂ镪
+ * |[gɃ[J[̐\PbgJAMCPŨ[J[̃\PbgɐU蕪
+ */
+
+#ifndef _STA_SHARD_H
+#define _STA_SHARD_H
+
+#define SHARD_MAX 64 ///< [J[̍ő吔
+
+/**
+ * @brief M[J[
+ */
+typedef struct _shard_worker {
+    int fd; ///< ̃[J[̃\Pbg
+    int index; ///< [J[ԍBSO_REUSEPORT̃O[v̒̃\Pbg̏ԂƓ
+    int cpu; ///< Œ肷CPUBŒłȂ-1
+} shard_worker;
+
+int shard_cpu_count(void);
+int shard_open(int port, int nworkers, shard_worker *workers);
+int shard_pin(shard_worker *worker);
+
+#endif
@@ -0,0 +1,298 @@
+/**
+ * @file sta_snap.c
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief Ԃ̃XibvVbg
+ *
+ * t@C͐擪snap_file_hdrƁAsnap_slot_hdr2̖ʂȂB
+ * seqn̒g͖n%2ɏ̂ŁAŌɊSɏʂ͏ȂB
+ * MAP_SHAREDmmapĂ̂ŁAvZXĂ̓y[WLbVɎcB
+ * тmsync(MS_ASYNC)ăfBXNւ̏oB
+ *
+ * ǧ`͌Ăяo߂B̃W[͖ʂ̑ICRC󂯎B
+ */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <syslog.h>
+#include <unistd.h>
+#include "sta_snap.h"
+
+static char *snap_base = NULL;
+static size_t snap_slot_size = 0;
+static size_t snap_map_size = 0;
+static uint64_t snap_seq = 0; ///< Ōɏ(ǂ)ʂseq
+static uint32_t crc_table[256];
+static pthread_mutex_t snap_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t snap_cond = PTHREAD_COND_INITIALIZER;
+static int snap_kicked = 0;
+static size_t (*snap_collect)(void *buf, size_t size) = NULL;
+static int snap_interval_ms = SNAP_INTERVAL_MS;
+
+/**
+ * @brief CRC32̕\
+ */
+static void crc_init() {
+    uint32_t c;
+    int n, k;
+
+    for (n = 0; n < 256; n++) {
+        c = (uint32_t)n;
+        for (k = 0; k < 8; k++) {
+            c = (c & 1) ? (0xedb88320u ^ (c >> 1)) : (c >> 1);
+        }
+        crc_table[n] = c;
+    }
+}
+
+/**
+ * @brief CRC32𑱂vZ
+ *
+ * @param crc ܂łCRCBŏ0
+ * @param buf f[^
+ * @param len f[^̒
+ * @return CRC
+ */
+static uint32_t crc_update(uint32_t crc, const void *buf, size_t len) {
+    const uint8_t *p = (const uint8_t *)buf;
+    uint32_t c = crc ^ 0xffffffffu;
+
+    while (len-- > 0) {
+        c = crc_table[(c ^ *p++) & 0xff] ^ (c >> 8);
+    }
+    return c ^ 0xffffffffu;
+}
+
+/**
+ * @brief ʂ̐擪𓾂
+ *
+ * @param i ʂ̔ԍB01
+ * @return ʂ̐擪Bg͂̒
+ */
+static snap_slot_hdr *snap_slot(int i) {
+    return (snap_slot_hdr *)(snap_base + sizeof(snap_file_hdr) + (size_t)i * (sizeof(snap_slot_hdr) + snap_slot_size));
+}
+
+/**
+ * @brief ʂCRCvZ
+ *
+ * @param seq 
+ * @param len g̒
+ * @param data g
+ * @return seqAlenƒgCRC
+ */
+static uint32_t snap_crc(uint64_t seq, uint32_t len, const void *data) {
+    uint32_t crc;
+
+    crc = crc_update(0, &seq, sizeof(seq));
+    crc = crc_update(crc, &len, sizeof(len));
+    return crc_update(crc, data, len);
+}
+
+/**
+ * @brief ʂSɏĂ邩ׂ
+ *
+ * @param h ʂ̐擪
+ * @retval 1 g
+ * @retval 0 󂩏
+ */
+static int snap_slot_valid(const snap_slot_hdr *h) {
+    return h->seq != 0 && h->len <= snap_slot_size && snap_crc(h->seq, h->len, h + 1) == h->crc;
+}
+
+/**
+ * @brief XibvVbg̃t@CJ
+ *
+ * Ȃ΍B`傫Ⴄt@C͋ɂč蒼B
+ * @param path t@C̃pX
+ * @param slot_size 1ʂɓ钆g̍ő̑傫
+ * @retval 0 
+ * @retval -1 s
+ */
+int snap_open(const char *path, size_t slot_size) {
+    snap_file_hdr *fh;
+    struct stat st;
+    int fd;
+    int i;
+
+    crc_init();
+    snap_slot_size = slot_size;
+    snap_map_size = sizeof(snap_file_hdr) + 2 * (sizeof(snap_slot_hdr) + slot_size);
+
+    fd = open(path, O_RDWR | O_CREAT, 0600);
+    if (fd < 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[snap_open] open %s error: %m", path);
+        return -1;
+    }
+    if (fstat(fd, &st) != 0 || ((size_t)st.st_size != snap_map_size && ftruncate(fd, snap_map_size) != 0)) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[snap_open] ftruncate %s error: %m", path);
+        close(fd);
+        return -1;
+    }
+    snap_base = (char *)mmap(NULL, snap_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // mmapƂ͗vȂ
+    if (snap_base == MAP_FAILED) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[snap_open] mmap %s error: %m", path);
+        snap_base = NULL;
+        return -1;
+    }
+
+    fh = (snap_file_hdr *)snap_base;
+    if (fh->magic != SNAP_MAGIC || fh->version != SNAP_VERSION || fh->slot_size != slot_size) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[snap_open] %s has no usable snapshot, initialized", path);
+        memset(snap_base, 0, snap_map_size);
+        fh->magic = SNAP_MAGIC;
+        fh->version = SNAP_VERSION;
+        fh->slot_size = (uint32_t)slot_size;
+    }
+    snap_seq = 0;
+    for (i = 0; i < 2; i++) {
+        if (snap_slot_valid(snap_slot(i)) && snap_slot(i)->seq > snap_seq) {
+            snap_seq = snap_slot(i)->seq;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief ŌɊSɏʂǂ
+ *
+ * @param[out] buf ǂݏo
+ * @param size buf̑傫
+ * @return g̒BgʂȂ0
+ */
+size_t snap_load(void *buf, size_t size) {
+    snap_slot_hdr *h;
+    size_t len;
+
+    if (snap_base == NULL || snap_seq == 0) {
+        return 0;
+    }
+    h = snap_slot((int)(snap_seq & 1));
+    if (!snap_slot_valid(h)) {
+        return 0;
+    }
+    len = (h->len < size) ? h->len : size;
+    memcpy(buf, h + 1, len);
+    return len;
+}
+
+/**
+ * @brief g
+ *
+ * Ōɏʂł͂ȂɏAŌseqėLɂB
+ * @param buf g
+ * @param len g̒
+ * @retval 0 
+ * @retval -1 s
+ */
+int snap_save(const void *buf, size_t len) {
+    snap_slot_hdr *h;
+    uint64_t seq;
+
+    if (snap_base == NULL || len > snap_slot_size) {
+        return -1;
+    }
+    pthread_mutex_lock(&snap_mutex);
+    seq = snap_seq + 1;
+    h = snap_slot((int)(seq & 1));
+    h->seq = 0; // ĂԂ͋
+    __sync_synchronize();
+    memcpy(h + 1, buf, len);
+    h->len = (uint32_t)len;
+    h->crc = snap_crc(seq, (uint32_t)len, buf);
+    __sync_synchronize();
+    h->seq = seq;
+    snap_seq = seq;
+    pthread_mutex_unlock(&snap_mutex);
+    msync(snap_base, snap_map_size, MS_ASYNC);
+    return 0;
+}
+
+/**
+ * @brief XibvVbgXbh
+ *
+ * snap_kickŋN邩Asnap_interval_msтɒgW߂ďB
+ * @param arg gĂȂ
+ * @return NULLԂ
+ */
+static void *snap_thread(void *arg) {
+    struct timeval tv;
+    struct timespec ts;
+    char *buf;
+    size_t len;
+
+    (void)arg;
+    pthread_detach(pthread_self());
+
+    buf = (char *)malloc(snap_slot_size);
+    if (buf == NULL) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[snap_thread] malloc error");
+        return NULL;
+    }
+    for (;;) {
+        pthread_mutex_lock(&snap_mutex);
+        if (!snap_kicked) {
+            gettimeofday(&tv, NULL);
+            ts.tv_sec = tv.tv_sec + snap_interval_ms / 1000;
+            ts.tv_nsec = tv.tv_usec * 1000 + (long)(snap_interval_ms % 1000) * 1000000;
+            if (ts.tv_nsec >= 1000000000) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&snap_cond, &snap_mutex, &ts);
+        }
+        snap_kicked = 0;
+        pthread_mutex_unlock(&snap_mutex);
+
+        len = snap_collect(buf, snap_slot_size);
+        if (len > 0) {
+            snap_save(buf, len);
+        }
+    }
+    free(buf);
+    return NULL;
+}
+
+/**
+ * @brief XibvVbgXbhn߂
+ *
+ * snap_openĂĂԂƁB
+ * @param collect gW߂֐BbufɏԂB0Ȃ珑Ȃ
+ * @param interval_ms m点ȂĂԊu[~b]
+ * @retval 0 
+ * @retval -1 s
+ */
+int snap_start(size_t (*collect)(void *buf, size_t size), int interval_ms) {
+    pthread_t tid;
+
+    if (snap_base == NULL) {
+        return -1;
+    }
+    snap_collect = collect;
+    snap_interval_ms = (interval_ms > 0) ? interval_ms : SNAP_INTERVAL_MS;
+    if (pthread_create(&tid, NULL, snap_thread, NULL) != 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[snap_start] pthread_create error: %m");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Ԃς̂ł悤m点
+ *
+ * ̂̓XibvVbg̃XbhȂ̂ŁAĂяo͑҂ȂB
+ */
+void snap_kick() {
+    if (snap_base == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&snap_mutex);
+    snap_kicked = 1;
+    pthread_cond_signal(&snap_cond);
+    pthread_mutex_unlock(&snap_mutex);
+}
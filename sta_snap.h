@@ -0,0 +1,46 @@
+/**
+ * @file sta_snap.h
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief Ԃ̃XibvVbg
+ * mmapt@CA/B2ʂŏԂAċNƂɍŌ̊SȖʂǂݖ߂
+ */
+
+#ifndef _STA_SNAP_H
+#define _STA_SNAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SNAP_MAGIC 0x53544153 ///< "STAS"
+#define SNAP_VERSION 1
+#define SNAP_INTERVAL_MS 1000 ///< ω̒m点ȂĂԊu[~b]Bߗ׃m[hƃJE^̂
+
+/**
+ * @brief t@C̐擪
+ */
+typedef struct _snap_file_hdr {
+    uint32_t magic; ///< SNAP_MAGIC
+    uint32_t version; ///< SNAP_VERSION
+    uint32_t slot_size; ///< 1ʂɓ钆g̑傫BႦ΍蒼
+    uint32_t reserved;
+} snap_file_hdr;
+
+/**
+ * @brief 1ʂ̐擪
+ *
+ * gcrcĂŌseqBĂrŗĂcrcȂ̂ŁA
+ * ǂނƂcrc̍ʂ̂seq̑傫gB
+ */
+typedef struct _snap_slot_hdr {
+    uint64_t seq; ///< ԁB0Ȃ
+    uint32_t len; ///< g̒
+    uint32_t crc; ///< seqAlenƒgCRC32
+} snap_slot_hdr;
+
+int snap_open(const char *path, size_t slot_size);
+size_t snap_load(void *buf, size_t size);
+int snap_save(const void *buf, size_t len);
+int snap_start(size_t (*collect)(void *buf, size_t size), int interval_ms);
+void snap_kick(void);
+
+#endif
@@ -0,0 +1,184 @@
+/**
+ * @file sta_stage.c
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief ʒȕ̒iƂ̊Ԃ̃L[
+ *
+ * ʒu1̃Xbhœǂł犄蓖Ă܂őďƁAJ[lւ̃AhX̐ݒ肪
+ * xƂɎ̈ʒuǂނ̂xBŏiɕAiƂɃXbh𗧂Ă
+ * Ɠǂݎ肪1̃Oobt@łȂB
+ *
+ * Oobt@͋NɊmۂA󂯓nmemcpyƔԍ̍XVȂ̂ŁAԂŃq[vgȂB
+ * ͑҂ȂBtȂ̂ĂĐ邩ǂ͌Ăяo߂B
+ * ǂݎ͋ȂԕϐŖBtaili߂ĂAǂݎ肪waiting𗧂ĂĂ΋NB
+ * ǂݎwaiting𗧂ĂĂ󂩂ǂ̂ŁAN˂邱Ƃ͂ȂB
+ */
+
+#define _GNU_SOURCE // CPU_SETApthread_setaffinity_np
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include "sta_stage.h"
+
+/**
+ * @brief L[
+ *
+ * @param q L[
+ * @param capacity vfB2ׂ̂ɐ؂グ
+ * @param size vf̑傫
+ * @retval 0 
+ * @retval -1 s
+ */
+int stage_queue_init(stage_queue *q, unsigned int capacity, size_t size) {
+    unsigned int n = 1;
+
+    while (n < capacity) {
+        n <<= 1;
+    }
+    memset(q, 0, sizeof(*q));
+    q->mask = n - 1;
+    q->size = size;
+    q->buf = (char *)malloc((size_t)n * size);
+    if (q->buf == NULL) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[stage_queue_init] malloc error");
+        return -1;
+    }
+    pthread_mutex_init(&(q->mutex), NULL);
+    pthread_cond_init(&(q->cond), NULL);
+    return 0;
+}
+
+/**
+ * @brief vf
+ *
+ * ̃XbhĂԂƁB
+ * @param q L[
+ * @param item vf
+ * @retval 0 ꂽ
+ * @retval -1 tȂ̂œȂ
+ */
+int stage_push(stage_queue *q, const void *item) {
+    unsigned int tail = q->tail;
+
+    if (tail - q->head > q->mask) {
+        q->dropped++;
+        return -1;
+    }
+    memcpy(q->buf + (size_t)(tail & q->mask) * q->size, item, q->size);
+    __sync_synchronize(); // gĂtaili߂
+    q->tail = tail + 1;
+    __sync_synchronize(); // taili߂Ăwaiting
+    if (q->waiting) {
+        pthread_mutex_lock(&(q->mutex));
+        pthread_cond_signal(&(q->cond));
+        pthread_mutex_unlock(&(q->mutex));
+    }
+    return 0;
+}
+
+/**
+ * @brief vfo
+ *
+ * ǂݎ̃XbhĂԂƁBȂ܂ŖB
+ * @param q L[
+ * @param[out] item ovf
+ */
+void stage_pop(stage_queue *q, void *item) {
+    unsigned int head = q->head;
+
+    if (q->tail == head) {
+        pthread_mutex_lock(&(q->mutex));
+        q->waiting = 1;
+        __sync_synchronize(); // waiting𗧂ĂĂ󂩌
+        while (q->tail == head) {
+            pthread_cond_wait(&(q->cond), &(q->mutex));
+        }
+        q->waiting = 0;
+        pthread_mutex_unlock(&(q->mutex));
+    }
+    __sync_synchronize(); // tailĂ璆gǂ
+    memcpy(item, q->buf + (size_t)(head & q->mask) * q->size, q->size);
+    __sync_synchronize(); // gǂłheadi߂
+    q->head = head + 1;
+}
+
+/**
+ * @brief L[ɗ܂Ăvf̐
+ *
+ * ǂ̃XbhĂł悢AǂłԂɂςB
+ * @param q L[
+ * @return vf̐
+ */
+unsigned int stage_depth(const stage_queue *q) {
+    unsigned int head = q->head;
+
+    return q->tail - head;
+}
+
+/**
+ * @brief ĂяoXbhCPUɌŒ肷
+ *
+ * @param cpu CPUԍBȂŒ肵Ȃ
+ * @retval 0 AŒ肵Ȃ
+ * @retval -1 sBŒ肹ɂ̂܂ܓ
+ */
+int stage_pin(int cpu) {
+    cpu_set_t set;
+    int err;
+
+    if (cpu < 0) {
+        return 0;
+    }
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0) {
+        errno = err;
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[stage_pin] pthread_setaffinity_np cpu %d error: %m", cpu);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief -Äǂ
+ *
+ * "ingest,decision,dad,program"̏CPUԍJ}ŋ؂ĕׂB
+ * Ȃi"-"̒i͌Œ肵ȂB
+ * @param spec 
+ * @param[out] cpus iƂCPUBSTAGE_MAX
+ * @retval 0 
+ * @retval -1 Ⴄ
+ */
+int stage_parse_cpus(const char *spec, int *cpus) {
+    char *end;
+    long cpu;
+    int i;
+
+    for (i = 0; i < STAGE_MAX; i++) {
+        cpus[i] = -1;
+    }
+    for (i = 0; i < STAGE_MAX; i++) {
+        if (*spec == '-' && (spec[1] == ',' || spec[1] == '\0')) {
+            end = (char *)spec + 1;
+        } else if (*spec != ',' && *spec != '\0') {
+            cpu = strtol(spec, &end, 10);
+            if (end == spec || cpu < 0 || cpu >= CPU_SETSIZE) {
+                return -1;
+            }
+            cpus[i] = (int)cpu;
+        } else {
+            end = (char *)spec;
+        }
+        if (*end == '\0') {
+            return 0;
+        } else if (*end != ',') {
+            return -1;
+        }
+        spec = end + 1;
+    }
+    return -1; // i
+}
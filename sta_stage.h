@@ -0,0 +1,54 @@
+/**
+ * @file sta_stage.h
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief ʒȕ̒iƂ̊Ԃ̃L[
+ * FIFO̓ǂݍ݁AfADADAAhX̐ݒꂼ̃XbhœA
+ * i̊Ԃ͏Ɠǂݎ肪1̃bNȂ̃Oobt@łȂ
+ */
+
+#ifndef _STA_STAGE_H
+#define _STA_STAGE_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define STAGE_CACHE_LINE 64
+
+/**
+ * @brief i̔ԍB-AŎw肷CPȔ
+ */
+typedef enum _stage_id {
+    STAGE_INGEST = 0, ///< FIFOǂ
+    STAGE_DECISION = 1, ///< ėL͈͂of
+    STAGE_DAD = 2, ///< AREQ𑗂
+    STAGE_PROGRAM = 3, ///< m肵STAC^[tF[Xɐݒ肷
+    STAGE_MAX = 4
+} stage_id;
+
+/**
+ * @brief Ɠǂݎ肪1̃L[
+ *
+ * tailAǂݎheadi߂̂ŁAvf̎󂯓nɃbN͗vȂB
+ * ̂Ƃɓǂݎ肪邽߂mutexƏԕϐA͓ǂݎ肪ĂƂNB
+ */
+typedef struct _stage_queue {
+    volatile unsigned int head __attribute__((aligned(STAGE_CACHE_LINE))); ///< ɓǂވʒuBǂݎ肾i߂
+    volatile int waiting; ///< ǂݎ肪Ă1
+    volatile unsigned int tail __attribute__((aligned(STAGE_CACHE_LINE))); ///< ɏʒuB肾i߂
+    uint64_t dropped; ///< tŎ̂Ăvf̐B肾
+    unsigned int mask __attribute__((aligned(STAGE_CACHE_LINE))); ///< vf-1Bvf2ׂ̂
+    size_t size; ///< vf̑傫
+    char *buf;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} stage_queue;
+
+int stage_queue_init(stage_queue *q, unsigned int capacity, size_t size);
+int stage_push(stage_queue *q, const void *item);
+void stage_pop(stage_queue *q, void *item);
+unsigned int stage_depth(const stage_queue *q);
+int stage_pin(int cpu);
+int stage_parse_cpus(const char *spec, int *cpus);
+
+#endif
@@ -0,0 +1,514 @@
+/**
+ * @file sta_tenant.c
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief }`eigǗ
+ * 1stamdŕ̘_m[h(eig)STAǗ
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include "sta_tenant.h"
+
+/**
+ * @brief [J[Ƃ̃L[
+ *
+ * vf̑傫tenant_pool_startŌ܂̂ŃoCg̃Oobt@ŎB
+ */
+typedef struct _tenant_queue {
+    char *items; ///< TENANT_QUEUE_LEN̗̈
+    int head; ///< Ɏoʒu
+    int len; ///< Ăvf
+    pthread_mutex_t mutex;
+} tenant_queue;
+
+tenant_table tenants; ///< eigƂ̏
+
+static tenant_queue queues[TENANT_MAX_WORKERS];
+static int nqueues = 0;
+static size_t queue_item_size = 0;
+static void (*queue_handler)(void *item) = NULL;
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_cond = PTHREAD_COND_INITIALIZER;
+static int pool_pending = 0; ///< SL[ɓĂvf
+static int idle_dad_state = 0; ///< Veigdad_statȅl
+
+static void *tenant_worker(void *arg);
+
+/**
+ * @brief 2ׂ̂ɐ؂グ
+ *
+ * @param n ؂グl
+ * @return nȏ̍ŏ2ׂ̂
+ */
+static unsigned int round_up_pow2(unsigned int n) {
+    unsigned int p = 1;
+
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+
+/**
+ * @brief FNV-1anbV
+ *
+ * @param data nbVf[^
+ * @param len f[^̒
+ * @return nbVl
+ */
+static uint32_t fnv1a(const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    uint32_t h = 2166136261U;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 16777619U;
+    }
+    return h;
+}
+
+/**
+ * @brief eig\
+ *
+ * őeig̔z܂Ƃ߂ĊmۂBȌeig\malloc͂ȂB
+ * @param capacity őeig
+ * @param idle_state Veigdad_statȅl(address_status̒l)
+ * @retval 0 
+ * @retval -1 s
+ */
+int tenant_table_init(int capacity, int idle_state) {
+    int i;
+    unsigned int slots;
+
+    memset(&tenants, 0, sizeof(tenants));
+    if (capacity <= 0) {
+        return -1;
+    }
+    tenants.capacity = capacity;
+    idle_dad_state = idle_state;
+
+    tenants.nodeid = calloc(capacity, sizeof(*tenants.nodeid));
+    tenants.nodeid_hash = calloc(capacity, sizeof(uint32_t));
+    tenants.sta = calloc(capacity, sizeof(struct in6_addr));
+    tenants.has_sta = calloc(capacity, sizeof(int));
+    tenants.anchor_lat = calloc(capacity, sizeof(double));
+    tenants.anchor_lon = calloc(capacity, sizeof(double));
+    tenants.anchor_alt = calloc(capacity, sizeof(double));
+    tenants.hyst = calloc(capacity, sizeof(hyst_state));
+    tenants.fix = calloc(capacity, sizeof(fix_filter));
+    tenants.dispatched = calloc(capacity, sizeof(uint64_t));
+    tenants.handled = calloc(capacity, sizeof(uint64_t));
+    tenants.pending = calloc(capacity, sizeof(struct in6_addr));
+    tenants.dad_state = calloc(capacity, sizeof(int));
+    tenants.dad_deadline = calloc(capacity, sizeof(time_t));
+    tenants.lock = calloc(capacity, sizeof(pthread_mutex_t));
+
+    slots = round_up_pow2((unsigned int)capacity * 2);
+    tenants.id_mask = slots - 1;
+    tenants.id_slots = malloc(slots * sizeof(int));
+    tenants.addr_mask = slots - 1;
+    tenants.addr_head = malloc(slots * sizeof(int));
+    tenants.addr_next = malloc(capacity * 2 * sizeof(int));
+
+    if (tenants.nodeid == NULL || tenants.nodeid_hash == NULL || tenants.sta == NULL
+        || tenants.has_sta == NULL || tenants.anchor_lat == NULL || tenants.anchor_lon == NULL
+        || tenants.anchor_alt == NULL || tenants.hyst == NULL || tenants.fix == NULL
+        || tenants.dispatched == NULL || tenants.handled == NULL || tenants.pending == NULL || tenants.dad_state == NULL
+        || tenants.dad_deadline == NULL || tenants.lock == NULL
+        || tenants.id_slots == NULL || tenants.addr_head == NULL || tenants.addr_next == NULL) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[tenant_table_init] malloc error");
+        return -1;
+    }
+
+    for (i = 0; i < (int)slots; i++) {
+        tenants.id_slots[i] = -1;
+        tenants.addr_head[i] = -1;
+    }
+    for (i = 0; i < capacity * 2; i++) {
+        tenants.addr_next[i] = -1;
+    }
+    for (i = 0; i < capacity; i++) {
+        pthread_mutex_init(&(tenants.lock[i]), NULL);
+    }
+    pthread_rwlock_init(&(tenants.addr_lock), NULL);
+
+    return 0;
+}
+
+/**
+ * @brief m[hID̃nbVl
+ *
+ * [J[ւ̐U蕪nodeid\̗ŎgB
+ * @param nodeid PositionOut.nodeid
+ * @return nbVl
+ */
+uint32_t tenant_nodeid_hash(const int *nodeid) {
+    return fnv1a(nodeid, sizeof(int) * TENANT_NODEID_LEN);
+}
+
+/**
+ * @brief m[hIDeigԍ
+ *
+ * ȂΐVeigƂēo^B
+ * ł̓bNȂ̂ŁÃXbhĂԂƂ͌ĂяoŔr邱ƁB
+ * @param nodeid PositionOut.nodeid
+ * @return eigԍB\tȂ-1
+ */
+int tenant_lookup_or_add(const int *nodeid) {
+    uint32_t h = tenant_nodeid_hash(nodeid);
+    unsigned int slot = h & tenants.id_mask;
+    int idx;
+
+    while ((idx = tenants.id_slots[slot]) != -1) {
+        if (tenants.nodeid_hash[idx] == h
+            && memcmp(tenants.nodeid[idx], nodeid, sizeof(tenants.nodeid[idx])) == 0) {
+            return idx;
+        }
+        slot = (slot + 1) & tenants.id_mask;
+    }
+
+    if (tenants.count >= tenants.capacity) {
+        return -1;
+    }
+    idx = tenants.count;
+    memcpy(tenants.nodeid[idx], nodeid, sizeof(tenants.nodeid[idx]));
+    tenants.nodeid_hash[idx] = h;
+    tenants.has_sta[idx] = 0;
+    tenants.dad_state[idx] = idle_dad_state;
+    tenants.id_slots[slot] = idx;
+    // [J[countđ̂ŁAgĂ瑝₷
+    __sync_synchronize();
+    tenants.count = idx + 1;
+
+    return idx;
+}
+
+/**
+ * @brief AhX\̃L[ɂȂAhXԂ
+ *
+ * @param node AhX\̃m[hԍ(eigԍ*2+)
+ * @return m[hɑΉAhX
+ */
+static struct in6_addr *addr_of_node(int node) {
+    if ((node & 1) == TENANT_ADDR_CURRENT) {
+        return &(tenants.sta[node >> 1]);
+    } else {
+        return &(tenants.pending[node >> 1]);
+    }
+}
+
+/**
+ * @brief AhX\m[hO
+ *
+ * addr_lock݂ŎԂŌĂԂƁB
+ * @param node Om[h
+ */
+static void addr_unlink(int node) {
+    unsigned int bucket = fnv1a(addr_of_node(node), sizeof(struct in6_addr)) & tenants.addr_mask;
+    int *pp = &(tenants.addr_head[bucket]);
+
+    while (*pp != -1) {
+        if (*pp == node) {
+            *pp = tenants.addr_next[node];
+            tenants.addr_next[node] = -1;
+            return;
+        }
+        pp = &(tenants.addr_next[*pp]);
+    }
+}
+
+/**
+ * @brief eig̃AhXݒ肵ăAhX\ɓo^
+ *
+ * tenants.staAtenants.pending͂̊֐tenant_addr_removełȂƁB
+ * @param idx eigԍ
+ * @param kind TENANT_ADDR_CURRENTTENANT_ADDR_PENDING
+ * @param addr o^AhX
+ * @retval 0 
+ * @retval -1 s
+ */
+int tenant_addr_insert(int idx, int kind, const struct in6_addr *addr) {
+    int node = idx * 2 + kind;
+    unsigned int bucket;
+
+    if (idx < 0 || idx >= tenants.capacity) {
+        return -1;
+    }
+
+    pthread_rwlock_wrlock(&(tenants.addr_lock));
+    addr_unlink(node);
+    *addr_of_node(node) = *addr;
+    bucket = fnv1a(addr, sizeof(struct in6_addr)) & tenants.addr_mask;
+    tenants.addr_next[node] = tenants.addr_head[bucket];
+    tenants.addr_head[bucket] = node;
+    if (kind == TENANT_ADDR_CURRENT) {
+        tenants.has_sta[idx] = 1;
+    }
+    pthread_rwlock_unlock(&(tenants.addr_lock));
+
+    return 0;
+}
+
+/**
+ * @brief eig̃AhXAhX\O
+ *
+ * @param idx eigԍ
+ * @param kind TENANT_ADDR_CURRENTTENANT_ADDR_PENDING
+ */
+void tenant_addr_remove(int idx, int kind) {
+    int node = idx * 2 + kind;
+
+    if (idx < 0 || idx >= tenants.capacity) {
+        return;
+    }
+
+    pthread_rwlock_wrlock(&(tenants.addr_lock));
+    addr_unlink(node);
+    memset(addr_of_node(node), 0, sizeof(struct in6_addr));
+    if (kind == TENANT_ADDR_CURRENT) {
+        tenants.has_sta[idx] = 0;
+    }
+    pthread_rwlock_unlock(&(tenants.addr_lock));
+}
+
+/**
+ * @brief AhXgĂeig
+ *
+ * Seiǧ݂STADAĎ1̃nbV\ŒׂB
+ * @param addr ׂAhX
+ * @param kind TENANT_ADDR_CURRENTATENANT_ADDR_PENDINGA܂-1łǂł
+ * @return eigԍBȂ-1
+ */
+int tenant_addr_lookup(const struct in6_addr *addr, int kind) {
+    unsigned int bucket;
+    int node;
+    int found = -1;
+
+    if (tenants.capacity == 0) {
+        return -1;
+    }
+    bucket = fnv1a(addr, sizeof(struct in6_addr)) & tenants.addr_mask;
+
+    pthread_rwlock_rdlock(&(tenants.addr_lock));
+    for (node = tenants.addr_head[bucket]; node != -1; node = tenants.addr_next[node]) {
+        if (kind != -1 && (node & 1) != kind) {
+            continue;
+        }
+        if (memcmp(addr_of_node(node), addr, sizeof(struct in6_addr)) == 0) {
+            found = node >> 1;
+            break;
+        }
+    }
+    pthread_rwlock_unlock(&(tenants.addr_lock));
+
+    return found;
+}
+
+/**
+ * @brief ̃AhX܂Ƃ߂Ĉ
+ *
+ * ǂݍ݃bN1񂾂đS̃AhX𒲂ׂB
+ * @param addrs ׂAhX
+ * @param count AhX̐B32ȉ
+ * @param kind TENANT_ADDR_CURRENTATENANT_ADDR_PENDINGA܂-1łǂł
+ * @return gĂAhX̃rbg(iԖڂȂbit i)
+ */
+uint32_t tenant_addr_lookup_many(const struct in6_addr *addrs, int count, int kind) {
+    unsigned int bucket;
+    int node;
+    int i;
+    uint32_t used = 0;
+
+    if (tenants.capacity == 0) {
+        return 0;
+    }
+
+    pthread_rwlock_rdlock(&(tenants.addr_lock));
+    for (i = 0; i < count && i < 32; i++) {
+        bucket = fnv1a(&addrs[i], sizeof(struct in6_addr)) & tenants.addr_mask;
+        for (node = tenants.addr_head[bucket]; node != -1; node = tenants.addr_next[node]) {
+            if (kind != -1 && (node & 1) != kind) {
+                continue;
+            }
+            if (memcmp(addr_of_node(node), &addrs[i], sizeof(struct in6_addr)) == 0) {
+                used |= (uint32_t)1 << i;
+                break;
+            }
+        }
+    }
+    pthread_rwlock_unlock(&(tenants.addr_lock));
+
+    return used;
+}
+
+/**
+ * @brief L[1o
+ *
+ * @param q oL[̔ԍ
+ * @param[out] item ovf̃Rs[
+ * @retval 0 o
+ * @retval -1 󂾂
+ */
+static int queue_pop(int q, void *item) {
+    tenant_queue *tq = &queues[q];
+    int ret = -1;
+
+    pthread_mutex_lock(&(tq->mutex));
+    if (tq->len > 0) {
+        memcpy(item, tq->items + (size_t)tq->head * queue_item_size, queue_item_size);
+        tq->head = (tq->head + 1) % TENANT_QUEUE_LEN;
+        tq->len--;
+        ret = 0;
+    }
+    pthread_mutex_unlock(&(tq->mutex));
+
+    if (ret == 0) {
+        __sync_fetch_and_sub(&pool_pending, 1);
+    }
+    return ret;
+}
+
+/**
+ * @brief ̃[J[̃L[瓐
+ *
+ * ̃L[̂ƂAԂ܂ĂL[1ĂB
+ * 񂾈ʒũ͎[J[̈ʒuƓɏ邱Ƃ̂ŁA
+ * 鑤ŃeiglockAǂzꂽÂʒûĂ邱ƁB
+ * @param self ̃[J[ԍ
+ * @param[out] item ovf̃Rs[
+ * @retval 0 o
+ * @retval -1 ǂ󂾂
+ */
+static int queue_steal(int self, void *item) {
+    int i;
+    int victim = -1;
+    int longest = 0;
+
+    for (i = 0; i < nqueues; i++) {
+        if (i != self && queues[i].len > longest) { // bNȂŔ`
+            longest = queues[i].len;
+            victim = i;
+        }
+    }
+    if (victim == -1) {
+        return -1;
+    }
+    return queue_pop(victim, item);
+}
+
+/**
+ * @brief [J[Xbh
+ *
+ * ̃L[AɂȂ瑼̃L[瓐ށB
+ * ǂɂdȂpool_condő҂B
+ * @param arg [J[ԍ
+ * @return NULLԂ
+ */
+static void *tenant_worker(void *arg) {
+    int self = (int)(long)arg;
+    char *item;
+
+    pthread_detach(pthread_self());
+    item = (char *)malloc(queue_item_size);
+    if (item == NULL) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[tenant_worker] malloc error");
+        return NULL;
+    }
+
+    for (;;) {
+        if (queue_pop(self, item) == 0 || queue_steal(self, item) == 0) {
+            (*queue_handler)(item);
+            continue;
+        }
+        pthread_mutex_lock(&pool_mutex);
+        while (pool_pending == 0) {
+            pthread_cond_wait(&pool_cond, &pool_mutex);
+        }
+        pthread_mutex_unlock(&pool_mutex);
+    }
+
+    free(item);
+    return NULL;
+}
+
+/**
+ * @brief [J[XbhQN
+ *
+ * @param nworkers [J[Xbh̐
+ * @param item_size L[ɓvf̑傫
+ * @param handler vf֐
+ * @retval 0 
+ * @retval -1 s
+ */
+int tenant_pool_start(int nworkers, size_t item_size, void (*handler)(void *item)) {
+    int i;
+    pthread_t tid;
+
+    if (nworkers <= 0 || nworkers > TENANT_MAX_WORKERS) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[tenant_pool_start] invalid number of workers: %d", nworkers);
+        return -1;
+    }
+
+    queue_item_size = item_size;
+    queue_handler = handler;
+    for (i = 0; i < nworkers; i++) {
+        queues[i].items = (char *)malloc(item_size * TENANT_QUEUE_LEN);
+        if (queues[i].items == NULL) {
+            syslog(LOG_LOCAL0|LOG_DEBUG, "[tenant_pool_start] malloc error");
+            return -1;
+        }
+        queues[i].head = 0;
+        queues[i].len = 0;
+        pthread_mutex_init(&(queues[i].mutex), NULL);
+    }
+    nqueues = nworkers;
+
+    for (i = 0; i < nworkers; i++) {
+        if (pthread_create(&tid, NULL, tenant_worker, (void *)(long)i) != 0) {
+            syslog(LOG_LOCAL0|LOG_DEBUG, "[tenant_pool_start] pthread_create error: %m");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief vf[J[ɐU蕪
+ *
+ * hashŒS[J[߂ẴL[ɓB
+ * L[tȂ炻̗vf͎̂ĂBʒu͎X̂ŌÂ̂͗vȂB
+ * @param hash U蕪ɎgnbVl
+ * @param item vfBRs[
+ * @retval 0 
+ * @retval -1 L[tŎ̂Ă
+ */
+int tenant_pool_dispatch(uint32_t hash, const void *item) {
+    tenant_queue *tq;
+    int tail;
+
+    if (nqueues == 0) {
+        return -1;
+    }
+    tq = &queues[hash % nqueues];
+
+    pthread_mutex_lock(&(tq->mutex));
+    if (tq->len >= TENANT_QUEUE_LEN) {
+        pthread_mutex_unlock(&(tq->mutex));
+        return -1;
+    }
+    tail = (tq->head + tq->len) % TENANT_QUEUE_LEN;
+    memcpy(tq->items + (size_t)tail * queue_item_size, item, queue_item_size);
+    tq->len++;
+    pthread_mutex_unlock(&(tq->mutex));
+
+    pthread_mutex_lock(&pool_mutex);
+    __sync_fetch_and_add(&pool_pending, 1);
+    pthread_cond_signal(&pool_cond);
+    pthread_mutex_unlock(&pool_mutex);
+
+    return 0;
+}
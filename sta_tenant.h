@@ -0,0 +1,77 @@
+/**
+ * @file sta_tenant.h
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief }`eigǗ
+ * 1stamdŕ̘_m[h(eig)STAǗ
+ */
+
+#ifndef _STA_TENANT_H
+#define _STA_TENANT_H
+
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include "sta_fix.h"
+#include "sta_hyst.h"
+
+#define TENANT_NODEID_LEN 16 ///< PositionOut.nodeid̗vf
+#define TENANT_QUEUE_LEN 256 ///< [J[1̃L[̒
+#define TENANT_MAX_WORKERS 64 ///< [J[Xbh̍ő吔
+
+#define TENANT_ADDR_CURRENT 0 ///< 蓖čς݂STA
+#define TENANT_ADDR_PENDING 1 ///< DAĎAhX
+
+/**
+ * @brief eigƂ̏
+ *
+ * eigƂ̏Ԃstructure of arraysŕێB
+ * iԖڂ̃eig̏Ԃ͊eziԖڂ̗vfB
+ * nodeideigԍ̓I[vAhX@̃nbV\A
+ * AhXeigԍ͘A@̃nbV\ňB
+ * AhX\̃m[h̓eigԍ*2+ʂŁA炩ߊmۂĂB
+ */
+typedef struct _tenant_table {
+    int capacity; ///< őeig
+    int count; ///< o^ς݃eig
+
+    int (*nodeid)[TENANT_NODEID_LEN]; ///< m[hID
+    uint32_t *nodeid_hash; ///< m[hID̃nbVl
+    struct in6_addr *sta; ///< ݂STA
+    int *has_sta; ///< STA蓖čς݂Ȃ1
+    double *anchor_lat; ///< L͈͂̊_(݂STAtZ)̈ܓx
+    double *anchor_lon; ///< L͈͂̊_̌ox
+    double *anchor_alt; ///< L͈͂̊_̍x
+    hyst_state *hyst; ///< L͈͂õqXeVX̏
+    fix_filter *fix; ///< ʒu𕽊J}tB^̏
+    uint64_t *dispatched; ///< [J[ɓnʒu̐BU蕪Xbh
+    uint64_t *handled; ///< Ōɏʒu̔ԍBlockēǂݏ
+    struct in6_addr *pending; ///< DAĎAhX
+    int *dad_state; ///< address_status̒l
+    time_t *dad_deadline; ///< DADł؂鎞
+    pthread_mutex_t *lock; ///< eigƂmutex
+
+    int *id_slots; ///< nodeideigԍB󂫂-1
+    unsigned int id_mask;
+
+    int *addr_head; ///< AhX\̃oPbg
+    int *addr_next; ///< AhX\̘A
+    unsigned int addr_mask;
+    pthread_rwlock_t addr_lock; ///< AhX\rwlock
+} tenant_table;
+
+extern tenant_table tenants;
+
+int tenant_table_init(int capacity, int idle_state);
+uint32_t tenant_nodeid_hash(const int *nodeid);
+int tenant_lookup_or_add(const int *nodeid);
+int tenant_addr_insert(int idx, int kind, const struct in6_addr *addr);
+void tenant_addr_remove(int idx, int kind);
+int tenant_addr_lookup(const struct in6_addr *addr, int kind);
+uint32_t tenant_addr_lookup_many(const struct in6_addr *addrs, int count, int kind);
+
+int tenant_pool_start(int nworkers, size_t item_size, void (*handler)(void *item));
+int tenant_pool_dispatch(uint32_t hash, const void *item);
+
+#endif
@@ -11,27 +11,62 @@
 #include <sys/time.h>
 #include "sta_timer.h"
 
+static pthread_once_t timer_once = PTHREAD_ONCE_INIT;
+
+static void timer_init(void);
 static void *thread_timer_on(void *arg);
 
+/**
+ * @brief ^C}[mutexƏԕϐ
+ *
+ * timer_ontimer_offŏɌĂ΂ꂽƂ1񂾂B
+ */
+static void timer_init(void) {
+    int i;
+
+    for (i = 0; i < MAX_NUM_TIMER; i++) {
+        sta_timers[i].timer_id = i;
+        sta_timers[i].status = 0;
+        sta_timers[i].started = 0;
+        pthread_mutex_init(&sta_timers[i].timer_mutex, NULL);
+        pthread_cond_init(&sta_timers[i].timer_cond, NULL);
+    }
+}
+
 /**
  * @brief ^C}[N
  *
  * w肵^C}[NBԁA^C}[؂ꂽƂɋN֐wB
+ * Ă^C}[NƁA؂鎞Ɗ֐ւB
+ * Xbh̓^C}[Ƃɍŏ1񂾂AƂ͎g񂷂̂ŁADAD̂тɃX^bNmۂȂB
  * @param timer_id N^C}[ID
  * @param func ؂ꂽƂɋN֐
  * @param duration 
  */
 void timer_on(int timer_id, void (*func)(void), int duration) {
+    time_event_t *t_event = &sta_timers[timer_id];
+    struct timeval tv;
     pthread_t tid;
 
-    sta_timers[timer_id].timer_id = timer_id;
-    sta_timers[timer_id].duration = duration;
-    sta_timers[timer_id].func = func;
-    sta_timers[timer_id].status = 0;
-    pthread_mutex_init(&sta_timers[timer_id].timer_mutex, NULL);
-    pthread_cond_init(&sta_timers[timer_id].timer_cond, NULL);
+    pthread_once(&timer_once, timer_init);
+    gettimeofday(&tv, NULL);
 
-    pthread_create(&tid, NULL, &thread_timer_on, &sta_timers[timer_id]);
+    pthread_mutex_lock(&(t_event->timer_mutex));
+    t_event->duration = duration;
+    t_event->func = func;
+    t_event->deadline.tv_sec = tv.tv_sec + duration;
+    t_event->deadline.tv_nsec = tv.tv_usec * 1000;
+    t_event->status = 1;
+    if (!t_event->started) {
+        if (pthread_create(&tid, NULL, &thread_timer_on, t_event) == 0) {
+            t_event->started = 1;
+        } else {
+            syslog(LOG_LOCAL0|LOG_DEBUG, "[timer_on] pthread_create error: %m");
+            t_event->status = 0;
+        }
+    }
+    pthread_cond_signal(&(t_event->timer_cond));
+    pthread_mutex_unlock(&(t_event->timer_mutex));
 }
 
 /**
@@ -41,6 +76,7 @@ void timer_on(int timer_id, void (*func)(void), int duration) {
  * @param timer_id ~^C}[ID
  */
 void timer_off(int timer_id) {
+    pthread_once(&timer_once, timer_init);
     pthread_mutex_lock(&sta_timers[timer_id].timer_mutex);
     sta_timers[timer_id].status = 0;
     pthread_cond_signal(&sta_timers[timer_id].timer_cond);
@@ -50,33 +86,42 @@ void timer_off(int timer_id) {
 /**
  * @brief ^C}[
  *
- * pthread_cond_timedwaitgts҂^C}[B؂t_event->funcNB
+ * N܂ő҂Apthread_cond_timedwaitdeadline܂ő҂^C}[B؂t_event->funcNB
+ * funcmutexĂĂԂ̂ŁAfunc̒Ń^C}[NĂ悢B
  * @param arg time_event_t^̍\
  * @return NULLԂ
  */
 static void *thread_timer_on(void *arg) {
-    struct timespec ts;
     struct timeval tv;
     time_event_t *t_event;
+    void (*func)(void);
     
     t_event = (time_event_t *)arg;
 
     pthread_detach(pthread_self());
 
-    gettimeofday(&tv, NULL);
-    ts.tv_sec  = tv.tv_sec  + t_event->duration;
-    ts.tv_nsec = tv.tv_usec * 1000;
-
     pthread_mutex_lock(&(t_event->timer_mutex));
-
-    t_event->status = 1;
-    pthread_cond_timedwait(&(t_event->timer_cond), &(t_event->timer_mutex), &ts);
-    if (t_event->status == 1) {
-        (*(t_event->func))();
+    for (;;) {
+        while (t_event->status == 0) {
+            pthread_cond_wait(&(t_event->timer_cond), &(t_event->timer_mutex));
+        }
+        pthread_cond_timedwait(&(t_event->timer_cond), &(t_event->timer_mutex), &(t_event->deadline));
+        if (t_event->status == 0) {
+            continue; // ~߂ꂽ
+        }
+        // NĐ؂鎞тĂΑ҂
+        gettimeofday(&tv, NULL);
+        if (tv.tv_sec < t_event->deadline.tv_sec
+            || (tv.tv_sec == t_event->deadline.tv_sec && tv.tv_usec * 1000 < t_event->deadline.tv_nsec)) {
+            continue;
+        }
+        t_event->status = 0;
+        func = t_event->func;
+        pthread_mutex_unlock(&(t_event->timer_mutex));
+        (*func)();
+        pthread_mutex_lock(&(t_event->timer_mutex));
     }
 
     pthread_mutex_unlock(&(t_event->timer_mutex));
-
-    //free(t_event); // BBB
     return NULL;
 }
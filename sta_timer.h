@@ -8,6 +8,9 @@
 #ifndef _STA_TIMER_H
 #define _STA_TIMER_H
 
+#include <pthread.h>
+#include <time.h>
+
 #define MAX_NUM_TIMER 4 ///< ^C}[̐
 
 /**
@@ -19,8 +22,10 @@ typedef struct _time_event_t {
     int duration; ///< 
     void (*func)(void); ///< N֐ւ̃|C^
     int status; ///< ^C}[̏ԁB0ŃItA1ŃIB
+    int started; ///< ^C}[̃Xbh1
+    struct timespec deadline; ///< ؂鎞
     pthread_mutex_t timer_mutex; ///< mutex
-    pthread_cond_t timer_cond; ///< Ԃ؂邩蓮ŃItꂽƂɃCxgmԕϐB
+    pthread_cond_t timer_cond; ///< N邩蓮ŃItꂽƂɃCxgmԕϐB
 } time_event_t;
 
 time_event_t sta_timers[MAX_NUM_TIMER]; ///< ^C}[̔z
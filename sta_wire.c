@@ -0,0 +1,345 @@
+/**
+ * @file sta_wire.c
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief AREQ/AREP̃pPbg`
+ *
+ * ]̌`̓zXg̃oCgtypeƃsockaddr_in6̂܂160oCgɋl߂́B
+ * RpNgȌ`̓lbg[NoCgŁAvtBbNX2001:200:0::/48
+ * STAŗL80rbgƃgUNVID^ԁB
+ *
+ * | 0-1 | 2 | 3 | 4 | 5 | 6-9 | 10-19 | (20-29) |
+ * | magic | version | type | flags | 0 | txid | STA80rbg | (ԓm[hSTA) |
+ *
+ * ǂ̌`󂯎悤ɂAAREPAREQƓ`ŕԂB
+ * ]̌`reservedWIRE_LEGACY_CAP_COMPACT𗧂ĂāARpNgȌ`ǂ߂邱Ƃm点B
+ */
+
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <string.h>
+#include "sta_wire.h"
+
+static const uint8_t sta_prefix[6] = { 0x20, 0x01, 0x02, 0x00, 0x00, 0x00 }; ///< 2001:200:0::/48
+
+static time_t legacy_only_seen = 0; ///< ]̌`ǂ߂Ȃm[hŌɕ
+static time_t compact_seen = 0; ///< RpNgȌ`ǂ߂m[hŌɕ
+static time_t legacy_probe = 0; ///< autoōŌɏ]̌`ő
+static time_t multi_probe = 0; ///< AREQ̑ɍŌɏ]AREQŊm߂
+static pthread_mutex_t wire_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief ]̌`͂
+ *
+ * @param buf 󂯎pPbg
+ * @param len pPbg̒
+ * @param[out] msg ͌
+ * @retval 0 
+ * @retval -1 Ă
+ */
+static int wire_parse_legacy(const char *buf, size_t len, wire_msg *msg) {
+    uint16_t type;
+    arep_flag_reserved flag_reserved;
+    struct sockaddr_in6 sin6;
+
+    if (len < WIRE_LEGACY_ADDR_OFFSET + sizeof(sin6)) {
+        return -1;
+    }
+    memcpy(&type, buf, sizeof(type));
+    memcpy(&flag_reserved, buf + sizeof(type), sizeof(flag_reserved));
+    memcpy(&sin6, buf + WIRE_LEGACY_ADDR_OFFSET, sizeof(sin6));
+
+    msg->format = WIRE_LEGACY;
+    msg->type = type;
+    msg->txid = 0;
+    msg->sta = sin6.sin6_addr;
+    msg->duplicate = flag_reserved.arep_flag;
+    msg->compact_capable = (flag_reserved.reserved & WIRE_LEGACY_CAP_COMPACT) != 0;
+    msg->negative_only = (flag_reserved.reserved & WIRE_LEGACY_NEGATIVE_ONLY) != 0;
+    msg->has_holder = 0;
+    if (len >= WIRE_LEGACY_HOLDER_OFFSET + sizeof(struct in6_addr)) {
+        memcpy(&(msg->holder), buf + WIRE_LEGACY_HOLDER_OFFSET, sizeof(struct in6_addr));
+        msg->has_holder = (memcmp(msg->holder.s6_addr, sta_prefix, sizeof(sta_prefix)) == 0);
+    }
+    return 0;
+}
+
+/**
+ * @brief RpNgȌ`͂
+ *
+ * @param buf 󂯎pPbg
+ * @param len pPbg̒
+ * @param[out] msg ͌
+ * @retval 0 
+ * @retval -1 ĂA܂͒mȂo[W
+ */
+static int wire_parse_compact(const char *buf, size_t len, wire_msg *msg) {
+    const uint8_t *p = (const uint8_t *)buf;
+    uint32_t txid;
+
+    if (len < WIRE_COMPACT_SIZE || p[2] != WIRE_VERSION) {
+        return -1;
+    }
+    memcpy(&txid, p + 6, sizeof(txid));
+
+    msg->format = WIRE_COMPACT;
+    msg->type = p[3];
+    msg->txid = ntohl(txid);
+    memcpy(msg->sta.s6_addr, sta_prefix, sizeof(sta_prefix));
+    memcpy(msg->sta.s6_addr + sizeof(sta_prefix), p + 10, 10);
+    msg->duplicate = (p[4] & WIRE_FLAG_DUPLICATE) != 0;
+    msg->compact_capable = 1;
+    msg->negative_only = (p[4] & WIRE_FLAG_NEGATIVE_ONLY) != 0;
+    msg->has_holder = 0;
+    if ((p[4] & WIRE_FLAG_HOLDER) && len >= WIRE_COMPACT_SIZE + WIRE_COMPACT_HOLDER_SIZE) {
+        memcpy(msg->holder.s6_addr, sta_prefix, sizeof(sta_prefix));
+        memcpy(msg->holder.s6_addr + sizeof(sta_prefix), p + WIRE_COMPACT_SIZE, WIRE_COMPACT_HOLDER_SIZE);
+        msg->has_holder = 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief AREQ/AREP͂
+ *
+ * 擪magicŌ`BZpPbgmȂo[W-1ԂŁAabort͂ȂB
+ * typeAREQ/AREPǂ͌ĂяoŌ邱ƁB
+ * @param buf 󂯎pPbg
+ * @param len pPbg̒
+ * @param[out] msg ͌
+ * @retval 0 
+ * @retval -1 Ă
+ */
+int wire_parse(const char *buf, size_t len, wire_msg *msg) {
+    uint16_t magic;
+
+    if (len < sizeof(magic)) {
+        return -1;
+    }
+    memcpy(&magic, buf, sizeof(magic));
+    if (ntohs(magic) == WIRE_MAGIC) {
+        return wire_parse_compact(buf, len, msg);
+    }
+    return wire_parse_legacy(buf, len, msg);
+}
+
+/**
+ * @brief AREQ/AREPgݗĂ
+ *
+ * msg->formať`őgݗĂBRpNgȌ`STÃvtBbNXȂ̂ŁA
+ * STAłȂAhX͑gݗĂȂB
+ * @param[out] buf gݗĂ
+ * @param buflen buf̑傫
+ * @param msg g
+ * @return pPbg̒BgݗĂȂ0
+ */
+size_t wire_build(char *buf, size_t buflen, const wire_msg *msg) {
+    uint8_t *p = (uint8_t *)buf;
+    uint16_t type;
+    uint16_t magic;
+    uint32_t txid;
+    arep_flag_reserved flag_reserved;
+    struct sockaddr_in6 sin6;
+    size_t len;
+
+    if (msg->format == WIRE_LEGACY) {
+        if (buflen < WIRE_LEGACY_SIZE) {
+            return 0;
+        }
+        memset(buf, 0, WIRE_LEGACY_SIZE);
+        type = (uint16_t)msg->type;
+        memset(&flag_reserved, 0, sizeof(flag_reserved));
+        flag_reserved.arep_flag = msg->duplicate ? 1 : 0;
+        flag_reserved.reserved = WIRE_LEGACY_CAP_COMPACT | (msg->negative_only ? WIRE_LEGACY_NEGATIVE_ONLY : 0);
+        memset(&sin6, 0, sizeof(sin6));
+        sin6.sin6_family = AF_INET6;
+        sin6.sin6_addr = msg->sta;
+        memcpy(buf, &type, sizeof(type));
+        memcpy(buf + sizeof(type), &flag_reserved, sizeof(flag_reserved));
+        memcpy(buf + WIRE_LEGACY_ADDR_OFFSET, &sin6, sizeof(sin6));
+        if (msg->has_holder) {
+            memcpy(buf + WIRE_LEGACY_HOLDER_OFFSET, &(msg->holder), sizeof(struct in6_addr));
+        }
+        return WIRE_LEGACY_SIZE;
+    }
+
+    len = WIRE_COMPACT_SIZE + (msg->has_holder ? WIRE_COMPACT_HOLDER_SIZE : 0);
+    if (buflen < len || memcmp(msg->sta.s6_addr, sta_prefix, sizeof(sta_prefix)) != 0
+        || (msg->has_holder && memcmp(msg->holder.s6_addr, sta_prefix, sizeof(sta_prefix)) != 0)) {
+        return 0;
+    }
+    magic = htons(WIRE_MAGIC);
+    txid = htonl(msg->txid);
+    memcpy(p, &magic, sizeof(magic));
+    p[2] = WIRE_VERSION;
+    p[3] = (uint8_t)msg->type;
+    p[4] = (msg->duplicate ? WIRE_FLAG_DUPLICATE : 0) | (msg->has_holder ? WIRE_FLAG_HOLDER : 0)
+        | (msg->negative_only ? WIRE_FLAG_NEGATIVE_ONLY : 0);
+    p[5] = 0;
+    memcpy(p + 6, &txid, sizeof(txid));
+    memcpy(p + 10, msg->sta.s6_addr + sizeof(sta_prefix), 10);
+    if (msg->has_holder) {
+        memcpy(p + WIRE_COMPACT_SIZE, msg->holder.s6_addr + sizeof(sta_prefix), WIRE_COMPACT_HOLDER_SIZE);
+    }
+    return len;
+}
+
+/**
+ * @brief 󂯎AREQ̏AREPɏ
+ *
+ * wire_buildőgݗĒɁAtypeƃtOĕԓm[hSTAɂB
+ * STAtxidAREQ̂̂̂܂܎ĉŁAreply->stareply->txid͌ȂB
+ * ]̌`͖₢킹sockaddr_in6̂܂ܕԂA160oCgɖȂAREQȂ瑫Ȃ0Ŗ߂B
+ * @param buf wire_parseAREQBAREPɂȂ
+ * @param len AREQ̒
+ * @param buflen buf̑傫
+ * @param reply ԂAREPBformatAREQƓł邱
+ * @return AREP̒BȂ0
+ */
+size_t wire_reply(char *buf, size_t len, size_t buflen, const wire_msg *reply) {
+    uint8_t *p = (uint8_t *)buf;
+    uint16_t type;
+    arep_flag_reserved flag_reserved;
+    int has_holder = reply->has_holder;
+
+    if (reply->format == WIRE_LEGACY) {
+        if (buflen < WIRE_LEGACY_SIZE) {
+            return 0;
+        }
+        if (len < WIRE_LEGACY_SIZE) {
+            memset(buf + len, 0, WIRE_LEGACY_SIZE - len);
+        }
+        type = (uint16_t)reply->type;
+        memset(&flag_reserved, 0, sizeof(flag_reserved));
+        flag_reserved.arep_flag = reply->duplicate ? 1 : 0;
+        flag_reserved.reserved = WIRE_LEGACY_CAP_COMPACT | (reply->negative_only ? WIRE_LEGACY_NEGATIVE_ONLY : 0);
+        memcpy(buf, &type, sizeof(type));
+        memcpy(buf + sizeof(type), &flag_reserved, sizeof(flag_reserved));
+        if (has_holder) {
+            memcpy(buf + WIRE_LEGACY_HOLDER_OFFSET, &(reply->holder), sizeof(struct in6_addr));
+        } else {
+            memset(buf + WIRE_LEGACY_HOLDER_OFFSET, 0, sizeof(struct in6_addr));
+        }
+        return WIRE_LEGACY_SIZE;
+    }
+
+    if (has_holder && memcmp(reply->holder.s6_addr, sta_prefix, sizeof(sta_prefix)) != 0) {
+        has_holder = 0; // RpNgȌ`ɂSTAڂȂ
+    }
+    len = WIRE_COMPACT_SIZE + (has_holder ? WIRE_COMPACT_HOLDER_SIZE : 0);
+    if (buflen < len) {
+        return 0;
+    }
+    p[3] = (uint8_t)reply->type;
+    p[4] = (reply->duplicate ? WIRE_FLAG_DUPLICATE : 0) | (has_holder ? WIRE_FLAG_HOLDER : 0)
+        | (reply->negative_only ? WIRE_FLAG_NEGATIVE_ONLY : 0);
+    p[5] = 0;
+    if (has_holder) {
+        memcpy(p + WIRE_COMPACT_SIZE, reply->holder.s6_addr + sizeof(sta_prefix), WIRE_COMPACT_HOLDER_SIZE);
+    }
+    return len;
+}
+
+/**
+ * @brief ̃m[h󂯎pPbǧ`o
+ *
+ * autôƂ̌`̑IɎgB[vobNŎ󂯎pPbg͓nȂƁB
+ * @param msg 󂯎pPbg
+ * @param now 󂯎
+ */
+void wire_heard(const wire_msg *msg, time_t now) {
+    pthread_mutex_lock(&wire_mutex);
+    if (msg->compact_capable) {
+        compact_seen = now;
+    } else {
+        legacy_only_seen = now;
+    }
+    pthread_mutex_unlock(&wire_mutex);
+}
+
+/**
+ * @brief AREQ𑗂`I
+ *
+ * autoł́ARpNgȌ`ǂ߂m[hĂāA
+ * ]̌`ǂ߂Ȃm[hWIRE_AUTO_HOLDbĂȂƂRpNgȌ`ɂB
+ * ]̃m[h̓RpNgAREQɂ͓Ȃ̂ŁAWIRE_AUTO_HOLDb1͏]̌`őĊm߂B
+ * @param mode Iѕ
+ * @param now ݎ
+ * @return `
+ */
+wire_format wire_choose(wire_mode mode, time_t now) {
+    wire_format format = WIRE_LEGACY;
+
+    if (mode == WIRE_MODE_COMPACT) {
+        return WIRE_COMPACT;
+    } else if (mode == WIRE_MODE_AUTO) {
+        pthread_mutex_lock(&wire_mutex);
+        if (compact_seen != 0 && (legacy_only_seen == 0 || now - legacy_only_seen > WIRE_AUTO_HOLD)) {
+            if (now - legacy_probe >= WIRE_AUTO_HOLD) {
+                legacy_probe = now;
+            } else {
+                format = WIRE_COMPACT;
+            }
+        }
+        pthread_mutex_unlock(&wire_mutex);
+    }
+    return format;
+}
+
+/**
+ * @brief AREQ/AREP󂯎Ƃo
+ *
+ * AREQ/AREP𑗂̂͐Vm[hȂ̂ŁARpNgȌ`ǂ߂B
+ * 烋[vobNŎ󂯎pPbgł͌Ă΂ȂƁB
+ * @param now 󂯎
+ */
+void wire_heard_multi(time_t now) {
+    pthread_mutex_lock(&wire_mutex);
+    compact_seen = now;
+    pthread_mutex_unlock(&wire_mutex);
+}
+
+/**
+ * @brief 𕡐ׂAREQ𑗂Ă悢߂
+ *
+ * ]̃m[h͕AREQقĎ̂Ă̂ŁAقĂ邱ƂdȂɌĂ܂B
+ * autǒ`ƓAVm[hĂāA]̌`ǂ߂Ȃm[h
+ * WIRE_AUTO_HOLDbĂȂƂBWIRE_AUTO_HOLDb1͏]AREQŊm߂B
+ * @param now ݎ
+ * @retval 1 AREQ𑗂Ă悢
+ * @retval 0 {]AREQŖ₢킹邱
+ */
+int wire_multi_ok(time_t now) {
+    int ok = 0;
+
+    pthread_mutex_lock(&wire_mutex);
+    if (compact_seen != 0 && (legacy_only_seen == 0 || now - legacy_only_seen > WIRE_AUTO_HOLD)) {
+        if (now - multi_probe >= WIRE_AUTO_HOLD) {
+            multi_probe = now;
+        } else {
+            ok = 1;
+        }
+    }
+    pthread_mutex_unlock(&wire_mutex);
+    return ok;
+}
+
+/**
+ * @brief R}hC̕񂩂Iѕ𓾂
+ *
+ * @param s "legacy"A"compact"A"auto"̂ǂꂩ
+ * @param[out] mode Iѕ
+ * @retval 0 
+ * @retval -1 mȂ
+ */
+int wire_mode_from_string(const char *s, wire_mode *mode) {
+    if (strcmp(s, "legacy") == 0) {
+        *mode = WIRE_MODE_LEGACY;
+    } else if (strcmp(s, "compact") == 0) {
+        *mode = WIRE_MODE_COMPACT;
+    } else if (strcmp(s, "auto") == 0) {
+        *mode = WIRE_MODE_AUTO;
+    } else {
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,85 @@
+/**
+ * @file sta_wire.h
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief AREQ/AREP̃pPbg`
+ * ]160oCǧ`ƁASTAŗL80rbg^ԃRpNgȌ`
+ */
+
+#ifndef _STA_WIRE_H
+#define _STA_WIRE_H
+
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define WIRE_LEGACY_SIZE 160 ///< ]AREQ/AREP̑傫
+#define WIRE_LEGACY_ADDR_OFFSET 4 ///< ]̌`sockaddr_in6̈ʒuBtypeAflaǧ
+#define WIRE_LEGACY_HOLDER_OFFSET 32 ///< ]AREP̒̕ԓm[hgSTÄʒuBAhX̌
+#define WIRE_LEGACY_CAP_COMPACT 0x1 ///< ]̌`reservedɗĂBRpNgȌ`ǂ߂
+#define WIRE_LEGACY_NEGATIVE_ONLY 0x2 ///< ]̌`AREQreservedɗĂBd̂ƂԓĂق
+
+#define WIRE_MAGIC 0x5354 ///< "ST"B]̌`type(zXg̃oCg01)Ƃ͏dȂȂ
+#define WIRE_VERSION 1
+#define WIRE_COMPACT_SIZE 20 ///< RpNgȌ`̑傫
+#define WIRE_COMPACT_HOLDER_SIZE 10 ///< AREP̌ɕtԓm[hSTȂ傫
+#define WIRE_FLAG_DUPLICATE 0x01
+#define WIRE_FLAG_HOLDER 0x02
+#define WIRE_FLAG_NEGATIVE_ONLY 0x04 ///< AREQŁAd̂ƂԓĂق
+
+#define WIRE_AUTO_HOLD 60 ///< autoŁA]̌`bȂm[hĂRpNgȌ`T鎞[b]
+
+/**
+ * @brief ]̌`1631rbg
+ *
+ * 1rbgAREP_FLAG15rbg̗\̈悩ȂB
+ * \̈̍ŉʃrbgWIRE_LEGACY_CAP_COMPACTA̎WIRE_LEGACY_NEGATIVE_ONLYB
+ */
+typedef struct _arep_flag_reserved {
+    unsigned arep_flag : 1;
+    unsigned reserved : 15;
+} __attribute__((packed)) arep_flag_reserved;
+
+/**
+ * @brief Ƃ̌`̑Iѕ
+ */
+typedef enum _wire_mode {
+    WIRE_MODE_LEGACY, ///< ɏ]̌`
+    WIRE_MODE_COMPACT, ///< ɃRpNgȌ`
+    WIRE_MODE_AUTO ///< ܂肪SRpNgȌ`ǂ߂ƂRpNg
+} wire_mode;
+
+/**
+ * @brief pPbǧ`
+ */
+typedef enum _wire_format {
+    WIRE_LEGACY,
+    WIRE_COMPACT
+} wire_format;
+
+/**
+ * @brief `ɂȂAREQ/AREP̒g
+ */
+typedef struct _wire_msg {
+    wire_format format;
+    int type; ///< packet_typeAREQAREP
+    uint32_t txid; ///< RpNgȌ`̂݁BAREPAREQ̂̂Ԃ
+    struct in6_addr sta; ///< ₢킹AhX
+    int duplicate; ///< AREPŏdȂ1
+    int compact_capable; ///< MRpNgȌ`ǂ߂Ȃ1
+    int negative_only; ///< AREQŁAdȂ̕ԓ͂ȂȂ1
+    int has_holder;
+    struct in6_addr holder; ///< AREPԂm[hSTA
+} wire_msg;
+
+int wire_parse(const char *buf, size_t len, wire_msg *msg);
+size_t wire_build(char *buf, size_t buflen, const wire_msg *msg);
+size_t wire_reply(char *buf, size_t len, size_t buflen, const wire_msg *reply);
+void wire_heard(const wire_msg *msg, time_t now);
+wire_format wire_choose(wire_mode mode, time_t now);
+void wire_heard_multi(time_t now);
+int wire_multi_ok(time_t now);
+int wire_mode_from_string(const char *s, wire_mode *mode);
+
+#endif
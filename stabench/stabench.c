@@ -0,0 +1,636 @@
+/**
+ * @file stabench.c
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief AREQ̕א
+ *
+ * 1stamdAREQjLXgŌ߂[gőAstamd
+ * 1b肢AREQɁAAREQ𑗂m[hwaiting_timêɓ邩B
+ * AREP͑MɕԂĂ̂ŁÂȂUDP\Pbg1{őMłB
+ * [vobNstamdɂAvetȟstamdɂgB
+ *
+ * ̂-x̊-c̃AhX(stamdĂSTA)ɂA
+ * cSTÃvtBbNX̗̒̃AhXɂB
+ * ԂĂAREP̏dȂÃAhXĂ邩ǂƍĂ邩B
+ *
+ * ]̌`txid^ׂȂ̂ŁÃAhX̉32rbgʂԍɂB
+ * -c̃AhXւAREṔÃAhXőĂ܂ԓ̂ȂԌÂAREQւ̂̂Ƃ݂ȂB
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../sta_multi.h"
+#include "../sta_wire.h"
+#include "stabench.h"
+
+static bench_slot *slots = NULL; ///< ԓ҂AREQBʂԍ&slot_maskň
+static uint32_t slot_mask = 0;
+static uint32_t next_seq = 0; ///< ɑAREQ̒ʂԍ
+static uint32_t retired = 0; ///< O̒ʂԍ́Aԓ҂Ԃ߂
+static uint32_t cursor[BENCH_COLLIDE_MAX]; ///< bench_take_collideɒׂʂԍ
+static uint32_t *latencies = NULL; ///< AREP̒x[}CNb]
+static unsigned long nlatencies = 0;
+static bench_stats stats;
+static int sending_done = 0;
+static long target_cpu_start = -1; ///< -P̃vZX̊JnCPU[clock tick]
+static pthread_mutex_t bench_mutex = PTHREAD_MUTEX_INITIALIZER; ///< ܂ł̕ϐ̔r
+
+/**
+ * @brief P鎞
+ *
+ * @return [imb]
+ */
+static int64_t bench_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief ʂԍXbg
+ *
+ * @param seq ʂԍ
+ * @return Xbg
+ */
+static bench_slot *bench_slot_of(uint32_t seq) {
+    return &slots[seq & slot_mask];
+}
+
+/**
+ * @brief AREP͂AREQ
+ *
+ * @param s Xbg
+ * @retval 1 ͂
+ * @retval 0 d̂Ƃԓ郂[hŁAdĂ͂̌₪Ȃ
+ */
+static int bench_expects_reply(const bench_slot *s) {
+    return !parameters.negative_only || s->expected != 0;
+}
+
+/**
+ * @brief ̃AhX
+ *
+ * @param[out] addr 
+ * @param seq ʂԍB̃AhX̉32rbgɓ
+ * @param[out] collide -c̃AhXɂ炻̔ԍBȂ-1
+ */
+static void bench_fill_address(struct in6_addr *addr, uint32_t seq, int *collide) {
+    uint32_t nseq;
+    int i;
+
+    if (parameters.ncollide > 0 && random() / ((double)RAND_MAX + 1.0) < parameters.collide_ratio) {
+        *collide = (int)(random() % parameters.ncollide);
+        *addr = parameters.collide[*collide];
+        return;
+    }
+    *collide = -1;
+    memset(addr, 0, sizeof(*addr));
+    addr->s6_addr[0] = 0x20;
+    addr->s6_addr[1] = 0x01;
+    addr->s6_addr[2] = 0x02;
+    for (i = 6; i < 12; i++) {
+        addr->s6_addr[i] = (uint8_t)random();
+    }
+    nseq = htonl(seq);
+    memcpy(&(addr->s6_addr[12]), &nseq, sizeof(nseq));
+}
+
+/**
+ * @brief AREQ1
+ *
+ * ɃXbgɏĂ瑗̂ŁAԂĂAREPB
+ * @param fd \Pbg
+ * @param seq ʂԍ
+ * @retval 0 
+ * @retval -1 s
+ */
+static int bench_send(int fd, uint32_t seq) {
+    struct in6_addr candidates[MULTI_MAX];
+    char buf[BENCH_BUF_SIZE];
+    wire_msg msg;
+    bench_slot *s;
+    uint32_t expected = 0;
+    size_t len;
+    int collide = -1;
+    int n, i;
+
+    n = (parameters.format == BENCH_MULTI) ? parameters.candidates : 1;
+    for (i = 0; i < n; i++) {
+        bench_fill_address(&candidates[i], seq, &collide);
+        if (collide != -1) {
+            expected |= (uint32_t)1 << i;
+        }
+    }
+
+    if (parameters.format == BENCH_MULTI) {
+        len = multi_build(buf, sizeof(buf), BENCH_AREQ_MULTI, seq, parameters.negative_only ? MULTI_NEGATIVE_ONLY : 0,
+                          candidates, n, NULL);
+    } else {
+        memset(&msg, 0, sizeof(msg));
+        msg.format = (parameters.format == BENCH_COMPACT) ? WIRE_COMPACT : WIRE_LEGACY;
+        msg.type = BENCH_AREQ;
+        msg.txid = seq;
+        msg.sta = candidates[0];
+        msg.negative_only = parameters.negative_only;
+        len = wire_build(buf, sizeof(buf), &msg);
+    }
+    if (len == 0) {
+        fprintf(stderr, "[bench_send] cannot build AREQ\n");
+        return -1;
+    }
+
+    pthread_mutex_lock(&bench_mutex);
+    s = bench_slot_of(seq);
+    s->seq = seq;
+    s->expected = expected;
+    s->collide = (int8_t)((parameters.format == BENCH_LEGACY) ? collide : -1);
+    s->state = SLOT_SENT;
+    s->sent_ns = bench_now();
+    next_seq = seq + 1;
+    pthread_mutex_unlock(&bench_mutex);
+
+    if (sendto(fd, buf, len, 0, (struct sockaddr *)&(parameters.target), sizeof(parameters.target)) < 0) {
+        pthread_mutex_lock(&bench_mutex);
+        s->state = SLOT_FREE;
+        stats.send_errors++;
+        pthread_mutex_unlock(&bench_mutex);
+        return -1;
+    }
+    pthread_mutex_lock(&bench_mutex);
+    stats.sent++;
+    pthread_mutex_unlock(&bench_mutex);
+    return 0;
+}
+
+/**
+ * @brief ҂Ԃ߂AREQЕt
+ *
+ * bench_mutexԂŌĂԂƁB
+ * @param now ̎[imb]
+ */
+static void bench_sweep(int64_t now) {
+    const int64_t wait_ns = (int64_t)parameters.wait_ms * 1000000;
+    bench_slot *s;
+
+    while (retired != next_seq) {
+        s = bench_slot_of(retired);
+        if (s->state != SLOT_FREE && now - s->sent_ns < wait_ns) {
+            break;
+        }
+        if (s->state == SLOT_SENT) {
+            if (bench_expects_reply(s)) {
+                stats.lost++;
+            } else {
+                stats.silent++;
+            }
+        }
+        s->state = SLOT_FREE;
+        retired++;
+    }
+}
+
+/**
+ * @brief -c̃AhXւ̏]̌`AREPAǂAREQւ̂̂
+ *
+ * bench_mutexԂŌĂԂƁB
+ * @param idx -c̃AhX̔ԍ
+ * @param[out] seq AREQ̒ʂԍ
+ * @retval 0 
+ * @retval -1 ̃AhXŕԓ҂AREQȂ
+ */
+static int bench_take_collide(int idx, uint32_t *seq) {
+    uint32_t i;
+    bench_slot *s;
+
+    i = cursor[idx];
+    if ((int32_t)(i - retired) < 0) {
+        i = retired;
+    }
+    for (; i != next_seq; i++) {
+        s = bench_slot_of(i);
+        if (s->state == SLOT_SENT && s->collide == idx) {
+            cursor[idx] = i + 1;
+            *seq = i;
+            return 0;
+        }
+    }
+    cursor[idx] = i;
+    return -1;
+}
+
+/**
+ * @brief AREP𐔂
+ *
+ * bench_mutexԂŌĂԂƁB
+ * @param seq AREQ̒ʂԍ
+ * @param duplicate dƕԂẴrbg
+ * @param now 󂯎[imb]
+ */
+static void bench_handle_reply(uint32_t seq, uint32_t duplicate, int64_t now) {
+    bench_slot *s;
+    uint32_t wrong;
+
+    if ((int32_t)(seq - next_seq) >= 0) {
+        stats.unknown++;
+        return;
+    }
+    if ((int32_t)(seq - retired) < 0) {
+        stats.late++;
+        return;
+    }
+    s = bench_slot_of(seq);
+    if (s->seq != seq || s->state == SLOT_FREE) {
+        stats.unknown++;
+        return;
+    }
+    if (s->state == SLOT_ANSWERED) {
+        stats.extra++;
+        return;
+    }
+    s->state = SLOT_ANSWERED;
+    stats.answered++;
+    latencies[nlatencies++] = (uint32_t)((now - s->sent_ns) / 1000);
+
+    for (wrong = duplicate & ~(s->expected); wrong != 0; wrong &= wrong - 1) {
+        stats.false_duplicate++;
+    }
+    for (wrong = s->expected & ~duplicate; wrong != 0; wrong &= wrong - 1) {
+        stats.missed_duplicate++;
+    }
+}
+
+/**
+ * @brief AREP󂯎Xbh
+ *
+ * IāASAREQ̕ԓ҂Ԃ߂IB
+ * @param arg \Pbg
+ * @return NULLԂ
+ */
+static void *bench_receiver(void *arg) {
+    int fd = *(int *)arg;
+    char buf[BENCH_BUF_SIZE];
+    struct pollfd pfd;
+    multi_packet rep;
+    wire_msg msg;
+    uint16_t type;
+    uint32_t seq;
+    int64_t now;
+    ssize_t len;
+    int finished;
+    int i;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    for (;;) {
+        poll(&pfd, 1, BENCH_POLL_MS);
+        for (;;) {
+            len = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+            now = bench_now();
+            pthread_mutex_lock(&bench_mutex);
+            bench_sweep(now);
+            if (len < 0) {
+                finished = sending_done && retired == next_seq;
+                pthread_mutex_unlock(&bench_mutex);
+                break;
+            }
+            if (len < (ssize_t)sizeof(type)) {
+                stats.unknown++;
+                pthread_mutex_unlock(&bench_mutex);
+                continue;
+            }
+            memcpy(&type, buf, sizeof(type));
+            if (type == BENCH_AREP_MULTI) {
+                if (multi_parse(buf, len, &rep) == 0 && rep.type == BENCH_AREP_MULTI) {
+                    bench_handle_reply(rep.txid, rep.duplicate & ~MULTI_NEGATIVE_ONLY, now);
+                } else {
+                    stats.unknown++;
+                }
+            } else if (wire_parse(buf, len, &msg) != 0 || msg.type != BENCH_AREP) {
+                stats.unknown++;
+            } else if (msg.format == WIRE_COMPACT) {
+                bench_handle_reply(msg.txid, msg.duplicate ? 1 : 0, now);
+            } else {
+                for (i = 0; i < parameters.ncollide; i++) {
+                    if (memcmp(&(msg.sta), &(parameters.collide[i]), sizeof(struct in6_addr)) == 0) {
+                        break;
+                    }
+                }
+                if (i < parameters.ncollide) {
+                    if (bench_take_collide(i, &seq) == 0) {
+                        bench_handle_reply(seq, msg.duplicate ? 1 : 0, now);
+                    } else {
+                        stats.late++; // ҂Ԃ߂AREQւ̂̂ƋʂłȂ
+                    }
+                } else {
+                    memcpy(&seq, &(msg.sta.s6_addr[12]), sizeof(seq));
+                    bench_handle_reply(ntohl(seq), msg.duplicate ? 1 : 0, now);
+                }
+            }
+            pthread_mutex_unlock(&bench_mutex);
+        }
+        if (finished) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief qsort̔r֐
+ */
+static int compare_latency(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief vZXCPUԂǂ
+ *
+ * /proc/pid/statutimestime̘aBSXbh̕ĂB
+ * @param pid vZXID
+ * @return CPU[clock tick]Bǂ߂Ȃ-1
+ */
+static long read_cpu_ticks(pid_t pid) {
+    char path[64], buf[1024];
+    unsigned long utime, stime;
+    char *p;
+    FILE *fp;
+    size_t n;
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    fp = fopen(path, "r");
+    if (fp == NULL) {
+        return -1;
+    }
+    n = fread(buf, 1, sizeof(buf) - 1, fp);
+    fclose(fp);
+    buf[n] = '\0';
+    p = strrchr(buf, ')'); // commɋ󔒂Ăǂ߂悤
+    if (p == NULL || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) != 2) {
+        return -1;
+    }
+    return (long)(utime + stime);
+}
+
+/**
+ * @brief ʂ\
+ *
+ * @param elapsed ̂ɂ[b]
+ */
+static void bench_report(double elapsed) {
+    static const double points[] = { 0.5, 0.9, 0.99, 0.999 };
+    static const char *labels[] = { "p50", "p90", "p99", "p99.9" };
+    unsigned long k;
+    double cpu;
+    int i;
+
+    printf("sent          %lu\n", stats.sent);
+    printf("send_errors   %lu\n", stats.send_errors);
+    printf("rate          %.1f/s\n", (elapsed > 0.0) ? stats.sent / elapsed : 0.0);
+    printf("answered      %lu\n", stats.answered);
+    printf("lost          %lu\n", stats.lost);
+    printf("silent        %lu\n", stats.silent);
+    printf("late          %lu\n", stats.late);
+    printf("extra         %lu\n", stats.extra);
+    printf("unknown       %lu\n", stats.unknown);
+    printf("false_dup     %lu\n", stats.false_duplicate);
+    printf("missed_dup    %lu\n", stats.missed_duplicate);
+    if (parameters.target_pid > 0 && target_cpu_start >= 0) {
+        cpu = (double)(read_cpu_ticks(parameters.target_pid) - target_cpu_start) / sysconf(_SC_CLK_TCK);
+        printf("target_cpu    %.2fs %.1fus/AREQ\n", cpu, (stats.sent > 0) ? cpu * 1e6 / stats.sent : 0.0);
+    }
+    if (nlatencies == 0) {
+        return;
+    }
+    qsort(latencies, nlatencies, sizeof(uint32_t), compare_latency);
+    printf("latency_us   ");
+    for (i = 0; i < (int)(sizeof(points) / sizeof(points[0])); i++) {
+        k = (unsigned long)(points[i] * (nlatencies - 1) + 0.5);
+        printf(" %s %u", labels[i], latencies[k]);
+    }
+    printf(" max %u\n", latencies[nlatencies - 1]);
+}
+
+/**
+ * @brief stamd̃AhX
+ *
+ * "fe80::1%eth0"̂悤ɃXR[vB
+ * @param host AhXzXg
+ * @param port |[gԍ
+ * @param[out] target stamd̃AhX
+ * @retval 0 
+ * @retval -1 s
+ */
+static int parse_target(const char *host, int port, struct sockaddr_in6 *target) {
+    struct addrinfo hints, *res;
+    int ret;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET6;
+    hints.ai_socktype = SOCK_DGRAM;
+    ret = getaddrinfo(host, NULL, &hints, &res);
+    if (ret != 0) {
+        fprintf(stderr, "%s: %s\n", host, gai_strerror(ret));
+        return -1;
+    }
+    memcpy(target, res->ai_addr, sizeof(*target));
+    target->sin6_port = htons(port);
+    freeaddrinfo(res);
+    return 0;
+}
+
+/**
+ * @brief gp@\ďI
+ */
+static void usage() {
+    fprintf(stderr, "usage: stabench [options] target\n");
+    fprintf(stderr, "  target : Address of the stamd to load, e.g. ::1 or fe80::1%%veth0\n");
+    fprintf(stderr, "  -c addr : STA the target currently holds; AREQs for it must be answered as duplicate. (up to %d)\n", BENCH_COLLIDE_MAX);
+    fprintf(stderr, "  -f format : legacy, compact or multi. (legacy)\n");
+    fprintf(stderr, "  -h : Show this help.\n");
+    fprintf(stderr, "  -m count : Candidates per AREQ with -f multi. (4, up to %d)\n", MULTI_MAX);
+    fprintf(stderr, "  -n count : Number of AREQs to send. (10000)\n");
+    fprintf(stderr, "  -N : Ask the target to answer duplicates only.\n");
+    fprintf(stderr, "  -P pid : Also report the CPU time the target process spent per AREQ.\n");
+    fprintf(stderr, "  -p port : UDP port of the target. (%d)\n", BENCH_PORT);
+    fprintf(stderr, "  -r rate : AREQs per second, 0 = as fast as possible. (1000)\n");
+    fprintf(stderr, "  -s seed : Random seed.\n");
+    fprintf(stderr, "  -w msec : Requester's waiting time; later AREPs count as late. (%d)\n", BENCH_WAIT_MS);
+    fprintf(stderr, "  -x ratio : Fraction of candidates taken from -c. (0.1)\n");
+    fprintf(stderr, "Exits with 1 if any AREP reported the wrong duplicate state.\n");
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    struct sockaddr_in6 local;
+    struct timespec deadline;
+    pthread_t tid;
+    int64_t start, t;
+    uint32_t seq;
+    unsigned long nslots;
+    int port = BENCH_PORT;
+    int bufsize = 4 * 1024 * 1024;
+    int fd;
+    int c;
+
+    memset(&parameters, 0, sizeof(parameters));
+    parameters.rate = 1000.0;
+    parameters.count = 10000;
+    parameters.wait_ms = BENCH_WAIT_MS;
+    parameters.collide_ratio = 0.1;
+    parameters.format = BENCH_LEGACY;
+    parameters.candidates = 4;
+    srandom((unsigned int)(time(NULL) ^ getpid()));
+
+    while ((c = getopt(argc, argv, "c:f:hm:n:Np:P:r:s:w:x:")) != -1) {
+        switch (c) {
+        case 'c':
+            if (parameters.ncollide >= BENCH_COLLIDE_MAX
+                || inet_pton(AF_INET6, optarg, &(parameters.collide[parameters.ncollide])) != 1) {
+                fprintf(stderr, "invalid address: %s\n", optarg);
+                usage();
+            }
+            parameters.ncollide++;
+            break;
+        case 'f':
+            if (strcmp(optarg, "legacy") == 0) {
+                parameters.format = BENCH_LEGACY;
+            } else if (strcmp(optarg, "compact") == 0) {
+                parameters.format = BENCH_COMPACT;
+            } else if (strcmp(optarg, "multi") == 0) {
+                parameters.format = BENCH_MULTI;
+            } else {
+                usage();
+            }
+            break;
+        case 'm':
+            parameters.candidates = atoi(optarg);
+            if (parameters.candidates < 1 || parameters.candidates > MULTI_MAX) {
+                usage();
+            }
+            break;
+        case 'n':
+            parameters.count = strtoul(optarg, NULL, 10);
+            if (parameters.count == 0 || parameters.count > 0x7fffffffUL) {
+                usage();
+            }
+            break;
+        case 'N':
+            parameters.negative_only = 1;
+            break;
+        case 'p':
+            port = atoi(optarg);
+            break;
+        case 'P':
+            parameters.target_pid = (pid_t)atoi(optarg);
+            break;
+        case 'r':
+            parameters.rate = atof(optarg);
+            if (parameters.rate < 0.0) {
+                usage();
+            }
+            break;
+        case 's':
+            srandom((unsigned int)strtoul(optarg, NULL, 10));
+            break;
+        case 'w':
+            parameters.wait_ms = atoi(optarg);
+            if (parameters.wait_ms <= 0) {
+                usage();
+            }
+            break;
+        case 'x':
+            parameters.collide_ratio = atof(optarg);
+            if (parameters.collide_ratio < 0.0 || parameters.collide_ratio > 1.0) {
+                usage();
+            }
+            break;
+        case 'h':
+        default:
+            usage();
+        }
+    }
+    if (optind != argc - 1 || parse_target(argv[optind], port, &(parameters.target)) != 0) {
+        usage();
+    }
+
+    for (nslots = 1; nslots < parameters.count && nslots < BENCH_SLOTS_MAX; nslots <<= 1)
+        ;
+    slot_mask = (uint32_t)(nslots - 1);
+    slots = calloc(nslots, sizeof(bench_slot));
+    latencies = malloc(parameters.count * sizeof(uint32_t));
+    if (slots == NULL || latencies == NULL) {
+        fprintf(stderr, "cannot allocate %lu requests\n", parameters.count);
+        exit(1);
+    }
+
+    fd = socket(AF_INET6, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        fprintf(stderr, "socket error: %s\n", strerror(errno));
+        exit(1);
+    }
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize)); // AREP܂Ƃ߂ėĂƂȂ悤
+    memset(&local, 0, sizeof(local));
+    local.sin6_family = AF_INET6;
+    local.sin6_addr = in6addr_any;
+    if (bind(fd, (struct sockaddr *)&local, sizeof(local)) < 0) {
+        fprintf(stderr, "bind error: %s\n", strerror(errno));
+        exit(1);
+    }
+    if (pthread_create(&tid, NULL, bench_receiver, &fd) != 0) {
+        fprintf(stderr, "pthread_create error\n");
+        exit(1);
+    }
+
+    if (parameters.target_pid > 0) {
+        target_cpu_start = read_cpu_ticks(parameters.target_pid);
+        if (target_cpu_start < 0) {
+            fprintf(stderr, "cannot read the CPU time of %d\n", (int)parameters.target_pid);
+        }
+    }
+    start = bench_now();
+    for (seq = 0; seq < parameters.count; seq++) {
+        if (parameters.rate > 0.0) {
+            t = start + (int64_t)(seq * 1e9 / parameters.rate);
+            deadline.tv_sec = t / 1000000000;
+            deadline.tv_nsec = t % 1000000000;
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+                ;
+        }
+        // XbgȂ΁AÂAREQЕt̂҂
+        for (;;) {
+            pthread_mutex_lock(&bench_mutex);
+            c = (seq - retired >= nslots);
+            pthread_mutex_unlock(&bench_mutex);
+            if (!c) {
+                break;
+            }
+            usleep(100);
+        }
+        bench_send(fd, seq);
+    }
+    t = bench_now();
+
+    pthread_mutex_lock(&bench_mutex);
+    sending_done = 1;
+    pthread_mutex_unlock(&bench_mutex);
+    pthread_join(tid, NULL);
+    close(fd);
+
+    bench_report((t - start) / 1e9);
+    exit(stats.false_duplicate > 0 || stats.missed_duplicate > 0);
+}
@@ -0,0 +1,106 @@
+/**
+ * @file stabench.h
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief AREQ̕א
+ *
+ * stamdAREQ߂[gőAAREP̒xAAd̐𑪂R}h
+ */
+
+#ifndef _STABENCH_H
+#define _STABENCH_H
+
+#define BENCH_PORT 5003 ///< stamdUDP_PORT_NUMBER
+#define BENCH_WAIT_MS 10000 ///< stamdWAITING_TIMEB߂AREP͊ԂɍȂ̂Ƃ
+#define BENCH_COLLIDE_MAX 16 ///< -cŎwłAhX̐
+#define BENCH_SLOTS_MAX (1 << 20) ///< ԓ҂ĂAREQ̍ő吔
+#define BENCH_BUF_SIZE 512 ///< stamdUDP_RECV_BUF_SIZE
+#define BENCH_POLL_MS 10 ///< MXbh؂𒲂ׂԊu[~b]
+
+#define BENCH_AREQ 0 ///< stamdpacket_typeAREQ
+#define BENCH_AREP 1 ///< stamdpacket_typeAREP
+#define BENCH_AREQ_MULTI 2 ///< stamdpacket_typeAREQ_MULTI
+#define BENCH_AREP_MULTI 3 ///< stamdpacket_typeAREP_MULTI
+
+/**
+ * @brief AREQ̌`
+ */
+typedef enum _bench_format {
+    BENCH_LEGACY, ///< ]160oCǧ`(allocation_request_start)
+    BENCH_COMPACT, ///< RpNgȌ`
+    BENCH_MULTI ///< ̌`
+} bench_format;
+
+/**
+ * @brief ԓ҂AREQ̏
+ */
+typedef enum _bench_slot_state {
+    SLOT_FREE,
+    SLOT_SENT, ///< Ă܂AREPĂȂ
+    SLOT_ANSWERED ///< AREP
+} bench_slot_state;
+
+/**
+ * @brief AREQ
+ *
+ * ʂԍ%XbgňBRpNgȌ`ƕ̌`͒ʂԍtxidɂB
+ * ]̌`txid^ׂȂ̂ŁAՓ˂ȂAhX̉32rbgɒʂԍB
+ */
+typedef struct _bench_slot {
+    int64_t sent_ns; ///< [imb]
+    uint32_t seq; ///< ʂԍ
+    uint32_t expected; ///< dƕԂĂ͂̌̃rbg
+    int8_t collide; ///< ]̌`ŏՓ˂AhX̔ԍBȂ-1
+    uint8_t state; ///< bench_slot_state
+} bench_slot;
+
+/**
+ * @brief R}hC̃p[^
+ */
+typedef struct _bench_parameters {
+    struct sockaddr_in6 target; ///< stamd̃AhX
+    double rate; ///< 1bAREQ̐B0Ȃ҂ɑ
+    unsigned long count; ///< AREQ̐
+    int wait_ms; ///< AREP҂[~b]
+    double collide_ratio; ///< ̂-c̃AhXɂ銄
+    struct in6_addr collide[BENCH_COLLIDE_MAX]; ///< stamdĂ͂̃AhX
+    int ncollide;
+    bench_format format;
+    int candidates; ///< ̌`1pPbǧ̐
+    int negative_only; ///< 1Ȃd̂ƂAREPԂĂ炤
+    pid_t target_pid; ///< CPUԂ𑪂stamd̃vZXB0Ȃ瑪Ȃ
+} bench_parameters;
+
+/**
+ * @brief 
+ */
+typedef struct _bench_stats {
+    unsigned long sent; ///< AREQ
+    unsigned long send_errors; ///< sendtoɎsAREQ
+    unsigned long answered; ///< ҂Ԃ̂AREPAREQ
+    unsigned long lost; ///< ԓ͂Ȃ̂ɁA҂Ԃ̂AREPȂAREQ
+    unsigned long silent; ///< d̂Ƃԓ郂[hŁAԓȂAREQ
+    unsigned long late; ///< ҂Ԃ߂Ă痈AREP
+    unsigned long extra; ///< AREQւ2߈ȍ~AREP
+    unsigned long unknown; ///< ĂȂAREQւAREPAǂ߂ȂpPbg
+    unsigned long false_duplicate; ///< dƕԂĂAdĂȂ͂̌
+    unsigned long missed_duplicate; ///< dȂƕԂĂAdĂ͂̌
+} bench_stats;
+
+bench_parameters parameters;
+
+static int bench_expects_reply(const bench_slot *s);
+static void bench_fill_address(struct in6_addr *addr, uint32_t seq, int *collide);
+static void bench_handle_reply(uint32_t seq, uint32_t duplicate, int64_t now);
+static int64_t bench_now(void);
+static void *bench_receiver(void *arg);
+static void bench_report(double elapsed);
+static int bench_send(int fd, uint32_t seq);
+static bench_slot *bench_slot_of(uint32_t seq);
+static void bench_sweep(int64_t now);
+static int bench_take_collide(int idx, uint32_t *seq);
+static int compare_latency(const void *a, const void *b);
+static int parse_target(const char *host, int port, struct sockaddr_in6 *target);
+static long read_cpu_ticks(pid_t pid);
+static void usage();
+
+#endif
@@ -0,0 +1,401 @@
+/**
+ * @file batch.c
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief STÄꊇݒ
+ *
+ * t@CW͂ǂ񂾑ʂadd/del1{netlink\PbgŗށB
+ * ioctlł1ƂɃ\PbgC^[tF[XƂɂȂ̂ŁA
+ * rtnetlinkRTM_NEWADDR/RTM_DELADDRBATCH_WINDOW܂Ƃ߂1sendőA
+ * Ƃ܂Ƃ߂ACKǂށBACK̃V[PXԍłǂ̃R[ȟʂ킩B
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "batch.h"
+
+#define BATCH_MSG_SIZE 128 ///< 1bZ[W̑傫̏
+#define BATCH_RECV_BUF_SIZE 65536
+#define BATCH_LINE_SIZE 512
+
+/**
+ * @brief ACK܂ǂłȂbZ[W
+ */
+typedef struct _batch_inflight {
+    uint32_t seq; ///< netlink̃V[PXԍB󂫂0
+    unsigned long recno; ///< R[hԍ(1)
+    int op; ///< batch_op
+    struct in6_addr addr; ///< ΏۂSTA
+} batch_inflight;
+
+/**
+ * @brief C^[tF[Xԍ̃LbV
+ */
+typedef struct _batch_ifcache {
+    char name[IF_NAMESIZE];
+    unsigned int index;
+} batch_ifcache;
+
+/**
+ * @brief ꊇݒ̏
+ */
+typedef struct _batch_state {
+    int fd; ///< netlink\Pbg
+    char buf[BATCH_WINDOW * BATCH_MSG_SIZE]; ///< M҂̃bZ[W
+    size_t used;
+    int inflight; ///< ACK҂̐
+    uint32_t sent; ///< bZ[W̐BV[PXԍɎg
+    batch_inflight slots[BATCH_WINDOW]; ///< V[PXԍ%BATCH_WINDOWňBR[hԍ͑ȂŝŎgȂ
+    unsigned long ok;
+    unsigned long failed;
+    batch_ifcache ifcache[BATCH_IFCACHE];
+    int nif;
+} batch_state;
+
+/**
+ * @brief R[h̎s񍐂
+ *
+ * @param st 
+ * @param recno R[hԍ
+ * @param op batch_opA킩Ȃ-1
+ * @param addr ΏۂSTAA킩ȂNULL
+ * @param reason R
+ */
+static void batch_report(batch_state *st, unsigned long recno, int op, const struct in6_addr *addr, const char *reason) {
+    char host[INET6_ADDRSTRLEN];
+
+    st->failed++;
+    if (addr != NULL && inet_ntop(AF_INET6, addr, host, sizeof(host)) != NULL) {
+        fprintf(stderr, "record %lu (%s %s): %s\n", recno, (op == BATCH_DEL) ? "del" : "add", host, reason);
+    } else {
+        fprintf(stderr, "record %lu: %s\n", recno, reason);
+    }
+}
+
+/**
+ * @brief C^[tF[Xԍ
+ *
+ * C^[tF[XƂقƂǂȂ̂ŁAʂoĂB
+ * @param st 
+ * @param name C^[tF[X
+ * @return C^[tF[XԍBȂ0
+ */
+static unsigned int batch_ifindex(batch_state *st, const char *name) {
+    int i;
+    unsigned int index;
+
+    for (i = 0; i < st->nif; i++) {
+        if (strncmp(st->ifcache[i].name, name, IF_NAMESIZE) == 0) {
+            return st->ifcache[i].index;
+        }
+    }
+    index = if_nametoindex(name);
+    if (index != 0) {
+        i = (st->nif < BATCH_IFCACHE) ? st->nif++ : 0;
+        strncpy(st->ifcache[i].name, name, IF_NAMESIZE - 1);
+        st->ifcache[i].name[IF_NAMESIZE - 1] = '\0';
+        st->ifcache[i].index = index;
+    }
+    return index;
+}
+
+/**
+ * @brief netlinkACKSǂ
+ *
+ * bZ[WACK낤܂œǂ݁Aŝ񍐂B
+ * @param st 
+ * @retval 0 
+ * @retval -1 \Pbg̃G[
+ */
+static int batch_collect(batch_state *st) {
+    char buf[BATCH_RECV_BUF_SIZE];
+    struct nlmsghdr *nh;
+    struct nlmsgerr *err;
+    batch_inflight *slot;
+    ssize_t len;
+
+    while (st->inflight > 0) {
+        len = recv(st->fd, buf, sizeof(buf), 0);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "[batch_collect] recv error: %m\n");
+            return -1;
+        }
+        for (nh = (struct nlmsghdr *)buf; NLMSG_OK(nh, (size_t)len); nh = NLMSG_NEXT(nh, len)) {
+            if (nh->nlmsg_type != NLMSG_ERROR) {
+                continue;
+            }
+            err = (struct nlmsgerr *)NLMSG_DATA(nh);
+            slot = &(st->slots[nh->nlmsg_seq % BATCH_WINDOW]);
+            if (slot->seq == 0 || slot->seq != nh->nlmsg_seq) {
+                continue; // mȂACK
+            }
+            if (err->error == 0) {
+                st->ok++;
+            } else {
+                batch_report(st, slot->recno, slot->op, &(slot->addr), strerror(-err->error));
+            }
+            slot->seq = 0;
+            st->inflight--;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief ܂bZ[W𑗂ACKǂ
+ *
+ * @param st 
+ * @retval 0 
+ * @retval -1 \Pbg̃G[
+ */
+static int batch_flush(batch_state *st) {
+    if (st->used == 0) {
+        return 0;
+    }
+    if (send(st->fd, st->buf, st->used, 0) < 0) {
+        fprintf(stderr, "[batch_flush] send error: %m\n");
+        return -1;
+    }
+    st->used = 0;
+    return batch_collect(st);
+}
+
+/**
+ * @brief netlink̑𑫂
+ *
+ * @param nh ̃bZ[W
+ * @param type ̎
+ * @param data ̒g
+ * @param len g̒
+ */
+static void batch_add_attr(struct nlmsghdr *nh, int type, const void *data, size_t len) {
+    struct rtattr *rta = (struct rtattr *)((char *)nh + NLMSG_ALIGN(nh->nlmsg_len));
+
+    rta->rta_type = type;
+    rta->rta_len = RTA_LENGTH(len);
+    memcpy(RTA_DATA(rta), data, len);
+    nh->nlmsg_len = NLMSG_ALIGN(nh->nlmsg_len) + RTA_ALIGN(rta->rta_len);
+}
+
+/**
+ * @brief 1R[h̃bZ[Wς
+ *
+ * tɂȂ瑗ACKǂށB
+ * @param st 
+ * @param recno R[hԍ
+ * @param rec R[h
+ * @param encoder R[hSTA֐
+ * @retval 0 (R[h̎s͕񍐍ς)
+ * @retval -1 \Pbg̃G[
+ */
+static int batch_queue(batch_state *st, unsigned long recno, const batch_record *rec, batch_encoder encoder) {
+    struct nlmsghdr *nh;
+    struct ifaddrmsg *ifa;
+    struct in6_addr addr;
+    char ifname[IF_NAMESIZE];
+    unsigned int index;
+    batch_inflight *slot;
+
+    if (rec->op != BATCH_ADD && rec->op != BATCH_DEL) {
+        batch_report(st, recno, -1, NULL, "invalid operation");
+        return 0;
+    }
+    // -bœǂ񂾃R[h̃C^[tF[X͏I[ĂƂ͌Ȃ
+    strncpy(ifname, rec->ifname, sizeof(ifname) - 1);
+    ifname[sizeof(ifname) - 1] = '\0';
+    if ((index = batch_ifindex(st, ifname)) == 0) {
+        batch_report(st, recno, rec->op, NULL, "no such interface");
+        return 0;
+    }
+    if ((*encoder)(rec, &addr) == -1) {
+        batch_report(st, recno, rec->op, NULL, "encode_to_sta error");
+        return 0;
+    }
+
+    nh = (struct nlmsghdr *)(st->buf + st->used);
+    memset(nh, 0, BATCH_MSG_SIZE);
+    nh->nlmsg_len = NLMSG_LENGTH(sizeof(struct ifaddrmsg));
+    nh->nlmsg_type = (rec->op == BATCH_ADD) ? RTM_NEWADDR : RTM_DELADDR;
+    nh->nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
+    if (rec->op == BATCH_ADD) {
+        nh->nlmsg_flags |= NLM_F_CREATE | NLM_F_REPLACE;
+    }
+    if (++st->sent == 0) {
+        st->sent = 1; // 0͋󂫂̈
+    }
+    nh->nlmsg_seq = st->sent;
+
+    ifa = (struct ifaddrmsg *)NLMSG_DATA(nh);
+    ifa->ifa_family = AF_INET6;
+    ifa->ifa_prefixlen = BATCH_PREFIXLEN;
+    ifa->ifa_index = index;
+    batch_add_attr(nh, IFA_LOCAL, &addr, sizeof(addr));
+    batch_add_attr(nh, IFA_ADDRESS, &addr, sizeof(addr));
+    st->used += NLMSG_ALIGN(nh->nlmsg_len);
+
+    slot = &(st->slots[st->sent % BATCH_WINDOW]);
+    slot->seq = st->sent;
+    slot->recno = recno;
+    slot->op = rec->op;
+    slot->addr = addr;
+    st->inflight++;
+
+    if (st->inflight >= BATCH_WINDOW) {
+        return batch_flush(st);
+    }
+    return 0;
+}
+
+/**
+ * @brief eLXg`1sR[hɂ
+ *
+ * uinterface lat lon alt time opv󔒂J}ŋ؂BopadddelB
+ * @param line 1s
+ * @param[out] rec R[h
+ * @retval 1 R[hɂ
+ * @retval 0 sRg
+ * @retval -1 
+ */
+static int batch_parse_line(char *line, batch_record *rec) {
+    const char *delim = " \t,\r\n";
+    char *field[6];
+    char *save = NULL;
+    char *end;
+    int n = 0;
+    char *p;
+
+    if ((p = strchr(line, '#')) != NULL) {
+        *p = '\0';
+    }
+    for (p = strtok_r(line, delim, &save); p != NULL && n < 6; p = strtok_r(NULL, delim, &save)) {
+        field[n++] = p;
+    }
+    if (n == 0) {
+        return 0;
+    }
+    if (n != 6 || p != NULL) {
+        return -1;
+    }
+
+    memset(rec, 0, sizeof(*rec));
+    if (strlen(field[0]) >= sizeof(rec->ifname)) {
+        return -1;
+    }
+    strcpy(rec->ifname, field[0]);
+    rec->lat = strtod(field[1], &end);
+    if (*end != '\0') {
+        return -1;
+    }
+    rec->lng = strtod(field[2], &end);
+    if (*end != '\0') {
+        return -1;
+    }
+    rec->alt = strtod(field[3], &end);
+    if (*end != '\0') {
+        return -1;
+    }
+    rec->time = strtoll(field[4], &end, 10);
+    if (*end != '\0') {
+        return -1;
+    }
+    if (strcmp(field[5], "add") == 0) {
+        rec->op = BATCH_ADD;
+    } else if (strcmp(field[5], "del") == 0) {
+        rec->op = BATCH_DEL;
+    } else {
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ * @brief ꊇݒs
+ *
+ * fp1R[hǂŐς݁AŌɎc𑗂B
+ * sR[h̓R[hԍ(eLXgȂsԍ)ŕWG[ɏoB
+ * @param fp 
+ * @param binary 1Ȃbatch_record̕сA0ȂeLXg
+ * @param encoder R[hSTA֐
+ * @retval 0 S
+ * @retval 1 sR[h
+ * @retval -1 netlinkgȂ
+ */
+int batch_run(FILE *fp, int binary, batch_encoder encoder) {
+    batch_state *st;
+    struct sockaddr_nl snl;
+    batch_record rec;
+    char line[BATCH_LINE_SIZE];
+    unsigned long recno = 0;
+    int bufsize = 1024 * 1024;
+    int ret;
+
+    st = (batch_state *)calloc(1, sizeof(batch_state));
+    if (st == NULL) {
+        fprintf(stderr, "[batch_run] calloc error\n");
+        return -1;
+    }
+
+    st->fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+    if (st->fd < 0) {
+        fprintf(stderr, "[batch_run] socket error: %m\n");
+        free(st);
+        return -1;
+    }
+    setsockopt(st->fd, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+    memset(&snl, 0, sizeof(snl));
+    snl.nl_family = AF_NETLINK;
+    if (bind(st->fd, (struct sockaddr *)&snl, sizeof(snl)) == -1) {
+        fprintf(stderr, "[batch_run] bind error: %m\n");
+        close(st->fd);
+        free(st);
+        return -1;
+    }
+
+    ret = 0;
+    for (;;) {
+        if (binary) {
+            if (fread(&rec, sizeof(rec), 1, fp) != 1) {
+                break;
+            }
+            recno++;
+        } else {
+            if (fgets(line, sizeof(line), fp) == NULL) {
+                break;
+            }
+            recno++;
+            ret = batch_parse_line(line, &rec);
+            if (ret == 0) {
+                continue;
+            } else if (ret == -1) {
+                batch_report(st, recno, -1, NULL, "parse error");
+                ret = 0;
+                continue;
+            }
+        }
+        if ((ret = batch_queue(st, recno, &rec, encoder)) == -1) {
+            break;
+        }
+    }
+    if (ret == 0) {
+        ret = batch_flush(st);
+    }
+
+    fprintf(stderr, "%lu ok, %lu failed\n", st->ok, st->failed);
+    if (ret == 0 && st->failed > 0) {
+        ret = 1;
+    }
+    close(st->fd);
+    free(st);
+    return ret;
+}
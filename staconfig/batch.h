@@ -0,0 +1,56 @@
+/**
+ * @file batch.h
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief STÄꊇݒ
+ *
+ * t@CW͂ǂ񂾑ʂadd/del1{netlink\Pbgŗ
+ */
+
+#ifndef _BATCH_H
+#define _BATCH_H
+
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define BATCH_WINDOW 64 ///< ԓ҂ɑ郁bZ[W̐
+#define BATCH_IFCACHE 16 ///< C^[tF[Xԍ̃LbV̐
+#define BATCH_PREFIXLEN 0 ///< ioctlładd_staƓvtBbNX
+
+/**
+ * @brief ̎
+ */
+typedef enum _batch_op {
+    BATCH_ADD = 0,
+    BATCH_DEL = 1
+} batch_op;
+
+/**
+ * @brief oCi`1R[h
+ *
+ * zXgoCgI[_[64oCgŒB
+ */
+typedef struct _batch_record {
+    char ifname[16]; ///< C^[tF[X
+    double lat; ///< latitude
+    double lng; ///< longitude
+    double alt; ///< altitude
+    int64_t time; ///< time
+    uint8_t op; ///< batch_op
+    uint8_t reserved[7];
+} batch_record;
+
+/**
+ * @brief R[hSTA֐̌^
+ *
+ * @param rec R[h
+ * @param[out] addr STA
+ * @retval 0 
+ * @retval -1 s
+ */
+typedef int (*batch_encoder)(const batch_record *rec, struct in6_addr *addr);
+
+int batch_run(FILE *fp, int binary, batch_encoder encoder);
+
+#endif
@@ -0,0 +1,688 @@
+/**
+ * @file codec.c
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief ԏSTÄꊇϊ
+ *
+ * staconfig encode/decode̖{́B
+ * ͂ʂ̃t@CȂmmapApCvȂ傫ȃobt@ɓǂݍށB
+ * ͂CODEC_CHUNKƂɃR[h̋ڂŐ؂ăXbhɔzA
+ * ʂ͓͂̏Ԃ̂܂܏oB
+ * 1R[hƂmalloclocaltimeAprintf͂ȂB
+ */
+
+#define _GNU_SOURCE // memrchr
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "codec.h"
+
+#define CODEC_OUT_MAX 128 ///< 1R[h̏o͂̍ő咷B64bit̒l4ƃAhX傫
+
+/**
+ * @brief 1Xbh̎d
+ */
+typedef struct _codec_job {
+    const char *in; ///< 
+    size_t inlen;
+    char *out; ///< óBȂȂL΂
+    size_t outlen;
+    size_t outmax;
+    unsigned long errors; ///< ϊłȂR[h̐
+    int nomem; ///< o͂L΂Ȃ
+    codec_tzcache tz;
+    const sta_layout *layout;
+    int dir;
+    int in_binary;
+    int out_binary;
+} codec_job;
+
+/**
+ * @brief ̓0̕b߂
+ *
+ * @param tz LbV
+ * @param t 
+ * @return ̓0̕b(n)
+ */
+static int codec_time_of_day(codec_tzcache *tz, time_t t) {
+    struct tm tm;
+
+    if (tz->base == (time_t)-1 || t < tz->base || t >= tz->base + 3600) {
+        tz->base = t - (((t % 3600) + 3600) % 3600);
+        memset(&tm, 0, sizeof(tm));
+        localtime_r(&(tz->base), &tm);
+        tz->tod = tm.tm_hour * 60 * 60 + tm.tm_min * 60 + tm.tm_sec;
+    }
+    return (tz->tod + (int)(t - tz->base)) % 86400;
+}
+
+/**
+ * @brief ԏ񂩂STAɕϊ
+ *
+ * staconfigencode_to_staƓϊŁAmallocƃOo͂Ȃ́B
+ * gݍ݂̔zuȂsta_layout̐p̃GR[_gB
+ * @param layout STÃrbgzu
+ * @param p ƈʒu
+ * @param tz localtimẽLbV
+ * @param[out] addr ϊSTA
+ * @retval 0 
+ * @retval -1 ͈͊O
+ */
+int codec_encode_sta(const sta_layout *layout, const codec_point *p, codec_tzcache *tz, struct in6_addr *addr) {
+    sta_coord c;
+
+    if (!(p->lat <= 90.0 && p->lat >= -90.0) || !(p->lng <= 180.0 && p->lng >= -180.0)
+        || !(p->alt < 1.0e9 && p->alt > -1.0e9)) {
+        return -1;
+    }
+
+    c.lon = p->lng;
+    c.lat = p->lat;
+    c.alt = p->alt;
+    c.tod = codec_time_of_day(tz, (time_t)p->time);
+    return sta_encode(layout, &c, addr);
+}
+
+/**
+ * @brief 10^-decimalsPʂ̒lɂ
+ */
+static double codec_fixed_value(const sta_fixed *f, sta_kind kind) {
+    double d = (double)f->v[kind];
+    int i;
+
+    for (i = 0; i < f->decimals[kind]; i++) {
+        d /= 10.0;
+    }
+    return d;
+}
+
+/**
+ * @brief STA玞ԏɕϊ
+ *
+ * x͔zũrbgŌ܂Btime͂̓0̕bɂȂB
+ * zuɂȂl0ɂȂB
+ * @param layout STÃrbgzu
+ * @param addr STA
+ * @param[out] p ƈʒu
+ * @retval 0 
+ * @retval -1 STAł͂Ȃ
+ */
+int codec_decode_sta(const sta_layout *layout, const struct in6_addr *addr, codec_point *p) {
+    sta_fixed f;
+
+    if (sta_decode_fixed(layout, addr, &f) == -1) {
+        return -1;
+    }
+    p->lat = codec_fixed_value(&f, STA_LAT);
+    p->lng = codec_fixed_value(&f, STA_LON);
+    p->alt = codec_fixed_value(&f, STA_ALT);
+    p->time = (int64_t)codec_fixed_value(&f, STA_TIME);
+    return 0;
+}
+
+/**
+ * @brief Ȃ10iŏ
+ *
+ * @param p ݐ
+ * @param v l
+ * @return ̈ʒu
+ */
+static char *codec_put_uint(char *p, uint64_t v) {
+    char tmp[20];
+    int n = 0;
+
+    do {
+        tmp[n++] = '0' + (v % 10);
+        v /= 10;
+    } while (v != 0);
+    while (n > 0) {
+        *p++ = tmp[--n];
+    }
+    return p;
+}
+
+/**
+ * @brief 10^-decimalsPʂ̒l_ȉdecimalsŏ
+ *
+ * decimals0Ȃ琮ƂďB
+ */
+static char *codec_put_fixed(char *p, int64_t v, int decimals) {
+    uint64_t u;
+    uint64_t scale = 1;
+    uint64_t frac;
+    int i;
+
+    if (v < 0) {
+        *p++ = '-';
+        u = (uint64_t)0 - (uint64_t)v;
+    } else {
+        u = (uint64_t)v;
+    }
+    if (decimals == 0) {
+        return codec_put_uint(p, u);
+    }
+    for (i = 0; i < decimals; i++) {
+        scale *= 10;
+    }
+    p = codec_put_uint(p, u / scale);
+    *p++ = '.';
+    frac = u % scale;
+    for (i = decimals - 1; i >= 0; i--) {
+        p[i] = '0' + (frac % 10);
+        frac /= 10;
+    }
+    return p + decimals;
+}
+
+/**
+ * @brief IPv6AhXinet_ntopƓŏ
+ *
+ * 2ȏ㑱0̃O[v̂ł̂::ɂB
+ * @param p ݐ(40oCgȏ)
+ * @param addr AhX
+ * @return ̈ʒu
+ */
+static char *codec_put_addr(char *p, const struct in6_addr *addr) {
+    static const char hex[] = "0123456789abcdef";
+    uint16_t w[8];
+    int best = -1, bestlen = 0;
+    int cur = -1, curlen = 0;
+    int i, shift, started;
+
+    for (i = 0; i < 8; i++) {
+        w[i] = ntohs(addr->s6_addr16[i]);
+        if (w[i] == 0) {
+            if (cur == -1) {
+                cur = i;
+                curlen = 0;
+            }
+            curlen++;
+            if (curlen > bestlen) {
+                best = cur;
+                bestlen = curlen;
+            }
+        } else {
+            cur = -1;
+        }
+    }
+    if (bestlen < 2) {
+        best = -1;
+    }
+
+    for (i = 0; i < 8; i++) {
+        if (i == best) {
+            *p++ = ':';
+            *p++ = ':';
+            i += bestlen - 1;
+            continue;
+        }
+        if (i != 0 && i != best + bestlen) {
+            *p++ = ':';
+        }
+        started = 0;
+        for (shift = 12; shift >= 0; shift -= 4) {
+            if (started || ((w[i] >> shift) & 0xf) != 0 || shift == 0) {
+                *p++ = hex[(w[i] >> shift) & 0xf];
+                started = 1;
+            }
+        }
+    }
+    return p;
+}
+
+/**
+ * @brief eLXg`̎ԏǂ
+ *
+ * ulat lon alt timev󔒂J}ŋ؂BtimeUNIX(b)B
+ * @param line NULI[1s
+ * @param[out] pt ǂ񂾒l
+ * @retval 0 
+ * @retval -1 
+ */
+static int codec_parse_point(char *line, codec_point *pt) {
+    char *p = line;
+    char *end;
+    double v[3];
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        v[i] = strtod(p, &end);
+        if (end == p || (*end != ',' && *end != ' ' && *end != '\t')) {
+            return -1;
+        }
+        p = end;
+        while (*p == ',' || *p == ' ' || *p == '\t') {
+            p++;
+        }
+    }
+    pt->lat = v[0];
+    pt->lng = v[1];
+    pt->alt = v[2];
+    pt->time = strtoll(p, &end, 10);
+    if (end == p) {
+        return -1;
+    }
+    while (*end == ' ' || *end == '\t') {
+        end++;
+    }
+    return (*end == '\0') ? 0 : -1;
+}
+
+/**
+ * @brief o͂̋󂫂mۂ
+ *
+ * @param job d
+ * @retval 0 
+ * @retval -1 Ȃ
+ */
+static int codec_reserve(codec_job *job) {
+    char *p;
+    size_t n;
+
+    if (job->outlen + CODEC_OUT_MAX <= job->outmax) {
+        return 0;
+    }
+    n = (job->outmax == 0) ? CODEC_CHUNK : job->outmax * 2;
+    p = (char *)realloc(job->out, n);
+    if (p == NULL) {
+        job->nomem = 1;
+        return -1;
+    }
+    job->out = p;
+    job->outmax = n;
+    return 0;
+}
+
+/**
+ * @brief 1R[hϊďo͂ɑ
+ *
+ * @param job d
+ * @param pt GR[hȂ́AfR[hȂNULL
+ * @param addr fR[hȂ́AGR[hȂNULL
+ */
+static void codec_emit(codec_job *job, const codec_point *pt, const struct in6_addr *addr) {
+    struct in6_addr sta;
+    sta_fixed f;
+    codec_point out;
+    char *p;
+
+    if (codec_reserve(job) == -1) {
+        return;
+    }
+    p = job->out + job->outlen;
+
+    if (job->dir == CODEC_ENCODE) {
+        if (codec_encode_sta(job->layout, pt, &(job->tz), &sta) == -1) {
+            job->errors++;
+            return;
+        }
+        if (job->out_binary) {
+            memcpy(p, &sta, sizeof(sta));
+            p += sizeof(sta);
+        } else {
+            p = codec_put_addr(p, &sta);
+            *p++ = '\n';
+        }
+    } else {
+        if (sta_decode_fixed(job->layout, addr, &f) == -1) {
+            job->errors++;
+            return;
+        }
+        if (job->out_binary) {
+            out.lat = codec_fixed_value(&f, STA_LAT);
+            out.lng = codec_fixed_value(&f, STA_LON);
+            out.alt = codec_fixed_value(&f, STA_ALT);
+            out.time = (int64_t)codec_fixed_value(&f, STA_TIME);
+            memcpy(p, &out, sizeof(out));
+            p += sizeof(out);
+        } else {
+            p = codec_put_fixed(p, f.v[STA_LAT], f.decimals[STA_LAT]);
+            *p++ = ',';
+            p = codec_put_fixed(p, f.v[STA_LON], f.decimals[STA_LON]);
+            *p++ = ',';
+            p = codec_put_fixed(p, f.v[STA_ALT], f.decimals[STA_ALT]);
+            *p++ = ',';
+            p = codec_put_fixed(p, f.v[STA_TIME], f.decimals[STA_TIME]);
+            *p++ = '\n';
+        }
+    }
+    job->outlen = p - job->out;
+}
+
+/**
+ * @brief eLXg`1sϊ
+ *
+ * s#Ŏn܂s͓ǂݔ΂BfR[hł͍s̃AhXB
+ * @param job d
+ * @param s s
+ * @param len s̒(s܂܂Ȃ)
+ */
+static void codec_text_line(codec_job *job, const char *s, size_t len) {
+    char line[CODEC_LINE_SIZE];
+    codec_point pt;
+    struct in6_addr addr;
+    size_t n;
+
+    if (len > 0 && s[len - 1] == '\r') {
+        len--;
+    }
+    if (len == 0 || s[0] == '#') {
+        return;
+    }
+    if (len >= sizeof(line)) {
+        job->errors++;
+        return;
+    }
+    memcpy(line, s, len);
+    line[len] = '\0';
+
+    if (job->dir == CODEC_ENCODE) {
+        if (codec_parse_point(line, &pt) == -1) {
+            job->errors++;
+            return;
+        }
+        codec_emit(job, &pt, NULL);
+    } else {
+        n = strcspn(line, ", \t");
+        line[n] = '\0';
+        if (inet_pton(AF_INET6, line, &addr) != 1) {
+            job->errors++;
+            return;
+        }
+        codec_emit(job, NULL, &addr);
+    }
+}
+
+/**
+ * @brief 1Xbh̓͂ϊ
+ *
+ * @param arg codec_job
+ * @return NULLԂ
+ */
+static void *codec_worker(void *arg) {
+    codec_job *job = (codec_job *)arg;
+    const char *p = job->in;
+    const char *end = job->in + job->inlen;
+    const char *nl;
+    codec_point pt;
+    struct in6_addr addr;
+    size_t recsize;
+
+    job->outlen = 0;
+    job->errors = 0;
+
+    if (job->in_binary) {
+        recsize = (job->dir == CODEC_ENCODE) ? sizeof(codec_point) : sizeof(struct in6_addr);
+        for (; p + recsize <= end && !job->nomem; p += recsize) {
+            if (job->dir == CODEC_ENCODE) {
+                memcpy(&pt, p, sizeof(pt));
+                codec_emit(job, &pt, NULL);
+            } else {
+                memcpy(&addr, p, sizeof(addr));
+                codec_emit(job, NULL, &addr);
+            }
+        }
+        if (p != end) {
+            job->errors++; // ̔[ȃR[h
+        }
+    } else {
+        while (p < end && !job->nomem) {
+            nl = (const char *)memchr(p, '\n', end - p);
+            if (nl == NULL) {
+                nl = end;
+            }
+            codec_text_line(job, p, nl - p);
+            p = nl + 1;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief ͂R[h̋ڂŐ؂
+ *
+ * @param data 
+ * @param len ͂̒
+ * @param want ؂肽傫
+ * @param recsize oCiȂ烌R[h̑傫AeLXgȂ0
+ * @param eof ɓ͂ȂȂ1
+ * @return ؂B1R[hĂȂ0
+ */
+static size_t codec_cut(const char *data, size_t len, size_t want, size_t recsize, int eof) {
+    const char *nl;
+
+    if (recsize != 0) {
+        if (len <= want && eof) {
+            return len;
+        }
+        return ((len < want) ? len : want) / recsize * recsize;
+    }
+    if (len <= want) {
+        if (eof) {
+            return len;
+        }
+        nl = (const char *)memrchr(data, '\n', len);
+        return (nl == NULL) ? 0 : (size_t)(nl - data) + 1;
+    }
+    nl = (const char *)memrchr(data, '\n', want);
+    if (nl == NULL) {
+        nl = (const char *)memchr(data + want, '\n', len - want);
+    }
+    if (nl == NULL) {
+        return eof ? len : 0;
+    }
+    return (size_t)(nl - data) + 1;
+}
+
+/**
+ * @brief S
+ *
+ * @retval 0 
+ * @retval -1 s
+ */
+static int codec_write_all(int fd, const char *buf, size_t len) {
+    ssize_t n;
+
+    while (len > 0) {
+        n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/**
+ * @brief ͂őnthreadsɐ؂ĕϊAԂɏo
+ *
+ * @param jobs XbhƂ̎d
+ * @param nthreads Xbh
+ * @param out_fd o͐
+ * @param data 
+ * @param len ͂̒
+ * @param eof ɓ͂ȂȂ1
+ * @param[out] consumed ῗ̒
+ * @retval 0 
+ * @retval -1 ȂA܂̓Ȃ
+ */
+static int codec_round(codec_job *jobs, int nthreads, int out_fd, const char *data, size_t len, int eof, size_t *consumed) {
+    pthread_t tid[CODEC_MAX_THREADS];
+    int started[CODEC_MAX_THREADS];
+    size_t recsize = 0;
+    size_t off = 0;
+    size_t n;
+    int njobs = 0;
+    int i;
+
+    if (jobs[0].in_binary) {
+        recsize = (jobs[0].dir == CODEC_ENCODE) ? sizeof(codec_point) : sizeof(struct in6_addr);
+    }
+    while (njobs < nthreads && off < len) {
+        n = codec_cut(data + off, len - off, CODEC_CHUNK, recsize, eof);
+        if (n == 0) {
+            break;
+        }
+        jobs[njobs].in = data + off;
+        jobs[njobs].inlen = n;
+        njobs++;
+        off += n;
+    }
+    *consumed = off;
+
+    if (njobs == 1) {
+        codec_worker(&jobs[0]);
+    } else {
+        for (i = 0; i < njobs; i++) {
+            started[i] = (pthread_create(&tid[i], NULL, codec_worker, &jobs[i]) == 0);
+            if (!started[i]) {
+                codec_worker(&jobs[i]);
+            }
+        }
+        for (i = 0; i < njobs; i++) {
+            if (started[i]) {
+                pthread_join(tid[i], NULL);
+            }
+        }
+    }
+
+    for (i = 0; i < njobs; i++) {
+        if (jobs[i].nomem) {
+            fprintf(stderr, "[codec_round] out of memory\n");
+            return -1;
+        }
+        if (codec_write_all(out_fd, jobs[i].out, jobs[i].outlen) == -1) {
+            fprintf(stderr, "[codec_round] write error: %m\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief ͑Ŝϊ
+ *
+ * in_fdʂ̃t@CȂmmapāAłȂnthreads*CODEC_CHUNKǂŕϊB
+ * ϊłȂR[h͏o͂AŌɂ̐WG[ɏoB
+ * @param layout STÃrbgzu
+ * @param in_fd 
+ * @param out_fd o
+ * @param dir codec_dir
+ * @param in_binary ͂oCiȂ1
+ * @param out_binary o͂oCiȂ1
+ * @param nthreads Xbh
+ * @retval 0 Sϊ
+ * @retval 1 ϊłȂR[h
+ * @retval -1 o͂̃G[
+ */
+int codec_run(const sta_layout *layout, int in_fd, int out_fd, int dir, int in_binary, int out_binary, int nthreads) {
+    codec_job jobs[CODEC_MAX_THREADS];
+    struct stat sb;
+    char *map = NULL;
+    char *buf = NULL;
+    size_t size = 0;
+    size_t have = 0;
+    size_t off;
+    size_t used;
+    ssize_t n;
+    unsigned long errors = 0;
+    int eof = 0;
+    int ret = 0;
+    int i;
+
+    if (nthreads < 1) {
+        nthreads = 1;
+    } else if (nthreads > CODEC_MAX_THREADS) {
+        nthreads = CODEC_MAX_THREADS;
+    }
+    tzset();
+    memset(jobs, 0, sizeof(jobs));
+    for (i = 0; i < nthreads; i++) {
+        jobs[i].layout = layout;
+        jobs[i].dir = dir;
+        jobs[i].in_binary = in_binary;
+        jobs[i].out_binary = out_binary;
+        jobs[i].tz.base = (time_t)-1;
+    }
+
+    if (fstat(in_fd, &sb) == 0 && S_ISREG(sb.st_mode) && sb.st_size > 0) {
+        size = sb.st_size;
+        map = (char *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, in_fd, 0);
+        if (map == MAP_FAILED) {
+            map = NULL;
+        }
+    }
+
+    if (map != NULL) {
+        madvise(map, size, MADV_SEQUENTIAL);
+        for (off = 0; off < size && ret == 0; off += used) {
+            ret = codec_round(jobs, nthreads, out_fd, map + off, size - off, 1, &used);
+            for (i = 0; i < nthreads; i++) {
+                errors += jobs[i].errors;
+                jobs[i].errors = 0;
+            }
+        }
+        munmap(map, size);
+    } else {
+        size = (size_t)nthreads * CODEC_CHUNK;
+        buf = (char *)malloc(size);
+        if (buf == NULL) {
+            fprintf(stderr, "[codec_run] malloc error\n");
+            return -1;
+        }
+        while (ret == 0) {
+            while (have < size && !eof) {
+                n = read(in_fd, buf + have, size - have);
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    fprintf(stderr, "[codec_run] read error: %m\n");
+                    ret = -1;
+                    break;
+                } else if (n == 0) {
+                    eof = 1;
+                } else {
+                    have += n;
+                }
+            }
+            if (ret != 0 || (eof && have == 0)) {
+                break;
+            }
+            ret = codec_round(jobs, nthreads, out_fd, buf, have, eof, &used);
+            if (ret == 0 && used == 0) {
+                // obt@蒷sB؂ڂȂ̂ł̂܂ܓn
+                ret = codec_round(jobs, nthreads, out_fd, buf, have, 1, &used);
+            }
+            for (i = 0; i < nthreads; i++) {
+                errors += jobs[i].errors;
+                jobs[i].errors = 0;
+            }
+            memmove(buf, buf + used, have - used);
+            have -= used;
+        }
+        free(buf);
+    }
+
+    for (i = 0; i < nthreads; i++) {
+        free(jobs[i].out);
+    }
+    if (errors > 0) {
+        fprintf(stderr, "%lu records skipped\n", errors);
+        if (ret == 0) {
+            ret = 1;
+        }
+    }
+    return ret;
+}
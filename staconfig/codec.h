@@ -0,0 +1,59 @@
+/**
+ * @file codec.h
+ * @author Satoshi OKANO <okano@mcl.iis.u-tokyo.ac.jp>
+ * @brief ԏSTÄꊇϊ
+ *
+ * ʂ̃OW͂Wo͂֗ȂϊtB^
+ */
+
+#ifndef _CODEC_H
+#define _CODEC_H
+
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <time.h>
+#include "../sta_layout.h"
+
+#define CODEC_CHUNK (4 * 1024 * 1024) ///< 1XbhxɎ󂯎͂̑傫
+#define CODEC_MAX_THREADS 64
+#define CODEC_LINE_SIZE 256 ///< eLXg`1s̍ő咷
+
+/**
+ * @brief ϊ̌
+ */
+typedef enum _codec_dir {
+    CODEC_ENCODE = 0, ///< ԏ񂩂STA
+    CODEC_DECODE = 1 ///< STA玞ԏ
+} codec_dir;
+
+/**
+ * @brief oCi`̎ԏ
+ *
+ * zXgoCgI[_[32oCgŒB
+ * fR[h̏o͂ł͓t͂킩Ȃ̂ŁAtime͂̓0̕bɂȂB
+ * oCi`STAstruct in6_addr̂܂16oCgŕׂB
+ */
+typedef struct _codec_point {
+    double lat; ///< latitude
+    double lng; ///< longitude
+    double alt; ///< altitude
+    int64_t time; ///< time
+} codec_point;
+
+/**
+ * @brief localtiměʂ̃LbV
+ *
+ * 1Ԃ̒ł͕ςȂƂāA1ԂƂ1񂾂localtime_rĂԁB
+ * XbhƂɎB
+ */
+typedef struct _codec_tzcache {
+    time_t base; ///< LbVĂ1Ԃ̎n܂BgpȂ-1
+    int tod; ///< base̎̂̓0̕b
+} codec_tzcache;
+
+int codec_encode_sta(const sta_layout *layout, const codec_point *p, codec_tzcache *tz, struct in6_addr *addr);
+int codec_decode_sta(const sta_layout *layout, const struct in6_addr *addr, codec_point *p);
+int codec_run(const sta_layout *layout, int in_fd, int out_fd, int dir, int in_binary, int out_binary, int nthreads);
+
+#endif
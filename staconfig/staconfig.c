@@ -6,8 +6,11 @@
  * 蓮STA̐ݒsR}h
  */
 
+#define _GNU_SOURCE // struct ucred
+
 #include <arpa/inet.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <ifaddrs.h>
 #include <math.h>
 #include <net/if.h>
@@ -18,8 +21,16 @@
 #include <string.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <time.h>
+#include <unistd.h>
 
+#include "../sta_cover.h"
+#include "../sta_alloc.h"
+#include "../sta_ctl.h"
+#include "../sta_layout.h"
+#include "batch.h"
+#include "codec.h"
 #include "staconfig.h"
 
 #ifndef _LINUX_IN6_H
@@ -45,10 +56,9 @@ struct in6_ifreq {
 /**
  * @brief ԏ񂩂STAɕϊ
  *
- * ԏ񂩂STAɕϊB
- * @todo Ƃ̈ѐ͕ۂ悤ɂ邱
+ * ԏ񂩂STAɕϊBrbg̕וparameters.layout(-L)Ō܂A
+ * stamdƓzuw肷邱ƁB
  * @todo vtBbNXƌ߂
- * @todo ̌_߂āAʂ͂B-11000mƂB
  * 
  * @param[in] st ƈʒu
  * @param[out] newsta ϊSTAĕԂ
@@ -57,12 +67,8 @@ struct in6_ifreq {
  * @retval -1 s
  */
 static int encode_to_sta(spatio_temporal st, struct in6_addr *newsta) {
-	int templatitude;
-	int templongitude;
-	int tempaltitude;
-	int temptime;
-	struct tm *tm_temptime;
-	char *temp;
+	sta_coord c;
+	struct tm tm_temptime;
 	
 	if (st.lat > 90.0 || st.lat < -90.0) {
 		fprintf(stderr, "[encode_to_sta] latitude range error");
@@ -73,54 +79,16 @@ static int encode_to_sta(spatio_temporal st, struct in6_addr *newsta) {
 		return -1;
 	}
 	
-	// ܐ1m=4.49*10^(-6)xA_ȉ6܂łƂ
-	templatitude = (int)floor((st.lat + 90.0) * 10.0 * 10.0 * 10.0 * 10.0 * 10.0 * 10.0);
-	// ܓx ő180xAȉ6 180000000 --> 28bit ̂ʂ26bito
-	templatitude &= 0xffffffc;
-	//syslog(LOG_LOCAL0|LOG_DEBUG, "[encode_to_sta] templatitude 28bit = %d", templatitude);
-	templatitude = (templatitude >> 2);
-	//syslog(LOG_LOCAL0|LOG_DEBUG, "[encode_to_sta] templatitude 26bit = %d", templatitude);
-
-
-	// ԓŌo1m=8.99*10^(-6)xȂ̂ŏ_ȉ5ł悻\
-	// mɐxۏ؂邽߂ƁAܓxƂ낦邽6܂łƂ邱ƂƂB
-	templongitude = (int)floor((st.lng + 180.0) * 10.0 * 10.0 * 10.0 * 10.0 * 10.0 * 10.0);
-	// ox ő360xA_ȉ6 360000000 --> 29bit ̂wʂx26bito
-	templongitude &= 0x1ffffff8;
-	//syslog(LOG_LOCAL0|LOG_DEBUG, "[encode_to_sta] templongitude 29bit = %d", templongitude);
-	templongitude = (templongitude >> 3);
-	//syslog(LOG_LOCAL0|LOG_DEBUG, "[encode_to_sta] templongitude 26bit = %d", templongitude);
-	
-	tempaltitude = (int)floor(st.alt / 2.0); // 2mxA܂͉ʂ𑫂ĂȂ14bit̃}XNĂȂ
-	//syslog(LOG_LOCAL0|LOG_DEBUG, "[encode_to_sta] tempaltitude 14bit = %d", tempaltitude);
-	
-	// time10bxƂ΂Ƃ14bitȂ̂Ń}XNKvȂ
-	tm_temptime = (struct tm *)malloc(sizeof(struct tm));
-	memset(tm_temptime, 0, sizeof(struct tm));
-	localtime_r(&(st.time), tm_temptime);
-	temptime = (tm_temptime->tm_hour * 60 * 60 + tm_temptime->tm_min * 60 + tm_temptime->tm_sec) / 10;
-	//syslog(LOG_LOCAL0|LOG_DEBUG, "[encode_to_sta] temptime 14bit = %d", temptime);
-	
-	newsta->s6_addr16[7] = htons(((tempaltitude & 0x3) << 14) + temptime); // alt2bit + time14bit
-	newsta->s6_addr16[6] = htons(((templatitude & 0xf) << 12) + ((tempaltitude & 0x3ffc) >> 2)); // lat4bit + alt12bit
-	newsta->s6_addr16[5] = htons((templatitude & 0xffff0) >> 4); // lat16bit
-	newsta->s6_addr16[4] = htons(((templongitude & 0x3ff) << 6) + ((templatitude & 0x3f00000) >> 20)); // lon10bit + lat6bit
-	newsta->s6_addr16[3] = htons((templongitude & 0x3fffc00) >> 10); // lon16bit
-	newsta->s6_addr16[2] = 0;
-	newsta->s6_addr16[1] = htons(0x200);
-	newsta->s6_addr16[0] = htons(0x2001);
-    
-    free(tm_temptime);
-	
-	temp = (char *)malloc(sizeof(char) * 512);
-	if (inet_ntop(AF_INET6, newsta, temp, 512) == NULL) {
-		fprintf(stderr, "[encode_to_sta] inet_ntop: %m");
-        free(temp);
+	memset(&tm_temptime, 0, sizeof(tm_temptime));
+	localtime_r(&(st.time), &tm_temptime);
+	c.lon = st.lng;
+	c.lat = st.lat;
+	c.alt = st.alt;
+	c.tod = tm_temptime.tm_hour * 60 * 60 + tm_temptime.tm_min * 60 + tm_temptime.tm_sec;
+	if (sta_encode(parameters.layout, &c, newsta) != 0) {
+		fprintf(stderr, "[encode_to_sta] (lng,lat,alt)=(%f, %f, %f) does not fit in %s\n", st.lng, st.lat, st.alt, parameters.layout->name);
 		return -1;
 	}
-	
-	//fprintf(stderr, "[encode_to_sta] New STA: %s", temp);
-    free(temp);
 	return 0;
 }
 
@@ -265,6 +233,299 @@ static int get_sta(char *interface, struct sockaddr_in6 *sta) {
 }
 
 
+/**
+ * @brief stamd̐\PbgɂȂ
+ *
+ * stamdĂȂΎsB\Pbgparameters.ctl_pathB
+ * 肪rootłȂ΁Aق̃[U[ĂŨ\PbgȂ̂ŎgȂB
+ * @return ڑ\PbgBȂȂ-1
+ */
+static int ctl_open(void) {
+	int fd;
+	struct sockaddr_un sun;
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+	
+	fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+	if (fd < 0) {
+		return -1;
+	}
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	strncpy(sun.sun_path, parameters.ctl_path, sizeof(sun.sun_path) - 1);
+	if (connect(fd, (struct sockaddr *)&sun, sizeof(sun)) == -1) {
+		close(fd);
+		return -1;
+	}
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == -1 || cred.uid != 0) {
+		fprintf(stderr, "%s is not owned by root, ignored\n", parameters.ctl_path);
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/**
+ * @brief stamdɗv𑗂ĕԓ󂯎
+ *
+ * @param fd ctl_openŊJ\Pbg
+ * @param op v̎
+ * @param payload ṽyC[h
+ * @param len yC[h̒
+ * @param[out] rep ԓ̃wb_
+ * @param[out] out ԓ̃yC[h̏ݐ
+ * @param outmax out̑傫
+ * @retval 0 ԓ󂯎Bʂrep->status
+ * @retval -1 ʐMɎs
+ */
+static int ctl_request(int fd, int op, const void *payload, size_t len, sta_ctl_hdr *rep, void *out, size_t outmax) {
+	char msg[sizeof(sta_ctl_hdr) + sizeof(sta_ctl_position)];
+	sta_ctl_hdr *hdr = (sta_ctl_hdr *)msg;
+	char *buf;
+	ssize_t n;
+	
+	if (len > sizeof(sta_ctl_position)) {
+		return -1;
+	}
+	memset(hdr, 0, sizeof(*hdr));
+	hdr->version = STA_CTL_VERSION;
+	hdr->op = op;
+	hdr->tenant = STA_CTL_ALL_TENANTS;
+	hdr->len = len;
+	memcpy(msg + sizeof(*hdr), payload, len);
+	if (send(fd, msg, sizeof(*hdr) + len, 0) < 0) {
+		return -1;
+	}
+	
+	buf = (char *)malloc(STA_CTL_MAX_MSG);
+	if (buf == NULL) {
+		return -1;
+	}
+	n = recv(fd, buf, STA_CTL_MAX_MSG, 0);
+	if (n < (ssize_t)sizeof(sta_ctl_hdr)) {
+		free(buf);
+		return -1;
+	}
+	memcpy(rep, buf, sizeof(*rep));
+	if (rep->len > outmax || rep->len != n - sizeof(sta_ctl_hdr)) {
+		free(buf);
+		return -1;
+	}
+	memcpy(out, buf + sizeof(sta_ctl_hdr), rep->len);
+	free(buf);
+	return 0;
+}
+
+/**
+ * @brief stamdSTA\
+ *
+ * stamdĂ΂̒̏Ԃ\BDAĎAhXoB
+ * @param interface ׂ閳LANC^[tF[X
+ * @retval 0 \
+ * @retval 1 Ȃ
+ * @retval -1 stamdĂȂA܂͕ʂ̃C^[tF[XǗĂ
+ */
+static int show_sta_from_daemon(char *interface) {
+	int fd;
+	sta_ctl_hdr rep;
+	sta_ctl_sta sta;
+	sta_ctl_dad dad;
+	char host[INET6_ADDRSTRLEN];
+	int ret = 1;
+	
+	if ((fd = ctl_open()) == -1) {
+		return -1;
+	}
+	if (ctl_request(fd, STA_CTL_GET_STA, NULL, 0, &rep, &sta, sizeof(sta)) == -1
+	    || rep.len != sizeof(sta) || strncmp(sta.ifname, interface, sizeof(sta.ifname)) != 0) {
+		close(fd);
+		return -1;
+	}
+	if (rep.status == STA_CTL_OK) {
+		inet_ntop(AF_INET6, &sta.addr, host, sizeof(host));
+		printf("%s STA: %s\n", interface, host);
+		ret = 0;
+	}
+	if (ctl_request(fd, STA_CTL_GET_PENDING, NULL, 0, &rep, &dad, sizeof(dad)) == 0
+	    && rep.status == STA_CTL_OK && dad.state == STA_STATE_DAD) {
+		inet_ntop(AF_INET6, &dad.addr, host, sizeof(host));
+		printf("%s pending: %s (DAD, %ld sec left)\n", interface, host, (long)(dad.deadline - time(NULL)));
+		ret = 0;
+	}
+	close(fd);
+	return ret;
+}
+
+/**
+ * @brief stamdDADZbVAJE^Aߗ׃m[h\
+ *
+ * @retval 0 
+ * @retval -1 stamdĂȂ
+ */
+static int show_status(void) {
+	int fd;
+	sta_ctl_hdr rep;
+	sta_ctl_dad *dad;
+	sta_ctl_neigh *neigh;
+	sta_metrics m;
+	char host[INET6_ADDRSTRLEN];
+	char from[INET6_ADDRSTRLEN];
+	size_t i;
+	
+	if ((fd = ctl_open()) == -1) {
+		fprintf(stderr, "stamd is not running.\n");
+		return -1;
+	}
+	
+	dad = (sta_ctl_dad *)malloc(STA_CTL_MAX_MSG);
+	if (dad != NULL && ctl_request(fd, STA_CTL_GET_DAD, NULL, 0, &rep, dad, STA_CTL_MAX_MSG) == 0) {
+		printf("DAD sessions: %lu%s\n", (unsigned long)(rep.len / sizeof(sta_ctl_dad)),
+		       (rep.flags & STA_CTL_F_TRUNCATED) ? " (truncated)" : "");
+		for (i = 0; i < rep.len / sizeof(sta_ctl_dad); i++) {
+			inet_ntop(AF_INET6, &dad[i].addr, host, sizeof(host));
+			if (dad[i].tenant == STA_CTL_ALL_TENANTS) {
+				printf("  %s deadline=%ld\n", host, (long)dad[i].deadline);
+			} else {
+				printf("  tenant %u %s deadline=%ld\n", dad[i].tenant, host, (long)dad[i].deadline);
+			}
+		}
+	}
+	free(dad);
+	
+	if (ctl_request(fd, STA_CTL_GET_METRICS, NULL, 0, &rep, &m, sizeof(m)) == 0 && rep.status == STA_CTL_OK) {
+		printf("samples       %llu\n", (unsigned long long)m.samples);
+		printf("areq_sent     %llu\n", (unsigned long long)m.areq_sent);
+		printf("areq_recv     %llu\n", (unsigned long long)m.areq_recv);
+		printf("arep_sent     %llu\n", (unsigned long long)m.arep_sent);
+		printf("arep_recv     %llu\n", (unsigned long long)m.arep_recv);
+		printf("dad_started   %llu\n", (unsigned long long)m.dad_started);
+		printf("dad_completed %llu\n", (unsigned long long)m.dad_completed);
+		printf("dad_duplicate %llu\n", (unsigned long long)m.dad_duplicate);
+		printf("addr_added    %llu\n", (unsigned long long)m.addr_added);
+		printf("addr_deleted  %llu\n", (unsigned long long)m.addr_deleted);
+		printf("ctl_requests  %llu\n", (unsigned long long)m.ctl_requests);
+		printf("areq_unicast  %llu\n", (unsigned long long)m.areq_unicast);
+		printf("cell_groups   %llu\n", (unsigned long long)m.cell_groups);
+		printf("areq_addrs    %llu\n", (unsigned long long)m.areq_addresses);
+		printf("dad_fallback  %llu\n", (unsigned long long)m.dad_fallback);
+		printf("malformed     %llu\n", (unsigned long long)m.wire_malformed);
+		printf("arep_suppress %llu\n", (unsigned long long)m.arep_suppressed);
+		printf("link_events   %llu\n", (unsigned long long)m.link_events);
+		printf("startup_us    %llu\n", (unsigned long long)m.startup_us);
+		printf("exit_margin   %llu\n", (unsigned long long)m.exit_margin);
+		printf("exit_dwell    %llu\n", (unsigned long long)m.exit_dwell);
+		printf("exit_return   %llu\n", (unsigned long long)m.exit_return);
+		printf("addr_deprec   %llu\n", (unsigned long long)m.addr_deprecated);
+		printf("exit_unsure   %llu\n", (unsigned long long)m.exit_unsure);
+		if (m.allocations == ALLOC_NOT_COUNTED) {
+			printf("allocations   -\n"); // stamd-checkłȂƐȂ
+		} else {
+			printf("allocations   %llu\n", (unsigned long long)m.allocations);
+		}
+		printf("queue_decide  %llu\n", (unsigned long long)m.queue_decision);
+		printf("queue_dad     %llu\n", (unsigned long long)m.queue_dad);
+		printf("queue_program %llu\n", (unsigned long long)m.queue_program);
+		printf("queue_dropped %llu\n", (unsigned long long)m.queue_dropped);
+	}
+	
+	neigh = (sta_ctl_neigh *)malloc(STA_CTL_MAX_MSG);
+	if (neigh != NULL && ctl_request(fd, STA_CTL_GET_NEIGH, NULL, 0, &rep, neigh, STA_CTL_MAX_MSG) == 0
+	    && rep.status == STA_CTL_OK) {
+		printf("neighbours: %lu%s\n", (unsigned long)(rep.len / sizeof(sta_ctl_neigh)),
+		       (rep.flags & STA_CTL_F_TRUNCATED) ? " (truncated)" : "");
+		for (i = 0; i < rep.len / sizeof(sta_ctl_neigh); i++) {
+			inet_ntop(AF_INET6, &neigh[i].addr, host, sizeof(host));
+			inet_ntop(AF_INET6, &neigh[i].from, from, sizeof(from));
+			printf("  %s via %s (%f, %f, %.0f) %ld sec ago\n", host, from, neigh[i].lat, neigh[i].lon, neigh[i].alt,
+			       (long)(time(NULL) - neigh[i].last_seen));
+		}
+	}
+	free(neigh);
+	close(fd);
+	return 0;
+}
+
+/**
+ * @brief stamdSTA̒ǉ𗊂
+ *
+ * stamdgDADʂĒǉB
+ * @param st ƈʒu
+ * @retval 0 DADn܂
+ * @retval 1 stamdɒfꂽA܂͉Ȃ
+ * @retval -1 stamdĂȂ
+ */
+static int add_sta_via_daemon(spatio_temporal st) {
+	int fd;
+	sta_ctl_hdr rep;
+	sta_ctl_position pos;
+	sta_ctl_dad dad;
+	char host[INET6_ADDRSTRLEN];
+	
+	if ((fd = ctl_open()) == -1) {
+		return -1;
+	}
+	memset(&pos, 0, sizeof(pos));
+	strncpy(pos.ifname, parameters.wlan_interface, sizeof(pos.ifname) - 1);
+	pos.time = st.time;
+	pos.lat = st.lat;
+	pos.lon = st.lng;
+	pos.alt = st.alt;
+	if (ctl_request(fd, STA_CTL_ADD, &pos, sizeof(pos), &rep, &dad, sizeof(dad)) == -1) {
+		fprintf(stderr, "no reply from stamd: %m\n");
+		close(fd);
+		return 1;
+	}
+	close(fd);
+	
+	if (rep.status == STA_CTL_EINVAL) {
+		fprintf(stderr, "stamd rejected the request as invalid (not managing %s, or needs a tenant).\n", parameters.wlan_interface);
+		return 1;
+	} else if (rep.status == STA_CTL_EBUSY) {
+		fprintf(stderr, "stamd is already in DAD.\n");
+		return 1;
+	} else if (rep.status != STA_CTL_OK) {
+		fprintf(stderr, "stamd refused the request (%d).\n", rep.status);
+		return 1;
+	}
+	inet_ntop(AF_INET6, &dad.addr, host, sizeof(host));
+	printf("DAD started: %s\n", host);
+	return 0;
+}
+
+/**
+ * @brief stamdSTA̍폜𗊂
+ *
+ * @retval 0 폜
+ * @retval 1 stamdɒfꂽA܂͉Ȃ
+ * @retval -1 stamdĂȂ
+ */
+static int delete_sta_via_daemon(void) {
+	int fd;
+	sta_ctl_hdr rep;
+	sta_ctl_ifname ifn;
+	
+	if ((fd = ctl_open()) == -1) {
+		return -1;
+	}
+	memset(&ifn, 0, sizeof(ifn));
+	strncpy(ifn.ifname, parameters.wlan_interface, sizeof(ifn.ifname) - 1);
+	if (ctl_request(fd, STA_CTL_DEL, &ifn, sizeof(ifn), &rep, NULL, 0) == -1) {
+		fprintf(stderr, "no reply from stamd: %m\n");
+		close(fd);
+		return 1;
+	}
+	close(fd);
+	
+	if (rep.status == STA_CTL_EINVAL) {
+		fprintf(stderr, "stamd rejected the request as invalid (not managing %s, or needs a tenant).\n", parameters.wlan_interface);
+		return 1;
+	} else if (rep.status == STA_CTL_ENOENT) {
+		fprintf(stderr, "STA not found.\n");
+		return 1;
+	}
+	return (rep.status == STA_CTL_OK) ? 0 : 1;
+}
+
 /**
  * @brief STA\
  *
@@ -281,6 +542,15 @@ static int show_sta(char *interface) {
 	memset(&sta, 0, sizeof(struct sockaddr_in6));
 	memset(host, 0, NI_NUMERICHOST);
 	
+	// stamdĂ΂ɕ
+	ret = show_sta_from_daemon((interface == (char *)NULL) ? DEFAULT_WLAN_INTERFACE : interface);
+	if (ret != -1) {
+		if (ret == 1) {
+			fprintf(stderr, "STA not found.\n");
+		}
+		return -ret;
+	}
+	
 	if (interface == (char *)NULL) {
 	    ret = get_sta(DEFAULT_WLAN_INTERFACE, &sta);
 	} else {
@@ -323,13 +593,278 @@ static int get_socket_for_afinet6() {
     return fd;
 }
 
+/**
+ * @brief ꊇݒpencode_to_sta
+ *
+ * @param rec R[h
+ * @param[out] addr ϊSTA
+ * @retval 0 
+ * @retval -1 s
+ */
+static int encode_batch_record(const batch_record *rec, struct in6_addr *addr) {
+	spatio_temporal st;
+	
+	st.time = (time_t)rec->time;
+	st.lat = rec->lat;
+	st.lng = rec->lng;
+	st.alt = rec->alt;
+	return encode_to_sta(st, addr);
+}
+
+/**
+ * @brief ꊇݒ
+ *
+ * staconfig batch [-b] [file|-]
+ * t@Cȗ邩-ȂW͂ǂށB-bȂbatch_record̕тƂēǂށB
+ * @param argc ̐(batcȟ)
+ * @param argv (batcȟ)
+ * @retval 0 S
+ * @retval 1 sR[hA܂͊JȂ
+ */
+static int run_batch(int argc, char **argv) {
+	FILE *fp = stdin;
+	int binary = 0;
+	int ret;
+	
+	if (argc > 0 && strcmp(*argv, "-b") == 0) {
+		binary = 1;
+		argv++;
+		argc--;
+	}
+	if (argc > 1) {
+		usage();
+	}
+	if (argc == 1 && strcmp(*argv, "-") != 0) {
+		fp = fopen(*argv, binary ? "rb" : "r");
+		if (fp == NULL) {
+			fprintf(stderr, "%s: %m\n", *argv);
+			return 1;
+		}
+	}
+	setvbuf(fp, NULL, _IOFBF, 1024 * 1024);
+	
+	ret = batch_run(fp, binary, encode_batch_record);
+	if (fp != stdin) {
+		fclose(fp);
+	}
+	return (ret != 0);
+}
+
+/**
+ * @brief ꊇϊ
+ *
+ * staconfig encode|decode [-b] [-B] [-j threads] [file|-]
+ * W(܂file)ϊĕWo͂ɏB
+ * -b͓͂A-B͏o͂oCi`B
+ * @param dir codec_dir
+ * @param argc ̐(encode/decode܂)
+ * @param argv (encode/decode܂)
+ * @retval 0 Sϊ
+ * @retval 1 ϊłȂR[hA܂͎s
+ */
+static int run_codec(int dir, int argc, char **argv) {
+	int in_fd = 0;
+	int in_binary = 0;
+	int out_binary = 0;
+	int nthreads = 1;
+	int c;
+	int ret;
+	
+	while ((c = getopt(argc, argv, "bBj:")) != -1) {
+		switch (c) {
+		case 'b':
+			in_binary = 1;
+			break;
+		case 'B':
+			out_binary = 1;
+			break;
+		case 'j':
+			nthreads = atoi(optarg);
+			if (nthreads < 1 || nthreads > CODEC_MAX_THREADS) {
+				fprintf(stderr, "threads must be 1-%d\n", CODEC_MAX_THREADS);
+				return 1;
+			}
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc > 1) {
+		usage();
+	}
+	if (argc == 1 && strcmp(*argv, "-") != 0) {
+		in_fd = open(*argv, O_RDONLY);
+		if (in_fd < 0) {
+			fprintf(stderr, "%s: %m\n", *argv);
+			return 1;
+		}
+	}
+	
+	ret = codec_run(parameters.layout, in_fd, 1, dir, in_binary, out_binary, nthreads);
+	if (in_fd != 0) {
+		close(in_fd);
+	}
+	return (ret != 0);
+}
+
+/**
+ * @brief ǂ
+ *
+ * HH:MMHH:MM:SSB
+ * @param s 
+ * @param[out] tod ̓0̕b
+ * @retval 0 
+ * @retval -1 ǂ߂Ȃ
+ */
+static int parse_tod(const char *s, long *tod) {
+	int h, m, sec = 0;
+	char tail;
+	
+	if (sscanf(s, "%d:%d:%d%c", &h, &m, &sec, &tail) != 3 && sscanf(s, "%d:%d%c", &h, &m, &tail) != 2) {
+		return -1;
+	}
+	if (h < 0 || h > 23 || m < 0 || m > 59 || sec < 0 || sec > 59) {
+		return -1;
+	}
+	*tod = h * 3600L + m * 60L + sec;
+	return 0;
+}
+
+/**
+ * @brief ͈͂𕢂vtBbNX
+ *
+ * staconfig cover [-m max] [-o prefix|pcap|nft] [-a min:max] [-t HH:MM-HH:MM] south west north east
+ * ܓxox͈̔͂ɓSTA𕢂vtBbNXWo͂ɏB
+ * -opcapȂtcpdump̎AnftȂnftables̏WɂB
+ * mɕAǂꂾL͕WG[o͂ɏB
+ * ̈ܓxoxƂ--ŋ؂邱ƁB
+ * @param argc ̐(cover܂)
+ * @param argv (cover܂)
+ * @retval 0 
+ * @retval 1 s
+ */
+static int run_cover(int argc, char **argv) {
+	sta_box box;
+	sta_prefix *prefixes;
+	const char *format = "prefix";
+	const char *sep;
+	char host[INET6_ADDRSTRLEN];
+	char *end;
+	double excess;
+	int max = STA_COVER_DEFAULT_MAX;
+	int n, i, c;
+	
+	memset(&box, 0, sizeof(box));
+	while ((c = getopt(argc, argv, "a:m:o:t:")) != -1) {
+		switch (c) {
+		case 'a':
+			box.alt_min = strtod(optarg, &end);
+			if (*end != ':') {
+				usage();
+			}
+			box.alt_max = strtod(end + 1, &end);
+			if (*end != '\0') {
+				usage();
+			}
+			box.has_alt = 1;
+			break;
+		case 'm':
+			max = atoi(optarg);
+			if (max < 1) {
+				fprintf(stderr, "max must be positive\n");
+				return 1;
+			}
+			break;
+		case 'o':
+			format = optarg;
+			if (strcmp(format, "prefix") != 0 && strcmp(format, "pcap") != 0 && strcmp(format, "nft") != 0) {
+				usage();
+			}
+			break;
+		case 't':
+			end = strchr(optarg, '-');
+			if (end == NULL) {
+				usage();
+			}
+			*end = '\0';
+			if (parse_tod(optarg, &box.tod_start) != 0 || parse_tod(end + 1, &box.tod_end) != 0) {
+				fprintf(stderr, "time must be HH:MM[:SS]-HH:MM[:SS]\n");
+				return 1;
+			}
+			box.has_time = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc != 4) {
+		usage();
+	}
+	box.lat_min = strtod(argv[0], NULL);
+	box.lon_min = strtod(argv[1], NULL);
+	box.lat_max = strtod(argv[2], NULL);
+	box.lon_max = strtod(argv[3], NULL);
+	if (box.lat_min < -90.0 || box.lat_max > 90.0 || box.lon_min < -180.0 || box.lon_min > 180.0
+		|| box.lon_max < -180.0 || box.lon_max > 180.0) {
+		fprintf(stderr, "latitude or longitude out of range\n");
+		return 1;
+	}
+	
+	prefixes = (sta_prefix *)malloc((size_t)max * sizeof(sta_prefix));
+	if (prefixes == NULL) {
+		fprintf(stderr, "malloc error\n");
+		return 1;
+	}
+	n = sta_cover(parameters.layout, &box, prefixes, max, &excess);
+	if (n < 0) {
+		fprintf(stderr, "invalid region\n");
+		free(prefixes);
+		return 1;
+	}
+	
+	if (strcmp(format, "nft") == 0) {
+		printf("{ ");
+	}
+	for (i = 0; i < n; i++) {
+		inet_ntop(AF_INET6, &prefixes[i].addr, host, sizeof(host));
+		if (strcmp(format, "prefix") == 0) {
+			printf("%s/%d\n", host, prefixes[i].len);
+			continue;
+		}
+		sep = (i == 0) ? "" : (strcmp(format, "pcap") == 0) ? " or " : ", ";
+		printf("%s%s%s/%d", sep, (strcmp(format, "pcap") == 0) ? "net " : "", host, prefixes[i].len);
+	}
+	if (strcmp(format, "nft") == 0) {
+		printf(" }\n");
+	} else if (strcmp(format, "pcap") == 0) {
+		printf("\n");
+	}
+	if (excess <= 1.0) {
+		fprintf(stderr, "%d prefixes, exact\n", n);
+	} else {
+		fprintf(stderr, "%d prefixes, %.6g times the region (raise -m%s)\n", n, excess,
+			parameters.layout->interleave ? "" : " or use a z: layout");
+	}
+	free(prefixes);
+	return 0;
+}
+
 /**
  * @brief gp@
  *
  * R}hC̐\ďIB
  */
 static void usage() {
-    fprintf(stderr, "Usage: stamd interface latitude longitude altitude [time]\n");
+    fprintf(stderr, "Usage: staconfig [-L layout] [-c ctl_path] [interface [add latitude longitude altitude [time] | del | status]]\n");
+    fprintf(stderr, "       staconfig [-L layout] batch [-b] [file|-]\n");
+    fprintf(stderr, "       staconfig [-L layout] encode|decode [-b] [-B] [-j threads] [file|-]\n");
+    fprintf(stderr, "       staconfig [-L layout] cover [-m max] [-o prefix|pcap|nft] [-a min:max] [-t HH:MM-HH:MM] [--] south west north east\n");
+    fprintf(stderr, "  -L layout : STA bit layout, same as stamd -L. z: prefix for Z-order. (%s)\n", STA_LAYOUT_DEFAULT);
+    fprintf(stderr, "  -c ctl_path : stamd control socket, same as stamd -c. $STAMD_CTL if set. (%s)\n", STA_CTL_PATH);
     exit(1);
 }
 
@@ -342,6 +877,11 @@ static void init_parameters(void) {
 	memset(&parameters, 0, sizeof(parameters));
 	
 	strcpy(parameters.wlan_interface, DEFAULT_WLAN_INTERFACE);
+	parameters.layout = sta_layout_find(STA_LAYOUT_DEFAULT);
+	parameters.ctl_path = getenv("STAMD_CTL");
+	if (parameters.ctl_path == NULL || parameters.ctl_path[0] == '\0') {
+		parameters.ctl_path = STA_CTL_PATH;
+	}
 }
 
 /**
@@ -362,6 +902,23 @@ int main(int argc, char **argv) {
     argv++;
     argc--;
     
+    // STÃrbgzuƐ\Pbg̓TuR}hOɎw肷
+    while (argc >= 2 && (*argv)[0] == '-') {
+    	if (strcmp(*argv, "-L") == 0) {
+    		parameters.layout = sta_layout_find(argv[1]);
+    		if (parameters.layout == NULL) {
+    			fprintf(stderr, "invalid STA layout: %s\n", argv[1]);
+    			usage();
+    		}
+    	} else if (strcmp(*argv, "-c") == 0) {
+    		parameters.ctl_path = argv[1];
+    	} else {
+    		break;
+    	}
+    	argv += 2;
+    	argc -= 2;
+    }
+    
     // PstaconfigƑłꂽ
     // S\
     if (argc == 0) {
@@ -369,6 +926,17 @@ int main(int argc, char **argv) {
     	exit(ret < 0);
     }
     
+    // staconfig batch/encode/decode/cover
+    if (strcmp(*argv, "batch") == 0) {
+    	exit(run_batch(argc - 1, argv + 1));
+    } else if (strcmp(*argv, "encode") == 0) {
+    	exit(run_codec(CODEC_ENCODE, argc, argv));
+    } else if (strcmp(*argv, "decode") == 0) {
+    	exit(run_codec(CODEC_DECODE, argc, argv));
+    } else if (strcmp(*argv, "cover") == 0) {
+    	exit(run_cover(argc, argv));
+    }
+    
     // staconfig ath0ȂǂƎw肳ꂽ
     spp = argv;
     strncpy(ifr.ifr_name, *spp, IFNAMSIZ);
@@ -380,9 +948,14 @@ int main(int argc, char **argv) {
     	exit(err < 0);
     }
     
-    if (strcmp(*spp, "del") == 0) {
+    if (strcmp(*spp, "status") == 0) {
+    	exit(show_status() < 0);
+    } else if (strcmp(*spp, "del") == 0) {
     	struct sockaddr_in6 oldsta;
     	int err;
+    	if ((err = delete_sta_via_daemon()) != -1) {
+    		exit(err);
+    	}
     	if ((get_sta(parameters.wlan_interface, &oldsta)) == -1) {
     		exit(-1);
     	}
@@ -397,48 +970,46 @@ int main(int argc, char **argv) {
     	exit(-1);
     }
     
+    if (argc != 3 && argc != 4) {
+    	usage();
+    }
     errno = 0;
-    if (argc == 3) {
-    	parameters.lat = strtod(*argv++, NULL);
-    	if (errno != 0) {
-    		fprintf(stderr, "latitude error: %m\n");
-    		exit(1);
-    	}
-    	parameters.lng = strtod(*argv++, NULL);
-    	if (errno != 0) {
-    		fprintf(stderr, "longitude error: %m\n");
-    		exit(1);
-    	}
-    	parameters.alt = strtod(*argv, NULL);
-    	if (errno != 0) {
-    		fprintf(stderr, "altitude error: %m\n");
-    		exit(1);
-    	}
-    	parameters.time = (time_t)0;
-    } else if (argc == 4) {
-    	parameters.lat = strtod(*argv++, NULL);
-    	if (errno != 0) {
-    		fprintf(stderr, "latitude error: %m\n");
-    		exit(1);
-    	}
-    	parameters.lng = strtod(*argv++, NULL);
-    	if (errno != 0) {
-    		fprintf(stderr, "longitude error: %m\n");
-    		exit(1);
-    	}
-    	parameters.alt = strtod(*argv++, NULL);
+    parameters.lat = strtod(*spp++, NULL);
+    if (errno != 0) {
+    	fprintf(stderr, "latitude error: %m\n");
+    	exit(1);
+    }
+    parameters.lng = strtod(*spp++, NULL);
+    if (errno != 0) {
+    	fprintf(stderr, "longitude error: %m\n");
+    	exit(1);
+    }
+    parameters.alt = strtod(*spp++, NULL);
+    if (errno != 0) {
+    	fprintf(stderr, "altitude error: %m\n");
+    	exit(1);
+    }
+    if (argc == 4) {
+    	// UNIX(b)
+    	parameters.time = (time_t)strtoll(*spp, NULL, 10);
     	if (errno != 0) {
-    		fprintf(stderr, "altitude error: %m\n");
+    		fprintf(stderr, "time error: %m\n");
     		exit(1);
     	}
-    	// time()
-    	parameters.time = (time_t)0;
+    } else {
+    	parameters.time = time(NULL);
     }
     
     st.lat = parameters.lat;
     st.lng = parameters.lng;
     st.alt = parameters.alt;
     st.time = parameters.time;
+    
+    // stamdĂstamdDADʂ
+    if ((ret = add_sta_via_daemon(st)) != -1) {
+    	exit(ret);
+    }
+    
     ret = encode_to_sta(st, &newsta.sin6_addr);
     
     if (ret == -1) {
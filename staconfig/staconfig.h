@@ -10,6 +10,7 @@
 #define _STACONFIG_H
 
 #define DEFAULT_WLAN_INTERFACE "ath0"
+#define STA_STATE_DAD 0 ///< stamdaddress_statusDAD
 
 /**
  * @brief STA肷B
@@ -46,16 +47,30 @@ typedef struct _global_parameters {
     double lng; ///< longitude
     double alt; ///< altitude
     time_t time; ///< time
+    const sta_layout *layout; ///< STÃrbgzu
+    const char *ctl_path; ///< stamd̐\PbgBstamd -cƓ
 } global_parameters; 
 
 global_parameters parameters;
 
 static int add_sta(struct sockaddr_in6 *newsta);
+static int add_sta_via_daemon(spatio_temporal st);
+static int ctl_open(void);
+static int ctl_request(int fd, int op, const void *payload, size_t len, sta_ctl_hdr *rep, void *out, size_t outmax);
 static int delete_sta(struct sockaddr_in6 *oldsta);
+static int delete_sta_via_daemon(void);
 static int get_sta(char *interface, struct sockaddr_in6 *sta);
 static int show_sta(char *interface);
+static int show_sta_from_daemon(char *interface);
+static int show_status(void);
 static int encode_to_sta(spatio_temporal st, struct in6_addr *newsta);
+static int encode_batch_record(const batch_record *rec, struct in6_addr *addr);
+static int parse_tod(const char *s, long *tod);
+static int run_batch(int argc, char **argv);
+static int run_codec(int dir, int argc, char **argv);
+static int run_cover(int argc, char **argv);
 static int get_socket_for_afinet6();
 static void init_parameters(void);
+static void usage();
 
 #endif
@@ -28,9 +28,7 @@
  */
 
 #include <arpa/inet.h>
-#include <assert.h>
 #include <errno.h>
-#include <ifaddrs.h>
 
 #if 0
 #include <linux/ipv6.h>
@@ -43,6 +41,7 @@
 #include <netdb.h>
 #include <pthread.h>
 #include <signal.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -53,6 +52,26 @@
 #include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
+#include "sta_alloc.h"
+#include "sta_cell.h"
+#include "sta_ctl.h"
+#include "sta_engine.h"
+#include "sta_export.h"
+#include "sta_filter.h"
+#include "sta_fix.h"
+#include "sta_handoff.h"
+#include "sta_hyst.h"
+#include "sta_layout.h"
+#include "sta_link.h"
+#include "sta_multi.h"
+#include "sta_neigh.h"
+#include "sta_reply.h"
+#include "sta_seqlock.h"
+#include "sta_shard.h"
+#include "sta_snap.h"
+#include "sta_stage.h"
+#include "sta_tenant.h"
+#include "sta_wire.h"
 #include "stamanagement.h"
 #include "sta_timer.h"
 
@@ -89,10 +108,40 @@ static int in6_addr_equal(const struct in6_addr *a, const struct in6_addr *b) {
 	return (memcmp(a, b, sizeof(struct in6_addr)) == 0);
 }
 
+/**
+ * @brief FIFOPositionOut1ǂ
+ *
+ * FIFOread͏̏ɂĂ̓R[h̓rŕԂ̂ŁA1낤܂œǂݑB
+ * @param fd FIFO
+ * @param[out] output ǂ񂾈ʒu
+ * @retval 1 ǂ
+ * @retval 0 肪Br܂œǂ񂾃R[ĥ͎Ă
+ * @retval -1 ǂ߂Ȃ
+ */
+static int read_record(int fd, PositionOut *output) {
+    size_t got = 0;
+    ssize_t len;
+    
+    while (got < sizeof(*output)) {
+        len = read(fd, (char *)output + got, sizeof(*output) - got);
+        if (len == 0) {
+            return 0;
+        } else if (len < 0) {
+            if (errno == EINTR && !srv_shutdown) {
+                continue;
+            }
+            return -1;
+        }
+        got += (size_t)len;
+    }
+    return 1;
+}
+
 /**
  * @brief FIFO̎M
  *
  * ~hEFAFIFOoRŃf[^M
+ * -eepollio_uringI񂾂Ã[vFIFOUDP\Pbg܂Ƃ߂ēǂށB
  * @param arg gĂȂ
  * @retval 0 0Ԃ
  */
@@ -100,513 +149,1590 @@ void *recv_from_fifo(void *arg) {
 	UNUSED(arg);
 	
     int fd; ///< FIFÔ߂fd
-    int len;
+    int ret;
     PositionOut output;
-    struct ifaddrs *ifap0, *ifap;
-    char host[NI_MAXHOST];
-    int found = 0;
-    struct sockaddr_in6 sin6;
-    struct sockaddr_in6 oldsta_sin6;
-    struct in6_addr *oldsta = NULL; ///< oldsta_sin6in6_addrw
-    PositionOut decode;
-    int duplicate;
-    struct timeval tv;
 
     memset(&output, 0, sizeof(output));
 
+    stage_pin(stage_cpus[STAGE_INGEST]);
     if ((fd = open(fifo_path, O_RDONLY)) == -1) {
     	syslog(LOG_LOCAL0|LOG_DEBUG, "[recv_from_fifo] %m : open %s", fifo_path);
         return NULL;
     }
+    
+    if (io_engine != ENGINE_THREADS) {
+        // -WȂ\Pbg̓[J[ǂ
+        if (engine_run(io_engine, &sockfd, (udp_workers > 1) ? 0 : 1, fd, sizeof(PositionOut), handle_udp_packet, handle_fifo_record) != 0) {
+            syslog(LOG_LOCAL0|LOG_DEBUG, "[recv_from_fifo] %s engine failed", engine_name(io_engine));
+        }
+        return NULL;
+    }
 
     while (!srv_shutdown) {
-        len = read(fd, &output, sizeof(output));
+        ret = read_record(fd, &output);
         
-        // ȉ̏dȂ悤ȂʃXbhɂׂ
-        if (len == 0) {
+        if (ret == 0) {
         	fprintf(stderr, "[recv_from_fifo] read size 0\n");
             break;
-        } else if (len < 0) {
+        } else if (ret < 0) {
         	syslog(LOG_LOCAL0|LOG_DEBUG, "[recv_from_fifo] read error: %m");
-        	fprintf(stderr, "[recv_from_fifo] read error: %m");
         	continue;
-        } else if (len > 0) {
-            syslog(LOG_LOCAL0|LOG_DEBUG, "[recv_from_fifo] index=%lu", output.index);
-
-            // ath0STA蓖ĂĂ邩`FbN
-            // AhXZbgĂȂ΃Zbg
-            if (getifaddrs(&ifap0)) {
-                 syslog(LOG_LOCAL0|LOG_DEBUG, "[recv_from_fifo] getifaddrs error %m");
-            }
-            for (ifap = ifap0; ifap; ifap = ifap->ifa_next) {
-                if (strstr(ifap->ifa_name, wlan_interface)) {
-                	if (ifap->ifa_addr == NULL) {
-                		syslog(LOG_LOCAL0|LOG_DEBUG, "[recv_from_fifo] %s ifa_addr is NULL!!", wlan_interface);
-                		continue;
-                	}
-                	if (ifap->ifa_addr->sa_family == AF_INET6) {
-                		getnameinfo(ifap->ifa_addr, sizeof(struct sockaddr_in6), host, sizeof(host), NULL, 0, NI_NUMERICHOST);
-                        syslog(LOG_LOCAL0|LOG_DEBUG, "[recv_from_fifo] address = %s", host);
-                        
-                        struct sockaddr_in6 *temp_sockaddr_in6 = (struct sockaddr_in6 *)(ifap->ifa_addr);
-                        if (IN6_IS_ADDR_STA(&temp_sockaddr_in6->sin6_addr)) {
-                        	found = 1;
-                        	oldsta_sin6 = *temp_sockaddr_in6;
-                        	oldsta = &oldsta_sin6.sin6_addr;
-                        	break;
-                        } else {
-                        	continue;
-                        }
-                	} else {
-                		// v4AhX
-                		continue;
-                	}
-                } else {
-                	// ath0ȊO
-                    continue;
-                }
-            }
-            
-            if (!found) { // Ȃ
-            	encode_to_sta(output, &(sin6.sin6_addr));
-            	sin6.sin6_family = AF_INET6;
-                
-                pthread_mutex_lock(&(temp_address.mutex));
-                if (temp_address.flag == DAD) {
-                	pthread_mutex_unlock(&(temp_address.mutex));
-                	continue;
-                }
-                
-                gettimeofday(&tv, NULL);
-                temp_address.generated_time = tv.tv_sec;
-                temp_address.address = sin6;
-                temp_address.flag = DAD;
-                pthread_mutex_unlock(&(temp_address.mutex));
-                
-                duplicate = allocation_request_start(sin6); // AREQ𑗂WT҂
-            } else { // 
-            	if (decode_from_sta(oldsta, &decode) == -1) {
-            		syslog(LOG_LOCAL0|LOG_DEBUG, "[recv_from_fifo] decode_from_sta error");
-            		continue;
-            	}
-            	
-            	if (is_inside_valid_range(&output, &decode)) { // L͈͈ȓȂ甲
-            		// syslog(LOG_LOCAL0|LOG_DEBUG, "[recv_from_fifo] OK, in the STA valid range.");
-            		// do nothing.
-            	} else { // ͈͂oĂ΁AAhXXV
-            		//syslog(LOG_LOCAL0|LOG_DEBUG, "[recv_from_fifo] No! outside the range.");
-                    encode_to_sta(output, &(sin6.sin6_addr));
-                    sin6.sin6_family = AF_INET6;
-                    
-                    pthread_mutex_lock(&(temp_address.mutex));
-                    if (temp_address.flag == DAD) {
-                    	pthread_mutex_unlock(&(temp_address.mutex));
-                    	continue;
-                    }
-                    
-                    gettimeofday(&tv, NULL);
-                    temp_address.generated_time = tv.tv_sec;
-                    temp_address.address = sin6;
-                    temp_address.flag = DAD;
-                    pthread_mutex_unlock(&(temp_address.mutex));
-                    
-                    duplicate = allocation_request_start(sin6); // AREQ𑗂WT҂
-            	}
-            }
-            fprintf(stderr, "srv_shutdown %d\n", srv_shutdown);
         }
-        fprintf(stderr, "srv_shutdown %d\n", srv_shutdown);
+        submit_position(&output);
     }
     fprintf(stderr, "srv_shutdown %d\n", srv_shutdown);
     return NULL;
 }
 
 /**
- * @brief ~hEFAo͂STAɕϊ
+ * @brief GWFIFOǂ񂾃R[h
  *
- * ~hEFAo͂STAɕϊB
- * @todo łgȂ
- * @todo vtBbNXƌ߂
- * @todo ̌_߂āAʂ͂B-11000mƂB
- * 
- * @param[in] po ~hEFȀo
- * @param[out] newsta ϊSTAĕԂ
- * 
- * @retval 0 
- * @retval -1 s
+ * @param record PositionOut
  */
-static int encode_to_sta(PositionOut po, struct in6_addr *newsta) {
-	int templatitude;
-	int templongitude;
-	int tempaltitude;
-	int temptime;
-	struct tm *tm_temptime;
-	char *temp;
-	
-	if (po.lat > 90.0 || po.lat < -90.0) {
-		syslog(LOG_LOCAL0|LOG_DEBUG, "[encode_to_sta] latitude range error");
-		return -1;
-	}
-	if (po.lon > 180.0 || po.lon < -180.0) {
-		syslog(LOG_LOCAL0|LOG_DEBUG, "[encode_to_sta] longitude range error");
-		return -1;
-	}
-	
-	// ܐ1m=4.49*10^(-6)xA_ȉ6܂łƂ
-	templatitude = (int)floor((po.lat + 90.0) * 10.0 * 10.0 * 10.0 * 10.0 * 10.0 * 10.0);
-	// ܓx ő180xAȉ6 180000000 --> 28bit ̂ʂ26bito
-	templatitude &= 0xffffffc;
-	//syslog(LOG_LOCAL0|LOG_DEBUG, "[encode_to_sta] templatitude 28bit = %d", templatitude);
-	templatitude = (templatitude >> 2);
-	//syslog(LOG_LOCAL0|LOG_DEBUG, "[encode_to_sta] templatitude 26bit = %d", templatitude);
-
-
-	// ԓŌo1m=8.99*10^(-6)xȂ̂ŏ_ȉ5ł悻\
-	// mɐxۏ؂邽߂ƁAܓxƂ낦邽6܂łƂ邱ƂƂB
-	templongitude = (int)floor((po.lon + 180.0) * 10.0 * 10.0 * 10.0 * 10.0 * 10.0 * 10.0);
-	// ox ő360xA_ȉ6 360000000 --> 29bit ̂wʂx26bito
-	templongitude &= 0x1ffffff8;
-	//syslog(LOG_LOCAL0|LOG_DEBUG, "[encode_to_sta] templongitude 29bit = %d", templongitude);
-	templongitude = (templongitude >> 3);
-	//syslog(LOG_LOCAL0|LOG_DEBUG, "[encode_to_sta] templongitude 26bit = %d", templongitude);
-	
-	tempaltitude = (int)floor(po.alt / 2.0); // 2mxA܂͉ʂ𑫂ĂȂ14bit̃}XNĂȂ
-	//syslog(LOG_LOCAL0|LOG_DEBUG, "[encode_to_sta] tempaltitude 14bit = %d", tempaltitude);
-	
-	// time10bxƂ΂Ƃ14bitȂ̂Ń}XNKvȂ
-	tm_temptime = (struct tm *)malloc(sizeof(struct tm));
-	memset(tm_temptime, 0, sizeof(struct tm));
-	localtime_r(&(po.time), tm_temptime);
-	temptime = (tm_temptime->tm_hour * 60 * 60 + tm_temptime->tm_min * 60 + tm_temptime->tm_sec) / 10;
-	//syslog(LOG_LOCAL0|LOG_DEBUG, "[encode_to_sta] temptime 14bit = %d", temptime);
-	
-	newsta->s6_addr16[7] = htons(((tempaltitude & 0x3) << 14) + temptime); // alt2bit + time14bit
-	newsta->s6_addr16[6] = htons(((templatitude & 0xf) << 12) + ((tempaltitude & 0x3ffc) >> 2)); // lat4bit + alt12bit
-	newsta->s6_addr16[5] = htons((templatitude & 0xffff0) >> 4); // lat16bit
-	newsta->s6_addr16[4] = htons(((templongitude & 0x3ff) << 6) + ((templatitude & 0x3f00000) >> 20)); // lon10bit + lat6bit
-	newsta->s6_addr16[3] = htons((templongitude & 0x3fffc00) >> 10); // lon16bit
-	newsta->s6_addr16[2] = 0;
-	newsta->s6_addr16[1] = htons(0x200);
-	newsta->s6_addr16[0] = htons(0x2001);
-    
-    free(tm_temptime);
-	
-	temp = (char *)malloc(sizeof(char) * 512);
-	if (inet_ntop(AF_INET6, newsta, temp, 512) == NULL) {
-		syslog(LOG_LOCAL0|LOG_DEBUG, "[encode_to_sta] inet_ntop: %m");
-        free(temp);
-		return -1;
-	}
-	
-	syslog(LOG_LOCAL0|LOG_DEBUG, "[encode_to_sta] New STA: %s", temp);
-    free(temp);
-	return 0;
+static void handle_fifo_record(const void *record) {
+    PositionOut output;
+    
+    memcpy(&output, record, sizeof(output));
+    submit_position(&output);
 }
 
 /**
- * @brief STAPositionOutɕϊB
- * 
- * STAPositionOutɕϊB
- * @param[in] sta ϊSTA
- * @param[out] po ϊPositionOut
- * @retval 0 
- * @retval -1 s
+ * @brief ǂ񂾈ʒu𔻒f̒iɓn
+ *
+ * ǂݍ݂̒iĂԁBf̒il܂ĂĂ҂Ɏ̂āÄʒuǂ݂ɖ߂B
+ * @param output ǂ񂾈ʒu
  */
-static int decode_from_sta(struct in6_addr *sta, PositionOut *po) {
-	int temp;
-	
-	if (po == NULL) {
-		return -1;
-	}
-	
-	if (!IN6_IS_ADDR_STA(sta)) {
-		syslog(LOG_LOCAL0|LOG_DEBUG, "[decode_from_sta] this is not an sta.");
-		return -1;
-	}
-	
-	// ȉSTAɏ񂪂Ȃ̂ŕs\B
-	po->index = 0;
-	
-	//syslog(LOG_LOCAL0|LOG_DEBUG, "[decode_from_sta] sta->s6_addr16[0,1,2,3,4,5,6,7] = (%d, %d, %d, %d, %d, %d, %d, %d)", sta->s6_addr16[0], sta->s6_addr16[1], sta->s6_addr16[2], sta->s6_addr16[3], sta->s6_addr16[4], sta->s6_addr16[5], sta->s6_addr16[6], sta->s6_addr16[7]);
-	
-	po->time = (time_t)(((int)ntohs(sta->s6_addr16[7]) & 0x3fff) * 10); // [7]14bit
-	
-	temp = (((int)ntohs(sta->s6_addr16[6]) & 0xfff) << 2) + (((int)ntohs(sta->s6_addr16[7]) & 0xc000) >> 14); // [6]12bit + [7]2bit
-	//syslog(LOG_LOCAL0|LOG_DEBUG, "[decode_from_sta] tempaltitude = %d", temp);
-	po->alt = temp * 2.0; 
-	
-	temp = (((int)ntohs(sta->s6_addr16[4]) & 0x3f) << 20) + ((int)ntohs(sta->s6_addr16[5]) << 4) + (((int)ntohs(sta->s6_addr16[6]) & 0xf000) >> 12); // [4]6bit + [5]16bitS + [6]4bit
-	//syslog(LOG_LOCAL0|LOG_DEBUG, "[decode_from_sta] templatitude = %d", temp);  
-	po->lat = (temp << 2) / 1000000.0 - 90.0;
-	
-	temp = ((int)ntohs(sta->s6_addr16[3]) << 10) + (((int)ntohs(sta->s6_addr16[4]) & 0xffc0) >> 6); // [3]16bitS + [4]10bit
-	//syslog(LOG_LOCAL0|LOG_DEBUG, "[decode_from_sta] templongitude = %d", temp);
-	po->lon = (temp << 3) / 1000000.0 - 180.0;
-	
-	syslog(LOG_LOCAL0|LOG_DEBUG, "[decode_from_sta] (time,lng,lat,alt)=(%ld, %f, %f, %f)", po->time, po->lon, po->lat, po->alt);
-	
-	return 0;
+static void submit_position(const PositionOut *output) {
+    if (stage_push(&decision_queue, output) != 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[submit_position] decision queue is full, index=%lu dropped", output->index);
+    }
 }
 
 /**
- * @brief STAaddB
+ * @brief f̒i
  *
- * C^[tF[XSTAaddB
- * 
- * @param newsta VSTA
- * @retval 0 
- * @retval -1 s
+ * ǂݍ݂̒i󂯎ʒu𕽊ADADv邩fB
+ * @param arg gĂȂ
+ * @retval NULL NULLԂ
  */
-static int add_sta(struct sockaddr_in6 *newsta) {
-	int fd = -1;
-    struct ifreq ifr;
-    struct in6_ifreq ifr6;
-    char host[NI_MAXHOST];
+static void *decision_stage(void *arg) {
+    PositionOut output;
     
-    newsta->sin6_family = AF_INET6;
-    newsta->sin6_port = 0;
-    memcpy((char *)&ifr6.ifr6_addr, (char *)&(newsta->sin6_addr), sizeof(struct in6_addr));
-
-    fd = get_socket_for_afinet6();
-    if (fd < 0) {
-        syslog(LOG_LOCAL0|LOG_DEBUG, "[update_sta] No support for INET6 on this system.");
-        return -1;
+    UNUSED(arg);
+    pthread_detach(pthread_self());
+    stage_pin(stage_cpus[STAGE_DECISION]);
+    for (;;) {
+        stage_pop(&decision_queue, &output);
+        handle_position(&output);
     }
+    return NULL;
+}
 
-    strcpy(ifr.ifr_name, wlan_interface);
-    // SIOGIFINDEXSIOCGIFINDEX͓Btypo\hdefineB
-    if (ioctl(fd, SIOCGIFINDEX, &ifr) < 0) {
-        syslog(LOG_LOCAL0|LOG_DEBUG, "[update_sta] SIOCGIFINDEX error: %m");
-        return -1;
+/**
+ * @brief DAD̒i
+ *
+ * f̒iDADvƂʒuAAREQ𑗂ă^C}[B
+ * @param arg gĂȂ
+ * @retval NULL NULLԂ
+ */
+static void *dad_stage(void *arg) {
+    PositionOut output;
+    struct sockaddr_in6 sin6;
+    
+    UNUSED(arg);
+    pthread_detach(pthread_self());
+    stage_pin(stage_cpus[STAGE_DAD]);
+    for (;;) {
+        stage_pop(&dad_queue, &output);
+        start_dad(&output, &sin6);
     }
-    ifr6.ifr6_ifindex = ifr.ifr_ifindex;
-    ifr6.ifr6_prefixlen = 0;
+    return NULL;
+}
 
-    // ȉ̃AhXݒioctlrootłȂƎss\.
-    if (ioctl(fd, SIOCSIFADDR, &ifr6) < 0) {
-        syslog(LOG_LOCAL0|LOG_DEBUG, "[update_sta] SIOCSIFADDR error: %m");
-        return -1;
-    }
+/**
+ * @brief AhX̐ݒ̒iɈ˗
+ *
+ * ^C}[Ɛ̃XbhĂԁB˗͎̂ĂȂ̂ŁAi󂯂܂ő҂B
+ * @param preq ˗
+ */
+static void program_push(const program_request *preq) {
+    struct timespec ts;
     
-    // OɋL^
-    getnameinfo((struct sockaddr *)newsta, sizeof(struct sockaddr_in6), host, sizeof(host), NULL, 0, NI_NUMERICHOST);
-    syslog(LOG_LOCAL0|LOG_DEBUG, "# add_sta complete, new address = %s", host);
+    pthread_mutex_lock(&program_push_mutex);
+    while (stage_push(&program_queue, preq) != 0) {
+        ts.tv_sec = 0;
+        ts.tv_nsec = 1000000;
+        nanosleep(&ts, NULL);
+    }
+    pthread_mutex_unlock(&program_push_mutex);
+}
+
+/**
+ * @brief AhX̐ݒ̒i
+ *
+ * m肵STAC^[tF[Xɐݒ肷BioctlxĂAق̒i͐ɐiށB
+ * \PbgADD/DELŏAm肵STA̐ݒƓȂ悤ɂB
+ * @param arg gĂȂ
+ * @retval NULL NULLԂ
+ */
+static void *program_stage(void *arg) {
+    program_request preq;
     
-    return 0;
+    UNUSED(arg);
+    pthread_detach(pthread_self());
+    stage_pin(stage_cpus[STAGE_PROGRAM]);
+    for (;;) {
+        stage_pop(&program_queue, &preq);
+        if (preq.req == NULL) {
+            program_sta(&(preq.sta));
+            continue;
+        }
+        ctl_handle_change(preq.req, preq.payload, preq.rep, preq.out);
+        pthread_mutex_lock(&program_done_mutex);
+        *(preq.done) = 1;
+        pthread_cond_broadcast(&program_done_cond);
+        pthread_mutex_unlock(&program_done_mutex);
+    }
+    return NULL;
 }
 
 /**
- * @brief ÂSTAdelB
+ * @brief iƃL[pӂăXbhN
  *
- * C^[tF[X̌ÂSTAdelB
- * @param oldsta 폜ÂSTA
+ * ǂݍ݂̒irecv_from_fiforeplay_positions̃Xbĥ܂܎󂯎B
  * @retval 0 
  * @retval -1 s
  */
-static int delete_sta(struct sockaddr_in6 *oldsta) {
-	int fd = -1;
-    struct ifreq ifr;
-    struct in6_ifreq ifr6;
-	
-	memcpy((char *)&ifr6.ifr6_addr, (char *)&(oldsta->sin6_addr), sizeof(struct in6_addr));
-	
-	fd = get_socket_for_afinet6();
-	if (fd < 0) {
-		syslog(LOG_LOCAL0|LOG_DEBUG, "[delete_sta] No support for INET6 on this system.");
+static int init_stages() {
+    pthread_t tid;
+    
+    if (stage_queue_init(&decision_queue, STAGE_DECISION_QUEUE_LEN, sizeof(PositionOut)) != 0
+        || stage_queue_init(&dad_queue, STAGE_DAD_QUEUE_LEN, sizeof(PositionOut)) != 0
+        || stage_queue_init(&program_queue, STAGE_PROGRAM_QUEUE_LEN, sizeof(program_request)) != 0) {
         return -1;
-	}
-	
-	strcpy(ifr.ifr_name, wlan_interface);
-	// SIOGIFINDEXSIOCGIFINDEX͓Btypo\hdefineB
-	if (ioctl(fd, SIOCGIFINDEX, &ifr) < 0) {
-		syslog(LOG_LOCAL0|LOG_DEBUG, "[delete_sta] SIOGIFINDEX error: %m");
+    }
+    if (pthread_create(&tid, NULL, decision_stage, NULL) != 0
+        || pthread_create(&tid, NULL, dad_stage, NULL) != 0
+        || pthread_create(&tid, NULL, program_stage, NULL) != 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[init_stages] pthread_create error: %m");
         return -1;
-	}
-	ifr6.ifr6_ifindex = ifr.ifr_ifindex;
-	ifr6.ifr6_prefixlen = 0;
-	
-	// ȉ̃AhXݒioctlrootłȂƎss\.
-	if (ioctl(fd, SIOCDIFADDR, &ifr6) < 0) {
-		syslog(LOG_LOCAL0|LOG_DEBUG, "[delete_sta] SIOCDIFADDR error: %m");
-		return -1;
-	}
-	
-	return 0;
+    }
+    return 0;
 }
 
 /**
- * @brief AREQu[hLXgWT҂
- *
- * AREQ(Allocation REQest)𖳐aɃu[hLXgWTb҂
+ * @brief Đʒuǂ
  *
- * @retval 0 dȂ
- * @retval 1 dĂƂ̕ԓ
+ * 1sɁutime lat lon altv󔒂ŋ؂ďB#sƋs͓ǂݔ΂B
+ * PositionOut̂܂ܕׂtime_tlong̑傫Ō`ς̂ŁAeLXgɂĂB
+ * @param path t@C̃pX
+ * @param[out] n ǂ񂾈ʒu̐
+ * @return ǂ񂾈ʒuBmalloćB1ȂNULL
  */
-static int allocation_request_start(struct sockaddr_in6 newsta) {
-    int ret;
-    struct sockaddr_in6 toaddr_in6;
-    u_int16_t type;
-    u_int16_t reserved = 0;
-    char *buf;
-    char host[NI_MAXHOST];
-    int mcast_if;
-    socklen_t optlen;
-    char *mcast_if_name;
-    
-    memset(&toaddr_in6, sizeof(toaddr_in6), 0);
-    toaddr_in6.sin6_family = AF_INET6;
-    toaddr_in6.sin6_addr = in6addr_linklocalmulticast;
-    toaddr_in6.sin6_port = htons(udp_port);
-    
-    type = AREQ;
-    
-    buf = (char *)malloc(AREQ_PACKET_SIZE * sizeof(char));
-    memset(buf, 0, AREQ_PACKET_SIZE);
-    memcpy(buf, &type, sizeof(type));
-    // memcpy(buf[sizeof(type)], reserved, sizeof(reserved)); // ̂Ƃ0Ȃ̂Ŏsv
-    memcpy(&(buf[sizeof(type) + sizeof(reserved)]), &newsta, sizeof(newsta));
+static PositionOut *load_replay(const char *path, size_t *n) {
+    PositionOut *records = NULL;
+    PositionOut *grown;
+    size_t capacity = 0;
+    char line[256];
+    long long t;
+    double lat, lon, alt;
+    FILE *fp;
+    char *p;
     
-    // OɋL^
-    if ((ret = getnameinfo((struct sockaddr *)&newsta, sizeof(struct sockaddr_in6), host, sizeof(host), NULL, 0, NI_NUMERICHOST)) != 0) {
-        syslog(LOG_LOCAL0|LOG_DEBUG, "[allocation_request_start] getnameinfo error: %s", gai_strerror(ret));
-    } else {
-        syslog(LOG_LOCAL0|LOG_DEBUG, "# allocation_request_start temp address = %s", host);
+    *n = 0;
+    if ((fp = fopen(path, "r")) == NULL) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[load_replay] %m : open %s", path);
+        return NULL;
+    }
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if ((p = strchr(line, '#')) != NULL) {
+            *p = '\0';
+        }
+        if (sscanf(line, "%lld %lf %lf %lf", &t, &lat, &lon, &alt) != 4) {
+            continue;
+        }
+        if (*n == capacity) {
+            capacity = (capacity > 0) ? capacity * 2 : 64;
+            grown = (PositionOut *)realloc(records, capacity * sizeof(PositionOut));
+            if (grown == NULL) {
+                break;
+            }
+            records = grown;
+        }
+        memset(&records[*n], 0, sizeof(PositionOut));
+        records[*n].index = *n;
+        records[*n].time = (time_t)t;
+        records[*n].lat = lat;
+        records[*n].lon = lon;
+        records[*n].alt = alt;
+        (*n)++;
     }
+    fclose(fp);
+    if (*n == 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[load_replay] no records in %s", path);
+        free(records);
+        return NULL;
+    }
+    return records;
+}
+
+/**
+ * @brief L^ʒuĐ
+ *
+ * -r̂Ƃrecv_from_fifȏɓBt@C͍ŏɑSǂłA
+ * L^̎̊Ԋuǂɔf̒i֓n̂REPLAY_PASSESJԂB
+ * 1ڂŃXbhobt@o낤̂ŁAŌ1q[v̊mۂ𐔂A
+ * 1łmۂĂΏIR[h1ɂBmake check͂Ŋm߂B
+ * mۂ𐔂Ȃrh(stamd-checkłȂstamd)ł͍Đ邾ŁAIR[h0B
+ * @param arg ʂint
+ * @retval NULL NULLԂ
+ */
+static void *replay_positions(void *arg) {
+    int *status = (int *)arg;
+    PositionOut *records;
+    PositionOut output;
+    struct timespec ts;
+    size_t n, i;
+    uint64_t before = 0;
+    int pass;
     
-    // /proc/net/igmp6Ƃ킩邪ftHgff02::1ɂ͎QĂ͂
-    // Double Check̂
-    ret = check_allnodes_membership(sockfd, if_nametoindex(WLAN_INTERFACE));
+    *status = 1;
+    stage_pin(stage_cpus[STAGE_INGEST]);
+    if ((records = load_replay(replay_path, &n)) == NULL) {
+        return NULL;
+    }
     
-    mcast_if = if_nametoindex(WLAN_INTERFACE);
-    optlen = sizeof(mcast_if);
-    ret = setsockopt(sockfd, IPPROTO_IPV6, IPV6_MULTICAST_IF, &mcast_if, sizeof(mcast_if));
-    if (ret != 0) {
-        syslog(LOG_LOCAL0|LOG_DEBUG, "[allocation_request_start] setsockopt error: %m");
-        return 0;
+    for (pass = 0; pass < REPLAY_PASSES && !srv_shutdown; pass++) {
+        if (pass == REPLAY_PASSES - 1) {
+            before = alloc_count();
+        }
+        for (i = 0; i < n && !srv_shutdown; i++) {
+            if (i > 0 && records[i].time > records[i - 1].time) {
+                ts.tv_sec = records[i].time - records[i - 1].time;
+                ts.tv_nsec = 0;
+                nanosleep(&ts, NULL);
+            }
+            output = records[i];
+            submit_position(&output);
+        }
+        // ŌDADI܂ő҂
+        ts.tv_sec = waiting_time + 1;
+        ts.tv_nsec = 0;
+        nanosleep(&ts, NULL);
     }
     
-    mcast_if = 0;
-    optlen = sizeof(mcast_if);
-    if (getsockopt(sockfd, IPPROTO_IPV6, IPV6_MULTICAST_IF, &mcast_if, &optlen) == 0) {
-        mcast_if_name = (char *)malloc(IF_NAMESIZE * sizeof(char));
-        memset(mcast_if_name, 0, IF_NAMESIZE * sizeof(char));
-        if_indextoname(mcast_if, mcast_if_name);
-        syslog(LOG_LOCAL0|LOG_DEBUG, "[allocation_request_start] mcast_if is: %s(%d); optlen=%d", mcast_if_name, mcast_if, optlen);
-    } else {
-        syslog(LOG_LOCAL0|LOG_DEBUG, "[allocation_request_start] getsockopt failed");
+    if (before == ALLOC_NOT_COUNTED) {
+        *status = 0;
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[replay_positions] allocations are not counted in this build, use stamd-check");
+        free(records);
+        return NULL;
     }
+    n = (size_t)(alloc_count() - before);
+    *status = (n > 0);
+    syslog(LOG_LOCAL0|LOG_DEBUG, "[replay_positions] %lu allocations in the last pass", (unsigned long)n);
+    free(records);
+    return NULL;
+}
+
+/**
+ * @brief 󂯎ʒu
+ *
+ * STAȂDADn߁AΗL͈͂oƂDADn߂B
+ * }`eig[hȂ烏[J[ɔCB
+ * @param output 󂯎ʒuB̂ŏ
+ */
+static void handle_position(PositionOut *output) {
+    published_state state;
+    PositionOut decode;
     
-    // u[hLXgsend
-    ret = sendto(sockfd, buf, AREQ_PACKET_SIZE, 0, (struct sockaddr *)&toaddr_in6, sizeof(toaddr_in6));
+    syslog(LOG_LOCAL0|LOG_DEBUG, "[handle_position] index=%lu", output->index);
+    METRIC_INC(samples);
+
+    // }`eig[hȂ烏[J[ɔCB[J[ōs
+    if (tenant_max > 0) {
+        tenant_dispatch_sample(output);
+        return;
+    }
+
+    smooth_fix(&my_fix, output);
     
-    // WTb̃^C}[I
-    timer_on(0, &allocation_request_timeout, waiting_time);
+    // ath0STA蓖ĂĂ邩`FbN
+    // AhXZbgĂȂ΃Zbg
+    // C^[tF[XSTAsta_link̃CxgŌJĂ̂ŁATvƂɂׂ͒Ȃ
+    read_state(&state);
     
-    free(buf);
-    return 0;
+    if (state.flag == DAD) {
+        return; // DADBdad_stagestart_dadłêŁAL[ɐς܂Ȃ
+    } else if (!state.has_sta) { // Ȃ
+        request_dad(output); // AREQ𑗂WT҂
+    } else { // 
+    	if (decode_from_sta(&(state.sta), &decode) == -1) {
+    		syslog(LOG_LOCAL0|LOG_DEBUG, "[handle_position] decode_from_sta error");
+    		return;
+    	}
+    	
+    	if (!should_leave_range(&my_hyst, output, &decode)) { // L͈͈ȓ(AoƂ͂܂Ȃ)Ȃ甲
+    		// syslog(LOG_LOCAL0|LOG_DEBUG, "[handle_position] OK, in the STA valid range.");
+    		// do nothing.
+    	} else { // ͈͂oĂ΁AAhXXV
+    		//syslog(LOG_LOCAL0|LOG_DEBUG, "[handle_position] No! outside the range.");
+            request_dad(output); // AREQ𑗂WT҂
+    	}
+    }
 }
 
 /**
- * @brief AREQu[hLXg̃^CAEg
+ * @brief DAD̒iDAD𗊂
  *
- * AREQu[hLXgƃ^CAEgƂ̏
- * AhXmA܂͏dĂPɔ
- * @return 0 0Ԃ
+ * f̒iĂԁB
+ * @param po ʒu
  */
-static void allocation_request_timeout() {
-    struct ifaddrs *ifap0, *ifap;
-    struct sockaddr_in6 mysta_sin6;
-    int found = 0;
-    
-    pthread_mutex_lock(&(temp_address.mutex));
-    if (temp_address.flag == DAD) {
-        // STA𒲂ׂ
-        if (getifaddrs(&ifap0)) {
-            syslog(LOG_LOCAL0|LOG_DEBUG, "[allocation_request_timeout] getifaddrs error %m");
-        }
-        for (ifap = ifap0; ifap; ifap = ifap->ifa_next) {
-            if (strstr(ifap->ifa_name, wlan_interface)) {
-                if (ifap->ifa_addr == NULL) {
-                    syslog(LOG_LOCAL0|LOG_DEBUG, "[allocation_request_timeout] %s ifa_addr is NULL!!", wlan_interface);
-                    continue;
-                }
-                if (ifap->ifa_addr->sa_family == AF_INET6) {
-                    struct sockaddr_in6 *temp_sockaddr_in6 = (struct sockaddr_in6 *)(ifap->ifa_addr);
-                    if (IN6_IS_ADDR_STA(&temp_sockaddr_in6->sin6_addr)) {
-                    	found = 1;
-                        mysta_sin6 = *temp_sockaddr_in6;
-                        break;
-                    } else {
-                        continue;
-                    }
-                } else {
-                    // v4AhX
-                    continue;
-                }
-            } else {
-                // ath0ȊO
+static void request_dad(const PositionOut *po) {
+    if (stage_push(&dad_queue, po) != 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[request_dad] DAD queue is full, index=%lu dropped", po->index);
+    }
+}
+
+/**
+ * @brief ʒuSTADADn߂
+ *
+ * VOm[ĥƂAʒuAhXtemp_addressɓAREQ𑗂B
+ * łDADȂ牽ȂB
+ * @param po ʒu
+ * @param[out] candidate AhX
+ * @retval 0 DADn߂
+ * @retval 1 łDAD
+ * @retval -1 s
+ */
+static int start_dad(const PositionOut *po, struct sockaddr_in6 *candidate) {
+    struct timeval tv;
+    struct in6_addr candidates[MULTI_MAX];
+    uint32_t txid;
+    int ncandidates = areq_candidates;
+    int i;
+    
+    memset(candidate, 0, sizeof(*candidate));
+    if (encode_to_sta(*po, &(candidate->sin6_addr)) == -1) {
+        return -1;
+    }
+    candidate->sin6_family = AF_INET6;
+    
+    // AREQȂÃrbg炵\̌ꏏɖ₢킹
+    // Ȃzuł͗\Ȃ̂ŁA1
+    candidates[0] = candidate->sin6_addr;
+    for (i = 1; i < ncandidates; i++) {
+        if (sta_shift_time(sta_layout_active, &(candidate->sin6_addr), i, &candidates[i]) != 0) {
+            ncandidates = 1;
+        }
+    }
+    // ]̃m[h͕AREQ̂Ă̂ŁA܂ɂȂ{₢킹
+    if (ncandidates > 1 && !wire_multi_ok(time(NULL))) {
+        ncandidates = 1;
+    }
+    txid = (uint32_t)random();
+    
+    pthread_mutex_lock(&(temp_address.mutex));
+    if (temp_address.flag == DAD) {
+        pthread_mutex_unlock(&(temp_address.mutex));
+        return 1;
+    }
+    
+    gettimeofday(&tv, NULL);
+    temp_address.generated_time = tv.tv_sec;
+    temp_address.address = *candidate;
+    memcpy(temp_address.candidates, candidates, ncandidates * sizeof(struct in6_addr));
+    temp_address.ncandidates = ncandidates;
+    temp_address.duplicate = 0;
+    temp_address.txid = txid;
+    temp_address.flag = DAD;
+    publish_state();
+    pthread_mutex_unlock(&(temp_address.mutex));
+    
+    follow_pending(TENANT_ADDR_PENDING, &(candidate->sin6_addr)); // ̃ZAREQ悤
+    METRIC_INC(dad_started);
+    allocation_request_start(candidates, ncandidates, txid, waiting_time); // AREQ𑗂WT҂
+    return 0;
+}
+
+/**
+ * @brief DAĎ̃ZǂA-B̃tB^ɂm点
+ *
+ * cell_followTENANT_ADDR_PENDING̃XbgDAD̎n܂ƏIɂς̂ŁA
+ * ƂŃtB^AREPʂǂςBAREQ𑗂OɌĂԂƁB
+ * @param slot cell_follow̃Xbg
+ * @param addr DAĎBDADIȂNULL
+ */
+static void follow_pending(int slot, const struct in6_addr *addr) {
+    cell_follow(slot, addr);
+    if (socket_filter) {
+        filter_pending(slot, addr != NULL);
+    }
+}
+
+/**
+ * @brief find_my_stalink_addrsĂ΂
+ *
+ * @param ifindex AhX̃C^[tF[Xԍ
+ * @param addr AhX
+ * @param arg TĂsockaddr_in6Bsin6_scope_idwlan_interface̔ԍĂ
+ * @retval 1 ̂ł߂
+ * @retval 0 
+ */
+static int find_my_sta_cb(unsigned int ifindex, const struct in6_addr *addr, void *arg) {
+    struct sockaddr_in6 *sta = (struct sockaddr_in6 *)arg;
+    
+    if (ifindex != sta->sin6_scope_id || !IN6_IS_ADDR_STA(addr) || handoff_holds(addr)) { // 񐄏ɂSTA͏
+        return 0;
+    }
+    sta->sin6_addr = *addr;
+    sta->sin6_family = AF_INET6;
+    return 1;
+}
+
+/**
+ * @brief STAT
+ *
+ * wlan_interfaceɊ蓖ĂĂSTATB
+ * DAD̂тɌĂ΂̂ŁAgetifaddrsł͂Ȃq[vgȂlink_addrsŒׂB
+ * @param[out] sta STA
+ * @retval 0 
+ * @retval -1 Ȃ
+ */
+static int find_my_sta(struct sockaddr_in6 *sta) {
+    struct sockaddr_in6 found;
+    
+    memset(&found, 0, sizeof(found));
+    found.sin6_scope_id = if_nametoindex(wlan_interface);
+    if (found.sin6_scope_id == 0 || link_addrs(find_my_sta_cb, &found) != 0 || found.sin6_family != AF_INET6) {
+        return -1;
+    }
+    found.sin6_scope_id = 0;
+    *sta = found;
+    return 0;
+}
+
+/**
+ * @brief 葤̍TJ
+ *
+ * temp_address.mutexԂŌĂԂƁB蓯m͂mutexŔrB
+ */
+static void publish_state() {
+    seqlock_write_begin(&state_seq);
+    published.sta = temp_address.sta;
+    published.has_sta = temp_address.has_sta;
+    published.flag = temp_address.flag;
+    published.pending = temp_address.address.sin6_addr;
+    published.generated_time = temp_address.generated_time;
+    memcpy(published.candidates, temp_address.candidates, sizeof(published.candidates));
+    published.ncandidates = temp_address.ncandidates;
+    seqlock_write_end(&state_seq);
+    snap_kick(); // XibvVbgɂ
+}
+
+/**
+ * @brief STAJ
+ *
+ * @param sta STABNULLȂSTAȂ
+ */
+static void publish_sta(const struct in6_addr *sta) {
+    pthread_mutex_lock(&(temp_address.mutex));
+    if (sta != NULL) {
+        temp_address.sta = *sta;
+        temp_address.has_sta = 1;
+    } else {
+        memset(&(temp_address.sta), 0, sizeof(temp_address.sta));
+        temp_address.has_sta = 0;
+    }
+    publish_state();
+    pthread_mutex_unlock(&(temp_address.mutex));
+}
+
+/**
+ * @brief JĂԂǂ
+ *
+ * bNȂ̂ŁAAREQ/AREP̏ĂłubNȂB
+ * @param[out] out ǂ񂾏
+ */
+static void read_state(published_state *out) {
+    unsigned int seq;
+    
+    do {
+        seq = seqlock_read_begin(&state_seq);
+        memcpy(out, &published, sizeof(*out));
+    } while (seqlock_read_retry(&state_seq, seq));
+}
+
+/**
+ * @brief C^[tF[XSTA𒲂גČJ
+ *
+ * NƁAsta_linkwlan_interfacẽAhX̑m点ĂƂɌĂԁB
+ * staconfigȂǊO瑫ꂽSTAŒǂB
+ */
+static void refresh_my_sta() {
+    struct sockaddr_in6 sta;
+    
+    publish_sta(find_my_sta(&sta) == 0 ? &(sta.sin6_addr) : NULL);
+}
+
+/**
+ * @brief refresh_my_addrslink_addrsĂ΂
+ *
+ * @param ifindex AhX̃C^[tF[Xԍ
+ * @param addr AhX
+ * @param arg W߂Ămy_addrs_dump
+ * @retval 1 tȂ̂ł߂
+ * @retval 0 
+ */
+static int refresh_my_addrs_cb(unsigned int ifindex, const struct in6_addr *addr, void *arg) {
+    my_addrs_dump *dump = (my_addrs_dump *)arg;
+    
+    UNUSED(ifindex);
+    dump->addrs[dump->n++] = *addr;
+    return (dump->n == MY_ADDRS_MAX);
+}
+
+/**
+ * @brief IPv6AhX𒲂ג
+ *
+ * is_from_myselfpPbgƂgetifaddrsĂ΂Ȃčςނ悤ɊoĂB
+ * NƁAsta_linkwlan_interfacẽAhX̑m点ĂƂɌĂԁB
+ * netlink͎̉茳̔zɏW߂Ԃɍς܂AV[PXbN͎̒ʂɂB
+ */
+static void refresh_my_addrs() {
+    my_addrs_dump dump;
+    
+    pthread_mutex_lock(&my_addrs_mutex);
+    dump.n = 0;
+    if (link_addrs(refresh_my_addrs_cb, &dump) != 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[refresh_my_addrs] link_addrs error");
+        pthread_mutex_unlock(&my_addrs_mutex);
+        return; // ÕAhX̂܂
+    }
+    seqlock_write_begin(&my_addrs_seq);
+    memcpy(my_addrs, dump.addrs, dump.n * sizeof(struct in6_addr));
+    my_naddrs = dump.n;
+    seqlock_write_end(&my_addrs_seq);
+    pthread_mutex_unlock(&my_addrs_mutex);
+}
+
+/**
+ * @brief wlan_interfaceIPv6AhXƂ̏
+ *
+ * sta_link̊ĎXbhĂ΂B
+ */
+static void on_addr_change() {
+    refresh_my_addrs();
+    if (tenant_max == 0) {
+        refresh_my_sta(); // staconfigȂǊO瑫ꂽSTAǂ
+    }
+}
+
+/**
+ * @brief XibvVbgɏԂW߂
+ *
+ * sta_snap̃XbhĂ΂B
+ * @param[out] buf snapshot_state
+ * @param size buf̑傫
+ * @return Bߗ׃m[h͎gĂ镪
+ */
+static size_t snapshot_collect(void *buf, size_t size) {
+    snapshot_state *snap = (snapshot_state *)buf;
+    int truncated;
+    
+    if (size < sizeof(snapshot_state)) {
+        return 0;
+    }
+    memset(snap, 0, offsetof(snapshot_state, neigh));
+    strncpy(snap->ifname, wlan_interface, sizeof(snap->ifname) - 1);
+    snap->saved = time(NULL);
+    if (tenant_max == 0) {
+        pthread_mutex_lock(&(temp_address.mutex));
+        snap->has_sta = temp_address.has_sta;
+        snap->sta = temp_address.sta;
+        snap->dad_flag = temp_address.flag;
+        snap->ncandidates = temp_address.ncandidates;
+        snap->duplicate = temp_address.duplicate;
+        snap->txid = temp_address.txid;
+        snap->generated_time = temp_address.generated_time;
+        memcpy(snap->candidates, temp_address.candidates, sizeof(snap->candidates));
+        pthread_mutex_unlock(&(temp_address.mutex));
+    }
+    memcpy(&(snap->metrics), &metrics, sizeof(snap->metrics));
+    snap->neigh_swept = neigh_swept_at();
+    snap->nneigh = (uint32_t)neigh_dump(snap->neigh, NEIGH_MAX, &truncated);
+    return offsetof(snapshot_state, neigh) + snap->nneigh * sizeof(sta_ctl_neigh);
+}
+
+/**
+ * @brief XibvVbgԂǂݖ߂
+ *
+ * JE^Ƌߗ׃m[h̕\͂̂܂ܖ߂BSTA̓C^[tF[Xɂ̂𐳂ƂA
+ * XibvVbgSTAȂΎ̂ĂBDADWT߂ĂȂΖ߂A
+ * NIĂresume_dadőBUDP̎Mn߂OɌĂԂƁB
+ * @retval 1 DAD𑱂
+ * @retval 0 DAD͂Ȃ
+ */
+static int restore_snapshot() {
+    snapshot_state *snap;
+    published_state state;
+    size_t len;
+    time_t now;
+    char host[INET6_ADDRSTRLEN];
+    int resume = 0;
+    
+    snap = (snapshot_state *)malloc(sizeof(snapshot_state));
+    if (snap == NULL) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[restore_snapshot] malloc error");
+        return 0;
+    }
+    len = snap_load(snap, sizeof(snapshot_state));
+    if (len < offsetof(snapshot_state, neigh) || snap->nneigh > NEIGH_MAX
+        || len != offsetof(snapshot_state, neigh) + snap->nneigh * sizeof(sta_ctl_neigh)) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[restore_snapshot] no snapshot in %s", snap_path);
+        free(snap);
+        return 0;
+    }
+    if (strncmp(snap->ifname, wlan_interface, sizeof(snap->ifname)) != 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[restore_snapshot] snapshot is for %s, not %s, ignored", snap->ifname, wlan_interface);
+        free(snap);
+        return 0;
+    }
+    now = time(NULL);
+    
+    // JE^͑琔
+    memcpy(&metrics, &(snap->metrics), sizeof(metrics));
+    neigh_restore(snap->neigh, snap->nneigh, if_nametoindex(wlan_interface), (time_t)snap->neigh_swept);
+    
+    if (tenant_max == 0) {
+        read_state(&state); // init_temporary_address_statusC^[tF[Xǂ񂾂
+        if (snap->has_sta && !(state.has_sta && in6_addr_equal(&(snap->sta), &(state.sta)))) {
+            inet_ntop(AF_INET6, &(snap->sta), host, sizeof(host));
+            syslog(LOG_LOCAL0|LOG_DEBUG, "[restore_snapshot] %s is no longer on %s, ignored", host, wlan_interface);
+        }
+        if (snap->dad_flag == DAD && snap->ncandidates >= 1 && snap->ncandidates <= MULTI_MAX
+            && snap->generated_time + waiting_time > now) {
+            pthread_mutex_lock(&(temp_address.mutex));
+            memset(&(temp_address.address), 0, sizeof(temp_address.address));
+            temp_address.address.sin6_family = AF_INET6;
+            temp_address.address.sin6_addr = snap->candidates[0];
+            temp_address.generated_time = (time_t)snap->generated_time;
+            memcpy(temp_address.candidates, snap->candidates, sizeof(temp_address.candidates));
+            temp_address.ncandidates = snap->ncandidates;
+            temp_address.duplicate = snap->duplicate;
+            temp_address.txid = snap->txid;
+            temp_address.flag = DAD;
+            publish_state();
+            pthread_mutex_unlock(&(temp_address.mutex));
+            resume = 1;
+        }
+    }
+    syslog(LOG_LOCAL0|LOG_DEBUG, "restored snapshot saved %ld sec ago: %u neighbours, %s",
+           (long)(now - snap->saved), snap->nneigh, resume ? "resuming DAD" : "no DAD in flight");
+    free(snap);
+    return resume;
+}
+
+/**
+ * @brief ǂݖ߂DAD𑱂
+ *
+ * AREQ𑗂蒼AƂWT̎c肾҂B~܂ĂԂ̕ԓ͕ĂȂ̂ŁA
+ * 蒼Ɋm͂ȂB
+ */
+static void resume_dad() {
+    struct in6_addr candidates[MULTI_MAX];
+    int count;
+    uint32_t txid;
+    time_t deadline;
+    int wait;
+    
+    pthread_mutex_lock(&(temp_address.mutex));
+    // NĂŋߗ׃m[ȟ`킩Ȃ΁A{₢킹
+    if (temp_address.ncandidates > 1 && !wire_multi_ok(time(NULL))) {
+        temp_address.ncandidates = 1;
+        publish_state();
+    }
+    memcpy(candidates, temp_address.candidates, sizeof(candidates));
+    count = temp_address.ncandidates;
+    txid = temp_address.txid;
+    deadline = temp_address.generated_time + waiting_time;
+    pthread_mutex_unlock(&(temp_address.mutex));
+    
+    wait = (int)(deadline - time(NULL));
+    if (wait < 1) {
+        wait = 1;
+    }
+    follow_pending(TENANT_ADDR_PENDING, &candidates[0]);
+    allocation_request_start(candidates, count, txid, wait);
+}
+
+/**
+ * @brief eig̃Tv[J[ɐU蕪
+ *
+ * nodeideig(ȂΓo^)Anodeid̃nbVŒS[J[ɓnB
+ * @param po FIFO󂯎ʒu
+ */
+static void tenant_dispatch_sample(const PositionOut *po) {
+    tenant_sample sample;
+
+    pthread_mutex_lock(&tenant_add_mutex);
+    sample.idx = tenant_lookup_or_add(po->nodeid);
+    pthread_mutex_unlock(&tenant_add_mutex);
+    if (sample.idx == -1) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[tenant_dispatch_sample] tenant table is full (%d)", tenant_max);
+        return;
+    }
+    sample.po = *po;
+    sample.seq = ++tenants.dispatched[sample.idx];
+
+    if (tenant_pool_dispatch(tenants.nodeid_hash[sample.idx], &sample) != 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[tenant_dispatch_sample] queue is full, index=%lu dropped", po->index);
+    }
+}
+
+/**
+ * @brief eig̃Tv
+ *
+ * [J[XbhĂ΂B
+ * ɂȃ[J[ނ̂ŁAeig̈ʒu2̃[J[œɏ邱ƂB
+ * Ɣftenant_start_dad̒ŃeiglockčsB
+ * @param item tenant_sample
+ */
+static void tenant_handle_sample(void *item) {
+    tenant_sample *sample = (tenant_sample *)item;
+    struct sockaddr_in6 candidate;
+
+    tenant_start_dad(sample->idx, &(sample->po), sample->seq, 0, &candidate);
+}
+
+/**
+ * @brief eigDADn߂
+ *
+ * VOm[hrecv_from_fifoƓeig\̏ōsAKvȂDADn߂B
+ * L͈͂̊_STA蓖ĂƂɌvZς݂̂̂gB
+ * @param idx eigԍ
+ * @param po ʒuBseq0łȂΕď
+ * @param seq [J[ɓnƂ̈ʒu̔ԍB0Ȃ琧\Pbg̈ʒuŁAԂ̊mFȂ
+ * @param force 1ȂL͈͓łDAD
+ * @param[out] candidate AhX
+ * @retval 0 DADn߂
+ * @retval 1 łDAD
+ * @retval 2 L͈͓Ȃ̂ŉȂ
+ * @retval 3 ƐVʒuς݂Ȃ̂Ŏ̂Ă
+ * @retval -1 sA܂͑̃eigƏd
+ */
+static int tenant_start_dad(int idx, PositionOut *po, uint64_t seq, int force, struct sockaddr_in6 *candidate) {
+    PositionOut anchor;
+    struct sockaddr_in6 sin6;
+    struct timeval tv;
+    char host[NI_MAXHOST];
+
+    pthread_mutex_lock(&(tenants.lock[idx]));
+    if (seq != 0) {
+        if (seq <= tenants.handled[idx]) { // ܂ꂽÂʒuǂzꂽ
+            pthread_mutex_unlock(&(tenants.lock[idx]));
+            return 3;
+        }
+        tenants.handled[idx] = seq;
+        smooth_fix(&(tenants.fix[idx]), po);
+    }
+    if (tenants.dad_state[idx] == DAD) {
+        pthread_mutex_unlock(&(tenants.lock[idx]));
+        return 1;
+    }
+
+    if (tenants.has_sta[idx] && !force) {
+        memset(&anchor, 0, sizeof(anchor));
+        anchor.lat = tenants.anchor_lat[idx];
+        anchor.lon = tenants.anchor_lon[idx];
+        anchor.alt = tenants.anchor_alt[idx];
+        if (!should_leave_range(&(tenants.hyst[idx]), po, &anchor)) { // L͈͈ȓȂ甲
+            pthread_mutex_unlock(&(tenants.lock[idx]));
+            return 2;
+        }
+    }
+
+    memset(&sin6, 0, sizeof(sin6));
+    if (encode_to_sta(*po, &(sin6.sin6_addr)) == -1) {
+        pthread_mutex_unlock(&(tenants.lock[idx]));
+        return -1;
+    }
+    sin6.sin6_family = AF_INET6;
+
+    // stamd̕ʂ̃eiggĂ邩DADȂAAREQ𑗂܂łȂd
+    if (tenant_addr_lookup(&(sin6.sin6_addr), -1) != -1) {
+        tenants.dad_state[idx] = DUPLICATE;
+        pthread_mutex_unlock(&(tenants.lock[idx]));
+        METRIC_INC(dad_duplicate);
+        getnameinfo((struct sockaddr *)&sin6, sizeof(sin6), host, sizeof(host), NULL, 0, NI_NUMERICHOST);
+        syslog(LOG_LOCAL0|LOG_DEBUG, "# DUPLICATE [tenant_start_dad] %s (local tenant)", host);
+        return -1;
+    }
+
+    gettimeofday(&tv, NULL);
+    tenant_addr_insert(idx, TENANT_ADDR_PENDING, &(sin6.sin6_addr));
+    tenants.dad_state[idx] = DAD;
+    tenants.dad_deadline[idx] = tv.tv_sec + waiting_time;
+    pthread_mutex_unlock(&(tenants.lock[idx]));
+
+    *candidate = sin6;
+    follow_pending(idx * 2 + TENANT_ADDR_PENDING, &(sin6.sin6_addr));
+    METRIC_INC(dad_started);
+    // ^CAEgtenant_dad_reaper܂Ƃ߂Č
+    if (areq_candidates > 1 && wire_multi_ok(time(NULL))) {
+        multi_batch_add(&(sin6.sin6_addr)); // ̃eiǧ1AREQɂ܂Ƃ߂
+    } else {
+        send_areq(&sin6);
+    }
+    return 0;
+}
+
+/**
+ * @brief eigDAD
+ *
+ * d̕ԓȂ܂WT߂eig̃AhXm肷B
+ * tenants.lock[idx]ԂŌĂԂƁB
+ * @param idx eigԍ
+ */
+static void tenant_dad_complete(int idx) {
+    struct sockaddr_in6 oldsta;
+    struct sockaddr_in6 newsta;
+    PositionOut anchor;
+    int had_sta;
+
+    memset(&newsta, 0, sizeof(newsta));
+    newsta.sin6_family = AF_INET6;
+    newsta.sin6_addr = tenants.pending[idx];
+
+    had_sta = tenants.has_sta[idx];
+    if (had_sta) {
+        memset(&oldsta, 0, sizeof(oldsta));
+        oldsta.sin6_family = AF_INET6;
+        oldsta.sin6_addr = tenants.sta[idx];
+        if (handoff_grace == 0) {
+            delete_sta(&oldsta);
+        }
+        tenant_addr_remove(idx, TENANT_ADDR_CURRENT);
+    }
+
+    if (install_sta(&newsta) == 0) {
+        if (had_sta && handoff_grace > 0) {
+            retire_sta(&oldsta);
+        }
+        tenant_addr_insert(idx, TENANT_ADDR_CURRENT, &(newsta.sin6_addr));
+        cell_follow(idx * 2 + TENANT_ADDR_CURRENT, &(newsta.sin6_addr));
+        if (decode_from_sta(&(newsta.sin6_addr), &anchor) == 0) {
+            tenants.anchor_lat[idx] = anchor.lat;
+            tenants.anchor_lon[idx] = anchor.lon;
+            tenants.anchor_alt[idx] = anchor.alt;
+        }
+    } else if (had_sta && handoff_grace > 0) {
+        tenant_addr_insert(idx, TENANT_ADDR_CURRENT, &(oldsta.sin6_addr)); // ÂSTÂ܂
+    }
+    tenant_addr_remove(idx, TENANT_ADDR_PENDING);
+    follow_pending(idx * 2 + TENANT_ADDR_PENDING, NULL);
+    tenants.dad_state[idx] = NOT_DUPLICATE;
+    METRIC_INC(dad_completed);
+}
+
+/**
+ * @brief ܂Ƃ܂eiǧ𕡐AREQő
+ *
+ * sta_multĩXbhĂ΂B
+ * @param candidates 
+ * @param count ̐
+ */
+static void tenant_flush_candidates(const struct in6_addr *candidates, int count) {
+    send_areq_multi(candidates, count, (uint32_t)random());
+}
+
+/**
+ * @brief d̕ԓ̃eigDADł؂
+ *
+ * @param addr dĂ
+ * @retval 0 DAD̃eig
+ * @retval -1 Ȃ
+ */
+static int tenant_mark_duplicate(const struct in6_addr *addr) {
+    struct sockaddr_in6 sin6;
+    char host[NI_MAXHOST];
+    int idx;
+    
+    idx = tenant_addr_lookup(addr, TENANT_ADDR_PENDING);
+    if (idx == -1) {
+        return -1;
+    }
+    pthread_mutex_lock(&(tenants.lock[idx]));
+    if (tenants.dad_state[idx] == DAD) {
+        tenants.dad_state[idx] = DUPLICATE;
+        tenant_addr_remove(idx, TENANT_ADDR_PENDING);
+        follow_pending(idx * 2 + TENANT_ADDR_PENDING, NULL);
+        METRIC_INC(dad_duplicate);
+    }
+    pthread_mutex_unlock(&(tenants.lock[idx]));
+    memset(&sin6, 0, sizeof(sin6));
+    sin6.sin6_family = AF_INET6;
+    sin6.sin6_addr = *addr;
+    getnameinfo((struct sockaddr *)&sin6, sizeof(sin6), host, sizeof(host), NULL, 0, NI_NUMERICHOST);
+    syslog(LOG_LOCAL0|LOG_DEBUG, "# DUPLICATE [tenant_mark_duplicate] %s (tenant %d)", host, idx);
+    return 0;
+}
+
+/**
+ * @brief eigDAD̃^CAEg
+ *
+ * eigƂɃ^C}[Xbh𗧂Ăƃeig̃XbhɂȂ̂ŁA
+ * 1bƂɑSeigdad_deadlineĐ؂ꂽ̂m肳B
+ * @param arg gĂȂ
+ * @return NULLԂ
+ */
+void *tenant_dad_reaper(void *arg) {
+    UNUSED(arg);
+
+    int idx;
+    int count;
+    struct timeval tv;
+
+    pthread_detach(pthread_self());
+
+    while (!srv_shutdown) {
+        gettimeofday(&tv, NULL);
+        count = tenants.count;
+        for (idx = 0; idx < count; idx++) {
+            if (tenants.dad_state[idx] != DAD) { // bNȂŔ`
                 continue;
             }
+            pthread_mutex_lock(&(tenants.lock[idx]));
+            if (tenants.dad_state[idx] == DAD && tenants.dad_deadline[idx] <= tv.tv_sec) {
+                tenant_dad_complete(idx);
+            }
+            pthread_mutex_unlock(&(tenants.lock[idx]));
+        }
+        sleep(1);
+    }
+    return NULL;
+}
+
+/**
+ * @brief ~hEFAo͂STAɕϊ
+ *
+ * ~hEFAo͂STAɕϊBrbg̕וsta_layout_active(-L)Ō܂B
+ * geo80͏]ƓSTAɂȂB
+ * @todo vtBbNXƌ߂
+ * 
+ * @param[in] po ~hEFȀo
+ * @param[out] newsta ϊSTAĕԂ
+ * 
+ * @retval 0 
+ * @retval -1 s
+ */
+static int encode_to_sta(PositionOut po, struct in6_addr *newsta) {
+	sta_coord c;
+	struct tm tm_temptime;
+	char temp[INET6_ADDRSTRLEN];
+	
+	if (po.lat > 90.0 || po.lat < -90.0) {
+		syslog(LOG_LOCAL0|LOG_DEBUG, "[encode_to_sta] latitude range error");
+		return -1;
+	}
+	if (po.lon > 180.0 || po.lon < -180.0) {
+		syslog(LOG_LOCAL0|LOG_DEBUG, "[encode_to_sta] longitude range error");
+		return -1;
+	}
+	
+	// ͂̓0̕b(n)
+	memset(&tm_temptime, 0, sizeof(tm_temptime));
+	localtime_r(&(po.time), &tm_temptime);
+	c.lon = po.lon;
+	c.lat = po.lat;
+	c.alt = po.alt;
+	c.tod = tm_temptime.tm_hour * 60 * 60 + tm_temptime.tm_min * 60 + tm_temptime.tm_sec;
+	if (sta_encode(sta_layout_active, &c, newsta) != 0) {
+		syslog(LOG_LOCAL0|LOG_DEBUG, "[encode_to_sta] (lng,lat,alt)=(%f, %f, %f) does not fit in %s", po.lon, po.lat, po.alt, sta_layout_active->name);
+		return -1;
+	}
+	
+	if (inet_ntop(AF_INET6, newsta, temp, sizeof(temp)) == NULL) {
+		syslog(LOG_LOCAL0|LOG_DEBUG, "[encode_to_sta] inet_ntop: %m");
+		return -1;
+	}
+	
+	syslog(LOG_LOCAL0|LOG_DEBUG, "[encode_to_sta] New STA: %s", temp);
+	return 0;
+}
+
+/**
+ * @brief STAPositionOutɕϊB
+ * 
+ * STAPositionOutɕϊBzuɂȂl0ɂȂB
+ * @param[in] sta ϊSTA
+ * @param[out] po ϊPositionOut
+ * @retval 0 
+ * @retval -1 s
+ */
+static int decode_from_sta(struct in6_addr *sta, PositionOut *po) {
+	sta_coord c;
+	
+	if (po == NULL) {
+		return -1;
+	}
+	
+	if (sta_decode(sta_layout_active, sta, &c) != 0) {
+		syslog(LOG_LOCAL0|LOG_DEBUG, "[decode_from_sta] this is not an sta.");
+		return -1;
+	}
+	
+	// ȉSTAɏ񂪂Ȃ̂ŕs\B
+	po->index = 0;
+	
+	po->time = (time_t)c.tod;
+	po->alt = c.alt;
+	po->lat = c.lat;
+	po->lon = c.lon;
+	
+	syslog(LOG_LOCAL0|LOG_DEBUG, "[decode_from_sta] (time,lng,lat,alt)=(%ld, %f, %f, %f)", po->time, po->lon, po->lat, po->alt);
+	
+	return 0;
+}
+
+/**
+ * @brief STAaddB
+ *
+ * C^[tF[XSTAaddB
+ * 
+ * @param newsta VSTA
+ * @retval 0 
+ * @retval -1 s
+ */
+static int add_sta(struct sockaddr_in6 *newsta) {
+	int fd = -1;
+    struct ifreq ifr;
+    struct in6_ifreq ifr6;
+    char host[NI_MAXHOST];
+    
+    newsta->sin6_family = AF_INET6;
+    newsta->sin6_port = 0;
+    memcpy((char *)&ifr6.ifr6_addr, (char *)&(newsta->sin6_addr), sizeof(struct in6_addr));
+
+    fd = get_socket_for_afinet6();
+    if (fd < 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[update_sta] No support for INET6 on this system.");
+        return -1;
+    }
+
+    strcpy(ifr.ifr_name, wlan_interface);
+    // SIOGIFINDEXSIOCGIFINDEX͓Btypo\hdefineB
+    if (ioctl(fd, SIOCGIFINDEX, &ifr) < 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[update_sta] SIOCGIFINDEX error: %m");
+        close(fd);
+        return -1;
+    }
+    ifr6.ifr6_ifindex = ifr.ifr_ifindex;
+    ifr6.ifr6_prefixlen = 0;
+
+    // ȉ̃AhXݒioctlrootłȂƎss\.
+    if (ioctl(fd, SIOCSIFADDR, &ifr6) < 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[update_sta] SIOCSIFADDR error: %m");
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    
+    // OɋL^
+    getnameinfo((struct sockaddr *)newsta, sizeof(struct sockaddr_in6), host, sizeof(host), NULL, 0, NI_NUMERICHOST);
+    syslog(LOG_LOCAL0|LOG_DEBUG, "# add_sta complete, new address = %s", host);
+    METRIC_INC(addr_added);
+    
+    return 0;
+}
+
+/**
+ * @brief ÂSTAdelB
+ *
+ * C^[tF[X̌ÂSTAdelB
+ * @param oldsta 폜ÂSTA
+ * @retval 0 
+ * @retval -1 s
+ */
+static int delete_sta(struct sockaddr_in6 *oldsta) {
+	int fd = -1;
+    struct ifreq ifr;
+    struct in6_ifreq ifr6;
+	
+	memcpy((char *)&ifr6.ifr6_addr, (char *)&(oldsta->sin6_addr), sizeof(struct in6_addr));
+	
+	fd = get_socket_for_afinet6();
+	if (fd < 0) {
+		syslog(LOG_LOCAL0|LOG_DEBUG, "[delete_sta] No support for INET6 on this system.");
+        return -1;
+	}
+	
+	strcpy(ifr.ifr_name, wlan_interface);
+	// SIOGIFINDEXSIOCGIFINDEX͓Btypo\hdefineB
+	if (ioctl(fd, SIOCGIFINDEX, &ifr) < 0) {
+		syslog(LOG_LOCAL0|LOG_DEBUG, "[delete_sta] SIOGIFINDEX error: %m");
+		close(fd);
+        return -1;
+	}
+	ifr6.ifr6_ifindex = ifr.ifr_ifindex;
+	ifr6.ifr6_prefixlen = 0;
+	
+	// ȉ̃AhXݒioctlrootłȂƎss\.
+	if (ioctl(fd, SIOCDIFADDR, &ifr6) < 0) {
+		syslog(LOG_LOCAL0|LOG_DEBUG, "[delete_sta] SIOCDIFADDR error: %m");
+		close(fd);
+		return -1;
+	}
+	close(fd);
+	METRIC_INC(addr_deleted);
+	
+	return 0;
+}
+
+/**
+ * @brief VSTA
+ *
+ * -G̗P\̂ɔ񐄏ɂSTA֖߂ĂȂAaddɎ߂B
+ * @param newsta VSTA
+ * @retval 0 
+ * @retval -1 s
+ */
+static int install_sta(struct sockaddr_in6 *newsta) {
+    if (handoff_reclaim(wlan_ifindex, &(newsta->sin6_addr)) == 0) {
+        return 0;
+    }
+    return add_sta(newsta);
+}
+
+/**
+ * @brief ÂSTA񐄏ɂ
+ *
+ * VSTAĂĂԁB-G̗P\߂remove_retired_staŏB
+ * 񐄏ɂłȂ΂B
+ * @param oldsta ÂSTA
+ */
+static void retire_sta(struct sockaddr_in6 *oldsta) {
+    char host[NI_MAXHOST];
+    
+    if (handoff_deprecate(wlan_ifindex, &(oldsta->sin6_addr)) != 0) {
+        delete_sta(oldsta);
+        return;
+    }
+    getnameinfo((struct sockaddr *)oldsta, sizeof(struct sockaddr_in6), host, sizeof(host), NULL, 0, NI_NUMERICHOST);
+    syslog(LOG_LOCAL0|LOG_DEBUG, "# retire_sta %s deprecated for %d sec", host, handoff_grace);
+    METRIC_INC(addr_deprecated);
+}
+
+/**
+ * @brief P\߂ÂSTA
+ *
+ * sta_handoff̃XbhĂ΂B
+ * @param addr ÂSTA
+ */
+static void remove_retired_sta(const struct in6_addr *addr) {
+    struct sockaddr_in6 oldsta;
+    
+    memset(&oldsta, 0, sizeof(oldsta));
+    oldsta.sin6_family = AF_INET6;
+    oldsta.sin6_addr = *addr;
+    delete_sta(&oldsta);
+}
+
+/**
+ * @brief AREQu[hLXgWT҂
+ *
+ * AREQ(Allocation REQest)𖳐aɃu[hLXgWTb҂
+ * ₪Ȃ畡AREQ1B
+ *
+ * @param candidates B擪{
+ * @param count ̐
+ * @param txid AREQ̔ԍ
+ * @param wait ҂[b]BӂWTAċNDAD𑱂Ƃ͎c
+ * @retval 0 dȂ
+ * @retval 1 dĂƂ̕ԓ
+ */
+static int allocation_request_start(const struct in6_addr *candidates, int count, uint32_t txid, int wait) {
+    struct sockaddr_in6 newsta;
+    int ret;
+    
+    if (count > 1) {
+        ret = send_areq_multi(candidates, count, txid);
+    } else {
+        memset(&newsta, 0, sizeof(newsta));
+        newsta.sin6_family = AF_INET6;
+        newsta.sin6_addr = candidates[0];
+        ret = send_areq(&newsta);
+    }
+    if (ret == -1) {
+        return 0;
+    }
+    
+    // WTb̃^C}[I
+    timer_on(0, &allocation_request_timeout, wait);
+    
+    return 0;
+}
+
+/**
+ * @brief AREQu[hLXg
+ *
+ * AREQgݗĂđSm[hN[J}`LXgɑB
+ * `-w̎wƂ܂̃m[hIԁB
+ * ^C}[͌ĂяoŊǗB
+ * @param newsta dmFAhX
+ * @retval 0 
+ * @retval -1 s
+ */
+static int send_areq(struct sockaddr_in6 *newsta) {
+    int ret;
+    wire_msg msg;
+    char buf[WIRE_LEGACY_SIZE];
+    size_t len;
+    char host[NI_MAXHOST];
+    
+    memset(&msg, 0, sizeof(msg));
+    msg.format = wire_choose(areq_wire_mode, time(NULL));
+    msg.type = AREQ;
+    msg.txid = (uint32_t)random();
+    msg.sta = newsta->sin6_addr;
+    msg.negative_only = negative_only;
+    len = wire_build(buf, sizeof(buf), &msg);
+    if (len == 0) { // STAłȂAhX̓RpNgȌ`ɂłȂ
+        msg.format = WIRE_LEGACY;
+        len = wire_build(buf, sizeof(buf), &msg);
+    }
+    
+    // OɋL^
+    if ((ret = getnameinfo((struct sockaddr *)newsta, sizeof(struct sockaddr_in6), host, sizeof(host), NULL, 0, NI_NUMERICHOST)) != 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[allocation_request_start] getnameinfo error: %s", gai_strerror(ret));
+    } else {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "# allocation_request_start temp address = %s", host);
+    }
+    
+    ret = send_dad_packet(&(newsta->sin6_addr), buf, len);
+    if (ret == 0) {
+        METRIC_INC(areq_addresses);
+    }
+    return ret;
+}
+
+/**
+ * @brief 2STAʒu\ׂ
+ *
+ * ̔züܓxAoxAx̃tB[hׂBzuɂȂނׂ͔ȂB
+ * ȂǈʒuȊÕrbgႦΓʒuB
+ * @param a STA
+ * @param b STA
+ * @retval 1 ʒu
+ * @retval 0 ႤʒuASTAƂēǂ߂Ȃ
+ */
+static int same_position(const struct in6_addr *a, const struct in6_addr *b) {
+    static const sta_kind kinds[] = { STA_LAT, STA_LON, STA_ALT };
+    uint64_t ra, rb;
+    int fa, fb;
+    size_t i;
+    
+    for (i = 0; i < sizeof(kinds) / sizeof(kinds[0]); i++) {
+        fa = sta_field_raw(sta_layout_active, a, kinds[i], &ra);
+        fb = sta_field_raw(sta_layout_active, b, kinds[i], &rb);
+        if (fa != fb || (fa == 0 && ra != rb)) {
+            return 0;
+        }
+    }
+    return sta_layout_field(sta_layout_active, STA_LAT) != NULL && sta_layout_field(sta_layout_active, STA_LON) != NULL;
+}
+
+/**
+ * @brief AREQ𑗂
+ *
+ * ₪݂ȓʒu(̃rbgႤ)ȂÄʒuőiB
+ * ʒu΂΂ȂSm[hɃ}`LXgB
+ * @param candidates 
+ * @param count ̐
+ * @param txid AREPŕԂĂԍ
+ * @retval 0 
+ * @retval -1 s
+ */
+static int send_areq_multi(const struct in6_addr *candidates, int count, uint32_t txid) {
+    char buf[UDP_RECV_BUF_SIZE];
+    size_t len;
+    const struct in6_addr *where = &candidates[0];
+    int i;
+    
+    len = multi_build(buf, sizeof(buf), AREQ_MULTI, txid, negative_only ? MULTI_NEGATIVE_ONLY : 0, candidates, count, NULL);
+    if (len == 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[send_areq_multi] too many candidates %d", count);
+        return -1;
+    }
+    for (i = 1; i < count; i++) {
+        // -L̔zuɂ炸AʒũtB[hŔׂ
+        if (!same_position(&candidates[i], &candidates[0])) {
+            where = NULL;
+            break;
+        }
+    }
+    syslog(LOG_LOCAL0|LOG_DEBUG, "# send_areq_multi txid=%08x, %d candidates", txid, count);
+    
+    if (send_dad_packet(where, buf, len) != 0) {
+        return -1;
+    }
+    METRIC_ADD(areq_addresses, count);
+    return 0;
+}
+
+/**
+ * @brief AREQ𑗂Iő
+ *
+ * ZƂ̃O[vAߗ׃m[hւ̃jLXgASm[h}`LXg瑗IԁB
+ * @param where ̈ʒu\STABNULLȂSm[hɃ}`LXg
+ * @param buf gݗĂAREQ
+ * @param len AREQ̒
+ * @retval 0 
+ * @retval -1 s
+ */
+static int send_dad_packet(const struct in6_addr *where, const char *buf, size_t len) {
+    int ret;
+    struct sockaddr_in6 toaddr_in6;
+    struct sockaddr_in6 targets[NEIGH_UNICAST_MAX];
+    struct in6_addr addr;
+    PositionOut decoded;
+    int ntargets = -1;
+    int i;
+    
+    // MC^[tF[Xƈinit_tx_pathŗpӂĂ
+    toaddr_in6 = allnodes_dest;
+    // ZƂ̃O[vgȂ̃Z̃O[vAłȂΑSm[h
+    if (where != NULL) {
+        cell_group(where, &(toaddr_in6.sin6_addr));
+    }
+    
+    // ߗ׃m[h킩Ă΁Adm[hɂjLXg
+    if (neigh_refresh_time > 0 && where != NULL) {
+        addr = *where;
+        if (decode_from_sta(&addr, &decoded) == 0) {
+            ntargets = neigh_targets(decoded.lat, decoded.lon, targets, NEIGH_UNICAST_MAX);
+        }
+    }
+    // \AREQ̑MƎAREP炵oȂ̂ŁAłNȂƂ͌Ȃ
+    if (ntargets <= 0) {
+        // u[hLXgsend
+        ret = sendto(sockfd, buf, len, 0, (struct sockaddr *)&toaddr_in6, sizeof(toaddr_in6));
+        if (ret > 0) {
+            METRIC_INC(areq_sent);
+        }
+        neigh_swept();
+    } else {
+        for (i = 0; i < ntargets; i++) {
+            targets[i].sin6_port = htons(udp_port);
+            ret = sendto(sockfd, buf, len, 0, (struct sockaddr *)&targets[i], sizeof(targets[i]));
+            if (ret > 0) {
+                METRIC_INC(areq_unicast);
+            }
         }
-        
-    	if (found == 1) {
-            delete_sta(&mysta_sin6);
+    }
+    
+    return 0;
+}
+
+/**
+ * @brief AREQu[hLXg̃^CAEg
+ *
+ * AREQu[hLXgƃ^CAEgƂ̏
+ * AhXmA܂͏dĂPɔ
+ * C^[tF[Xւ̐ݒ̓AhX̐ݒ̒iɔCA^C}[̃XbhłioctlĂ΂ȂB
+ * @return 0 0Ԃ
+ */
+static void allocation_request_timeout() {
+    struct sockaddr_in6 newsta;
+    program_request preq;
+    address_status flag;
+    int i;
+    
+    // ߂Ƃ낾rBioctl̊ԂAREP̏҂Ȃ
+    pthread_mutex_lock(&(temp_address.mutex));
+    flag = temp_address.flag;
+    if (flag == DAD) {
+        // {dĂAd̕ԓȂ\̌g
+        for (i = 0; i < temp_address.ncandidates; i++) {
+            if (!(temp_address.duplicate & ((uint32_t)1 << i))) {
+                break;
+            }
+        }
+        if (i > 0 && i < temp_address.ncandidates) {
+            temp_address.address.sin6_addr = temp_address.candidates[i];
+            METRIC_INC(dad_fallback);
+            syslog(LOG_LOCAL0|LOG_DEBUG, "[allocation_request_timeout] fall back to candidate %d", i);
         }
-        add_sta(&(temp_address.address));
+        newsta = temp_address.address;
+        
+        // 蓖ĂO玩STAƂēADAĎ₩Oꂽɑ̃m[hɎȂ悤ɂ
+        temp_address.sta = newsta.sin6_addr;
+        temp_address.has_sta = 1;
         temp_address.flag = NOT_DUPLICATE;
         temp_address.generated_time = 0;
         memset(&(temp_address.address), 0, sizeof(temp_address.address));
-    } else if (temp_address.flag == DUPLICATE) {
-        // do nothing
+        temp_address.ncandidates = 1;
+        temp_address.duplicate = 0;
+        publish_state();
+    } else if (flag == DUPLICATE) {
         char host[NI_MAXHOST];
         getnameinfo((struct sockaddr *)&(temp_address.address), sizeof(struct sockaddr_in6), host, sizeof(host), NULL, 0, NI_NUMERICHOST);
         syslog(LOG_LOCAL0|LOG_DEBUG, "# DUPLICATE [allcation_request_timeout] %s", host);
     }
     pthread_mutex_unlock(&(temp_address.mutex));
+    
+    if (flag == DUPLICATE) {
+        follow_pending(TENANT_ADDR_PENDING, NULL);
+        return;
+    } else if (flag != DAD) {
+        return;
+    }
+    
+    // m肵STÂ͎ĂȂ̂ŁAAhX̐ݒ̒i󂯂܂ő҂
+    memset(&preq, 0, sizeof(preq));
+    preq.sta = newsta;
+    program_push(&preq);
+}
+
+/**
+ * @brief m肵STAC^[tF[Xɐݒ肷
+ *
+ * AhX̐ݒ̒iĂԁB
+ * STAւB-GȂVSTAĂÂSTA񐄏ɂ
+ * @param confirmed m肵STA
+ */
+static void program_sta(const struct sockaddr_in6 *confirmed) {
+    struct sockaddr_in6 mysta_sin6;
+    struct sockaddr_in6 newsta = *confirmed;
+    int found;
+    
+    found = (find_my_sta(&mysta_sin6) == 0);
+    if (found && handoff_grace == 0) {
+        delete_sta(&mysta_sin6);
+    }
+    if (install_sta(&newsta) == 0) {
+        cell_follow(TENANT_ADDR_CURRENT, &(newsta.sin6_addr));
+        if (found && handoff_grace > 0) {
+            retire_sta(&mysta_sin6);
+        }
+    } else if (found && handoff_grace > 0) {
+        publish_sta(&(mysta_sin6.sin6_addr)); // ÂSTÂ܂
+    } else {
+        if (found) {
+            cell_follow(TENANT_ADDR_CURRENT, NULL);
+        }
+        publish_sta(NULL);
+    }
+    follow_pending(TENANT_ADDR_PENDING, NULL);
+    METRIC_INC(dad_completed);
+}
+
+/**
+ * @brief STAL͈͓ɂ邩ǂ肷B
+ *
+ * STAL͈͓ɂ邩ǂ肷B
+ * STAtZ_쐼̊pƂʒu̗x̎lp`4̊pA
+ * ׂč̈ʒu疳a̒ɂΔ͈͓B
+ * aPositionOut.radio_range(0ȉȂVALID_RANGE_M)AxSTÃrbgzu狁߂B
+ * -E̐Mx0łȂPositionOut.error̐Mȉ~B΂񉓂p̌ւ
+ * ȉ~̍L𑫂Ă͈͓Ȃ͈͓AĂ͈͊OȂ͈͊OÂǂłȂΕsmB
+ * @param real ɎgŐV݈̌ʒuBLocationmwFIFOoRŎ󂯎́B
+ * @param decoded ݎgpĂSTAtZObh̊_̈ʒuB
+ * @retval RANGE_INSIDE ͈͓
+ * @retval RANGE_OUTSIDE ͈͊O
+ * @retval RANGE_UNSURE ʂ̕sm̂߂ǂƂȂ
+ */
+static range_verdict is_inside_valid_range(const PositionOut * const real, const PositionOut * const decoded) {
+    const double cr = (real->radio_range > 0.0) ? real->radio_range : VALID_RANGE_M; ///< communication range a
+    const double lgx = lon2x(sta_field_quantum(sta_layout_field(sta_layout_active, STA_LON)), real->lat); ///< location granularity ʒu̗x
+    const double lgy = lat2y(sta_field_quantum(sta_layout_field(sta_layout_active, STA_LAT)));
+    double dx, dy, cx, cy, d;
+    double far = 0.0, ux = 0.0, uy = 0.0;
+    double spread = 0.0;
+    int i;
+    
+    dx = lon2x(decoded->lon - real->lon, real->lat);
+    dy = lat2y(decoded->lat - real->lat);
+    for (i = 0; i < 4; i++) {
+        cx = dx + ((i & 1) ? lgx : 0.0);
+        cy = dy + ((i & 2) ? lgy : 0.0);
+        d = sqrt(cx * cx + cy * cy);
+        if (d > far) {
+            far = d;
+            ux = cx / d;
+            uy = cy / d;
+        }
+    }
+    if (fix_confidence > 0.0 && fix_cov_valid(real->error)) {
+        spread = fix_spread(real->error, ux, uy, fix_scale);
+    }
+    
+    if (far + spread <= cr) {
+        return RANGE_INSIDE;
+    } else if (far - spread > cr) {
+        return RANGE_OUTSIDE;
+    }
+    return RANGE_UNSURE;
+}
+
+/**
+ * @brief L͈͂ôDADׂf
+ *
+ * is_inside_valid_rangěʂ-H̃qXeVXɒʂB-HȂΔ͈͂o炷1B
+ * ʂsmłǂƂȂƂ́ADADɎ̈ʒu҂B
+ * ~߂ʒu̐͗RƂɃgNXɐB
+ * @param h m[h(eig)Ƃ̃qXeVX̏
+ * @param real ̈ʒu
+ * @param anchor L͈͂̊_
+ * @retval 1 DAD
+ * @retval 0 Ȃ
+ */
+static int should_leave_range(hyst_state *h, const PositionOut *real, const PositionOut *anchor) {
+    struct timespec ts;
+    int64_t now_ms;
+    range_verdict range;
+    
+    range = is_inside_valid_range(real, anchor);
+    if (range == RANGE_UNSURE) {
+        METRIC_INC(exit_unsure);
+        return 0;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now_ms = (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    switch (hyst_check(h, &hysteresis, range == RANGE_INSIDE, real->lat, real->lon, anchor->lat, anchor->lon,
+                       (real->radio_range > 0.0) ? real->radio_range : VALID_RANGE_M, now_ms)) {
+    case HYST_MOVE:
+        hyst_reset(h);
+        return 1;
+    case HYST_HELD_MARGIN:
+        METRIC_INC(exit_margin);
+        break;
+    case HYST_HELD_DWELL:
+        METRIC_INC(exit_dwell);
+        break;
+    case HYST_HELD_DIRECTION:
+        METRIC_INC(exit_return);
+        break;
+    default:
+        break;
+    }
+    return 0;
 }
 
 /**
- * @brief STAL͈͓ɂ邩ǂ肷B
+ * @brief -KȂʒuJ}tB^ŕ
  *
- * STAL͈͓ɂ邩ǂ肷B
- * @param real ɎgŐV݈̌ʒuBLocationmwFIFOoRŎ󂯎́B
- * @param decoded ݎgpĂSTAtZObh̊_̈ʒuB
- * @retval 1 ͈͓
- * @retval 0 ͈͊O
- */
-static int is_inside_valid_range(const PositionOut * const real, const PositionOut * const decoded) {
-    const double cr = 50.0; ///< communication range a
-    const double lg = 1.0; ///< location granularity ʒu̗x
-    int cond1 = 0;
-    int cond2 = 0;
-    int cond3 = 0;
-    int cond4 = 0;
-    
-    cond1 = (lon2x(real->lon - decoded->lon, real->lat) * lon2x(real->lon - decoded->lon, real->lat) + lat2y(real->lat - decoded->lat) * lat2y(real->lat - decoded->lat) <= (cr * cr));
-    cond1 &= (lon2x(real->lon, real->lat) >= lon2x(decoded->lon, decoded->lat) + lg / 2);
-    cond1 &= (lat2y(real->lat) >= lat2y(decoded->lat) + lg / 2);
-    if (!cond1) return 0;
-
-    cond2 = (lon2x(real->lon - decoded->lon, real->lat) * lon2x(real->lon - decoded->lon, real->lat) + (lat2y(real->lat - decoded->lat) - lg) * (lat2y(real->lat - decoded->lat) - lg) <= (cr * cr));
-    cond2 &= (lon2x(real->lon, real->lat) >= lon2x(decoded->lon, decoded->lat) + lg / 2);
-    cond2 &= (lat2y(real->lat) <= lat2y(decoded->lat) + lg / 2);
-    if (!cond2) return 0;
-
-    cond3 = ((lon2x(real->lon - decoded->lon, real->lat) - lg) * (lon2x(real->lon - decoded->lon, real->lat) - lg) + lat2y(real->lat - decoded->lat) * lat2y(real->lat - decoded->lat) <= (cr * cr));
-    cond3 &= (lon2x(real->lon, real->lat) <= lon2x(decoded->lon, decoded->lat) + lg / 2);
-    cond3 &= (lat2y(real->lat) >= lat2y(decoded->lat) + lg / 2);
-    if (!cond3) return 0;
-
-    cond4 = ((lon2x(real->lon - decoded->lon, real->lat) - lg) * (lon2x(real->lon - decoded->lon, real->lat) - lg) + (lat2y(real->lat - decoded->lat) - lg) * (lat2y(real->lat - decoded->lat) - lg) <= (cr * cr));
-    cond4 &= (lon2x(real->lon, real->lat) <= lon2x(decoded->lon, decoded->lat) + lg / 2);
-    cond4 &= (lat2y(real->lat) <= lat2y(decoded->lat) + lg / 2);
-    if (!cond4) return 0;
-
-	if (cond1 && cond2 && cond3 && cond4) {
-		return 1;
-	} else {
-		return 0;
-	}
+ * ܓxAoxPositionOut.error𕽊̂ɒuB
+ * @param f m[h(eig)Ƃ̃tB^̏
+ * @param po ʒu
+ */
+static void smooth_fix(fix_filter *f, PositionOut *po) {
+    struct timespec ts;
+    
+    if (kalman_q <= 0.0) {
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    fix_filter_step(f, kalman_q, ts.tv_sec + ts.tv_nsec / 1e9, &(po->lat), &(po->lon), po->error);
 }
 
 /**
@@ -634,7 +1760,7 @@ inline static double lat2y(double lat) {
  * @return mPʂ̒
  */
 inline static double lon2x(double lon, double lat) {
-	return 111319.0 * lon * cos(lat);
+	return 111319.0 * lon * cos(lat * M_PI / 180.0);
 }
 
 /**
@@ -662,9 +1788,38 @@ static int get_socket_for_afinet6() {
 static int init_udp_socket(pthread_t recv_from_udp_thread_id) {
     int status;
     int one = 1;
+    int ncpus;
+    int i;
     pthread_attr_t detached_attr;
     struct sockaddr_in6 my_sockaddr_in6;
     
+    pthread_attr_init(&detached_attr);
+    pthread_attr_setdetachstate(&detached_attr, PTHREAD_CREATE_DETACHED);
+    
+    // CPU葽[J[ɂ͉U蕪ꂸAMobt@VԂȂ̂Ō炷
+    ncpus = shard_cpu_count();
+    if (udp_workers > 1 && ncpus > 0 && udp_workers > ncpus) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[init_udp_socket] -W %d is more than the %d usable CPUs, using %d workers", udp_workers, ncpus, ncpus);
+        udp_workers = ncpus;
+    }
+    
+    // -WȂSO_REUSEPORTŕA0Ԃ̃\PbgsockfdƂđMƃ}`LXgɂg
+    if (udp_workers > 1) {
+        if (shard_open(udp_port, udp_workers, udp_shards) == 0) {
+            sockfd = udp_shards[0].fd;
+            for (i = 0; i < udp_workers; i++) {
+                status = pthread_create(&recv_from_udp_thread_id, &detached_attr, recv_from_udp_shard, &udp_shards[i]);
+                if (status != 0) {
+                    syslog(LOG_LOCAL0|LOG_DEBUG, "[init_udp_socket] pthread_create error: %m");
+                    return status;
+                }
+            }
+            syslog(LOG_LOCAL0|LOG_DEBUG, "UDP port %d is sharded over %d workers", udp_port, udp_workers);
+            return 0;
+        }
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[init_udp_socket] SO_REUSEPORT sharding is not available, using one socket");
+    }
+    
     memset(&my_sockaddr_in6, sizeof(my_sockaddr_in6), 0);
     my_sockaddr_in6.sin6_family = AF_INET6;
     my_sockaddr_in6.sin6_addr = in6addr_any;
@@ -681,354 +1836,930 @@ static int init_udp_socket(pthread_t recv_from_udp_thread_id) {
         return -1;
     }
     
-    pthread_attr_init(&detached_attr);
-    pthread_attr_setdetachstate(&detached_attr, PTHREAD_CREATE_DETACHED);
+    if (io_engine != ENGINE_THREADS && replay_path[0] == '\0') {
+        return 0; // recv_from_fifõGWFIFOƈꏏɓǂ
+    }
+    status = pthread_create(&recv_from_udp_thread_id, &detached_attr, recv_from_udp, NULL);
+    // status = pthread_create(&recv_from_udp_thread_id, NULL, recv_from_udp, NULL);
+    if (status != 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[init_udp_socket] pthread_create error: %m");
+    }
+    
+    return status;
+}
+
+/**
+ * @brief AhX̍\̂
+ *
+ * AhX̍\̂B
+ * 
+ */
+void init_temporary_address_status() {
+    memset(&(temp_address.address), 0, sizeof(temp_address.address));
+    temp_address.generated_time = 0;
+    pthread_mutex_init(&(temp_address.mutex), NULL);
+    temp_address.flag = NOT_DUPLICATE;
+    memset(temp_address.candidates, 0, sizeof(temp_address.candidates));
+    temp_address.ncandidates = 1;
+    temp_address.duplicate = 0;
+    temp_address.txid = 0;
+    memset(&(temp_address.sta), 0, sizeof(temp_address.sta));
+    temp_address.has_sta = 0;
+    seqlock_init(&state_seq);
+    memset(&published, 0, sizeof(published));
+    seqlock_init(&my_addrs_seq);
+    refresh_my_addrs();
+    refresh_my_sta(); // łɊ蓖ĂĂSTA
+}
+
+/**
+ * @brief DAD̂߂UDPM
+ *
+ * DAĎʂ̎MXbhB
+ * ͂ĂpPbg܂Ƃ߂ĎMāÃXbhŏɏB
+ * X^[^̏ꍇDAD̕ԓ󂯎A]ȍꍇAREQ󂯎
+ */
+void *recv_from_udp(void *arg) {
+	UNUSED(arg);
+	
+    engine_recv_udp(sockfd, handle_udp_packet);
+    return NULL;
+}
+
+/**
+ * @brief -W̃[J[̎M[v
+ *
+ * CPUɌŒ肵Ã\PbgǂށBqXbh͍炸ɂ̃XbhŏB
+ * @param arg shard_worker
+ * @return NULLԂ
+ */
+void *recv_from_udp_shard(void *arg) {
+    shard_worker *worker = (shard_worker *)arg;
+    
+    shard_pin(worker);
+    syslog(LOG_LOCAL0|LOG_DEBUG, "[recv_from_udp_shard] worker %d on cpu %d", worker->index, worker->cpu);
+    if (io_engine != ENGINE_THREADS) {
+        engine_run(io_engine, &(worker->fd), 1, -1, 0, handle_udp_packet, NULL);
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[recv_from_udp_shard] %s engine failed, reading with recvmmsg", engine_name(io_engine));
+    }
+    engine_recv_udp(worker->fd, handle_udp_packet);
+    return NULL;
+}
+
+/**
+ * @brief 󂯎AREQ/AREP
+ *
+ * X^[^̏ꍇDAD̕ԓ󂯎A]ȍꍇAREQ󂯎B
+ * AREPpacket̏ŏčAreply_sendŕԂB
+ * @param fd 󂯎\PbgBAREP͂ŕԂ
+ * @param fromaddr M
+ * @param packet 󂯎pPbgBUDP_RECV_BUF_SIZE܂ŏĂ悢
+ * @param usedlen pPbg̒
+ */
+static void handle_udp_packet(int fd, const struct sockaddr_in6 *fromaddr, char *packet, int usedlen) {
+    u_int16_t type;
+    wire_msg msg;
+    wire_msg reply;
+    size_t len;
+    
+    if (usedlen <= 0) {
+        return;
+    }
+    
+    // AREQ/AREP
+    if (usedlen >= (int)sizeof(multi_hdr)) {
+        memcpy(&type, packet, sizeof(type));
+        if ((type == AREQ_MULTI || type == AREP_MULTI) && areq_candidates > 1 && !is_from_myself(fromaddr)) {
+            wire_heard_multi(time(NULL));
+        }
+        if (type == AREQ_MULTI) {
+            handle_areq_multi(fd, fromaddr, packet, usedlen);
+            return;
+        } else if (type == AREP_MULTI) {
+            handle_arep_multi(fromaddr, packet, usedlen);
+            return;
+        }
+    }
+    
+    // ]̌`ƃRpNgȌ`̂ǂ炩
+    if (wire_parse(packet, usedlen, &msg) != 0 || (msg.type != AREQ && msg.type != AREP)) {
+        METRIC_INC(wire_malformed);
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[handle_udp_packet] malformed packet (%d bytes)", usedlen);
+        return;
+    }
+    // autǒ`ƕAREQ́A܂̃m[hǂ߂`ɍ킹
+    if ((areq_wire_mode == WIRE_MODE_AUTO || areq_candidates > 1) && !is_from_myself(fromaddr)) {
+        wire_heard(&msg, time(NULL));
+    }
+    
+    if (msg.type == AREQ) { // ]ȍꍇAAREQ󂯂
+        METRIC_INC(areq_recv);
+        published_state state;
+        
+        neigh_learn_from_packet(fromaddr, &(msg.sta));
+        
+        // AREPAREQƓ`ŁAtxidŕԂ
+        memset(&reply, 0, sizeof(reply));
+        reply.format = msg.format;
+        reply.type = AREP;
+        
+        if (tenant_max > 0) {
+            // SeigSTA1ň
+            reply.duplicate = (tenant_addr_lookup(&(msg.sta), TENANT_ADDR_CURRENT) != -1);
+        } else {
+            // JĂ鎩STABgetifaddrs͌Ă΂Ȃ
+            read_state(&state);
+            if (state.has_sta) {
+                // ߗ׃m[h̕\悤ɁASTAڂĂ
+                reply.has_holder = 1;
+                reply.holder = state.sta;
+            }
+            // ̃AhXƓȂAREP_FLAG=1AقȂ0
+            reply.duplicate = state.has_sta && in6_addr_equal(&(msg.sta), &(state.sta));
+        }
+        if (!reply.duplicate) {
+            reply.duplicate = handoff_holds(&(msg.sta)); // 񐄏ɂSTA܂̂
+        }
+        
+        if (msg.negative_only) {
+            // DAD̃AhXȂdƂĕԂBقĂƗm肵Ă܂
+            if (!reply.duplicate) {
+                reply.duplicate = (testing_mask(fromaddr, &(msg.sta), 1) != 0);
+            }
+            if (!reply.duplicate) {
+                METRIC_INC(arep_suppressed); // قĂ邱ƂdȂ̈Ӗ
+                return;
+            }
+        }
+        
+        // AREQ̃obt@̂܂AREPɂ
+        len = wire_reply(packet, usedlen, UDP_RECV_BUF_SIZE, &reply);
+        if (len > 0 && reply_send_later(fd, fromaddr, packet, len, msg.negative_only ? arep_backoff() : 0) == 0) {
+            METRIC_INC(arep_sent);
+        }
+        return;
+        
+    } else { // X^[^̏ꍇAAREP(DAD̕ԓ)󂯎
+        METRIC_INC(arep_recv);
+        if (msg.has_holder) {
+            neigh_learn_from_packet(fromaddr, &(msg.holder));
+        }
+        if (!msg.duplicate) {
+            return; // do nothing
+        } else if (tenant_max > 0) { // dAǂ̃eigDAD
+            tenant_mark_duplicate(&(msg.sta));
+        } else { // d
+            // ^C}[~߂ăCxg
+            char host[NI_MAXHOST];
+            int hit = 0;
+            pthread_mutex_lock(&(temp_address.mutex));
+            if (temp_address.flag == DAD && in6_addr_equal(&(msg.sta), &(temp_address.address.sin6_addr))) {
+                METRIC_INC(dad_duplicate);
+                temp_address.flag = DUPLICATE;
+                publish_state();
+                hit = 1;
+            }
+            getnameinfo((struct sockaddr *)&(temp_address.address), sizeof(struct sockaddr_in6), host, sizeof(host), NULL, 0, NI_NUMERICHOST);
+            pthread_mutex_unlock(&(temp_address.mutex));
+            if (hit) { // DADĂւ̕ԓ̂Ƃ
+                syslog(LOG_LOCAL0|LOG_DEBUG, "# DUPLICATE [handle_udp_packet] %s", host);
+                timer_off(0);
+                follow_pending(TENANT_ADDR_PENDING, NULL); // ^C}[~߂̂Ń^CAEg͑Ȃ
+            }
+        }
+    }
+}
+
+/**
+ * @brief DAD̃AhX
+ *
+ * d̂Ƃԓ郂[hł́AAhX𓯎DADĂm[hm
+ * dƂĕԓȂƁA݂ɖق܂ܗm肵Ă܂B
+ * [vobNĂAREQɂ͓ȂB
+ * @param from AREQ̑M
+ * @param addrs ₢킹ꂽAhX
+ * @param count AhX̐
+ * @return DAD̃AhX̃rbg(iԖڂȂbit i)
+ */
+static uint32_t testing_mask(const struct sockaddr_in6 *from, const struct in6_addr *addrs, int count) {
+    published_state state;
+    uint32_t testing = 0;
+    int i, j;
+    
+    if (tenant_max > 0) {
+        testing = tenant_addr_lookup_many(addrs, count, TENANT_ADDR_PENDING);
+    } else {
+        read_state(&state);
+        if (state.flag == DAD) {
+            for (i = 0; i < count; i++) {
+                for (j = 0; j < state.ncandidates; j++) {
+                    if (in6_addr_equal(&addrs[i], &(state.candidates[j]))) {
+                        testing |= (uint32_t)1 << i;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    if (testing != 0 && is_from_myself(from)) {
+        return 0;
+    }
+    return testing;
+}
+
+/**
+ * @brief AREPԂOɑ҂Ԃ𗐐Ō߂
+ *
+ * dAREP͓AhX̃m[h瓯ɕԂ邱Ƃ̂ŁA
+ * 0arep_backoff_ms~b̊Ԃł炵Ĕ}̏̏Փ˂B
+ * M[v͎~߂ɁAreply_send_laterŒx点đB
+ * @return ҂[}CNb]
+ */
+static long arep_backoff() {
+    if (arep_backoff_ms > 0) {
+        return random() % ((long)arep_backoff_ms * 1000);
+    }
+    return 0;
+}
+
+/**
+ * @brief pPbgǂ肷
+ *
+ * }`LXg̓[vobNĎɂ͂̂ŁAM̃AhXǂB
+ * AhXrefresh_my_addrsŊô̂ŁApPbgƂɃJ[lɂ͖₢킹ȂB
+ * @param from pPbg̑M
+ * @retval 1 
+ * @retval 0 ̃m[h
+ */
+static int is_from_myself(const struct sockaddr_in6 *from) {
+    unsigned int seq;
+    int mine;
+    int i;
+    
+    do {
+        seq = seqlock_read_begin(&my_addrs_seq);
+        mine = 0;
+        for (i = 0; i < my_naddrs && i < MY_ADDRS_MAX; i++) {
+            if (in6_addr_equal(&my_addrs[i], &(from->sin6_addr))) {
+                mine = 1;
+                break;
+            }
+        }
+    } while (seqlock_read_retry(&my_addrs_seq, seq));
+    return mine;
+}
+
+/**
+ * @brief AREQɓ
+ *
+ * Š1ŒׂāAdẴrbg𗧂ĂAREPԂB
+ * }`eig[hȂSeigSTA1̓ǂݍ݃bNňB
+ * d̂ƂԓĂقAREQȂAdȂΉԂȂB
+ * AREPbuf̏ŏčB
+ * @param fd 󂯎\PbgBAREP͂ŕԂ
+ * @param from AREQ̑M
+ * @param buf 󂯎pPbgBUDP_RECV_BUF_SIZE܂ŏĂ悢
+ * @param len pPbg̒
+ */
+static void handle_areq_multi(int fd, const struct sockaddr_in6 *from, char *buf, int len) {
+    multi_packet req;
+    published_state state;
+    size_t replylen;
+    long delay = 0;
+    uint32_t duplicate = 0;
+    int has_sta = 0;
+    int i;
+    
+    if (multi_parse(buf, len, &req) != 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[handle_areq_multi] malformed packet (%d bytes)", len);
+        return;
+    }
+    METRIC_INC(areq_recv);
+    for (i = 0; i < req.count; i++) {
+        neigh_learn_from_packet(from, &(req.candidates[i]));
+    }
+    
+    if (tenant_max > 0) {
+        duplicate = tenant_addr_lookup_many(req.candidates, req.count, TENANT_ADDR_CURRENT);
+    } else {
+        read_state(&state);
+        has_sta = state.has_sta;
+        for (i = 0; i < req.count && has_sta; i++) {
+            if (in6_addr_equal(&(req.candidates[i]), &(state.sta))) {
+                duplicate |= (uint32_t)1 << i;
+            }
+        }
+    }
+    for (i = 0; i < req.count; i++) {
+        if (handoff_holds(&(req.candidates[i]))) { // 񐄏ɂSTA܂̂
+            duplicate |= (uint32_t)1 << i;
+        }
+    }
+    
+    if (req.duplicate & MULTI_NEGATIVE_ONLY) {
+        duplicate |= testing_mask(from, req.candidates, req.count);
+        if (duplicate == 0) {
+            METRIC_INC(arep_suppressed);
+            return;
+        }
+        delay = arep_backoff();
+    }
+    
+    replylen = multi_reply(buf, UDP_RECV_BUF_SIZE, AREP_MULTI, duplicate, has_sta ? &(state.sta) : NULL);
+    if (replylen > 0 && reply_send_later(fd, from, buf, replylen, delay) == 0) {
+        METRIC_INC(arep_sent);
+    }
+}
+
+/**
+ * @brief AREP󂯎
+ *
+ * rbg̗ĂdɂB
+ * VOm[hł͑Š₪dƂDADł؂A
+ * łȂWT߂ƂɎc₩IԁB
+ * @param from AREP̑M
+ * @param buf 󂯎pPbg
+ * @param len pPbg̒
+ */
+static void handle_arep_multi(const struct sockaddr_in6 *from, const char *buf, int len) {
+    multi_packet rep;
+    uint32_t all;
+    int exhausted = 0;
+    int i;
+    
+    if (multi_parse(buf, len, &rep) != 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[handle_arep_multi] malformed packet (%d bytes)", len);
+        return;
+    }
+    METRIC_INC(arep_recv);
+    if (rep.has_holder) {
+        neigh_learn_from_packet(from, &(rep.holder));
+    }
+    if (rep.duplicate == 0) {
+        return;
+    }
+    
+    if (tenant_max > 0) {
+        for (i = 0; i < rep.count; i++) {
+            if (rep.duplicate & ((uint32_t)1 << i)) {
+                tenant_mark_duplicate(&(rep.candidates[i]));
+            }
+        }
+        return;
+    }
+    
+    pthread_mutex_lock(&(temp_address.mutex));
+    if (temp_address.flag == DAD && temp_address.txid == rep.txid) {
+        for (i = 0; i < rep.count && i < temp_address.ncandidates; i++) {
+            if ((rep.duplicate & ((uint32_t)1 << i))
+                && in6_addr_equal(&(rep.candidates[i]), &(temp_address.candidates[i]))) {
+                temp_address.duplicate |= (uint32_t)1 << i;
+            }
+        }
+        all = ((uint32_t)1 << temp_address.ncandidates) - 1;
+        if ((temp_address.duplicate & all) == all) {
+            temp_address.flag = DUPLICATE;
+            publish_state();
+            METRIC_INC(dad_duplicate);
+            exhausted = 1;
+        }
+    }
+    pthread_mutex_unlock(&(temp_address.mutex));
+    
+    if (exhausted) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "# DUPLICATE [handle_arep_multi] all candidates of txid=%08x", rep.txid);
+        timer_off(0);
+        follow_pending(TENANT_ADDR_PENDING, NULL); // ^C}[~߂̂Ń^CAEg͑Ȃ
+    }
+}
+
+/**
+ * @brief 󂯎pPbgߗ׃m[ho
+ *
+ * AREQȂvꂽAhXAAREPȂԓm[hSTAAMƑgɂĊoB
+ * STADAĎƓAhX́A[vobNẴpPbgȂ̂ŊoȂB
+ * @param from pPbg̑M
+ * @param sta ߗ׃m[hSTA
+ */
+static void neigh_learn_from_packet(const struct sockaddr_in6 *from, const struct in6_addr *sta) {
+    struct in6_addr addr;
+    published_state state;
+    PositionOut decoded;
+    int mine;
+    int i;
+    
+    if (neigh_refresh_time <= 0 && export_path[0] == '\0') {
+        return;
+    }
+    memcpy(&addr, sta, sizeof(addr)); // pPbg̒̓ACĂȂ
+    if (!IN6_IS_ADDR_STA(&addr)) {
+        return;
+    }
+    if (tenant_max > 0) {
+        mine = (tenant_addr_lookup(&addr, -1) != -1);
+    } else {
+        read_state(&state);
+        mine = state.has_sta && in6_addr_equal(&addr, &(state.sta));
+        if (state.flag == DAD) {
+            for (i = 0; i < state.ncandidates && !mine; i++) {
+                mine = in6_addr_equal(&addr, &(state.candidates[i]));
+            }
+        }
+    }
+    if (mine || decode_from_sta(&addr, &decoded) != 0) {
+        return;
+    }
+    if (neigh_learn(from, &addr, decoded.lat, decoded.lon, decoded.alt) && export_path[0] != '\0') {
+        export_kick(); // Vߗ׃m[h͊Ԋu҂ɏo
+    }
+}
+
+/**
+ * @brief Sm[hN[J}`LXgɎQo^
+ *
+ * Sm[hN[J}`LXgɂ炽߂ĖIɎQo^B
+ * radvd 1.0̃\[XR[hQlɂB
+ *
+ * @param sock `FbN\Pbg
+ * @param if_index `FbNC^[tF[X̃CfbNXԍ
+ * @retval 0 
+ * @retval -1 s
+ */
+static int setup_allnodes_membership(int sock, unsigned int if_index) {
+    struct ipv6_mreq mreq;
+    char if_name[IF_NAMESIZE];
+    
+    memset(&mreq, 0, sizeof(mreq));
+    mreq.ipv6mr_interface = if_index;
+    
+    /* ipv6-allnodes: ff02::1 */
+    mreq.ipv6mr_multiaddr.s6_addr32[0] = htonl(0xFF020000);
+    mreq.ipv6mr_multiaddr.s6_addr32[3] = htonl(0x1);
+
+    if (setsockopt(sock, SOL_IPV6, IPV6_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+        /* linux-2.6.12-bk4 returns error with HUP signal but keep listening */
+        if (errno != EADDRINUSE) {
+            memset(if_name, 0, sizeof(if_name));
+            if_indextoname(if_index, if_name);
+            syslog(LOG_LOCAL0|LOG_DEBUG, "[setup_allnodes_membership] can't join ipv6-allnodes on %s(%d)", if_name, if_index);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief VOinh
+ *
+ * SIGTERMȂǂLb`nhB
+ * @param sig Signal Number
+ * @param si VOi\
+ * @param context [U[ReLXg\
+ */
+static void sigaction_handler(int sig, siginfo_t *si, void *context) {
+	UNUSED(si);
+	UNUSED(context);
+	
+	switch (sig) {
+	case SIGINT:
+	    srv_shutdown = 1;
+	    //fprintf(stderr, "sigint\n");
+	    break;
+	default:
+	    break;
+	}
+}
+
+/**
+ * @brief O[oϐ̏
+ *
+ * ep[^ۑĂO[oϐB
+ */
+static void init_parameters() {
+    memset(wlan_interface, 0, 5);
+    strncpy(wlan_interface, WLAN_INTERFACE, sizeof(WLAN_INTERFACE));
+    
+    memset(fifo_path, 0, sizeof(fifo_path));
+    strncpy(fifo_path, FIFOPATH, sizeof(FIFOPATH));
+    
+    waiting_time = WAITING_TIME;
+    udp_port = UDP_PORT_NUMBER;
     
-    status = pthread_create(&recv_from_udp_thread_id, &detached_attr, recv_from_udp, NULL);
-    // status = pthread_create(&recv_from_udp_thread_id, NULL, recv_from_udp, NULL);
-    if (status != 0) {
-        syslog(LOG_LOCAL0|LOG_DEBUG, "[init_udp_socket] pthread_create error: %m");
-    }
+    memset(ctl_path, 0, sizeof(ctl_path));
+    strncpy(ctl_path, STA_CTL_PATH, sizeof(ctl_path) - 1);
     
-    return status;
+    memset(snap_path, 0, sizeof(snap_path));
+    memset(export_path, 0, sizeof(export_path));
+    memset(replay_path, 0, sizeof(replay_path));
+    stage_parse_cpus("", stage_cpus);
+    
+    sta_layout_active = sta_layout_find(STA_LAYOUT_DEFAULT);
 }
 
 /**
- * @brief AhX̍\̂
+ * @brief DADZbV𐧌\Pbg̕ԓ̌`ɋl߂
  *
- * AhX̍\̂B
- * 
+ * @param[out] dad l߂
+ * @param tenant eigԍAVOm[hȂSTA_CTL_ALL_TENANTS
+ * @param state address_status̒l
+ * @param addr AhX
+ * @param generated_time DADn߂
+ * @param deadline DADł؂鎞
  */
-void init_temporary_address_status() {
-    memset(&(temp_address.address), 0, sizeof(temp_address.address));
-    temp_address.generated_time = 0;
-    pthread_mutex_init(&(temp_address.mutex), NULL);
-    temp_address.flag = NOT_DUPLICATE;
+static void ctl_fill_dad(sta_ctl_dad *dad, uint32_t tenant, int state, const struct in6_addr *addr, time_t generated_time, time_t deadline) {
+    memset(dad, 0, sizeof(*dad));
+    dad->tenant = tenant;
+    dad->state = state;
+    dad->addr = *addr;
+    dad->generated_time = generated_time;
+    dad->deadline = deadline;
 }
 
 /**
- * @brief DAD̂߂UDPM
+ * @brief \PbgADD/DEL
  *
- * DAĎʂ̎MXbhB
- * MĂɂȂqXbhɏCB
- * X^[^̏ꍇDAD̕ԓ󂯎A]ȍꍇAREQ󂯎
+ * AhX̐ݒ̒iĂ΂Bm肵STA̐ݒƓXbhŏԂɏ̂ŁA
+ * STATĂ܂ł̊Ԃɓւ邱Ƃ͂ȂB
+ * @param req ṽwb_
+ * @param payload ṽyC[h
+ * @param[out] rep ԓ̃wb_
+ * @param[out] out ԓ̃yC[hBsta_ctl_dad傫邱
  */
-void *recv_from_udp(void *arg) {
-	UNUSED(arg);
-	
-    int status;
-    int len;
-    char *buf;
+static void ctl_handle_change(const sta_ctl_hdr *req, const void *payload, sta_ctl_hdr *rep, void *out) {
+    int per_tenant = (tenant_max > 0 && req->tenant != STA_CTL_ALL_TENANTS);
+    int idx = (int)req->tenant;
+    struct sockaddr_in6 sin6;
     
-    while (!srv_shutdown) {
-        pthread_t recv_from_udp_child_thread_id;
-        pthread_attr_t detached_attr;
-        struct sockaddr_storage from;
-        socklen_t fromlen;
-        pthreadarg_addr_buf *pthreadarg;
+    switch (req->op) {
+    case STA_CTL_ADD: {
+        const sta_ctl_position *pos = (const sta_ctl_position *)payload;
+        PositionOut po;
+        int ret;
         
-        fromlen = sizeof(from);
-        
-        buf = (char *)malloc(UDP_RECV_BUF_SIZE * sizeof(char));
-        pthreadarg = (pthreadarg_addr_buf *)malloc(sizeof(pthreadarg_addr_buf));
-        
-        pthread_attr_init(&detached_attr);
-        pthread_attr_setdetachstate(&detached_attr, PTHREAD_CREATE_DETACHED);
+        if (req->len != sizeof(*pos)
+            || (pos->ifname[0] != '\0' && strncmp(pos->ifname, wlan_interface, sizeof(pos->ifname)) != 0)) {
+            rep->status = STA_CTL_EINVAL;
+            return;
+        }
+        memset(&po, 0, sizeof(po));
+        memcpy(po.nodeid, pos->nodeid, sizeof(po.nodeid));
+        po.time = (time_t)pos->time;
+        po.lat = pos->lat;
+        po.lon = pos->lon;
+        po.alt = pos->alt;
         
-        len = recvfrom(sockfd, buf, UDP_RECV_BUF_SIZE, 0, (struct sockaddr *)&from, &fromlen);
-        if (len < 0) {
-            syslog(LOG_LOCAL0|LOG_DEBUG, "[recv_from_udp] recvfrom error: %m");
-            continue;
-        } else if (len == 0) {
-            char theotherside[NI_MAXHOST];
-            int ret;
-            ret = getnameinfo((struct sockaddr *)&from, sizeof(from), theotherside, sizeof(theotherside), NULL, 0, NI_NUMERICHOST);
-            if (ret != 0) {
-                syslog(LOG_LOCAL0|LOG_DEBUG, "[recv_from_udp] getnameinfo error: %s", gai_strerror(ret));
-            } else {
-                syslog(LOG_LOCAL0|LOG_DEBUG, "[recv_from_udp] the other side(%s) shut down normally.", theotherside);
+        if (tenant_max > 0) {
+            if (!per_tenant) {
+                pthread_mutex_lock(&tenant_add_mutex);
+                idx = tenant_lookup_or_add(po.nodeid);
+                pthread_mutex_unlock(&tenant_add_mutex);
+                if (idx == -1) {
+                    rep->status = STA_CTL_ENOENT;
+                    return;
+                }
             }
+            ret = tenant_start_dad(idx, &po, 0, 1, &sin6);
         } else {
-            syslog(LOG_LOCAL0|LOG_DEBUG, "[recv_from_udp] %d", len);
+            ret = start_dad(&po, &sin6);
+            idx = STA_CTL_ALL_TENANTS;
         }
         
-        memcpy(&(pthreadarg->fromaddr), &from, sizeof(struct sockaddr_storage));
-        pthreadarg->buf = buf;
-        pthreadarg->usedlen = len;
+        if (ret == 1) {
+            rep->status = STA_CTL_EBUSY;
+        } else if (ret != 0) {
+            rep->status = STA_CTL_EINVAL;
+        } else {
+            ctl_fill_dad((sta_ctl_dad *)out, idx, DAD, &(sin6.sin6_addr), time(NULL), time(NULL) + waiting_time);
+            rep->len = sizeof(sta_ctl_dad);
+        }
+        break;
+    }
+    case STA_CTL_DEL: {
+        const sta_ctl_ifname *ifn = (const sta_ctl_ifname *)payload;
         
-        status = pthread_create(&recv_from_udp_child_thread_id, &detached_attr, recv_from_udp_child, pthreadarg);
-        if (status != 0) {
-            syslog(LOG_LOCAL0|LOG_DEBUG, "[recv_from_udp] pthread_create error: %m");
+        if (req->len != sizeof(*ifn)
+            || (ifn->ifname[0] != '\0' && strncmp(ifn->ifname, wlan_interface, sizeof(ifn->ifname)) != 0)) {
+            rep->status = STA_CTL_EINVAL;
+            return;
+        }
+        if (per_tenant) {
+            pthread_mutex_lock(&(tenants.lock[idx]));
+            if (tenants.has_sta[idx]) {
+                memset(&sin6, 0, sizeof(sin6));
+                sin6.sin6_family = AF_INET6;
+                sin6.sin6_addr = tenants.sta[idx];
+                delete_sta(&sin6);
+                tenant_addr_remove(idx, TENANT_ADDR_CURRENT);
+                cell_follow(idx * 2 + TENANT_ADDR_CURRENT, NULL);
+            } else {
+                rep->status = STA_CTL_ENOENT;
+            }
+            pthread_mutex_unlock(&(tenants.lock[idx]));
+        } else if (tenant_max > 0) {
+            rep->status = STA_CTL_EINVAL; // ǂ̃eigw肪Ȃ
+        } else if (find_my_sta(&sin6) == 0) {
+            if (delete_sta(&sin6) != 0) {
+                rep->status = STA_CTL_EINVAL;
+            } else {
+                cell_follow(TENANT_ADDR_CURRENT, NULL);
+                publish_sta(NULL);
+            }
+        } else {
+            rep->status = STA_CTL_ENOENT;
         }
+        break;
+    }
+    default:
+        rep->status = STA_CTL_ENOTSUP;
+        break;
     }
-    return NULL;
 }
 
 /**
- * @brief DAD̂߂UDPMAqXbh
+ * @brief \Pbg̗v
  *
- * ۂ̏󂯎qXbh
- * X^[^̏ꍇDAD̕ԓ󂯎A]ȍꍇAREQ󂯎
+ * sta_ctl.c̎tXbhĂ΂BADD/DELctl_handle_changeŃAhX̐ݒ̒iɔCB
+ * }`eig[hłreq->tenantŃeigw肷B
+ * @param req ṽwb_
+ * @param payload ṽyC[h
+ * @param[out] rep ԓ̃wb_
+ * @param[out] out ԓ̃yC[h
+ * @param outmax out̑傫
  */
-void *recv_from_udp_child(void *arg) {
-    pthreadarg_addr_buf *pthreadarg = (pthreadarg_addr_buf *)arg;
-    struct sockaddr_in6 *fromaddr = (struct sockaddr_in6 *)&(pthreadarg->fromaddr);
-    int ret;
-    u_int16_t type;
-    char *buf;
+static void ctl_handle_request(const sta_ctl_hdr *req, const void *payload, sta_ctl_hdr *rep, void *out, size_t outmax) {
+    int per_tenant = (tenant_max > 0 && req->tenant != STA_CTL_ALL_TENANTS);
+    int idx = (int)req->tenant;
+    published_state state;
     
-    if (packet_type_is_areq(pthreadarg->buf)) { // ]ȍꍇAAREQ󂯂
-        struct sockaddr_in6 requested_address;
-        arep_flag_reserved flag_reserved;
-        struct ifaddrs *ifap0, *ifap;
-        struct sockaddr_in6 mysta_sin6;
-        
-        memcpy(&requested_address, &(pthreadarg->buf[sizeof(type)]), sizeof(requested_address));
-        memset(&flag_reserved, 0, sizeof(flag_reserved));
+    if (per_tenant && (req->tenant >= (uint32_t)tenants.count)) {
+        rep->status = STA_CTL_ENOENT;
+        return;
+    }
+    
+    switch (req->op) {
+    case STA_CTL_GET_STA: {
+        sta_ctl_sta *sta = (sta_ctl_sta *)out;
         
-        type = AREP;
-        buf = (char *)malloc(AREP_PACKET_SIZE * sizeof(char));
-        memset(buf, 0, AREP_PACKET_SIZE);
-        memcpy(buf, &type, sizeof(type));
-        memcpy(&(buf[sizeof(type) + sizeof(flag_reserved)]), &requested_address, sizeof(requested_address));
+        memset(sta, 0, sizeof(*sta));
+        strncpy(sta->ifname, wlan_interface, sizeof(sta->ifname) - 1);
+        if (per_tenant) {
+            pthread_mutex_lock(&(tenants.lock[idx]));
+            if (tenants.has_sta[idx]) {
+                sta->addr = tenants.sta[idx];
+            } else {
+                rep->status = STA_CTL_ENOENT;
+            }
+            pthread_mutex_unlock(&(tenants.lock[idx]));
+        } else {
+            read_state(&state);
+            if (state.has_sta) {
+                sta->addr = state.sta;
+            } else {
+                rep->status = STA_CTL_ENOENT;
+            }
+        }
+        rep->len = sizeof(*sta);
+        break;
+    }
+    case STA_CTL_GET_PENDING: {
+        sta_ctl_dad *dad = (sta_ctl_dad *)out;
         
-        // STA𒲂ׂ
-        if (getifaddrs(&ifap0)) {
-            syslog(LOG_LOCAL0|LOG_DEBUG, "[recv_from_udp_child] getifaddrs error %m");
+        if (per_tenant) {
+            pthread_mutex_lock(&(tenants.lock[idx]));
+            ctl_fill_dad(dad, req->tenant, tenants.dad_state[idx], &(tenants.pending[idx]), 0, tenants.dad_deadline[idx]);
+            pthread_mutex_unlock(&(tenants.lock[idx]));
+        } else {
+            read_state(&state);
+            ctl_fill_dad(dad, STA_CTL_ALL_TENANTS, state.flag, &(state.pending),
+                         state.generated_time, state.generated_time + waiting_time);
+        }
+        if (IN6_IS_ADDR_UNSPECIFIED(&(dad->addr))) {
+            rep->status = STA_CTL_ENOENT;
         }
-        for (ifap = ifap0; ifap; ifap = ifap->ifa_next) {
-            if (strstr(ifap->ifa_name, wlan_interface)) {
-                if (ifap->ifa_addr == NULL) {
-                    syslog(LOG_LOCAL0|LOG_DEBUG, "[recv_from_udp_child] %s ifa_addr is NULL!!", wlan_interface);
+        rep->len = sizeof(*dad);
+        break;
+    }
+    case STA_CTL_GET_DAD: {
+        sta_ctl_dad *dad = (sta_ctl_dad *)out;
+        size_t n = 0;
+        size_t nmax = outmax / sizeof(sta_ctl_dad);
+        
+        if (tenant_max > 0) {
+            int count = tenants.count;
+            for (idx = 0; idx < count; idx++) {
+                if (tenants.dad_state[idx] != DAD) { // bNȂŔ`
                     continue;
                 }
-                if (ifap->ifa_addr->sa_family == AF_INET6) {
-                    struct sockaddr_in6 *temp_sockaddr_in6 = (struct sockaddr_in6 *)(ifap->ifa_addr);
-                    if (IN6_IS_ADDR_STA(&temp_sockaddr_in6->sin6_addr)) {
-                        mysta_sin6 = *temp_sockaddr_in6;
-                        break;
-                    } else {
-                        continue;
-                    }
-                } else {
-                    // v4AhX
-                    continue;
+                if (n >= nmax) {
+                    rep->flags |= STA_CTL_F_TRUNCATED;
+                    break;
                 }
-            } else {
-                // ath0ȊO
-                continue;
+                pthread_mutex_lock(&(tenants.lock[idx]));
+                if (tenants.dad_state[idx] == DAD) {
+                    ctl_fill_dad(&dad[n++], idx, DAD, &(tenants.pending[idx]), 0, tenants.dad_deadline[idx]);
+                }
+                pthread_mutex_unlock(&(tenants.lock[idx]));
+            }
+        } else {
+            read_state(&state);
+            if (state.flag == DAD) {
+                ctl_fill_dad(&dad[n++], STA_CTL_ALL_TENANTS, DAD, &(state.pending),
+                             state.generated_time, state.generated_time + waiting_time);
             }
         }
+        rep->len = n * sizeof(sta_ctl_dad);
+        break;
+    }
+    case STA_CTL_GET_METRICS:
+        metrics.cell_groups = cell_joined();
+        metrics.allocations = alloc_count();
+        metrics.queue_decision = stage_depth(&decision_queue);
+        metrics.queue_dad = stage_depth(&dad_queue);
+        metrics.queue_program = stage_depth(&program_queue);
+        metrics.queue_dropped = decision_queue.dropped + dad_queue.dropped;
+        memcpy(out, &metrics, sizeof(metrics));
+        rep->len = sizeof(metrics);
+        break;
+    case STA_CTL_ADD:
+    case STA_CTL_DEL: {
+        // C^[tF[Xς̂ŁAAhX̐ݒ̒iɔCďI܂ő҂
+        volatile int done = 0;
+        program_request preq;
         
-        if (in6_addr_equal(&(requested_address.sin6_addr), &(mysta_sin6.sin6_addr)) == 0) { // ̃AhXƈقȂ
-            // AREP_FLAG=0̃pPbgԂ
-            flag_reserved.arep_flag = 0;
-            memcpy(&(buf[sizeof(type)]), &flag_reserved, sizeof(flag_reserved));
-            ret = sendto(sockfd, buf, AREP_PACKET_SIZE, 0, (struct sockaddr *)fromaddr, sizeof(fromaddr));
-        } else { // Ad
-            // AREP_FLAG=1̃pPbgԂ
-            flag_reserved.arep_flag = 1;
-            memcpy(&(buf[sizeof(type)]), &flag_reserved, sizeof(flag_reserved));
-            ret = sendto(sockfd, buf, AREP_PACKET_SIZE, 0, (struct sockaddr *)fromaddr, sizeof(fromaddr));
+        memset(&preq, 0, sizeof(preq));
+        preq.req = req;
+        preq.payload = payload;
+        preq.rep = rep;
+        preq.out = out;
+        preq.done = &done;
+        program_push(&preq);
+        pthread_mutex_lock(&program_done_mutex);
+        while (!done) {
+            pthread_cond_wait(&program_done_cond, &program_done_mutex);
         }
+        pthread_mutex_unlock(&program_done_mutex);
+        break;
+    }
+    case STA_CTL_GET_NEIGH: {
+        int truncated;
         
-        free(buf);
-        return NULL;
-        
-    } else if (packet_type_is_arep(pthreadarg->buf)) { // X^[^̏ꍇAAREP(DAD̕ԓ)󂯎
-        if (is_duplicate(pthreadarg->buf) == 0) {
-            return NULL; // do nothing
-        } else { // d
-            // ^C}[~߂ăCxg
-            char host[NI_MAXHOST];
-            pthread_mutex_lock(&(temp_address.mutex));
-            temp_address.flag = DUPLICATE;
-            getnameinfo((struct sockaddr *)&(temp_address.address), sizeof(struct sockaddr_in6), host, sizeof(host), NULL, 0, NI_NUMERICHOST);
-            pthread_mutex_unlock(&(temp_address.mutex));
-            syslog(LOG_LOCAL0|LOG_DEBUG, "# DUPLICATE [recv_from_udp_child] %s", host);
-            timer_off(0);
+        if (neigh_refresh_time <= 0 && export_path[0] == '\0') {
+            rep->status = STA_CTL_ENOTSUP;
+            break;
         }
+        rep->len = neigh_dump((sta_ctl_neigh *)out, outmax / sizeof(sta_ctl_neigh), &truncated) * sizeof(sta_ctl_neigh);
+        if (truncated) {
+            rep->flags |= STA_CTL_F_TRUNCATED;
+        }
+        break;
+    }
+    default:
+        rep->status = STA_CTL_ENOTSUP;
+        break;
     }
-    return NULL;
 }
 
 /**
- * @brief AREQǂ肷
+ * @brief }`eig[h̏
  *
- * pPbgAREQǂ肷B
- * @param buf pPbgւ̃|C^
- * @retval 0 AREQȊO
- * @retval 1 AREQ
+ * eig\mۂA[J[XbhDAD̃^CAEgXbhNB
+ * AREQgȂAeiǧ܂Ƃ߂đXbhNB
+ * @retval 0 
+ * @retval -1 s
  */
-inline static int packet_type_is_areq(char *buf) {
-    u_int16_t type;
-    memcpy(&type, buf, sizeof(type));
+static int init_tenants() {
+    pthread_t reaper_thread_id;
     
-    if (type == AREQ) {
-        return 1;
-    } else { // ȊO
-        return 0;
+    if (tenant_table_init(tenant_max, NOT_DUPLICATE) != 0) {
+        return -1;
+    }
+    if (tenant_pool_start(tenant_workers, sizeof(tenant_sample), tenant_handle_sample) != 0) {
+        return -1;
+    }
+    if (pthread_create(&reaper_thread_id, NULL, tenant_dad_reaper, NULL) != 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[init_tenants] pthread_create error: %m");
+        return -1;
+    }
+    if (areq_candidates > 1 && multi_batch_start(areq_candidates, tenant_flush_candidates) != 0) {
+        return -1;
     }
+    syslog(LOG_LOCAL0|LOG_DEBUG, "multi-tenant mode: %d tenants, %d workers", tenant_max, tenant_workers);
+    return 0;
 }
 
 /**
- * @brief AREPǂ肷
+ * @brief AREQ̑M̏
  *
- * pPbgAREPǂ肷B
- * @parm buf pPbgւ̃|C^
- * @retval 0 AREPȊO
- * @retval 1 AREP
+ * MC^[tF[X̎wASm[h}`LXgւ̎QȂgݗĂxsA
+ * AREQ𑗂邽тɂsendtoōςނ悤ɂB
+ * C^[tF[X蒼ꂽƂsta_link̃Cxgł蒼B
+ * @retval 0 
+ * @retval -1 s
  */
-inline static int packet_type_is_arep(char *buf) {
-    u_int16_t type;
-    memcpy(&type, buf, sizeof(type));
+static int init_tx_path() {
+    wlan_ifindex = if_nametoindex(wlan_interface);
+    if (wlan_ifindex == 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[init_tx_path] %s not found: %m", wlan_interface);
+        return -1;
+    }
+    if (setsockopt(sockfd, IPPROTO_IPV6, IPV6_MULTICAST_IF, &wlan_ifindex, sizeof(wlan_ifindex)) != 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[init_tx_path] setsockopt error: %m");
+        return -1;
+    }
+    // /proc/net/igmp6Ƃ킩邪ftHgff02::1ɂ͎QĂ͂
+    // Double Check̂
+    setup_allnodes_membership(sockfd, wlan_ifindex);
     
-    if (type == AREP) {
-        return 1;
-    } else { // ȊO
-        return 0;
+    memset(&allnodes_dest, 0, sizeof(allnodes_dest));
+    allnodes_dest.sin6_family = AF_INET6;
+    allnodes_dest.sin6_port = htons(udp_port);
+    allnodes_dest.sin6_addr = in6addr_linklocalmulticast;
+    
+    // VOm[hł̓AhX̑āAJĂ鎩STAǂ
+    if (link_monitor_start(wlan_interface, on_link_change, on_addr_change) != 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[init_tx_path] link monitor is not available");
     }
+    syslog(LOG_LOCAL0|LOG_DEBUG, "AREQs go out on %s(%u)", wlan_interface, wlan_ifindex);
+    return 0;
 }
 
 /**
- * @brief d肩Ȃ肷
+ * @brief C^[tF[XςƂ̏
  *
- * AREPpPbg̃tOďd肩Ȃ肷B
- * @note ǂƂłȂꍇabortB
- * @param buf pPbgւ̃|C^
- * @retval 0 dȂ
- * @retval 1 d
+ * sta_link̊ĎXbhĂ΂Bオ蒼ꂽA
+ * MC^[tF[X̎wƃ}`LXgO[vւ̎Q蒼B
+ * @param ifindex VC^[tF[Xԍ
+ * @param up オĂ1
  */
-inline static int is_duplicate(char *buf) {
-    if (buf[16] == 0) { // dȂ
-        return 0;
-    } else if (buf[16] == 1) { // d
-        return 1;
-    } else {
-        assert(0);
+static void on_link_change(unsigned int ifindex, int up) {
+    METRIC_INC(link_events);
+    if (!up || ifindex == 0) {
+        return; // オƂɂ蒼
+    }
+    wlan_ifindex = ifindex;
+    if (setsockopt(sockfd, IPPROTO_IPV6, IPV6_MULTICAST_IF, &wlan_ifindex, sizeof(wlan_ifindex)) != 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "[on_link_change] setsockopt error: %m");
     }
+    setup_allnodes_membership(sockfd, ifindex);
+    cell_rejoin(ifindex);
+    syslog(LOG_LOCAL0|LOG_DEBUG, "[on_link_change] %s is up as %u, memberships restored", wlan_interface, ifindex);
 }
 
 /**
- * @brief Sm[hN[J}`LXgɎQo^
- *
- * Sm[hN[J}`LXgɂ炽߂ĖIɎQo^B
- * radvd 1.0̃\[XR[hQlɂB
+ * @brief ZƂ̃}`LXgO[v̏
  *
- * @param sock `FbN\Pbg
- * @param if_index `FbNC^[tF[X̃CfbNXԍ
+ * Xbg̓VOm[hȂ猻݂STADAĎ2A
+ * }`eig[hȂeigƂ2B
+ * łSTA΂̃Z̃O[vɎQĂB
  * @retval 0 
  * @retval -1 s
  */
-static int setup_allnodes_membership(int sock, unsigned int if_index) {
-    struct ipv6_mreq mreq;
-    char *if_name;
+static int init_cells() {
+    published_state state;
     
-    memset(&mreq, 0, sizeof(mreq));
-    mreq.ipv6mr_interface = if_index;
-    
-    /* ipv6-allnodes: ff02::1 */
-    mreq.ipv6mr_multiaddr.s6_addr32[0] = htonl(0xFF020000);
-    mreq.ipv6mr_multiaddr.s6_addr32[3] = htonl(0x1);
-
-    if (setsockopt(sock, SOL_IPV6, IPV6_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
-        /* linux-2.6.12-bk4 returns error with HUP signal but keep listening */
-        if (errno != EADDRINUSE) {
-            if_name = (char *)malloc(IF_NAMESIZE * sizeof(char));
-            memset(if_name, 0, IF_NAMESIZE * sizeof(char));
-            if_indextoname(if_index, if_name);
-            syslog(LOG_LOCAL0|LOG_DEBUG, "[setup_allnodes_membership] can't join ipv6-allnodes on %s(%d)", if_name, if_index);
-            return -1;
+    if (cell_bits == 0) {
+        return 0;
+    }
+    if (cell_init(sockfd, wlan_ifindex, sta_layout_active, cell_bits, (tenant_max > 0) ? tenant_max * 2 : 2) != 0) {
+        return -1;
+    }
+    if (tenant_max == 0) {
+        read_state(&state);
+        if (state.has_sta) {
+            cell_follow(TENANT_ADDR_CURRENT, &(state.sta));
         }
     }
-
+    syslog(LOG_LOCAL0|LOG_DEBUG, "per-cell multicast: cell_bits=%d, %d groups joined", cell_bits, cell_joined());
     return 0;
 }
 
 /**
- * @brief Sm[hN[J}`LXgւ̎Qo^`FbN
- *
- * Sm[hN[J}`LXgɎQĂ邩`FbNAQĂȂ΂炽߂ĎQo^B
- * radvd 1.0̃\[XR[hQlɂB
+ * @brief -BȂUDP\PbgBPFtB^t
  *
- * @param sock `FbN\PbgAIɂsetup_allnodes_membershipɓn߂Ɏg
- * @param if_index `FbNC^[tF[X̃CfbNXԍ
+ * -WŕĂΑS̃[J[̃\PbgɕtB
  * @retval 0 
  * @retval -1 s
  */
-static int check_allnodes_membership(int sock, unsigned int if_index) {
-    FILE *fp;
-    unsigned int idx, allnodes_ok = 0;
-    char addr[32 + 1];
-    int ret = 0;
-    char *if_name;
-
-    if ((fp = fopen(PATH_PROC_NET_IGMP6, "r")) == NULL) {
-        syslog(LOG_LOCAL0|LOG_DEBUG, "[check_allnodes_membership] can't open %s: %m", PATH_PROC_NET_IGMP6);
+static int init_socket_filter() {
+    int i;
+    
+    if (filter_start((tenant_max > 0) ? tenant_max * 2 : 2) != 0) {
         return -1;
     }
-    
-    while ((ret = fscanf(fp, "%u %*s %32[0-9A-Fa-f] %*x %*x %*x\n", &idx, addr)) != EOF) {
-        if (ret == 2) {
-            if (if_index == idx) {
-                if (strncmp(addr, ALL_NODES_MCAST, sizeof(addr)) == 0) {
-                    allnodes_ok = 1;
-                }
+    if (udp_workers > 1 && sockfd == udp_shards[0].fd) {
+        for (i = 0; i < udp_workers; i++) {
+            if (filter_attach(udp_shards[i].fd) != 0) {
+                return -1;
             }
         }
+    } else if (filter_attach(sockfd) != 0) {
+        return -1;
     }
-
-    fclose(fp);
-
-    if (!allnodes_ok) {
-        if_name = (char *)malloc(IF_NAMESIZE * sizeof(char));
-        memset(if_name, 0, IF_NAMESIZE * sizeof(char));
-        if_indextoname(if_index, if_name);
-        syslog(LOG_LOCAL0|LOG_DEBUG, "[check_allnodes_membership] resetting ipv6-allnodes membership on %s(%d)", if_name, if_index);
-        setup_allnodes_membership(sock, if_index);
-    }
-
+    syslog(LOG_LOCAL0|LOG_DEBUG, "BPF socket filter attached");
     return 0;
 }
 
-/**
- * @brief VOinh
- *
- * SIGTERMȂǂLb`nhB
- * @param sig Signal Number
- * @param si VOi\
- * @param context [U[ReLXg\
- */
-static void sigaction_handler(int sig, siginfo_t *si, void *context) {
-	UNUSED(si);
-	UNUSED(context);
-	
-	switch (sig) {
-	case SIGINT:
-	    srv_shutdown = 1;
-	    //fprintf(stderr, "sigint\n");
-	    break;
-	default:
-	    break;
-	}
-}
-
-/**
- * @brief O[oϐ̏
- *
- * ep[^ۑĂO[oϐB
- */
-static void init_parameters() {
-    memset(wlan_interface, 0, 5);
-    strncpy(wlan_interface, WLAN_INTERFACE, sizeof(WLAN_INTERFACE));
-    
-    memset(fifo_path, 0, sizeof(fifo_path));
-    strncpy(fifo_path, FIFOPATH, sizeof(FIFOPATH));
-    
-    waiting_time = WAITING_TIME;
-    udp_port = UDP_PORT_NUMBER;
-}
-
 /**
  * @brief gp@
  *
@@ -1037,12 +2768,32 @@ static void init_parameters() {
 static void usage() {
     fprintf(stderr, "Usage: stamd [options]\n");
     fprintf(stderr, "where options are:\n");
+    fprintf(stderr, "  -a candidates : Addresses per AREQ, with fallback candidates or aggregated tenants. Legacy AREQ while legacy peers are heard. (1 = legacy AREQ, up to %d)\n", MULTI_MAX);
+    fprintf(stderr, "  -A ingest,decision,dad,program : CPUs to pin the pipeline stages to, '-' to leave a stage unpinned. (none)\n");
+    fprintf(stderr, "  -B : Attach a BPF filter that drops looped-back, malformed and unexpected packets in the kernel. (off)\n");
+    fprintf(stderr, "  -c ctl_path : Path to control socket, empty to disable. (%s)\n", STA_CTL_PATH);
+    fprintf(stderr, "  -C cell_bits : Send AREQs to per-cell multicast groups, cells of 2^cell_bits STA units. (0 = ff02::1, %d-%d)\n", CELL_SHIFT_MIN, CELL_SHIFT_MAX);
+    fprintf(stderr, "  -e threads|epoll|uring : I/O engine for the FIFO and the UDP sockets. uring falls back to epoll. (threads)\n");
+    fprintf(stderr, "  -E confidence : Defer exits whose confidence ellipse of PositionOut.error crosses the range. (%.2f, 0 = ignore error)\n", FIX_CONFIDENCE_DEFAULT);
     fprintf(stderr, "  -f fifo_path : Path to FIFO. (%s)\n", FIFOPATH);
+    fprintf(stderr, "  -G grace : Make-before-break handoff, keep the old STA deprecated for grace [sec]. (0 = delete before add)\n");
+    fprintf(stderr, "  -g refresh : Unicast AREQs to nearby neighbours, multicast every refresh [sec]. (0 = always multicast)\n");
     fprintf(stderr, "  -h : Show this message and exit.\n");
+    fprintf(stderr, "  -H margin_m[,dwell_ms[,min_speed]] : Leave the valid range only beyond margin_m, after dwell_ms, and unless heading back (faster than min_speed [m/s]). (off)\n");
     fprintf(stderr, "  -i wlan_interface : WLAN Interface to use. (%s)\n", WLAN_INTERFACE);
+    fprintf(stderr, "  -K q : Smooth fixes with a constant-velocity Kalman filter, acceleration noise q [m^2/s^3]. (0 = off)\n");
+    fprintf(stderr, "  -L layout : STA bit layout, geo80, ground80 or kind:bits:decimals:step:offset[:s],..., z: prefix for Z-order (%s)\n", STA_LAYOUT_DEFAULT);
+    fprintf(stderr, "  -M max_tenants : Multi-tenant mode, manage STAs per PositionOut.nodeid. (0 = off)\n");
     fprintf(stderr, "  -n : Not daemonize.\n");
+    fprintf(stderr, "  -N backoff_ms : Negative-only AREPs, only nodes owning or testing the address reply after a random backoff. (off)\n");
     fprintf(stderr, "  -p port : UDP port number. (%d)\n", UDP_PORT_NUMBER);
+    fprintf(stderr, "  -r replay_path : Replay \"time lat lon alt\" lines instead of reading the FIFO, %d passes at their recorded pace, and exit 1 if the last pass allocates heap memory (stamd-check only). (off)\n", REPLAY_PASSES);
+    fprintf(stderr, "  -s snapshot_path : Keep state in an mmap'd snapshot and resume from it on restart. (off)\n");
+    fprintf(stderr, "  -S shm_path : Publish the neighbour table (STA, position, last seen, link quality) in a seqlock-protected shared file, e.g. /dev/shm/stamd-neigh. (off)\n");
     fprintf(stderr, "  -t waiting_time : Waiting Time [sec] in DAD. (%d)\n", WAITING_TIME);
+    fprintf(stderr, "  -T workers : Number of worker threads in multi-tenant mode. (1)\n");
+    fprintf(stderr, "  -W workers : Shard the UDP port over SO_REUSEPORT sockets, one receive loop pinned per CPU. (up to %d and the usable CPUs, off)\n", SHARD_MAX);
+    fprintf(stderr, "  -w legacy|compact|auto : AREQ wire format. auto uses compact only when no legacy-only node is heard. (legacy)\n");
     exit(1);
 }
 
@@ -1058,8 +2809,12 @@ int main(int argc, char **argv) {
     pthread_t recv_from_fifo_thread_id; // LocationmwFIFOMXbh
     pthread_t recv_from_udp_thread_id;
     int ret;
+    int resume = 0;
     struct sigaction act;
+    struct timeval started, ready;
+    char layout_desc[256];
     
+    gettimeofday(&started, NULL);
     memset(&act, 0, sizeof(act));
 
     openlog("stamd", LOG_PID, LOG_LOCAL0|LOG_DEBUG);
@@ -1068,31 +2823,126 @@ int main(int argc, char **argv) {
     
     init_parameters();
     
-    while ((ret = getopt(argc, argv, "fhi:np:t:")) != -1) {
+    while ((ret = getopt(argc, argv, "a:A:Bc:C:e:E:f:g:G:hH:i:K:L:M:nN:p:r:s:S:t:T:w:W:")) != -1) {
         switch (ret) {
+        case 'a':
+            areq_candidates = atoi(optarg);
+            if (areq_candidates < 1 || areq_candidates > MULTI_MAX) {
+                usage();
+            }
+            break;
+        case 'A':
+            if (stage_parse_cpus(optarg, stage_cpus) != 0) {
+                usage();
+            }
+            break;
+        case 'B':
+            socket_filter = 1;
+            break;
+        case 'c':
+            strncpy(ctl_path, optarg, sizeof(ctl_path) - 1);
+            break;
+        case 'C':
+            cell_bits = atoi(optarg);
+            break;
+        case 'e':
+            if (engine_from_string(optarg, &io_engine) != 0) {
+                usage();
+            }
+            break;
+        case 'E':
+            fix_confidence = atof(optarg);
+            if (fix_confidence < 0.0 || fix_confidence >= 1.0) {
+                usage();
+            }
+            break;
         case 'f':
             strncpy(fifo_path, optarg, sizeof(fifo_path) - 1);
             break;
+        case 'g':
+            neigh_refresh_time = atoi(optarg);
+            break;
+        case 'G':
+            handoff_grace = atoi(optarg);
+            if (handoff_grace < 0) {
+                usage();
+            }
+            break;
         case 'h':
             usage();
             break;
+        case 'H':
+            if (hyst_parse(optarg, &hysteresis) != 0) {
+                usage();
+            }
+            break;
         case 'i':
             strncpy(wlan_interface, optarg, sizeof(wlan_interface) - 1);
             break;
+        case 'K':
+            kalman_q = atof(optarg);
+            if (kalman_q < 0.0) {
+                usage();
+            }
+            break;
+        case 'L':
+            sta_layout_active = sta_layout_find(optarg);
+            if (sta_layout_active == NULL) {
+                fprintf(stderr, "invalid STA layout: %s\n", optarg);
+                usage();
+            }
+            break;
+        case 'M':
+            tenant_max = atoi(optarg);
+            break;
         case 'n':
             daemonize = 0;
             break;
+        case 'N':
+            negative_only = 1;
+            arep_backoff_ms = atoi(optarg);
+            break;
         case 'p':
             udp_port = atoi(optarg);
             break;
+        case 'r':
+            strncpy(replay_path, optarg, sizeof(replay_path) - 1);
+            break;
+        case 's':
+            strncpy(snap_path, optarg, sizeof(snap_path) - 1);
+            break;
+        case 'S':
+            strncpy(export_path, optarg, sizeof(export_path) - 1);
+            break;
         case 't':
             waiting_time = atoi(optarg);
             break;
+        case 'T':
+            tenant_workers = atoi(optarg);
+            break;
+        case 'w':
+            if (wire_mode_from_string(optarg, &areq_wire_mode) != 0) {
+                usage();
+            }
+            break;
+        case 'W':
+            udp_workers = atoi(optarg);
+            if (udp_workers < 0 || udp_workers > SHARD_MAX) {
+                usage();
+            }
+            break;
         default:
             usage();
         }
     }
     
+    if (fix_confidence > 0.0) {
+        fix_scale = fix_confidence_scale(fix_confidence);
+    }
+    sta_layout_describe(sta_layout_active, layout_desc, sizeof(layout_desc));
+    syslog(LOG_LOCAL0|LOG_DEBUG, "STA layout: %s", layout_desc);
+    syslog(LOG_LOCAL0|LOG_DEBUG, "I/O engine: %s", engine_name(io_engine));
+    
     if (daemonize) {
         daemon(0, 1);
     }
@@ -1107,15 +2957,75 @@ int main(int argc, char **argv) {
         return -1;
     }
 
+    srandom((unsigned int)time(NULL) ^ (unsigned int)getpid());
+    if (handoff_grace > 0 && handoff_start(handoff_grace, remove_retired_sta) != 0) {
+        fprintf(stderr, "handoff initialization failed\n");
+        printf("STA Management Daemon dying...\n");
+        closelog();
+        return -1;
+    }
     init_temporary_address_status();
+    if (init_stages() != 0) {
+        fprintf(stderr, "pipeline stages initialization failed\n");
+        printf("STA Management Daemon dying...\n");
+        closelog();
+        return -1;
+    }
+    neigh_init(neigh_refresh_time, export_path[0] != '\0');
+    if (tenant_max > 0 && init_tenants() != 0) {
+        fprintf(stderr, "multi-tenant mode initialization failed\n");
+        printf("STA Management Daemon dying...\n");
+        closelog();
+        return -1;
+    }
+    // AREQ󂯎n߂OɁAȌԂǂݖ߂Ă
+    if (snap_path[0] != '\0') {
+        if (snap_open(snap_path, sizeof(snapshot_state)) == 0) {
+            resume = restore_snapshot();
+        } else {
+            syslog(LOG_LOCAL0|LOG_DEBUG, "snapshot %s is not available", snap_path);
+        }
+    }
     init_udp_socket(recv_from_udp_thread_id);
+    if (socket_filter && init_socket_filter() != 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "BPF socket filter is not available");
+    }
+    if (init_tx_path() != 0) {
+        fprintf(stderr, "%s is not available\n", wlan_interface);
+        printf("STA Management Daemon dying...\n");
+        closelog();
+        return -1;
+    }
+    if (init_cells() != 0) {
+        fprintf(stderr, "per-cell multicast initialization failed\n");
+        printf("STA Management Daemon dying...\n");
+        closelog();
+        return -1;
+    }
+    if (resume) {
+        resume_dad();
+    }
+    gettimeofday(&ready, NULL);
+    metrics.startup_us = (uint64_t)((ready.tv_sec - started.tv_sec) * 1000000L + (ready.tv_usec - started.tv_usec));
+    syslog(LOG_LOCAL0|LOG_DEBUG, "ready to answer AREQs in %llu us", (unsigned long long)metrics.startup_us);
+    snap_start(snapshot_collect, SNAP_INTERVAL_MS);
+    if (export_path[0] != '\0' && (export_open(export_path, NEIGH_MAX) != 0 || export_start(neigh_export, EXPORT_INTERVAL_MS) != 0)) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "neighbour table %s is not available", export_path);
+    }
+    if (ctl_path[0] != '\0' && sta_ctl_start(ctl_path, ctl_handle_request) != 0) {
+        syslog(LOG_LOCAL0|LOG_DEBUG, "control socket %s is not available", ctl_path);
+    }
     
-    ret = pthread_create(&recv_from_fifo_thread_id, NULL, recv_from_fifo, (void *)NULL);
+    if (replay_path[0] != '\0') {
+        ret = pthread_create(&recv_from_fifo_thread_id, NULL, replay_positions, &replay_status);
+    } else {
+        ret = pthread_create(&recv_from_fifo_thread_id, NULL, recv_from_fifo, (void *)NULL);
+    }
     
     pthread_join(recv_from_fifo_thread_id, NULL);
     syslog(LOG_LOCAL0|LOG_DEBUG, "STA Management Daemon dying...");
     printf("STA Management Daemon dying...\n");
     
     closelog();
-    return 0;
+    return replay_status;
 }
@@ -13,11 +13,13 @@
 #define WAITING_TIME 10 ///< second
 #define UDP_PORT_NUMBER 5003 ///< GPSRDEFAULT_DAEMON_PORTADEFAULT_OAM_PORT̎
 #define UDP_RECV_BUF_SIZE 512
+#define VALID_RANGE_M 50.0 ///< L͈͂̔a(a)[m]
+#define MY_ADDRS_MAX 64 ///< is_from_myselfoẴAhX̐
+#define STAGE_DECISION_QUEUE_LEN 256 ///< f̒i߂Ăʒu̐
+#define STAGE_DAD_QUEUE_LEN 16 ///< DAD̒i߂Ăʒu̐
+#define STAGE_PROGRAM_QUEUE_LEN 16 ///< AhX̐ݒ̒i߂ĂSTA̐
+#define REPLAY_PASSES 2 ///< -rōĐ񐔁BŌ1q[v̊mۂ𐔂
 #define IN6ADDR_MC_LINKLOCAL_INIT { { { 0xff,0x02,0,0,0,0,0,0,0,0,0,0,0,0,0,0x1 } } }
-#define AREQ_PACKET_SIZE 160
-#define AREP_PACKET_SIZE 160
-#define ALL_NODES_MCAST "ff020000000000000000000000000001"
-#define PATH_PROC_NET_IGMP6 "/proc/net/igmp6"
 
 // RpČx}邽߂Ɏg
 #define UNUSED(x) ((void)(x))
@@ -45,6 +47,15 @@ typedef enum _address_status {
     NOT_DUPLICATE
 } address_status;
 
+/**
+ * @brief L͈͂̔茋
+ */
+typedef enum _range_verdict {
+    RANGE_OUTSIDE = 0,
+    RANGE_INSIDE = 1,
+    RANGE_UNSURE = 2 ///< Mȉ~EɂĂāAǂƂȂ
+} range_verdict;
+
 /**
  * @brief pPbg̃^Cv\邽߂̗񋓌^
  *
@@ -52,7 +63,9 @@ typedef enum _address_status {
  */
 typedef enum _packet_type {
     AREQ,
-    AREP
+    AREP,
+    AREQ_MULTI, ///< AREQ(sta_multi.h)
+    AREP_MULTI ///< AREP(sta_multi.h)
 } packet_type;
 
 /**
@@ -76,16 +89,38 @@ typedef struct _PositionOut {
 } PositionOut;
 
 /**
- * @brief recv_from_udp_child֐̈
+ * @brief refresh_my_addrsnetlinkW߂AhX
+ */
+typedef struct _my_addrs_dump {
+    struct in6_addr addrs[MY_ADDRS_MAX];
+    int n;
+} my_addrs_dump;
+
+/**
+ * @brief AhX̐ݒ̒iւ̈˗
  *
- * recv_from_udp_child֐̈̌^B
- * MAhXƃf[^i[Ăobt@̃AhXB
+ * C^[tF[X̃AhXς鏈͑S̒iŏԂɍsA݂ɒǂzȂB
+ * \PbgADD/DEĹAiԓI܂Ő̃Xbh҂B
  */
-typedef struct _pthreadarg_addr_buf {
-    struct sockaddr_storage fromaddr;
-    char *buf;
-    int usedlen;
-} pthreadarg_addr_buf;
+typedef struct _program_request {
+    struct sockaddr_in6 sta; ///< reqNULL̂ƂAm肵STA
+    const sta_ctl_hdr *req; ///< \Pbg̗vBm肵STA̐ݒȂNULL
+    const void *payload;
+    sta_ctl_hdr *rep;
+    void *out;
+    volatile int *done; ///< ԓI1ɂ
+} program_request;
+
+/**
+ * @brief [J[ɓneig̃Tv
+ *
+ * }`eig[hFIFO󂯎ʒu[J[ɓnƂ̌^B
+ */
+typedef struct _tenant_sample {
+    int idx; ///< eigԍ
+    uint64_t seq; ///< eig̒ł̈ʒu̔ԍB1
+    PositionOut po; ///< 󂯎ʒu
+} tenant_sample;
 
 /**
  * @brief 蓖ĖԂ̉AhX
@@ -99,54 +134,181 @@ typedef struct _temporary_address_status {
     time_t generated_time;
     pthread_mutex_t mutex;
     address_status flag; ///< dĂ邩ǂB0ŏdȂA1łB
+    struct in6_addr candidates[MULTI_MAX]; ///< AREQŖ₢킹B擪addressƓ
+    int ncandidates; ///< ̐B]AREQȂ1
+    uint32_t duplicate; ///< d̕ԓ̃rbg
+    uint32_t txid; ///< AREQ̔ԍ
+    struct in6_addr sta; ///< STABpublish_stateŌJ鏑葤̍T
+    int has_sta;
 } temporary_address_status;
 
 /**
- * @brief AREPpPbg1631rbg
+ * @brief pPbg̏ǂރVOm[h̏
+ *
+ * temp_address.mutex肪publish_stateŏA
+ * ǂݎread_statestate_seqgēǂނ̂ŁA肪J[lĂłĂ҂ȂB
+ */
+typedef struct _published_state {
+    struct in6_addr sta; ///< STA
+    int has_sta;
+    address_status flag; ///< DAĎ̏
+    struct in6_addr pending; ///< DAĎ(temp_address.address)
+    time_t generated_time;
+    struct in6_addr candidates[MULTI_MAX];
+    int ncandidates;
+} published_state;
+
+/**
+ * @brief XibvVbgɏ
  *
- * AREPpPbg1631rbgځA1rbgAREP_FLAG
- * 15rbg̗\̈悩ȂB
+ * ċNƂɓǂݖ߂Bߗ׃m[h͎gĂ镪̂ōŌɒuB
  */
-typedef struct _arep_flag_reserved {
-    unsigned arep_flag : 1;
-    unsigned reserved : 15;
-} __attribute__((packed)) arep_flag_reserved;
+typedef struct _snapshot_state {
+    char ifname[IF_NAMESIZE]; ///< Ƃwlan_interfaceBႦΓǂݖ߂Ȃ
+    int64_t saved; ///< 
+    int32_t has_sta;
+    struct in6_addr sta; ///< Ƃ̎STA
+    int32_t dad_flag; ///< DAĎ̏
+    int32_t ncandidates;
+    uint32_t duplicate; ///< d̕ԓ̃rbg
+    uint32_t txid;
+    int64_t generated_time; ///< DADn߂
+    struct in6_addr candidates[MULTI_MAX];
+    sta_metrics metrics;
+    int64_t neigh_swept; ///< ŌɃ}`LXg
+    uint32_t nneigh;
+    sta_ctl_neigh neigh[NEIGH_MAX];
+} snapshot_state;
 
 int daemonize = 1;
 char fifo_path[256];
+char ctl_path[108]; ///< \Pbg̃pXBsun_path̑傫
+char snap_path[256]; ///< XibvVbg̃pXBȂgȂ
+char export_path[256]; ///< ߗ׃m[h̕\oL̃pXBȂ珑oȂ
+char replay_path[256]; ///< Đʒũt@CBȂFIFOǂ
 char wlan_interface[5];
 int udp_port = 0;
 int waiting_time = 0;
+int tenant_max = 0; ///< 0ȂVOm[hAȂ}`eig[h̍őeig
+int tenant_workers = 1; ///< }`eig[h̃[J[Xbh
+engine_kind io_engine = ENGINE_THREADS; ///< FIFOUDP\PbgǂރGW
+int socket_filter = 0; ///< 1ȂUDP\PbgBPFtB^t(-B)
+int udp_workers = 0; ///< SO_REUSEPORTUDP|[g𕪊郏[J[̐B1ȉȂ番Ȃ
+int areq_candidates = 1; ///< 1AREQɓ̐B1Ȃ]AREQ
+wire_mode areq_wire_mode = WIRE_MODE_LEGACY; ///< AREQ̌`̑Iѕ
+int negative_only = 0; ///< 1Ȃd̂ƂAREPԂĂ炤
+int arep_backoff_ms = 0; ///< dAREPԂOɑ҂ő厞[~b]
+const sta_layout *sta_layout_active = NULL; ///< STÃrbgzuBinit_parametersŊ̔zuɂ
+int handoff_grace = 0; ///< ÂSTA񐄏̂܂܎cbB0ȂVSTAOɏ
+double fix_confidence = FIX_CONFIDENCE_DEFAULT; ///< Mȉ~̐MxB0Ȃ瑪ʂ̕smȂ
+double kalman_q = 0.0; ///< J}tB^̉x̎G̋B0Ȃ畽Ȃ
+hyst_params hysteresis; ///< L͈͂oƔfqXeVXB0ȂgȂ
+int cell_bits = 0; ///< ZƂ̃}`LXgO[ṽZ̑傫(Ƃʃrbg)B0ȂgȂ
+int neigh_refresh_time = 0; ///< ߗ׃m[h̕\gƂ̃}`LXg̊Ԋu[b]B0ȂgȂ
+int stage_cpus[STAGE_MAX]; ///< iƂɌŒ肷CPU(-A)BȂŒ肵Ȃ
+static pthread_mutex_t tenant_add_mutex = PTHREAD_MUTEX_INITIALIZER; ///< tenant_lookup_or_add̔r
 int sockfd; ///< UDPM\Pbg̃fBXNv^
+static shard_worker udp_shards[SHARD_MAX]; ///< -W̃[J[B0Ԃ̃\Pbgsockfd
 temporary_address_status temp_address; ///< 蓖ĖԂ̉AhX
+static double fix_scale = 0.0; ///< fix_confidence̐Mȉ~̔{
+static fix_filter my_fix; ///< VOm[h̃J}tB^̏
+static hyst_state my_hyst; ///< VOm[h̃qXeVX̏
+static seqlock state_seq; ///< published̃V[PXbN
+static published_state published; ///< pPbg̏ǂޏ
 static struct in6_addr in6addr_linklocalmulticast = IN6ADDR_MC_LINKLOCAL_INIT;
+static unsigned int wlan_ifindex = 0; ///< wlan_interface̔ԍBsta_link̃CxgōXV
+static struct sockaddr_in6 allnodes_dest; ///< gݗčς݂AREQ̈(Sm[h)
+static struct in6_addr my_addrs[MY_ADDRS_MAX]; ///< IPv6AhXBrefresh_my_addrsŒג
+static int my_naddrs = 0;
+static seqlock my_addrs_seq; ///< my_addrs̃V[PXbN
+static pthread_mutex_t my_addrs_mutex = PTHREAD_MUTEX_INITIALIZER; ///< refresh_my_addrs̔r
+static stage_queue decision_queue; ///< ǂݍ݂̒i画f̒i
+static stage_queue dad_queue; ///< f̒iDAD̒i
+static stage_queue program_queue; ///< ^C}[Ɛ̃XbhAhX̐ݒ̒i
+static pthread_mutex_t program_push_mutex = PTHREAD_MUTEX_INITIALIZER; ///< program_queuȅ2̂ŁAƂr
+static pthread_mutex_t program_done_mutex = PTHREAD_MUTEX_INITIALIZER; ///< program_request.done҂
+static pthread_cond_t program_done_cond = PTHREAD_COND_INITIALIZER;
+static int replay_status = 0; ///< -řʁBŌ1Ńq[vmۂ1
 
 static volatile sig_atomic_t srv_shutdown = 0;
 
 static int add_sta(struct sockaddr_in6 *newsta);
-static int allocation_request_start(struct sockaddr_in6 newsta);
+static long arep_backoff(void);
+static int allocation_request_start(const struct in6_addr *candidates, int count, uint32_t txid, int wait);
 static void allocation_request_timeout(void);
-static int check_allnodes_membership(int sock, unsigned int if_index);
+static void ctl_handle_change(const sta_ctl_hdr *req, const void *payload, sta_ctl_hdr *rep, void *out);
+static void ctl_handle_request(const sta_ctl_hdr *req, const void *payload, sta_ctl_hdr *rep, void *out, size_t outmax);
+static void *dad_stage(void *arg);
+static void *decision_stage(void *arg);
 static int decode_from_sta(struct in6_addr *sta, PositionOut *po);
 static int delete_sta(struct sockaddr_in6 *oldsta);
 static int encode_to_sta(PositionOut po, struct in6_addr *newsta);
+static int find_my_sta(struct sockaddr_in6 *sta);
+static int find_my_sta_cb(unsigned int ifindex, const struct in6_addr *addr, void *arg);
+static void follow_pending(int slot, const struct in6_addr *addr);
 static int get_socket_for_afinet6();
+static void handle_areq_multi(int fd, const struct sockaddr_in6 *from, char *buf, int len);
+static void handle_arep_multi(const struct sockaddr_in6 *from, const char *buf, int len);
+static void handle_fifo_record(const void *record);
+static void handle_position(PositionOut *output);
+static void handle_udp_packet(int fd, const struct sockaddr_in6 *fromaddr, char *packet, int usedlen);
 static int in6_addr_equal(const struct in6_addr *a, const struct in6_addr *b);
+static int init_cells(void);
+static int install_sta(struct sockaddr_in6 *newsta);
+static int init_tenants(void);
 static void init_parameters(void);
+static int init_socket_filter(void);
+static int init_stages(void);
 static void init_temporary_address_status(void);
+static int init_tx_path(void);
 static int init_udp_socket(pthread_t recv_from_udp_thread_id);
-static int is_inside_valid_range(const PositionOut * const real, const PositionOut * const decoded);
+static int is_from_myself(const struct sockaddr_in6 *from);
+static PositionOut *load_replay(const char *path, size_t *n);
+static range_verdict is_inside_valid_range(const PositionOut * const real, const PositionOut * const decoded);
+static void neigh_learn_from_packet(const struct sockaddr_in6 *from, const struct in6_addr *sta);
+static void on_addr_change(void);
+static void on_link_change(unsigned int ifindex, int up);
+static void program_push(const program_request *preq);
+static void *program_stage(void *arg);
+static void program_sta(const struct sockaddr_in6 *confirmed);
+static void publish_sta(const struct in6_addr *sta);
+static void publish_state(void);
+static void read_state(published_state *out);
+static int read_record(int fd, PositionOut *output);
+static void refresh_my_addrs(void);
+static int refresh_my_addrs_cb(unsigned int ifindex, const struct in6_addr *addr, void *arg);
+static void refresh_my_sta(void);
+static int restore_snapshot(void);
+static void remove_retired_sta(const struct in6_addr *addr);
+static void *replay_positions(void *arg);
+static void request_dad(const PositionOut *po);
+static void resume_dad(void);
+static void retire_sta(struct sockaddr_in6 *oldsta);
+static int same_position(const struct in6_addr *a, const struct in6_addr *b);
+static int send_areq(struct sockaddr_in6 *newsta);
+static int send_areq_multi(const struct in6_addr *candidates, int count, uint32_t txid);
+static int send_dad_packet(const struct in6_addr *where, const char *buf, size_t len);
 static int setup_allnodes_membership(int sock, unsigned int if_index);
+static int should_leave_range(hyst_state *h, const PositionOut *real, const PositionOut *anchor);
 static void sigaction_handler(int sig, siginfo_t *si, void *context);
+static void smooth_fix(fix_filter *f, PositionOut *po);
+static size_t snapshot_collect(void *buf, size_t size);
+static int start_dad(const PositionOut *po, struct sockaddr_in6 *candidate);
+static void submit_position(const PositionOut *output);
+static void tenant_dad_complete(int idx);
+static void tenant_dispatch_sample(const PositionOut *po);
+static void tenant_flush_candidates(const struct in6_addr *candidates, int count);
+static void tenant_handle_sample(void *item);
+static int tenant_mark_duplicate(const struct in6_addr *addr);
+static int tenant_start_dad(int idx, PositionOut *po, uint64_t seq, int force, struct sockaddr_in6 *candidate);
+static uint32_t testing_mask(const struct sockaddr_in6 *from, const struct in6_addr *addrs, int count);
 static void usage(void);
 inline static double lat2y(double lat);
 inline static double lon2x(double lon, double lat);
-inline static int packet_type_is_areq(char *buf);
-inline static int packet_type_is_arep(char *buf);
-inline static int is_duplicate(char *buf);
 
 void *recv_from_fifo(void *arg);
 void *recv_from_udp(void *arg);
-void *recv_from_udp_child(void *arg);
+void *recv_from_udp_shard(void *arg);
+void *tenant_dad_reaper(void *arg);
 
 #endif